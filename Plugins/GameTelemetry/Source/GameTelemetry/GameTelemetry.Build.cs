@@ -29,7 +29,9 @@ namespace UnrealBuildTool.Rules
 				{
                     "Http",
                     "Json",
-                    "JsonUtilities"
+                    "JsonUtilities",
+                    "RenderCore",
+                    "RHI"
                 });
         }
     }
@@ -13,6 +13,493 @@
 #include "TelemetryPCH.h"
 
 
+//Shortest round-trip formatting for 32-bit floats, following Ulf Adams' Ryu algorithm (PLDI 2018).
+//Telemetry positions and values are almost all floats, and printing them through a double with 17 digits
+//both costs a printf per value and turns 0.1f into 0.10000000149011612 on the wire.
+namespace TelemetryRyu
+{
+    static const int32 MantissaBits = 23;
+    static const int32 ExponentBits = 8;
+    static const int32 Bias = 127;
+    static const int32 Pow5InvBitCount = 59;
+    static const int32 Pow5BitCount = 61;
+
+    //floor(2^(Pow5Bits(i) - 1 + Pow5InvBitCount) / 5^i) + 1
+    static const uint64 Pow5InvSplit[31] = {
+    576460752303423489ull, 461168601842738791ull, 368934881474191033ull, 295147905179352826ull,
+    472236648286964522ull, 377789318629571618ull, 302231454903657294ull, 483570327845851670ull,
+    386856262276681336ull, 309485009821345069ull, 495176015714152110ull, 396140812571321688ull,
+    316912650057057351ull, 507060240091291761ull, 405648192073033409ull, 324518553658426727ull,
+    519229685853482763ull, 415383748682786211ull, 332306998946228969ull, 531691198313966350ull,
+    425352958651173080ull, 340282366920938464ull, 544451787073501542ull, 435561429658801234ull,
+    348449143727040987ull, 557518629963265579ull, 446014903970612463ull, 356811923176489971ull,
+    570899077082383953ull, 456719261665907162ull, 365375409332725730ull,
+    };
+
+    //Top Pow5BitCount bits of 5^i
+    static const uint64 Pow5Split[47] = {
+    1152921504606846976ull, 1441151880758558720ull, 1801439850948198400ull, 2251799813685248000ull,
+    1407374883553280000ull, 1759218604441600000ull, 2199023255552000000ull, 1374389534720000000ull,
+    1717986918400000000ull, 2147483648000000000ull, 1342177280000000000ull, 1677721600000000000ull,
+    2097152000000000000ull, 1310720000000000000ull, 1638400000000000000ull, 2048000000000000000ull,
+    1280000000000000000ull, 1600000000000000000ull, 2000000000000000000ull, 1250000000000000000ull,
+    1562500000000000000ull, 1953125000000000000ull, 1220703125000000000ull, 1525878906250000000ull,
+    1907348632812500000ull, 1192092895507812500ull, 1490116119384765625ull, 1862645149230957031ull,
+    1164153218269348144ull, 1455191522836685180ull, 1818989403545856475ull, 2273736754432320594ull,
+    1421085471520200371ull, 1776356839400250464ull, 2220446049250313080ull, 1387778780781445675ull,
+    1734723475976807094ull, 2168404344971008868ull, 1355252715606880542ull, 1694065894508600678ull,
+    2117582368135750847ull, 1323488980084844279ull, 1654361225106055349ull, 2067951531382569187ull,
+    1292469707114105741ull, 1615587133892632177ull, 2019483917365790221ull,
+    };
+
+    //ceil(log2(5^e)), or 1 for e == 0
+    static FORCEINLINE int32 Pow5Bits(int32 e)
+    {
+        return (int32)(((uint32)e * 1217359) >> 19) + 1;
+    }
+
+    //floor(log10(2^e))
+    static FORCEINLINE uint32 Log10Pow2(int32 e)
+    {
+        return ((uint32)e * 78913) >> 18;
+    }
+
+    //floor(log10(5^e))
+    static FORCEINLINE uint32 Log10Pow5(int32 e)
+    {
+        return ((uint32)e * 732923) >> 20;
+    }
+
+    static FORCEINLINE bool IsMultipleOfPow5(uint32 Value, uint32 Power)
+    {
+        uint32 Count = 0;
+        while (Value % 5 == 0)
+        {
+            Value /= 5;
+            Count++;
+        }
+
+        return Count >= Power;
+    }
+
+    static FORCEINLINE bool IsMultipleOfPow2(uint32 Value, uint32 Power)
+    {
+        return (Value & ((1u << Power) - 1)) == 0;
+    }
+
+    static FORCEINLINE uint32 MulShift(uint32 m, uint64 Factor, int32 Shift)
+    {
+        const uint64 Low = (uint64)m * (uint32)Factor;
+        const uint64 High = (uint64)m * (uint32)(Factor >> 32);
+        return (uint32)(((Low >> 32) + High) >> (Shift - 32));
+    }
+
+    //Finds the shortest decimal Mantissa * 10^Exponent that rounds back to the float with these bits
+    static void ToDecimal(uint32 IeeeMantissa, uint32 IeeeExponent, uint32 &OutMantissa, int32 &OutExponent)
+    {
+        int32 e2;
+        uint32 m2;
+        if (IeeeExponent == 0)
+        {
+            e2 = 1 - Bias - MantissaBits - 2;
+            m2 = IeeeMantissa;
+        }
+        else
+        {
+            e2 = (int32)IeeeExponent - Bias - MantissaBits - 2;
+            m2 = (1u << MantissaBits) | IeeeMantissa;
+        }
+
+        const bool bAcceptBounds = (m2 & 1) == 0;
+
+        //The value and the halfway points to its neighbours, all scaled by 4
+        const uint32 mv = 4 * m2;
+        const uint32 mp = 4 * m2 + 2;
+        const uint32 mmShift = (IeeeMantissa != 0 || IeeeExponent <= 1) ? 1 : 0;
+        const uint32 mm = 4 * m2 - 1 - mmShift;
+
+        uint32 vr, vp, vm;
+        int32 e10;
+        bool bVmTrailingZeros = false;
+        bool bVrTrailingZeros = false;
+        uint8 LastRemovedDigit = 0;
+
+        if (e2 >= 0)
+        {
+            const uint32 q = Log10Pow2(e2);
+            e10 = (int32)q;
+            const int32 k = Pow5InvBitCount + Pow5Bits((int32)q) - 1;
+            const int32 i = -e2 + (int32)q + k;
+            vr = MulShift(mv, Pow5InvSplit[q], i);
+            vp = MulShift(mp, Pow5InvSplit[q], i);
+            vm = MulShift(mm, Pow5InvSplit[q], i);
+
+            if (q != 0 && (vp - 1) / 10 <= vm / 10)
+            {
+                const int32 l = Pow5InvBitCount + Pow5Bits((int32)(q - 1)) - 1;
+                LastRemovedDigit = (uint8)(MulShift(mv, Pow5InvSplit[q - 1], -e2 + (int32)q - 1 + l) % 10);
+            }
+
+            if (q <= 9)
+            {
+                //Only one of mp, mv and mm can be a multiple of 5
+                if (mv % 5 == 0)
+                {
+                    bVrTrailingZeros = IsMultipleOfPow5(mv, q);
+                }
+                else if (bAcceptBounds)
+                {
+                    bVmTrailingZeros = IsMultipleOfPow5(mm, q);
+                }
+                else
+                {
+                    vp -= IsMultipleOfPow5(mp, q) ? 1 : 0;
+                }
+            }
+        }
+        else
+        {
+            const uint32 q = Log10Pow5(-e2);
+            e10 = (int32)q + e2;
+            const int32 i = -e2 - (int32)q;
+            const int32 k = Pow5Bits(i) - Pow5BitCount;
+            int32 j = (int32)q - k;
+            vr = MulShift(mv, Pow5Split[i], j);
+            vp = MulShift(mp, Pow5Split[i], j);
+            vm = MulShift(mm, Pow5Split[i], j);
+
+            if (q != 0 && (vp - 1) / 10 <= vm / 10)
+            {
+                j = (int32)q - 1 - (Pow5Bits(i + 1) - Pow5BitCount);
+                LastRemovedDigit = (uint8)(MulShift(mv, Pow5Split[i + 1], j) % 10);
+            }
+
+            if (q <= 1)
+            {
+                //mv = 4 * m2 always has at least two trailing zero bits
+                bVrTrailingZeros = true;
+                if (bAcceptBounds)
+                {
+                    bVmTrailingZeros = mmShift == 1;
+                }
+                else
+                {
+                    --vp;
+                }
+            }
+            else if (q < 31)
+            {
+                bVrTrailingZeros = IsMultipleOfPow2(mv, q - 1);
+            }
+        }
+
+        //Remove digits while the bounds still differ
+        int32 Removed = 0;
+        uint32 Output;
+        if (bVmTrailingZeros || bVrTrailingZeros)
+        {
+            while (vp / 10 > vm / 10)
+            {
+                bVmTrailingZeros &= vm % 10 == 0;
+                bVrTrailingZeros &= LastRemovedDigit == 0;
+                LastRemovedDigit = (uint8)(vr % 10);
+                vr /= 10;
+                vp /= 10;
+                vm /= 10;
+                Removed++;
+            }
+
+            if (bVmTrailingZeros)
+            {
+                while (vm % 10 == 0)
+                {
+                    bVrTrailingZeros &= LastRemovedDigit == 0;
+                    LastRemovedDigit = (uint8)(vr % 10);
+                    vr /= 10;
+                    vp /= 10;
+                    vm /= 10;
+                    Removed++;
+                }
+            }
+
+            if (bVrTrailingZeros && LastRemovedDigit == 5 && vr % 2 == 0)
+            {
+                //Round half to even
+                LastRemovedDigit = 4;
+            }
+
+            Output = vr + (((vr == vm && (!bAcceptBounds || !bVmTrailingZeros)) || LastRemovedDigit >= 5) ? 1 : 0);
+        }
+        else
+        {
+            //Common case, no trailing zeros to track
+            while (vp / 10 > vm / 10)
+            {
+                LastRemovedDigit = (uint8)(vr % 10);
+                vr /= 10;
+                vp /= 10;
+                vm /= 10;
+                Removed++;
+            }
+
+            Output = vr + ((vr == vm || LastRemovedDigit >= 5) ? 1 : 0);
+        }
+
+        OutMantissa = Output;
+        OutExponent = e10 + Removed;
+    }
+}
+
+//Writes the digits of Value backwards, ending just before End.  Returns the first digit written
+static FORCEINLINE TCHAR *WriteDigitsBackwards(uint64 Value, TCHAR *End)
+{
+    do
+    {
+        *--End = (TCHAR)(TEXT('0') + (Value % 10));
+        Value /= 10;
+    }
+    while (Value != 0);
+
+    return End;
+}
+
+//Writes Mantissa * 10^Exponent the way JavaScript prints numbers: plain notation for
+//moderate magnitudes and d.ddde+x otherwise.  Returns the number of characters written
+static int32 WriteDecimal(bool bNegative, uint64 Mantissa, int32 Exponent, TCHAR *Buffer)
+{
+    TCHAR Digits[24];
+    TCHAR *const DigitsEnd = Digits + ARRAY_COUNT(Digits);
+    const TCHAR *First = WriteDigitsBackwards(Mantissa, DigitsEnd);
+    const int32 NumDigits = (int32)(DigitsEnd - First);
+
+    //Number of digits before the decimal point
+    const int32 Point = NumDigits + Exponent;
+
+    TCHAR *Out = Buffer;
+    if (bNegative)
+    {
+        *Out++ = TEXT('-');
+    }
+
+    if (Point > 0 && Point <= 21)
+    {
+        if (Exponent >= 0)
+        {
+            for (int32 i = 0; i < NumDigits; i++)
+            {
+                *Out++ = First[i];
+            }
+            for (int32 i = 0; i < Exponent; i++)
+            {
+                *Out++ = TEXT('0');
+            }
+        }
+        else
+        {
+            for (int32 i = 0; i < NumDigits; i++)
+            {
+                if (i == Point)
+                {
+                    *Out++ = TEXT('.');
+                }
+                *Out++ = First[i];
+            }
+        }
+    }
+    else if (Point <= 0 && Point > -6)
+    {
+        *Out++ = TEXT('0');
+        *Out++ = TEXT('.');
+        for (int32 i = Point; i < 0; i++)
+        {
+            *Out++ = TEXT('0');
+        }
+        for (int32 i = 0; i < NumDigits; i++)
+        {
+            *Out++ = First[i];
+        }
+    }
+    else
+    {
+        *Out++ = First[0];
+        if (NumDigits > 1)
+        {
+            *Out++ = TEXT('.');
+            for (int32 i = 1; i < NumDigits; i++)
+            {
+                *Out++ = First[i];
+            }
+        }
+
+        int32 Scientific = Point - 1;
+        *Out++ = TEXT('e');
+        if (Scientific < 0)
+        {
+            *Out++ = TEXT('-');
+            Scientific = -Scientific;
+        }
+        else
+        {
+            *Out++ = TEXT('+');
+        }
+
+        TCHAR ExponentDigits[8];
+        TCHAR *const ExponentEnd = ExponentDigits + ARRAY_COUNT(ExponentDigits);
+        for (const TCHAR *Digit = WriteDigitsBackwards((uint64)Scientific, ExponentEnd); Digit != ExponentEnd; Digit++)
+        {
+            *Out++ = *Digit;
+        }
+    }
+
+    *Out = TEXT('\0');
+    return (int32)(Out - Buffer);
+}
+
+//Json has no representation for infinities or NaN
+static int32 WriteNull(TCHAR *Buffer)
+{
+    FCString::Strcpy(Buffer, FTelemetryJsonNumber::MaxLength, TEXT("null"));
+    return 4;
+}
+
+int32 FTelemetryJsonNumber::WriteFloat(float Value, TCHAR *Buffer)
+{
+    uint32 Bits;
+    FMemory::Memcpy(&Bits, &Value, sizeof(Bits));
+
+    const bool bNegative = (Bits >> 31) != 0;
+    const uint32 IeeeMantissa = Bits & ((1u << TelemetryRyu::MantissaBits) - 1);
+    const uint32 IeeeExponent = (Bits >> TelemetryRyu::MantissaBits) & ((1u << TelemetryRyu::ExponentBits) - 1);
+
+    if (IeeeExponent == ((1u << TelemetryRyu::ExponentBits) - 1))
+    {
+        return WriteNull(Buffer);
+    }
+
+    if (IeeeExponent == 0 && IeeeMantissa == 0)
+    {
+        return WriteUInt(0, Buffer);
+    }
+
+    uint32 Mantissa;
+    int32 Exponent;
+    TelemetryRyu::ToDecimal(IeeeMantissa, IeeeExponent, Mantissa, Exponent);
+
+    return WriteDecimal(bNegative, Mantissa, Exponent, Buffer);
+}
+
+int32 FTelemetryJsonNumber::WriteDouble(double Value, TCHAR *Buffer)
+{
+    if (!FMath::IsFinite(Value))
+    {
+        return WriteNull(Buffer);
+    }
+
+    //Whole numbers such as counters and timestamps skip printf entirely
+    if (Value == FMath::FloorToDouble(Value) && FMath::Abs(Value) < 9007199254740992.0)
+    {
+        return WriteInt((int64)Value, Buffer);
+    }
+
+    //Doubles are rare in telemetry, so these take the shortest of 15 to 17 significant digits that reads back exactly
+    ANSICHAR Text[FTelemetryJsonNumber::MaxLength];
+    for (int32 Precision = 15; Precision <= 17; Precision++)
+    {
+        FCStringAnsi::Snprintf(Text, sizeof(Text), "%.*e", Precision - 1, Value);
+        if (Precision == 17 || FCStringAnsi::Atod(Text) == Value)
+        {
+            break;
+        }
+    }
+
+    //Text is [-]d.ddde[+-]x; gather the digits and drop trailing zeros
+    const ANSICHAR *Read = Text;
+    const bool bNegative = *Read == '-';
+    if (bNegative)
+    {
+        Read++;
+    }
+
+    uint64 Mantissa = 0;
+    int32 NumFraction = 0;
+    bool bFraction = false;
+    for (; *Read != 'e' && *Read != '\0'; Read++)
+    {
+        if (*Read == '.')
+        {
+            bFraction = true;
+            continue;
+        }
+
+        Mantissa = Mantissa * 10 + (*Read - '0');
+        NumFraction += bFraction ? 1 : 0;
+    }
+
+    const int32 Exponent = (*Read == 'e') ? FCStringAnsi::Atoi(Read + 1) : 0;
+
+    int32 Scale = Exponent - NumFraction;
+    while (Mantissa != 0 && Mantissa % 10 == 0)
+    {
+        Mantissa /= 10;
+        Scale++;
+    }
+
+    return WriteDecimal(bNegative, Mantissa, Scale, Buffer);
+}
+
+int32 FTelemetryJsonNumber::WriteInt(int64 Value, TCHAR *Buffer)
+{
+    if (Value < 0)
+    {
+        //Negate as unsigned so INT64_MIN does not overflow
+        Buffer[0] = TEXT('-');
+        return WriteUInt(0 - (uint64)Value, Buffer + 1) + 1;
+    }
+
+    return WriteUInt((uint64)Value, Buffer);
+}
+
+int32 FTelemetryJsonNumber::WriteUInt(uint64 Value, TCHAR *Buffer)
+{
+    TCHAR Digits[24];
+    TCHAR *const DigitsEnd = Digits + ARRAY_COUNT(Digits);
+    const TCHAR *First = WriteDigitsBackwards(Value, DigitsEnd);
+    const int32 Length = (int32)(DigitsEnd - First);
+
+    FMemory::Memcpy(Buffer, First, Length * sizeof(TCHAR));
+    Buffer[Length] = TEXT('\0');
+    return Length;
+}
+
+//Numbers are formatted here and handed to the writer as raw Json
+static FORCEINLINE void WriteFloat(const TSharedRef<TJsonWriter<>> &Writer, const FString &Key, float Value)
+{
+    TCHAR Buffer[FTelemetryJsonNumber::MaxLength];
+    const int32 Length = FTelemetryJsonNumber::WriteFloat(Value, Buffer);
+    Writer->WriteRawJSONValue(Key, FString(Length, Buffer));
+}
+
+static FORCEINLINE void WriteDouble(const TSharedRef<TJsonWriter<>> &Writer, const FString &Key, double Value)
+{
+    TCHAR Buffer[FTelemetryJsonNumber::MaxLength];
+    const int32 Length = FTelemetryJsonNumber::WriteDouble(Value, Buffer);
+    Writer->WriteRawJSONValue(Key, FString(Length, Buffer));
+}
+
+static FORCEINLINE void WriteInt(const TSharedRef<TJsonWriter<>> &Writer, const FString &Key, int64 Value)
+{
+    TCHAR Buffer[FTelemetryJsonNumber::MaxLength];
+    const int32 Length = FTelemetryJsonNumber::WriteInt(Value, Buffer);
+    Writer->WriteRawJSONValue(Key, FString(Length, Buffer));
+}
+
+static FORCEINLINE void WriteUInt(const TSharedRef<TJsonWriter<>> &Writer, const FString &Key, uint64 Value)
+{
+    TCHAR Buffer[FTelemetryJsonNumber::MaxLength];
+    const int32 Length = FTelemetryJsonNumber::WriteUInt(Value, Buffer);
+    Writer->WriteRawJSONValue(Key, FString(Length, Buffer));
+}
+
 void FTelemetryJsonSerializer::Serialize(const FTelemetryProperties &Container, const TSharedRef<TJsonWriter<>> &Writer)
 {
     for (const FTelemetryProperty &Property : Container)
@@ -44,37 +531,37 @@ void FTelemetryJsonSerializer::Serialize(const FTelemetryProperty &Property, con
 
         // Numerics
         case EVariantTypes::Bool:
-            Writer->WriteValue<uint8>(Property.Key, Property.Value.GetValue<bool>() ? 1 : 0);
+            WriteUInt(Writer, Property.Key, Property.Value.GetValue<bool>() ? 1 : 0);
             break;
         case EVariantTypes::UInt8:
-            Writer->WriteValue<int64>(Property.Key, Property.Value.GetValue<uint8>());
+            WriteUInt(Writer, Property.Key, Property.Value.GetValue<uint8>());
             break;
         case EVariantTypes::UInt16:
-            Writer->WriteValue<int64>(Property.Key, Property.Value.GetValue<uint16>());
+            WriteUInt(Writer, Property.Key, Property.Value.GetValue<uint16>());
             break;
         case EVariantTypes::UInt32:
-            Writer->WriteValue<int64>(Property.Key, Property.Value.GetValue<uint32>());
+            WriteUInt(Writer, Property.Key, Property.Value.GetValue<uint32>());
             break;
         case EVariantTypes::UInt64:
-            Writer->WriteValue<int64>(Property.Key, Property.Value.GetValue<uint64>());
+            WriteUInt(Writer, Property.Key, Property.Value.GetValue<uint64>());
             break;
         case EVariantTypes::Int8:
-            Writer->WriteValue<int8>(Property.Key, Property.Value.GetValue<int8>());
+            WriteInt(Writer, Property.Key, Property.Value.GetValue<int8>());
             break;
         case EVariantTypes::Int16:
-            Writer->WriteValue<int16>(Property.Key, Property.Value.GetValue<int16>());
+            WriteInt(Writer, Property.Key, Property.Value.GetValue<int16>());
             break;
         case EVariantTypes::Int32:
-            Writer->WriteValue<int32>(Property.Key, Property.Value.GetValue<int32>());
+            WriteInt(Writer, Property.Key, Property.Value.GetValue<int32>());
             break;
         case EVariantTypes::Int64:
-            Writer->WriteValue<int64>(Property.Key, Property.Value.GetValue<int64>());
+            WriteInt(Writer, Property.Key, Property.Value.GetValue<int64>());
             break;
         case EVariantTypes::Float:
-            Writer->WriteValue<float>(Property.Key, Property.Value.GetValue<float>());
+            WriteFloat(Writer, Property.Key, Property.Value.GetValue<float>());
             break;
         case EVariantTypes::Double:
-            Writer->WriteValue<double>(Property.Key, Property.Value.GetValue<double>());
+            WriteDouble(Writer, Property.Key, Property.Value.GetValue<double>());
             break;
 
         // Strings
@@ -95,33 +582,33 @@ void FTelemetryJsonSerializer::Serialize(const FTelemetryProperty &Property, con
         case EVariantTypes::Vector:
         {
             FVector V(Property.Value.GetValue<FVector>());
-            Writer->WriteValue(Property.Key + "_x", V.X);
-            Writer->WriteValue(Property.Key + "_y", V.Y);
-            Writer->WriteValue(Property.Key + "_z", V.Z);
+            WriteFloat(Writer, Property.Key + "_x", V.X);
+            WriteFloat(Writer, Property.Key + "_y", V.Y);
+            WriteFloat(Writer, Property.Key + "_z", V.Z);
         }
         break;
         case EVariantTypes::Vector2d:
         {
             FVector2D V(Property.Value.GetValue<FVector2D>());
-            Writer->WriteValue(Property.Key + "_x", V.X);
-            Writer->WriteValue(Property.Key + "_y", V.Y);
+            WriteFloat(Writer, Property.Key + "_x", V.X);
+            WriteFloat(Writer, Property.Key + "_y", V.Y);
         }
         break;
         case EVariantTypes::Vector4:
         {
             FVector4 V(Property.Value.GetValue<FVector4>());
-            Writer->WriteValue(Property.Key + "_x", V.X);
-            Writer->WriteValue(Property.Key + "_y", V.Y);
-            Writer->WriteValue(Property.Key + "_z", V.Z);
-            Writer->WriteValue(Property.Key + "_w", V.W);
+            WriteFloat(Writer, Property.Key + "_x", V.X);
+            WriteFloat(Writer, Property.Key + "_y", V.Y);
+            WriteFloat(Writer, Property.Key + "_z", V.Z);
+            WriteFloat(Writer, Property.Key + "_w", V.W);
         }
         break;
         case EVariantTypes::IntVector:
         {
             FIntVector V(Property.Value.GetValue<FIntVector>());
-            Writer->WriteValue(Property.Key + "_x", V.X);
-            Writer->WriteValue(Property.Key + "_y", V.Y);
-            Writer->WriteValue(Property.Key + "_z", V.Z);
+            WriteInt(Writer, Property.Key + "_x", V.X);
+            WriteInt(Writer, Property.Key + "_y", V.Y);
+            WriteInt(Writer, Property.Key + "_z", V.Z);
         }
         break;
 
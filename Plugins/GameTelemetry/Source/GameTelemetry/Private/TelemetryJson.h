@@ -11,6 +11,22 @@
 
 #pragma once
 
+// Number formatting used by the serializer, written without going through printf
+// Floats use the fewest digits that read back to the same value, so 0.1f is sent as 0.1.
+class GAMETELEMETRY_API FTelemetryJsonNumber
+{
+public:
+    // Buffer size that fits any value written below, including the terminator
+    static const int32 MaxLength = 32;
+
+    // Each writes a terminated Json number into Buffer and returns its length
+    // Infinities and NaN have no Json form and are written as null
+    static int32 WriteFloat(float Value, TCHAR *Buffer);
+    static int32 WriteDouble(double Value, TCHAR *Buffer);
+    static int32 WriteInt(int64 Value, TCHAR *Buffer);
+    static int32 WriteUInt(uint64 Value, TCHAR *Buffer);
+};
+
 class GAMETELEMETRY_API FTelemetryJsonSerializer
 {
 public:
@@ -13,6 +13,8 @@
 #include "TelemetryPCH.h"
 #include "TelemetryService.h"
 #include "Telemetry.h"
+#include "TelemetryScope.h"
+#include "HAL/ThreadSafeCounter64.h"
 
 FString FTelemetryService::AuthenticationKey;
 bool FTelemetryService::IsInitialized = false;
@@ -24,6 +26,20 @@ bool hasInit = false;
 
 TAtomic<uint32> Sequence;
 
+// Totals behind FTelemetryManager::GetUploadStats, kept outside the worker so they outlive it
+static struct FTelemetryUploadCounters
+{
+    FThreadSafeCounter64 Recorded;
+    FThreadSafeCounter64 Dropped;
+    FThreadSafeCounter64 Sent;
+    FThreadSafeCounter64 Batches;
+    FThreadSafeCounter64 CompletedBatches;
+    FThreadSafeCounter64 FailedBatches;
+    FThreadSafeCounter64 FailedEvents;
+    FThreadSafeCounter64 Bytes;
+    FThreadSafeCounter64 SendCycles;
+} UploadCounters;
+
 class FTelemetryBatchPayload
 {
 public:
@@ -72,13 +88,150 @@ private:
     bool IsFinalized;
 };
 
+// Folds identical events within one flush window into a single event with a count
+// Events are identical if every property other than the timestamp and sequence matches
+class FTelemetryCoalescer
+{
+public:
+    void Add(const TSharedPtr<FTelemetryBuilder> &Event)
+    {
+        const FTelemetryProperties &Properties = Event->GetProperties();
+        const uint32 Hash = HashEvent(Properties);
+
+        if (const int32 *Index = Lookup.Find(Hash))
+        {
+            // Walk the chain of groups sharing this hash to rule out collisions
+            for (int32 Candidate = *Index; Candidate != INDEX_NONE; Candidate = Groups[Candidate].NextWithHash)
+            {
+                FGroup &Group = Groups[Candidate];
+                if (IsSameEvent(Group.First->GetProperties(), Properties))
+                {
+                    Group.Count++;
+                    Group.LastTimestamp = GetTimestamp(Properties);
+                    return;
+                }
+            }
+        }
+
+        const int32 NewIndex = Groups.AddDefaulted();
+        FGroup &Group = Groups[NewIndex];
+        Group.First = Event;
+        Group.Count = 1;
+        Group.FirstTimestamp = GetTimestamp(Properties);
+        Group.LastTimestamp = Group.FirstTimestamp;
+        Group.NextWithHash = INDEX_NONE;
+
+        if (int32 *Head = Lookup.Find(Hash))
+        {
+            Group.NextWithHash = *Head;
+            *Head = NewIndex;
+        }
+        else
+        {
+            Lookup.Add(Hash, NewIndex);
+        }
+    }
+
+    // Writes one event per group, in the order each group was first seen
+    void Finalize(FTelemetryBatchPayload &Payload)
+    {
+        for (FGroup &Group : Groups)
+        {
+            if (Group.Count == 1)
+            {
+                Payload.AddTelemetry(Group.First->GetProperties());
+            }
+            else
+            {
+                FTelemetryProperties Properties = Group.First->GetProperties();
+                Properties.Add(TEXT("count"), FVariant(Group.Count));
+                Properties.Add(TEXT("first_ts"), FVariant(Group.FirstTimestamp));
+                Properties.Add(TEXT("last_ts"), FVariant(Group.LastTimestamp));
+                Payload.AddTelemetry(MoveTemp(Properties));
+            }
+        }
+
+        Groups.Reset();
+        Lookup.Reset();
+    }
+
+private:
+    struct FGroup
+    {
+        TSharedPtr<FTelemetryBuilder> First;
+        int32 Count;
+        int32 NextWithHash;
+        FDateTime FirstTimestamp;
+        FDateTime LastTimestamp;
+    };
+
+    static bool IsIgnored(const FString &Key)
+    {
+        return Key == TEXT("client_ts") || Key == TEXT("seq");
+    }
+
+    static FDateTime GetTimestamp(const FTelemetryProperties &Properties)
+    {
+        const FVariant *Value = Properties.Find(TEXT("client_ts"));
+        return (Value != nullptr && Value->GetType() == EVariantTypes::DateTime) ? Value->GetValue<FDateTime>() : FDateTime::UtcNow();
+    }
+
+    // Order independent, since properties are stored in a map
+    static uint32 HashEvent(const FTelemetryProperties &Properties)
+    {
+        uint32 Hash = 0;
+        for (const FTelemetryProperty &Property : Properties)
+        {
+            if (!IsIgnored(Property.Key))
+            {
+                Hash += FCrc::MemCrc32(Property.Value.GetBytes().GetData(), Property.Value.GetBytes().Num(), FCrc::StrCrc32(*Property.Key));
+            }
+        }
+        return Hash;
+    }
+
+    static bool IsSameEvent(const FTelemetryProperties &A, const FTelemetryProperties &B)
+    {
+        int32 Compared = 0;
+        for (const FTelemetryProperty &Property : A)
+        {
+            if (IsIgnored(Property.Key))
+            {
+                continue;
+            }
+
+            const FVariant *Other = B.Find(Property.Key);
+            if (Other == nullptr || *Other != Property.Value)
+            {
+                return false;
+            }
+            Compared++;
+        }
+
+        for (const FTelemetryProperty &Property : B)
+        {
+            if (!IsIgnored(Property.Key))
+            {
+                Compared--;
+            }
+        }
+
+        return Compared == 0;
+    }
+
+private:
+    TArray<FGroup> Groups;
+    TMap<uint32, int32> Lookup;
+};
+
 class FTelemetryWorker : public FRunnable
 {
 public:
 
-    FTelemetryWorker(FString IngestUrl, double SendInterval = 10.0, int PendingBufferSize = 127) :
+    FTelemetryWorker(FString IngestUrl, double SendInterval = 10.0, int PendingBufferSize = 127, bool CoalesceEvents = false) :
         IngestUrl(IngestUrl),
         SendInterval(SendInterval),
+        CoalesceEvents(CoalesceEvents),
         ShouldRun(true),
         IsComplete(false),
         Pending(PendingBufferSize)
@@ -107,7 +260,7 @@ public:
 
             // Flush here
 
-            if (Pending.Count() > 0)
+            if (Pending.Count() > 0 || FTelemetryScopeStat::HasPendingSamples())
             {
                 SendTelemetry(FTelemetryManager::Get().GetCommonProperties());
             }
@@ -144,16 +297,26 @@ public:
 
     void Enqueue(TSharedPtr<FTelemetryBuilder> Properties)
     {
+        UploadCounters.Recorded.Increment();
+
         // Circular Queue/Buffer want SPSC model, so limit to the most likely thread telemetry will be generated on
         if (!IsInGameThread())
         {
             AsyncTask(ENamedThreads::GameThread, [this, Properties]() {
-                Pending.Enqueue(Properties);
+                EnqueuePending(Properties);
             });
         }
         else
         {
-            Pending.Enqueue(Properties);
+            EnqueuePending(Properties);
+        }
+    }
+
+    void EnqueuePending(const TSharedPtr<FTelemetryBuilder> &Properties)
+    {
+        if (!Pending.Enqueue(Properties))
+        {
+            UploadCounters.Dropped.Increment();
         }
     }
 
@@ -177,14 +340,43 @@ public:
 
     void SendTelemetry(const FTelemetryProperties &CommonProperties)
     {
+        const uint64 StartCycles = FPlatformTime::Cycles64();
+        int32 Count = 0;
+
         auto request = FTelemetryService::CreateServiceRequest();
 
         FTelemetryBatchPayload BatchPayload(CommonProperties);
 
         TSharedPtr<FTelemetryBuilder> Event;
-        while (Pending.Dequeue(Event))
+        if (CoalesceEvents)
+        {
+            while (Pending.Dequeue(Event))
+            {
+                Coalescer.Add(Event);
+                Count++;
+            }
+            Coalescer.Finalize(BatchPayload);
+        }
+        else
+        {
+            while (Pending.Dequeue(Event))
+            {
+                BatchPayload.AddTelemetry(Event->GetProperties());
+                Count++;
+            }
+        }
+
+        // Scope timings are aggregated in place and only become events once per interval, slow samples included
+        TArray<FTelemetryBuilder> ScopeSummaries;
+        TArray<FTelemetryBuilder> SlowSamples;
+        FTelemetryScopeStat::CollectSummaries(ScopeSummaries, SlowSamples);
+        for (FTelemetryBuilder &Summary : ScopeSummaries)
+        {
+            BatchPayload.AddTelemetry(FTelemetryManager::CreateEvent(TEXT("scope_timing"), TEXT("Performance"), TEXT("1.0.0"), MoveTemp(Summary))->GetProperties());
+        }
+        for (FTelemetryBuilder &Sample : SlowSamples)
         {
-            BatchPayload.AddTelemetry(Event->GetProperties());
+            BatchPayload.AddTelemetry(FTelemetryManager::CreateEvent(TEXT("scope_slow"), TEXT("Performance"), TEXT("1.0.0"), MoveTemp(Sample))->GetProperties());
         }
 
         request->SetURL(IngestUrl);
@@ -205,8 +397,20 @@ public:
             request->SetContentAsString(Payload);
         }
 
-        request->OnProcessRequestComplete().BindLambda([](FHttpRequestPtr req, FHttpResponsePtr resp, bool successful)
+        UploadCounters.Sent.Add(Count);
+        UploadCounters.Batches.Increment();
+        UploadCounters.Bytes.Add(request->GetContentLength());
+        UploadCounters.SendCycles.Add(FPlatformTime::Cycles64() - StartCycles);
+
+        request->OnProcessRequestComplete().BindLambda([Count](FHttpRequestPtr req, FHttpResponsePtr resp, bool successful)
         {
+            UploadCounters.CompletedBatches.Increment();
+            if (!successful || !resp.IsValid() || resp->GetResponseCode() >= 400)
+            {
+                UploadCounters.FailedBatches.Increment();
+                UploadCounters.FailedEvents.Add(Count);
+            }
+
             UE_LOG(LogTelemetry, Display, TEXT("Http telemetry ingestion attempt %s."), successful ? TEXT("succeeded") : TEXT("failed"));
             if (resp.IsValid())
             {
@@ -229,6 +433,8 @@ private:
     TUniquePtr<FRunnableThread> Thread;
     TUniquePtr<FEvent> Sync;
     double SendInterval;
+    bool CoalesceEvents;
+    FTelemetryCoalescer Coalescer;
     bool ShouldRun;
     bool IsComplete;
     FString IngestUrl;
@@ -248,6 +454,8 @@ FTelemetryConfiguration FTelemetryManager::GetConfigFromIni()
     FTelemetryConfiguration::GetString(TEXT("IngestUrl"), Config.IngestionUrl);
     FTelemetryConfiguration::GetDouble(TEXT("SendInterval"), Config.SendInterval);
     FTelemetryConfiguration::GetInt(TEXT("MaxBufferSize"), Config.PendingBufferSize);
+    FTelemetryConfiguration::GetFloat(TEXT("ScopeRawThreshold"), Config.ScopeRawThreshold);
+    FTelemetryConfiguration::GetBool(TEXT("CoalesceEvents"), Config.CoalesceEvents);
 
     return Config;
 }
@@ -279,7 +487,9 @@ void FTelemetryManager::Initialize(const FTelemetryConfiguration & Config)
     //Process ID
     Instance->CommonProperties.SetProperty(L"process_id", FGenericPlatformProcess::GetCurrentProcessId());
 
-    TelemetryWorker = MakeUnique<FTelemetryWorker>(Config.IngestionUrl, Config.SendInterval, Config.PendingBufferSize);
+    FTelemetryScopeStat::SetDefaultRawThreshold(Config.ScopeRawThreshold);
+
+    TelemetryWorker = MakeUnique<FTelemetryWorker>(Config.IngestionUrl, Config.SendInterval, Config.PendingBufferSize, Config.CoalesceEvents);
     hasInit = true;
 }
 
@@ -287,17 +497,7 @@ void FTelemetryManager::Record(const FString &Name, const FString &Category, con
 {
     if (hasInit)
     {
-        TSharedPtr<FTelemetryBuilder> Evt(new FTelemetryBuilder(MoveTemp(Properties)));
-
-        Evt->SetProperty(FTelemetry::ClientTimestamp());
-        Evt->SetProperty(FTelemetry::EventName(Name));
-        Evt->SetProperty(FTelemetry::Category(Category));
-        Evt->SetProperty(FTelemetry::Version(Version));
-
-        uint32 CurrentSequence = Sequence++;
-        Evt->SetProperty(TEXT("seq"), FVariant(CurrentSequence));
-
-        TelemetryWorker->Enqueue(Evt);
+        TelemetryWorker->Enqueue(CreateEvent(Name, Category, Version, MoveTemp(Properties)));
     }
     else
     {
@@ -306,6 +506,44 @@ void FTelemetryManager::Record(const FString &Name, const FString &Category, con
 
 }
 
+TSharedPtr<FTelemetryBuilder> FTelemetryManager::CreateEvent(const FString &Name, const FString &Category, const FString &Version, FTelemetryBuilder &&Properties)
+{
+    TSharedPtr<FTelemetryBuilder> Evt(new FTelemetryBuilder(MoveTemp(Properties)));
+
+    Evt->SetProperty(FTelemetry::ClientTimestamp());
+    Evt->SetProperty(FTelemetry::EventName(Name));
+    Evt->SetProperty(FTelemetry::Category(Category));
+    Evt->SetProperty(FTelemetry::Version(Version));
+
+    uint32 CurrentSequence = Sequence++;
+    Evt->SetProperty(TEXT("seq"), FVariant(CurrentSequence));
+
+    return Evt;
+}
+
+void FTelemetryManager::Flush()
+{
+    if (hasInit)
+    {
+        TelemetryWorker->TriggerFlush();
+    }
+}
+
+FTelemetryUploadStats FTelemetryManager::GetUploadStats()
+{
+    FTelemetryUploadStats Stats;
+    Stats.Recorded = UploadCounters.Recorded.GetValue();
+    Stats.Dropped = UploadCounters.Dropped.GetValue();
+    Stats.Sent = UploadCounters.Sent.GetValue();
+    Stats.Batches = UploadCounters.Batches.GetValue();
+    Stats.CompletedBatches = UploadCounters.CompletedBatches.GetValue();
+    Stats.FailedBatches = UploadCounters.FailedBatches.GetValue();
+    Stats.FailedEvents = UploadCounters.FailedEvents.GetValue();
+    Stats.Bytes = UploadCounters.Bytes.GetValue();
+    Stats.SendSeconds = FPlatformTime::ToSeconds64(UploadCounters.SendCycles.GetValue());
+    return Stats;
+}
+
 inline void FTelemetryManager::SetClientId(const FString & InClientId)
 {
     Instance->CommonProperties.SetProperty(FTelemetry::ClientId(InClientId));
@@ -0,0 +1,218 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//--------------------------------------------------------------------------------------
+// TelemetryPerformance.cpp
+//
+// Automatic frame time and hitch capture
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "TelemetryPerformance.h"
+#include "TelemetryPCH.h"
+#include "Telemetry.h"
+#include "Containers/Ticker.h"
+#include "RenderCore.h"
+#include "RHI.h"
+
+static const TCHAR *PerformanceCategory = TEXT("Performance");
+static const TCHAR *PerformanceVersion = TEXT("1.0.0");
+
+FTelemetryPerformanceSettings FTelemetryPerformanceSettings::GetFromIni()
+{
+    FTelemetryPerformanceSettings Settings;
+
+    FString Mode;
+    if (FTelemetryConfiguration::GetString(TEXT("PerfCaptureMode"), Mode))
+    {
+        if (Mode == TEXT("Hitches"))
+        {
+            Settings.Mode = ETelemetryPerformanceMode::Hitches;
+        }
+        else if (Mode == TEXT("All"))
+        {
+            Settings.Mode = ETelemetryPerformanceMode::All;
+        }
+    }
+
+    FTelemetryConfiguration::GetDouble(TEXT("PerfSummaryInterval"), Settings.SummaryInterval);
+    FTelemetryConfiguration::GetFloat(TEXT("PerfHitchThreshold"), Settings.HitchThreshold);
+    FTelemetryConfiguration::GetDouble(TEXT("PerfHitchCooldown"), Settings.HitchCooldown);
+
+    return Settings;
+}
+
+FTelemetryPerformanceCapture::FTelemetryPerformanceCapture(const FTelemetryPerformanceSettings &Settings) :
+    Settings(Settings),
+    ContextProvider(nullptr),
+    LastHitchTime(0)
+{
+    ResetSummary();
+}
+
+FTelemetryPerformanceCapture::~FTelemetryPerformanceCapture()
+{
+    if (IsRunning())
+    {
+        FTicker::GetCoreTicker().RemoveTicker(TickHandle);
+        TickHandle.Reset();
+    }
+}
+
+void FTelemetryPerformanceCapture::Start(ITelemetryProvider *InContextProvider)
+{
+    if (IsRunning())
+    {
+        return;
+    }
+
+    ContextProvider = InContextProvider;
+    ResetSummary();
+
+    TickHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(this, &FTelemetryPerformanceCapture::Tick));
+}
+
+void FTelemetryPerformanceCapture::Stop()
+{
+    if (!IsRunning())
+    {
+        return;
+    }
+
+    FTicker::GetCoreTicker().RemoveTicker(TickHandle);
+    TickHandle.Reset();
+
+    if (Settings.Mode != ETelemetryPerformanceMode::Hitches && FrameCount > 0)
+    {
+        RecordSummary();
+    }
+
+    ContextProvider = nullptr;
+}
+
+FTelemetryPerformanceCapture::FFrameSample FTelemetryPerformanceCapture::Sample(float DeltaTime) const
+{
+    //These are the same counters "stat unit" reads, so sampling them costs nothing extra
+    FFrameSample Frame;
+    Frame.Frame = DeltaTime * 1000.f;
+    Frame.Game = FPlatformTime::ToMilliseconds(GGameThreadTime);
+    Frame.Render = FPlatformTime::ToMilliseconds(GRenderThreadTime);
+    Frame.GPU = FPlatformTime::ToMilliseconds(RHIGetGPUFrameCycles());
+    Frame.GPUWait = FPlatformTime::ToMilliseconds(GRenderThreadIdle[ERenderThreadIdleTypes::WaitingForGPUQuery] + GRenderThreadIdle[ERenderThreadIdleTypes::WaitingForGPUPresent]);
+
+    return Frame;
+}
+
+bool FTelemetryPerformanceCapture::Tick(float DeltaTime)
+{
+    const FFrameSample Frame = Sample(DeltaTime);
+    const double Now = FPlatformTime::Seconds();
+
+    FrameCount++;
+    Total.Frame += Frame.Frame;
+    Total.Game += Frame.Game;
+    Total.Render += Frame.Render;
+    Total.GPU += Frame.GPU;
+    Total.GPUWait += Frame.GPUWait;
+    Worst.Frame = FMath::Max(Worst.Frame, Frame.Frame);
+    Worst.Game = FMath::Max(Worst.Game, Frame.Game);
+    Worst.Render = FMath::Max(Worst.Render, Frame.Render);
+    Worst.GPU = FMath::Max(Worst.GPU, Frame.GPU);
+    Worst.GPUWait = FMath::Max(Worst.GPUWait, Frame.GPUWait);
+
+    if (Frame.Frame > Settings.HitchThreshold)
+    {
+        HitchCount++;
+
+        if (Settings.Mode != ETelemetryPerformanceMode::Summary && Now - LastHitchTime >= Settings.HitchCooldown)
+        {
+            RecordHitch(Frame);
+            LastHitchTime = Now;
+        }
+    }
+
+    if (Settings.Mode != ETelemetryPerformanceMode::Hitches && Now - IntervalStart >= Settings.SummaryInterval)
+    {
+        RecordSummary();
+        ResetSummary();
+    }
+
+    return true;
+}
+
+//Reports which part of the frame was the most expensive
+static const TCHAR *GetBoundThread(float Game, float Render, float GPU)
+{
+    if (GPU >= Game && GPU >= Render)
+    {
+        return TEXT("gpu");
+    }
+
+    return (Game >= Render) ? TEXT("game") : TEXT("render");
+}
+
+void FTelemetryPerformanceCapture::RecordHitch(const FFrameSample &Frame)
+{
+    FTelemetryBuilder Builder;
+
+    if (ContextProvider != nullptr)
+    {
+        Builder.GetPropertiesFromProvider(*ContextProvider);
+    }
+
+    Builder.SetProperties({
+        FTelemetry::Value(TEXT("frame_ms"), Frame.Frame),
+        FTelemetry::Value(TEXT("game_ms"), Frame.Game),
+        FTelemetry::Value(TEXT("render_ms"), Frame.Render),
+        FTelemetry::Value(TEXT("gpu_ms"), Frame.GPU),
+        FTelemetry::Value(TEXT("gpu_wait_ms"), Frame.GPUWait),
+        FTelemetry::Prop(TEXT("bound"), FString(GetBoundThread(Frame.Game, Frame.Render, Frame.GPU))),
+    });
+
+    FTelemetryManager::Get().Record(TEXT("perf_hitch"), PerformanceCategory, PerformanceVersion, MoveTemp(Builder));
+}
+
+void FTelemetryPerformanceCapture::RecordSummary()
+{
+    if (FrameCount == 0)
+    {
+        return;
+    }
+
+    const float Count = (float)FrameCount;
+    const float AverageFrame = Total.Frame / Count;
+
+    FTelemetryBuilder Builder;
+
+    if (ContextProvider != nullptr)
+    {
+        Builder.GetPropertiesFromProvider(*ContextProvider);
+    }
+
+    Builder.SetProperties({
+        FTelemetry::Value(TEXT("frame_ms"), AverageFrame),
+        FTelemetry::Value(TEXT("frame_max_ms"), Worst.Frame),
+        FTelemetry::Value(TEXT("game_ms"), Total.Game / Count),
+        FTelemetry::Value(TEXT("game_max_ms"), Worst.Game),
+        FTelemetry::Value(TEXT("render_ms"), Total.Render / Count),
+        FTelemetry::Value(TEXT("render_max_ms"), Worst.Render),
+        FTelemetry::Value(TEXT("gpu_ms"), Total.GPU / Count),
+        FTelemetry::Value(TEXT("gpu_max_ms"), Worst.GPU),
+        FTelemetry::Value(TEXT("gpu_wait_ms"), Total.GPUWait / Count),
+        FTelemetry::Value(TEXT("fps"), AverageFrame > 0.f ? 1000.f / AverageFrame : 0.f),
+        FTelemetry::Value(TEXT("hitches"), (float)HitchCount),
+        FTelemetry::Prop(TEXT("frames"), FrameCount),
+    });
+
+    FTelemetryManager::Get().Record(TEXT("perf_summary"), PerformanceCategory, PerformanceVersion, MoveTemp(Builder));
+}
+
+void FTelemetryPerformanceCapture::ResetSummary()
+{
+    IntervalStart = FPlatformTime::Seconds();
+    FrameCount = 0;
+    HitchCount = 0;
+    Total = { 0.f, 0.f, 0.f, 0.f, 0.f };
+    Worst = { 0.f, 0.f, 0.f, 0.f, 0.f };
+}
@@ -0,0 +1,246 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//--------------------------------------------------------------------------------------
+// TelemetryScope.cpp
+//
+// Scoped timers that aggregate durations before they are sent
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "TelemetryScope.h"
+#include "TelemetryPCH.h"
+#include "Telemetry.h"
+#include "Misc/ScopeLock.h"
+
+FTelemetryScopeStat *FTelemetryScopeStat::Head = nullptr;
+float FTelemetryScopeStat::DefaultRawThreshold = 0.f;
+
+//Guards the list of scopes.  A function static, since scopes in other modules may be constructed before the statics of
+//this one
+static FCriticalSection &GetListLock()
+{
+    static FCriticalSection ListLock;
+    return ListLock;
+}
+
+//Upper bound of a histogram bucket in milliseconds
+static inline double GetBucketLimit(int32 Bucket)
+{
+    return (double)(1ull << Bucket) / 1000.0;
+}
+
+FTelemetryScopeStat::FTelemetryScopeStat(const TCHAR *Name, float RawThreshold) :
+    Name(Name),
+    RawThreshold(RawThreshold),
+    Count(0),
+    TotalCycles(0),
+    MaxCycles(0),
+    DroppedSlowSamples(0)
+{
+    FMemory::Memzero((void *)Buckets, sizeof(Buckets));
+    FMemory::Memzero((void *)SlowSamples, sizeof(SlowSamples));
+
+    //Scopes are usually function statics, so they can be constructed on any thread at any time
+    FScopeLock Lock(&GetListLock());
+    Next = Head;
+    Head = this;
+}
+
+FTelemetryScopeStat::~FTelemetryScopeStat()
+{
+    //Samples not yet drained are lost with the module that recorded them
+    FScopeLock Lock(&GetListLock());
+    for (FTelemetryScopeStat **Link = &Head; *Link != nullptr; Link = &(*Link)->Next)
+    {
+        if (*Link == this)
+        {
+            *Link = Next;
+            break;
+        }
+    }
+}
+
+void FTelemetryScopeStat::AddSample(uint64 Cycles)
+{
+    const double Microseconds = FPlatformTime::ToSeconds64(Cycles) * 1000000.0;
+
+    int32 Bucket = 0;
+    if (Microseconds >= 1.0)
+    {
+        Bucket = (Microseconds >= (double)(1u << (NumBuckets - 2))) ? NumBuckets - 1 : (int32)FMath::FloorLog2((uint32)Microseconds) + 1;
+    }
+
+    FPlatformAtomics::InterlockedIncrement(&Buckets[Bucket]);
+    FPlatformAtomics::InterlockedIncrement(&Count);
+    FPlatformAtomics::InterlockedAdd(&TotalCycles, (int64)Cycles);
+
+    int64 CurrentMax = MaxCycles;
+    while ((int64)Cycles > CurrentMax)
+    {
+        const int64 Previous = FPlatformAtomics::InterlockedCompareExchange(&MaxCycles, (int64)Cycles, CurrentMax);
+        if (Previous == CurrentMax)
+        {
+            break;
+        }
+        CurrentMax = Previous;
+    }
+
+    const float Threshold = (RawThreshold < 0.f) ? DefaultRawThreshold : RawThreshold;
+
+    if (Threshold > 0.f && Microseconds > Threshold * 1000.0)
+    {
+        //Claim a free slot rather than record the event here, so a slow frame does not also pay for building one.
+        //Slow samples are rare, so scanning the few slots costs nothing next to the sample itself
+        for (int32 i = 0; i < MaxSlowSamples; i++)
+        {
+            if (SlowSamples[i] == 0 && FPlatformAtomics::InterlockedCompareExchange(&SlowSamples[i], (int64)Cycles, 0) == 0)
+            {
+                return;
+            }
+        }
+
+        FPlatformAtomics::InterlockedIncrement(&DroppedSlowSamples);
+    }
+}
+
+void FTelemetryScopeStat::DrainSlowSamples(TArray<FTelemetryBuilder> &OutSlowSamples)
+{
+    for (int32 i = 0; i < MaxSlowSamples; i++)
+    {
+        if (SlowSamples[i] == 0)
+        {
+            continue;
+        }
+
+        const int64 Cycles = FPlatformAtomics::InterlockedExchange(&SlowSamples[i], 0);
+
+        FTelemetryBuilder Event;
+        Event.SetProperties({
+            FTelemetry::Prop(TEXT("scope"), FString(Name)),
+            FTelemetry::Value(TEXT("duration_ms"), (float)(FPlatformTime::ToSeconds64(Cycles) * 1000.0)),
+        });
+        OutSlowSamples.Add(MoveTemp(Event));
+    }
+
+    const int32 Dropped = (DroppedSlowSamples > 0) ? FPlatformAtomics::InterlockedExchange(&DroppedSlowSamples, 0) : 0;
+    if (Dropped > 0)
+    {
+        UE_LOG(LogTelemetry, Verbose, TEXT("%d slow samples of %s over the last interval were not sent"), Dropped, Name);
+    }
+}
+
+bool FTelemetryScopeStat::Drain(FTelemetryBuilder &OutSummary)
+{
+    if (Count == 0)
+    {
+        return false;
+    }
+
+    //Each field is swapped out on its own, so a sample landing mid-drain may be split across two summaries.
+    //Totals over time are still exact, which is what matters when summaries are merged.
+    const int64 SampleCount = FPlatformAtomics::InterlockedExchange(&Count, 0);
+    const int64 SampleCycles = FPlatformAtomics::InterlockedExchange(&TotalCycles, 0);
+    const int64 SampleMax = FPlatformAtomics::InterlockedExchange(&MaxCycles, 0);
+
+    int32 Histogram[NumBuckets];
+    int32 LastBucket = 0;
+    int64 HistogramCount = 0;
+    for (int32 i = 0; i < NumBuckets; i++)
+    {
+        Histogram[i] = FPlatformAtomics::InterlockedExchange(&Buckets[i], 0);
+        HistogramCount += Histogram[i];
+        if (Histogram[i] > 0)
+        {
+            LastBucket = i;
+        }
+    }
+
+    if (SampleCount <= 0)
+    {
+        return false;
+    }
+
+    //Percentiles are the upper bound of the bucket they fall in
+    double P50 = 0;
+    double P95 = 0;
+    int64 Running = 0;
+    for (int32 i = 0; i <= LastBucket; i++)
+    {
+        Running += Histogram[i];
+        if (P50 == 0 && Running * 2 >= HistogramCount)
+        {
+            P50 = GetBucketLimit(i);
+        }
+        if (P95 == 0 && Running * 100 >= HistogramCount * 95)
+        {
+            P95 = GetBucketLimit(i);
+        }
+    }
+
+    //Bucket counts are sent as text so summaries from many clients can be added together after ingestion
+    FString HistogramText;
+    for (int32 i = 0; i <= LastBucket; i++)
+    {
+        if (i > 0)
+        {
+            HistogramText.AppendChar(TEXT(','));
+        }
+        HistogramText.AppendInt(Histogram[i]);
+    }
+
+    const double TotalMs = FPlatformTime::ToSeconds64(SampleCycles) * 1000.0;
+
+    OutSummary.SetProperties({
+        FTelemetry::Prop(TEXT("scope"), FString(Name)),
+        FTelemetry::Prop(TEXT("hist"), HistogramText),
+        FTelemetry::Value(TEXT("count"), (float)SampleCount),
+        FTelemetry::Value(TEXT("total_ms"), (float)TotalMs),
+        FTelemetry::Value(TEXT("avg_ms"), (float)(TotalMs / SampleCount)),
+        FTelemetry::Value(TEXT("max_ms"), (float)(FPlatformTime::ToSeconds64(SampleMax) * 1000.0)),
+        FTelemetry::Value(TEXT("p50_ms"), (float)P50),
+        FTelemetry::Value(TEXT("p95_ms"), (float)P95),
+    });
+
+    return true;
+}
+
+void FTelemetryScopeStat::CollectSummaries(TArray<FTelemetryBuilder> &OutSummaries, TArray<FTelemetryBuilder> &OutSlowSamples)
+{
+    //Held while draining so a module cannot unload a scope, or the name it points to, underneath the worker
+    FScopeLock Lock(&GetListLock());
+    for (FTelemetryScopeStat *Stat = Head; Stat != nullptr; Stat = Stat->Next)
+    {
+        //Slots are drained on their own, since a sample may claim one after its count was already drained
+        Stat->DrainSlowSamples(OutSlowSamples);
+
+        FTelemetryBuilder Summary;
+        if (Stat->Drain(Summary))
+        {
+            OutSummaries.Add(MoveTemp(Summary));
+        }
+    }
+}
+
+bool FTelemetryScopeStat::HasPendingSamples()
+{
+    FScopeLock Lock(&GetListLock());
+    for (FTelemetryScopeStat *Stat = Head; Stat != nullptr; Stat = Stat->Next)
+    {
+        if (Stat->Count > 0)
+        {
+            return true;
+        }
+
+        for (int32 i = 0; i < MaxSlowSamples; i++)
+        {
+            if (Stat->SlowSamples[i] != 0)
+            {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,168 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//--------------------------------------------------------------------------------------
+// TelemetryStats.cpp
+//
+// Forwards engine counters and Low-Level Memory tracker tags to telemetry
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "TelemetryStats.h"
+#include "TelemetryPCH.h"
+#include "Telemetry.h"
+#include "Containers/Ticker.h"
+#include "HAL/LowLevelMemTracker.h"
+#include "RHI.h"
+
+static const double BytesPerMegabyte = 1024.0 * 1024.0;
+
+FTelemetryStatsSettings FTelemetryStatsSettings::GetFromIni()
+{
+    FTelemetryStatsSettings Settings;
+
+    FTelemetryConfiguration::GetDouble(TEXT("StatsInterval"), Settings.Interval);
+
+    FString Names;
+    if (FTelemetryConfiguration::GetString(TEXT("StatsCounters"), Names))
+    {
+        Names.ParseIntoArray(Settings.Counters, TEXT(","), true);
+    }
+
+    if (FTelemetryConfiguration::GetString(TEXT("StatsLLMTags"), Names))
+    {
+        Names.ParseIntoArray(Settings.LLMTags, TEXT(","), true);
+    }
+
+    for (FString &Name : Settings.Counters)
+    {
+        Name.TrimStartAndEndInline();
+    }
+
+    for (FString &Name : Settings.LLMTags)
+    {
+        Name.TrimStartAndEndInline();
+    }
+
+    return Settings;
+}
+
+FTelemetryStatsBridge::FTelemetryStatsBridge(const FTelemetryStatsSettings &Settings) :
+    Settings(Settings),
+    ContextProvider(nullptr)
+{
+    RegisterDefaultCounters();
+}
+
+FTelemetryStatsBridge::~FTelemetryStatsBridge()
+{
+    if (IsRunning())
+    {
+        FTicker::GetCoreTicker().RemoveTicker(TickHandle);
+        TickHandle.Reset();
+    }
+}
+
+void FTelemetryStatsBridge::RegisterDefaultCounters()
+{
+    RegisterCounter(TEXT("drawcalls"), []() { return (double)GNumDrawCallsRHI; });
+    RegisterCounter(TEXT("primitives"), []() { return (double)GNumPrimitivesDrawnRHI; });
+    RegisterCounter(TEXT("mem_physical_mb"), []() { return FPlatformMemory::GetStats().UsedPhysical / BytesPerMegabyte; });
+    RegisterCounter(TEXT("mem_virtual_mb"), []() { return FPlatformMemory::GetStats().UsedVirtual / BytesPerMegabyte; });
+    RegisterCounter(TEXT("mem_physical_peak_mb"), []() { return FPlatformMemory::GetStats().PeakUsedPhysical / BytesPerMegabyte; });
+}
+
+void FTelemetryStatsBridge::RegisterCounter(const FString &Name, FCounterReader Reader)
+{
+    Readers.Add(Name, MoveTemp(Reader));
+}
+
+void FTelemetryStatsBridge::Start(ITelemetryProvider *InContextProvider)
+{
+    if (IsRunning())
+    {
+        return;
+    }
+
+    ContextProvider = InContextProvider;
+
+    for (const FString &Name : Settings.Counters)
+    {
+        if (!Readers.Contains(Name))
+        {
+            UE_LOG(LogTelemetry, Warning, TEXT("Unknown telemetry stats counter '%s' will not be sent."), *Name);
+        }
+    }
+
+#if !ENABLE_LOW_LEVEL_MEM_TRACKER
+    if (Settings.LLMTags.Num() > 0)
+    {
+        UE_LOG(LogTelemetry, Warning, TEXT("Low-Level Memory tracker tags are configured, but the tracker is not enabled in this build."));
+    }
+#endif
+
+    TickHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(this, &FTelemetryStatsBridge::Tick), Settings.Interval);
+}
+
+void FTelemetryStatsBridge::Stop()
+{
+    if (IsRunning())
+    {
+        FTicker::GetCoreTicker().RemoveTicker(TickHandle);
+        TickHandle.Reset();
+    }
+
+    ContextProvider = nullptr;
+}
+
+bool FTelemetryStatsBridge::Tick(float DeltaTime)
+{
+    RecordStats();
+    return true;
+}
+
+void FTelemetryStatsBridge::RecordStats()
+{
+    FTelemetryBuilder Builder;
+
+    if (ContextProvider != nullptr)
+    {
+        Builder.GetPropertiesFromProvider(*ContextProvider);
+    }
+
+    int32 ValueCount = 0;
+
+    for (const FString &Name : Settings.Counters)
+    {
+        const FCounterReader *Reader = Readers.Find(Name);
+        if (Reader != nullptr)
+        {
+            Builder.SetProperty(FTelemetry::Value(Name, (float)(*Reader)()));
+            ValueCount++;
+        }
+    }
+
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+    FLowLevelMemTracker &Tracker = FLowLevelMemTracker::Get();
+
+    if (Tracker.IsEnabled())
+    {
+        for (const FString &Name : Settings.LLMTags)
+        {
+            uint64 Tag;
+            if (Tracker.FindTagByName(*Name, Tag))
+            {
+                const int64 Amount = Tracker.GetTagAmountForTracker(ELLMTracker::Default, (ELLMTag)Tag);
+                Builder.SetProperty(FTelemetry::Value(TEXT("llm_") + Name + TEXT("_mb"), (float)(Amount / BytesPerMegabyte)));
+                ValueCount++;
+            }
+        }
+    }
+#endif
+
+    if (ValueCount > 0)
+    {
+        FTelemetryManager::Get().Record(TEXT("engine_stats"), TEXT("Performance"), TEXT("1.0.0"), MoveTemp(Builder));
+    }
+}
@@ -0,0 +1,129 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//--------------------------------------------------------------------------------------
+// TelemetryTrail.cpp
+//
+// Movement trail recording with dead-reckoning compression
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "TelemetryTrail.h"
+#include "TelemetryPCH.h"
+#include "Telemetry.h"
+
+FTelemetryTrailRecorder::FTelemetryTrailRecorder(const FString &Name, const FString &Category, const FString &Version, const FTelemetryTrailSettings &Settings) :
+    Name(Name),
+    Category(Category),
+    Version(Version),
+    Settings(Settings)
+{
+    Reset();
+}
+
+void FTelemetryTrailRecorder::Reset()
+{
+    HasSent = false;
+    HasLatest = false;
+    LatestSent = false;
+    UpdateCount = 0;
+    SampleCount = 0;
+}
+
+void FTelemetryTrailRecorder::Update(const FVector &Position, const FVector &Orientation, double Time)
+{
+    FTrailSample Current;
+    Current.Position = Position;
+    Current.Orientation = Orientation;
+    Current.Time = Time;
+    Current.Velocity = FVector::ZeroVector;
+
+    //Velocity is estimated from the previous update so the prediction follows the most recent movement
+    if (HasLatest && Time > Latest.Time)
+    {
+        Current.Velocity = (Position - Latest.Position) / (Time - Latest.Time);
+    }
+
+    UpdateCount++;
+
+    if (ShouldSend(Current))
+    {
+        Send(Current);
+        LatestSent = true;
+    }
+    else
+    {
+        LatestSent = false;
+    }
+
+    Latest = Current;
+    HasLatest = true;
+}
+
+void FTelemetryTrailRecorder::Flush()
+{
+    if (HasLatest && !LatestSent)
+    {
+        Send(Latest);
+        LatestSent = true;
+    }
+}
+
+bool FTelemetryTrailRecorder::ShouldSend(const FTrailSample &Current) const
+{
+    //Always start a trail with a sample
+    if (!HasSent)
+    {
+        return true;
+    }
+
+    const double Elapsed = Current.Time - LastSent.Time;
+
+    if (Elapsed < Settings.MinInterval)
+    {
+        return false;
+    }
+
+    if (Elapsed >= Settings.MaxInterval)
+    {
+        return true;
+    }
+
+    //Compare against where the last sample said we would be by now
+    const FVector Predicted = LastSent.Position + LastSent.Velocity * Elapsed;
+    if (FVector::DistSquared(Predicted, Current.Position) > FMath::Square(Settings.DistanceThreshold))
+    {
+        return true;
+    }
+
+    const FVector LastDir = LastSent.Orientation.GetSafeNormal();
+    const FVector CurrentDir = Current.Orientation.GetSafeNormal();
+    if (!LastDir.IsZero() && !CurrentDir.IsZero())
+    {
+        const float CosAngle = FMath::Clamp(FVector::DotProduct(LastDir, CurrentDir), -1.f, 1.f);
+        if (FMath::RadiansToDegrees(FMath::Acos(CosAngle)) > Settings.AngleThreshold)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void FTelemetryTrailRecorder::Send(const FTrailSample &Sample)
+{
+    FTelemetryBuilder Builder(ExtraProperties);
+    Builder.SetProperties({
+        FTelemetry::Position(Sample.Position),
+        FTelemetry::Orientation(Sample.Orientation),
+        FTelemetry::Prop(TEXT("vel"), Sample.Velocity),
+        FTelemetry::Value(TEXT("speed"), Sample.Velocity.Size()),
+    });
+
+    FTelemetryManager::Get().Record(Name, Category, Version, MoveTemp(Builder));
+
+    LastSent = Sample;
+    HasSent = true;
+    SampleCount++;
+}
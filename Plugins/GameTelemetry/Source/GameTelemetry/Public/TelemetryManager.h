@@ -28,6 +28,12 @@ public:
     // Number of events that can be pending before events are lost
     int32 PendingBufferSize = 128;
 
+    // Default duration (in milliseconds) over which a TELEMETRY_SCOPE also sends an individual event.  Zero disables them
+    float ScopeRawThreshold = 0.f;
+
+    // Fold identical events sent in the same interval into one event with count, first_ts and last_ts
+    bool CoalesceEvents = false;
+
 public:
     static const FString &GetIniFileName() { return IniFileName; }
     static const FString &GetIniSectionName() { return IniSectionName; }
@@ -35,12 +41,40 @@ public:
     static bool GetString(const TCHAR *Key, FString &Value) { return GConfig->GetString(*IniSectionName, Key, Value, IniFileName); }
     static bool GetDouble(const TCHAR *Key, double &Value) { return GConfig->GetDouble(*IniSectionName, Key, Value, IniFileName); }
     static bool GetInt(const TCHAR *Key, int32 &Value) { return GConfig->GetInt(*IniSectionName, Key, Value, IniFileName); }
+    static bool GetFloat(const TCHAR *Key, float &Value) { return GConfig->GetFloat(*IniSectionName, Key, Value, IniFileName); }
+    static bool GetBool(const TCHAR *Key, bool &Value) { return GConfig->GetBool(*IniSectionName, Key, Value, IniFileName); }
 
 private:
     static FString IniFileName;
     static FString IniSectionName;
 };
 
+// Counts of the events passing through the uploader since the process started
+struct FTelemetryUploadStats
+{
+    // Events handed to the uploader by Record
+    int64 Recorded = 0;
+
+    // Events lost because the pending buffer was full
+    int64 Dropped = 0;
+
+    // Events written to a batch
+    int64 Sent = 0;
+
+    // Batches posted, answered, and answered with a failure
+    int64 Batches = 0;
+    int64 CompletedBatches = 0;
+    int64 FailedBatches = 0;
+
+    // Events in the batches that failed
+    int64 FailedEvents = 0;
+
+    // Bytes posted, after compression
+    int64 Bytes = 0;
+
+    // Seconds the upload thread spent building, serializing and compressing batches
+    double SendSeconds = 0.0;
+};
 
 class GAMETELEMETRY_API FTelemetryManager
 {
@@ -104,6 +138,21 @@ public:
     */
     void Record(const FString &Name, const FString &Category, const FString &Version, FTelemetryBuilder &&PropertiesBuilder);
 
+    /**
+        Adds the standard event properties (timestamp, name, category, version and sequence) without queuing the event
+        @param Name: Event name
+        @param Category: Category
+        @param Version: Semantic version of this event
+        @param PropertiesBuilder: Properties to set in this event
+    */
+    static TSharedPtr<FTelemetryBuilder> CreateEvent(const FString &Name, const FString &Category, const FString &Version, FTelemetryBuilder &&PropertiesBuilder);
+
+
+    // Sends pending telemetry now rather than at the end of the current interval
+    void Flush();
+
+    // Counts of recorded, dropped and sent events, for measuring how much telemetry the uploader sustains
+    static FTelemetryUploadStats GetUploadStats();
 
     // Flushes any pending telemetry and shuts down the singleton
     void Shutdown();
@@ -0,0 +1,97 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//--------------------------------------------------------------------------------------
+// TelemetryPerformance.h
+//
+// Automatic frame time and hitch capture
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TelemetryInterfaces.h"
+
+// What the performance capture records
+enum class ETelemetryPerformanceMode : uint8
+{
+    // One event per interval with the average and worst frame times
+    Summary = 0,
+    // One event for every frame over the hitch threshold
+    Hitches = 1,
+    // Both summaries and hitches
+    All = 2
+};
+
+// Storage class for performance capture configuration
+struct GAMETELEMETRY_API FTelemetryPerformanceSettings
+{
+    ETelemetryPerformanceMode Mode = ETelemetryPerformanceMode::Summary;
+
+    // Seconds between summary events
+    double SummaryInterval = 5.0;
+
+    // Frames taking longer than this (in milliseconds) are counted as hitches
+    float HitchThreshold = 50.f;
+
+    // Minimum seconds between two hitch events, so a stall of many frames is not recorded many times
+    double HitchCooldown = 1.0;
+
+    // Helper function to read the settings from the telemetry ini
+    static FTelemetryPerformanceSettings GetFromIni();
+};
+
+// Samples frame, game thread, render thread and GPU times every frame and records them as telemetry
+// Values are recorded with the "val_" prefix so they can be used directly by the visualizer's value heatmaps.
+// Position and camera direction come from the context provider, since the runtime module does not know about the player.
+class GAMETELEMETRY_API FTelemetryPerformanceCapture
+{
+public:
+    FTelemetryPerformanceCapture(const FTelemetryPerformanceSettings &Settings = FTelemetryPerformanceSettings());
+    ~FTelemetryPerformanceCapture();
+
+    /**
+        Starts sampling every frame
+        @param ContextProvider: Adds the position (and optionally camera direction) of each event.  Must outlive the capture
+    */
+    void Start(ITelemetryProvider *ContextProvider = nullptr);
+
+    // Stops sampling and records any pending summary
+    void Stop();
+
+    bool IsRunning() const { return TickHandle.IsValid(); }
+
+    const FTelemetryPerformanceSettings &GetSettings() const { return Settings; }
+
+private:
+    // Per frame sample of the thread timings, in milliseconds
+    struct FFrameSample
+    {
+        float Frame;
+        float Game;
+        float Render;
+        float GPU;
+        float GPUWait;
+    };
+
+    bool Tick(float DeltaTime);
+    FFrameSample Sample(float DeltaTime) const;
+    void RecordHitch(const FFrameSample &Frame);
+    void RecordSummary();
+    void ResetSummary();
+
+private:
+    FTelemetryPerformanceSettings Settings;
+    ITelemetryProvider *ContextProvider;
+    FDelegateHandle TickHandle;
+
+    // Summary accumulation for the current interval
+    double IntervalStart;
+    double LastHitchTime;
+    int32 FrameCount;
+    int32 HitchCount;
+    FFrameSample Total;
+    FFrameSample Worst;
+};
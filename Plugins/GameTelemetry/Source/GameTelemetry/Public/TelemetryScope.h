@@ -0,0 +1,99 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//--------------------------------------------------------------------------------------
+// TelemetryScope.h
+//
+// Scoped timers that aggregate durations before they are sent
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TelemetryBuilder.h"
+
+// Aggregated durations for one named scope
+// Samples are added with atomics into fixed buckets, so timing a scope never locks or allocates.
+// The telemetry worker drains every scope once per send interval and sends one summary event for each scope that ran,
+// along with an event for each slow sample kept since the last drain.
+class GAMETELEMETRY_API FTelemetryScopeStat
+{
+public:
+    // Bucket i holds durations in [2^(i-1), 2^i) microseconds, with bucket 0 holding anything under 1us
+    static const int32 NumBuckets = 24;
+
+    // Slow samples kept per scope between drains.  Further ones are only counted
+    static const int32 MaxSlowSamples = 16;
+
+    /**
+        @param Name: Scope name sent with the summary.  Must be a string literal
+        @param RawThreshold: Durations over this many milliseconds are also sent as individual events.  Negative uses the configured default
+    */
+    FTelemetryScopeStat(const TCHAR *Name, float RawThreshold = -1.f);
+
+    // Removes the scope from the list the telemetry worker drains.  Scopes are function statics, so this runs when
+    // the module that holds one is unloaded or hot reloaded
+    ~FTelemetryScopeStat();
+
+    // Adds one duration measured with FPlatformTime::Cycles64
+    void AddSample(uint64 Cycles);
+
+    const TCHAR *GetName() const { return Name; }
+
+    // Moves the accumulated samples of every scope into summary events, and the slow samples into one event each.
+    // Called by the telemetry worker
+    static void CollectSummaries(TArray<FTelemetryBuilder> &OutSummaries, TArray<FTelemetryBuilder> &OutSlowSamples);
+
+    // True if any scope has samples waiting to be collected
+    static bool HasPendingSamples();
+
+    // Default threshold for sending individual events, in milliseconds.  Zero or less disables them
+    static void SetDefaultRawThreshold(float Threshold) { DefaultRawThreshold = Threshold; }
+
+private:
+    bool Drain(FTelemetryBuilder &OutSummary);
+    void DrainSlowSamples(TArray<FTelemetryBuilder> &OutSlowSamples);
+
+private:
+    const TCHAR *Name;
+    float RawThreshold;
+
+    volatile int64 Count;
+    volatile int64 TotalCycles;
+    volatile int64 MaxCycles;
+    volatile int32 Buckets[NumBuckets];
+
+    // Durations over the raw threshold, in cycles.  Zero marks a free slot
+    volatile int64 SlowSamples[MaxSlowSamples];
+    volatile int32 DroppedSlowSamples;
+
+    // Intrusive list of every live scope, changed and walked only under the list lock
+    FTelemetryScopeStat *Next;
+    static FTelemetryScopeStat *Head;
+
+    static float DefaultRawThreshold;
+};
+
+// Times the enclosing scope and adds the duration to a scope stat
+class FTelemetryScopeTimer
+{
+public:
+    FORCEINLINE FTelemetryScopeTimer(FTelemetryScopeStat &InStat) : Stat(InStat), StartCycles(FPlatformTime::Cycles64()) {}
+    FORCEINLINE ~FTelemetryScopeTimer() { Stat.AddSample(FPlatformTime::Cycles64() - StartCycles); }
+
+private:
+    FTelemetryScopeStat &Stat;
+    uint64 StartCycles;
+};
+
+// Times the rest of the enclosing scope, e.g. TELEMETRY_SCOPE("ai_update")
+#define TELEMETRY_SCOPE(Name) \
+    static FTelemetryScopeStat PREPROCESSOR_JOIN(TelemetryScopeStat_, __LINE__)(TEXT(Name)); \
+    FTelemetryScopeTimer PREPROCESSOR_JOIN(TelemetryScopeTimer_, __LINE__)(PREPROCESSOR_JOIN(TelemetryScopeStat_, __LINE__))
+
+// Times the rest of the enclosing scope, sending an individual event for any duration over ThresholdMs
+#define TELEMETRY_SCOPE_THRESHOLD(Name, ThresholdMs) \
+    static FTelemetryScopeStat PREPROCESSOR_JOIN(TelemetryScopeStat_, __LINE__)(TEXT(Name), ThresholdMs); \
+    FTelemetryScopeTimer PREPROCESSOR_JOIN(TelemetryScopeTimer_, __LINE__)(PREPROCESSOR_JOIN(TelemetryScopeStat_, __LINE__))
@@ -0,0 +1,77 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//--------------------------------------------------------------------------------------
+// TelemetryStats.h
+//
+// Forwards engine counters and Low-Level Memory tracker tags to telemetry
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TelemetryInterfaces.h"
+
+// Storage class for the stats bridge configuration
+struct GAMETELEMETRY_API FTelemetryStatsSettings
+{
+    // Seconds between stats events
+    double Interval = 10.0;
+
+    // Counters to send, by name.  See FTelemetryStatsBridge for the built in counters
+    TArray<FString> Counters;
+
+    // Low-Level Memory tracker tags to send, by name (e.g. "Textures", "Meshes")
+    // Only available in builds with the memory tracker enabled
+    TArray<FString> LLMTags;
+
+    // Helper function to read the settings from the telemetry ini
+    static FTelemetryStatsSettings GetFromIni();
+};
+
+// Periodically records a chosen set of engine counters as "val_" properties of a single event
+// Counters are read directly from the engine globals that back them, so stat capture does not need to be enabled.
+// Built in counters:
+//   drawcalls, primitives          - RHI draw calls and primitives of the last frame
+//   mem_physical_mb, mem_virtual_mb - Memory currently used by the process
+//   mem_physical_peak_mb           - Peak physical memory used by the process
+class GAMETELEMETRY_API FTelemetryStatsBridge
+{
+public:
+    typedef TFunction<double()> FCounterReader;
+
+    FTelemetryStatsBridge(const FTelemetryStatsSettings &Settings = FTelemetryStatsSettings());
+    ~FTelemetryStatsBridge();
+
+    /**
+        Adds a counter that can be selected by name in the settings
+        @param Name: Counter name, sent as "val_<Name>"
+        @param Reader: Returns the current value.  Called on the game thread at the configured interval
+    */
+    void RegisterCounter(const FString &Name, FCounterReader Reader);
+
+    /**
+        Starts sending the configured counters
+        @param ContextProvider: Adds the position of each event.  Must outlive the bridge
+    */
+    void Start(ITelemetryProvider *ContextProvider = nullptr);
+    void Stop();
+
+    bool IsRunning() const { return TickHandle.IsValid(); }
+
+    // Records the configured counters immediately
+    void RecordStats();
+
+private:
+    bool Tick(float DeltaTime);
+    void RegisterDefaultCounters();
+
+private:
+    FTelemetryStatsSettings Settings;
+    ITelemetryProvider *ContextProvider;
+    FDelegateHandle TickHandle;
+
+    TMap<FString, FCounterReader> Readers;
+};
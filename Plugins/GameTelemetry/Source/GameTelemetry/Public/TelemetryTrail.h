@@ -0,0 +1,105 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//--------------------------------------------------------------------------------------
+// TelemetryTrail.h
+//
+// Movement trail recording with dead-reckoning compression
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TelemetryInterfaces.h"
+
+// Thresholds controlling when a trail sample is emitted
+struct GAMETELEMETRY_API FTelemetryTrailSettings
+{
+    // Distance (in world units) the entity may drift from its predicted position before a sample is sent
+    float DistanceThreshold = 50.f;
+
+    // Angle (in degrees) the orientation may turn from the last sent sample before a sample is sent
+    float AngleThreshold = 15.f;
+
+    // Samples are never sent more often than this (in seconds)
+    double MinInterval = 0.1;
+
+    // A sample is always sent after this long (in seconds), even if the prediction still holds
+    double MaxInterval = 5.0;
+};
+
+// Records the path of a single entity (usually a player pawn)
+// Instead of recording every tick, the recorder extrapolates the last sent sample using its velocity
+// and only sends a new sample once the real movement no longer matches that prediction.
+// The sent samples include the velocity so the path can be reconstructed as a smooth curve.
+class GAMETELEMETRY_API FTelemetryTrailRecorder
+{
+public:
+    /**
+        Creates a trail recorder
+        @param Name: Event name used for each sample
+        @param Category: Category used for each sample
+        @param Version: Semantic version of the sample event
+        @param Settings: Thresholds for sending samples
+    */
+    FTelemetryTrailRecorder(const FString &Name, const FString &Category = TEXT("Trail"), const FString &Version = TEXT("1.0.0"), const FTelemetryTrailSettings &Settings = FTelemetryTrailSettings());
+
+    /**
+        Provides the current transform of the entity, usually called once per tick
+        @param Position: Current world position
+        @param Orientation: Current facing unit vector
+        @param Time: Current time in seconds
+    */
+    void Update(const FVector &Position, const FVector &Orientation, double Time);
+    void Update(const FVector &Position, const FVector &Orientation) { Update(Position, Orientation, FPlatformTime::Seconds()); }
+
+    // Sends the last known sample if it has not been sent yet.  Call when the entity stops being tracked (death, level change)
+    void Flush();
+
+    // Forgets the current trail so the next update starts a new one
+    void Reset();
+
+    // Properties added to every sample (e.g. a player or character id)
+    void SetProperty(const FTelemetryProperty &Property) { ExtraProperties.Add(Property.Key, Property.Value); }
+
+    const FTelemetryTrailSettings &GetSettings() const { return Settings; }
+    void SetSettings(const FTelemetryTrailSettings &InSettings) { Settings = InSettings; }
+
+    // Number of updates received and samples sent since the last reset
+    int32 GetUpdateCount() const { return UpdateCount; }
+    int32 GetSampleCount() const { return SampleCount; }
+
+private:
+    struct FTrailSample
+    {
+        FVector Position;
+        FVector Orientation;
+        FVector Velocity;
+        double Time;
+    };
+
+    bool ShouldSend(const FTrailSample &Current) const;
+    void Send(const FTrailSample &Sample);
+
+private:
+    FString Name;
+    FString Category;
+    FString Version;
+    FTelemetryTrailSettings Settings;
+    FTelemetryProperties ExtraProperties;
+
+    // Last sample sent, used as the base of the prediction
+    FTrailSample LastSent;
+
+    // Most recent update, sent by Flush if it was not already
+    FTrailSample Latest;
+
+    bool HasSent;
+    bool HasLatest;
+    bool LatestSent;
+
+    int32 UpdateCount;
+    int32 SampleCount;
+};
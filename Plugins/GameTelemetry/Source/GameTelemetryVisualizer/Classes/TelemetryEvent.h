@@ -15,7 +15,7 @@
 #include "Query/TelemetryQuery.h"
 #include "TelemetryEvent.generated.h"
 
-struct STelemetryEvent;
+struct FTelemetryEventView;
 
 //Type of mesh to draw for an event
 static enum EventType
@@ -76,7 +76,11 @@ public:
     TArray<InstanceType> InstanceTypes;
 
     //Populates event values based on an Telemetry event
-    void SetEvent(const TSharedPtr<STelemetryEvent> inPointer);
+    void SetEvent(const FTelemetryEventView& inEvent);
+
+    //Adds the fields that were not fetched with the event, once it is selected
+    void SetDetails(FSimpleEvent& inDetails);
+    bool HasDetails() const { return hasDetails; }
 
     //Sets the emissive color of the mesh
     void SetColor(FColor inColor);
@@ -126,4 +130,5 @@ private:
     FVector scale;
     FString name;
     FString category;
+    bool hasDetails;
 };
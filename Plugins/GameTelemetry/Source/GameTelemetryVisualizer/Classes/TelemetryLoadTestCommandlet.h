@@ -0,0 +1,43 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//--------------------------------------------------------------------------------------
+// TelemetryLoadTestCommandlet.h
+//
+// Measures how much telemetry the uploader sustains
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "TelemetryLoadTestCommandlet.generated.h"
+
+/**
+ * Records events from many simulated clients through FTelemetryManager and its upload thread in to the local
+ * query server, then reports the rate sustained, events dropped, CPU time per event and memory used, e.g.
+ *   UE4Editor-Cmd <project> -run=TelemetryLoadTest -clients=200 -rate=20 -duration=60 -minrate=3500 -maxdrop=0.1
+ * Options:
+ *   -clients=    simulated clients, each with its own session, 100 by default
+ *   -rate=       events per second each client records, 10 by default
+ *   -duration=   seconds to record for, 30 by default
+ *   -values=     val_ properties of each event, 4 by default
+ *   -strings=    string properties of each event, 1 by default, each -stringlength= characters long
+ *   -interval=   seconds between uploads, -buffer= events pending before they are dropped, -coalesce to fold them
+ *   -port=       port of the local sink, 8081 by default, or -url= to send to another ingestion service
+ *   -report=     Json file the results are written to
+ * Thresholds, any of which failing makes the commandlet return 1:
+ *   -minrate=    events per second delivered
+ *   -maxdrop=    percent of recorded events not delivered
+ *   -maxcpu=     microseconds of recording and upload thread time per event
+ *   -maxmemory=  megabytes of memory used above that at the start
+ */
+UCLASS()
+class UTelemetryLoadTestCommandlet : public UCommandlet
+{
+    GENERATED_UCLASS_BODY()
+
+    virtual int32 Main(const FString &Params) override;
+};
@@ -0,0 +1,37 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//--------------------------------------------------------------------------------------
+// TelemetryQueryServerCommandlet.h
+//
+// Headless local query server, for benchmarking without a backend
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "TelemetryQueryServerCommandlet.generated.h"
+
+/**
+ * Serves the local query server over loopback http until stopped, e.g.
+ *   UE4Editor-Cmd <project> -run=TelemetryQueryServer -port=8080 -store=Events.json -generate=5000000
+ * Options:
+ *   -port=       port to listen on, 8080 by default
+ *   -store=      newline delimited Json file the events are loaded from and new events appended to
+ *   -load=       saved query response to add
+ *   -generate=   number of events to synthesize, with -sessions=, -clusters=, -days= and -seed=
+ *   -rate=       events per second to keep generating
+ *   -latency=    milliseconds to delay each response, plus -latencyperthousand= for each thousand events returned
+ *   -max=        events to keep, at least those generated
+ *   -duration=   seconds to serve before exiting, 0 to serve until the process is stopped
+ */
+UCLASS()
+class UTelemetryQueryServerCommandlet : public UCommandlet
+{
+    GENERATED_UCLASS_BODY()
+
+    virtual int32 Main(const FString &Params) override;
+};
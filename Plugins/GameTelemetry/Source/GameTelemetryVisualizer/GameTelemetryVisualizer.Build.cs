@@ -33,11 +33,16 @@ public class GameTelemetryVisualizer : ModuleRules
 				"UnrealEd",
                 "InputCore",
                 "Http",
+                "Sockets",
+                "Networking",
+                "DesktopPlatform",
                 "Json",
                 "JsonUtilities"
             }
             );
 
+        AddEngineThirdPartyPrivateStaticDependencies(Target, "zlib");
+
 		PrivateIncludePathModuleNames.AddRange(
 			new string[]
             {
@@ -26,6 +26,7 @@ ATelemetryEvent::ATelemetryEvent(const FObjectInitializer& InInitializer)
 
     //Default scale
     scale = FVector(0.5f);
+    hasDetails = false;
 
     //Cache pointer for material
     static ConstructorHelpers::FObjectFinder<UMaterial> MaterialAsset(TEXT("/GameTelemetry/Materials/M_Telemetry.M_Telemetry"));
@@ -149,24 +150,50 @@ void ATelemetryEvent::AddEvent(FVector inLocation, FVector inOrientation, FColor
     NewComponent->AddInstanceWorldSpace(FTransform(tempRot, inLocation + inScale.GetCenter(), scale));
 }
 
-void ATelemetryEvent::SetEvent(const TSharedPtr<STelemetryEvent> inPointer)
+void ATelemetryEvent::SetEvent(const FTelemetryEventView& inEvent)
 {
     if (InstanceTypes.Num() != 1) return;
 
-    time = inPointer->time;
-    location = inPointer->point;
-    session = inPointer->session;
-    orientation = inPointer->orientation;
-    build = inPointer->build;
-    name = inPointer->eventname;
-    category = inPointer->category;
+    time = inEvent.GetTime();
+    location = inEvent.GetPoint();
+    session = inEvent.GetSession();
+    orientation = inEvent.GetOrientation();
+    build = inEvent.GetBuild();
+    name = inEvent.GetName();
+    category = inEvent.GetCategory();
 
-    for (auto& value : inPointer->values)
+    const SEventEditorContainer& container = *inEvent.container;
+    for (int32 i = 0; i < container.attributeNames.Num(); i++)
     {
-        values.Add(value.Key, value.Value->AsString());
+        if (container.HasValue(i, inEvent.index))
+        {
+            values.Add(container.attributeNames[i], FString::SanitizeFloat(container.attributeValues[i][inEvent.index]));
+        }
     }
 
+    if (inEvent.GetCount() > 1)
+    {
+        values.Add(TEXT("count"), FString::FromInt(inEvent.GetCount()));
+    }
+
+    eventName = category.IsEmpty() ? name : category + L" " + name;
+}
+
+void ATelemetryEvent::SetDetails(FSimpleEvent& inDetails)
+{
+    category = inDetails.GetCategory();
+    build = inDetails.GetBuildType() + L" " + inDetails.GetBuildId() + L" " + inDetails.GetPlatform();
     eventName = category + L" " + name;
+
+    TMap<FString, TSharedPtr<FJsonValue>> attributes;
+    inDetails.GetAttributes(attributes);
+
+    for (auto& attr : attributes)
+    {
+        values.Add(attr.Key, FString::SanitizeFloat(attr.Value->AsNumber()));
+    }
+
+    hasDetails = true;
 }
 
 void ATelemetryEvent::SetColor(FColor inColor)
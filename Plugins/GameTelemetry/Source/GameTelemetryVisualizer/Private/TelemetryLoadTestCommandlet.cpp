@@ -0,0 +1,380 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//--------------------------------------------------------------------------------------
+// TelemetryLoadTestCommandlet.cpp
+//
+// Measures how much telemetry the uploader sustains
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "TelemetryLoadTestCommandlet.h"
+#include "Query/TelemetryLocalServer.h"
+#include "Query/TelemetryLocalHttpServer.h"
+#include "TelemetryVisualizerModule.h"
+#include "Telemetry.h"
+#include "TelemetryManager.h"
+#include "Async/Async.h"
+#include "Async/TaskGraphInterfaces.h"
+#include "Containers/Ticker.h"
+#include "HAL/PlatformMemory.h"
+#include "HAL/ThreadSafeBool.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Parse.h"
+#include "Serialization/JsonWriter.h"
+
+//Events the local sink keeps, so its memory stays flat however long the test runs
+static const int32 SinkMaxEvents = 10000;
+
+//Seconds given to the uploader to deliver what is still pending once recording stops
+static const double DrainTimeout = 30.0;
+
+//Seconds between progress reports, and between flushes while draining
+static const double ReportInterval = 5.0;
+static const double DrainFlushInterval = 0.5;
+
+static const double BytesPerMegabyte = 1024.0 * 1024.0;
+
+//Threads the clients record from unless -threads= is given.  0 records every client on the game thread
+static const int32 DefaultThreads = 4;
+
+struct FLoadTestClient
+{
+    FString SessionId;
+    FVector Position;
+    FVector Direction;
+
+    //Events due but not yet recorded
+    double Due;
+};
+
+//Runs what other threads queued for the game thread, which is where the uploader takes events recorded elsewhere
+//and where http requests complete
+static void PumpGameThread(float DeltaTime)
+{
+    FTaskGraphInterface::Get().ProcessThreadUntilIdle(ENamedThreads::GameThread);
+    FTicker::GetCoreTicker().Tick(DeltaTime);
+}
+
+static FTelemetryUploadStats operator-(const FTelemetryUploadStats &A, const FTelemetryUploadStats &B)
+{
+    FTelemetryUploadStats Result;
+    Result.Recorded = A.Recorded - B.Recorded;
+    Result.Dropped = A.Dropped - B.Dropped;
+    Result.Sent = A.Sent - B.Sent;
+    Result.Batches = A.Batches - B.Batches;
+    Result.CompletedBatches = A.CompletedBatches - B.CompletedBatches;
+    Result.FailedBatches = A.FailedBatches - B.FailedBatches;
+    Result.FailedEvents = A.FailedEvents - B.FailedEvents;
+    Result.Bytes = A.Bytes - B.Bytes;
+    Result.SendSeconds = A.SendSeconds - B.SendSeconds;
+    return Result;
+}
+
+UTelemetryLoadTestCommandlet::UTelemetryLoadTestCommandlet(const FObjectInitializer& ObjectInitializer)
+    : Super(ObjectInitializer)
+{
+    IsClient = false;
+    IsEditor = false;
+    IsServer = false;
+    LogToConsole = true;
+}
+
+int32 UTelemetryLoadTestCommandlet::Main(const FString &Params)
+{
+    int32 NumClients = 100;
+    float Rate = 10.f;
+    float Duration = 30.f;
+    int32 NumValues = 4;
+    int32 NumStrings = 1;
+    int32 StringLength = 32;
+    int32 Port = 8081;
+    int32 NumThreads = DefaultThreads;
+    FParse::Value(*Params, TEXT("clients="), NumClients);
+    FParse::Value(*Params, TEXT("rate="), Rate);
+    FParse::Value(*Params, TEXT("duration="), Duration);
+    FParse::Value(*Params, TEXT("values="), NumValues);
+    FParse::Value(*Params, TEXT("strings="), NumStrings);
+    FParse::Value(*Params, TEXT("stringlength="), StringLength);
+    FParse::Value(*Params, TEXT("port="), Port);
+    FParse::Value(*Params, TEXT("threads="), NumThreads);
+
+    FTelemetryConfiguration Config = FTelemetryManager::GetConfigFromIni();
+    float Interval = 1.f;
+    FParse::Value(*Params, TEXT("interval="), Interval);
+    FParse::Value(*Params, TEXT("buffer="), Config.PendingBufferSize);
+    Config.SendInterval = Interval;
+    Config.CoalesceEvents = Config.CoalesceEvents || FParse::Param(*Params, TEXT("coalesce"));
+
+    //Events go to the local server unless another ingestion service is given
+    TUniquePtr<FTelemetryLocalHttpServer> Sink;
+    if (!FParse::Value(*Params, TEXT("url="), Config.IngestionUrl))
+    {
+        FTelemetryLocalServer::Get().SetMaxEvents(SinkMaxEvents);
+
+        Sink = MakeUnique<FTelemetryLocalHttpServer>(FTelemetryLocalServer::Get());
+        if (!Sink->Start(Port))
+        {
+            UE_LOG(LogTelemetryVisualizer, Error, TEXT("Unable to listen on port %d"), Port);
+            return 1;
+        }
+
+        Config.IngestionUrl = FString::Printf(TEXT("http://127.0.0.1:%d/api/ingest"), Port);
+    }
+
+    FTelemetryManager::Initialize(Config);
+
+    TArray<FString> ValueNames;
+    for (int32 i = 0; i < NumValues; i++)
+    {
+        ValueNames.Add(FString::Printf(TEXT("val_load%d"), i));
+    }
+
+    TArray<FString> StringNames;
+    for (int32 i = 0; i < NumStrings; i++)
+    {
+        StringNames.Add(FString::Printf(TEXT("text%d"), i));
+    }
+
+    const FString Text = FString::ChrN(FMath::Max(StringLength, 0), TEXT('x'));
+
+    FRandomStream Random(0);
+    TArray<FLoadTestClient> Clients;
+    Clients.SetNum(FMath::Max(NumClients, 1));
+    NumThreads = FMath::Clamp(NumThreads, 0, Clients.Num());
+
+    for (FLoadTestClient &Client : Clients)
+    {
+        Client.SessionId = FGuid::NewGuid().ToString(EGuidFormats::DigitsWithHyphens);
+        Client.Position = Random.GetUnitVector() * Random.FRandRange(0.f, 10000.f);
+        Client.Direction = Random.GetUnitVector();
+
+        //Staggered, so clients do not all record on the same tick
+        Client.Due = Random.GetFraction();
+    }
+
+    auto RecordEvent = [&](FLoadTestClient &Client, FRandomStream &ClientRandom)
+    {
+        Client.Position += Client.Direction * 50.f;
+
+        //Each client's session goes in the event, as the manager holds only one
+        FTelemetryBuilder Properties;
+        Properties.SetProperty(FTelemetry::SessionId(Client.SessionId));
+        Properties.SetProperty(FTelemetry::Position(Client.Position));
+        Properties.SetProperty(FTelemetry::Orientation(Client.Direction));
+
+        for (const FString &Name : ValueNames)
+        {
+            Properties.SetProperty(FTelemetryProperty(Name, ClientRandom.FRandRange(0.f, 100.f)));
+        }
+
+        for (const FString &Name : StringNames)
+        {
+            Properties.SetProperty(FTelemetryProperty(Name, Text));
+        }
+
+        FTelemetryManager::Get().Record(TEXT("load_test"), TEXT("LoadTest"), TEXT("1.0.0"), MoveTemp(Properties));
+    };
+
+    //Records the events due from Count clients starting at First, and returns the cycles it took
+    auto RecordDue = [&](int32 First, int32 Count, double Elapsed, FRandomStream &ClientRandom)
+    {
+        const uint64 Cycles = FPlatformTime::Cycles64();
+        for (int32 i = First; i < First + Count; i++)
+        {
+            FLoadTestClient &Client = Clients[i];
+            for (Client.Due += Rate * Elapsed; Client.Due >= 1.0; Client.Due -= 1.0)
+            {
+                RecordEvent(Client, ClientRandom);
+            }
+        }
+        return FPlatformTime::Cycles64() - Cycles;
+    };
+
+    UE_LOG(LogTelemetryVisualizer, Display, TEXT("Recording %.0f events per second from %d clients on %d threads for %.0f s to %s"), Rate * Clients.Num(), Clients.Num(), FMath::Max(NumThreads, 1), Duration, *Config.IngestionUrl);
+
+    const FTelemetryUploadStats StartStats = FTelemetryManager::GetUploadStats();
+    const uint64 StartMemory = FPlatformMemory::GetStats().UsedPhysical;
+    uint64 MaxMemory = StartMemory;
+
+    const double StartTime = FPlatformTime::Seconds();
+    double LastTime = StartTime;
+    double LastReport = StartTime;
+
+    //Clients are split between recording threads, the way a game records from its game thread, workers and
+    //audio at once.  Events recorded off the game thread reach the uploader through the game thread pumped below
+    FThreadSafeBool IsStopping;
+    TArray<uint64> ThreadCycles;
+    ThreadCycles.SetNumZeroed(NumThreads);
+    TArray<TFuture<void>> Threads;
+
+    for (int32 Thread = 0; Thread < NumThreads; Thread++)
+    {
+        const int32 First = Clients.Num() * Thread / NumThreads;
+        const int32 Count = Clients.Num() * (Thread + 1) / NumThreads - First;
+
+        Threads.Add(Async<void>(EAsyncExecution::Thread, [&, Thread, First, Count]()
+        {
+            FRandomStream ThreadRandom(Thread + 1);
+            double ThreadLastTime = StartTime;
+
+            while (!IsStopping)
+            {
+                const double Now = FPlatformTime::Seconds();
+                ThreadCycles[Thread] += RecordDue(First, Count, Now - ThreadLastTime, ThreadRandom);
+                ThreadLastTime = Now;
+
+                FPlatformProcess::Sleep(0.001f);
+            }
+        }));
+    }
+
+    uint64 RecordCycles = 0;
+
+    while (!GIsRequestingExit && LastTime - StartTime < Duration)
+    {
+        const double Now = FPlatformTime::Seconds();
+        const double Elapsed = Now - LastTime;
+        LastTime = Now;
+
+        //Without threads every client records on the game thread, between pumps
+        if (NumThreads == 0)
+        {
+            RecordCycles += RecordDue(0, Clients.Num(), Elapsed, Random);
+        }
+
+        PumpGameThread(Elapsed);
+        MaxMemory = FMath::Max(MaxMemory, FPlatformMemory::GetStats().UsedPhysical);
+
+        if (Now - LastReport >= ReportInterval)
+        {
+            const FTelemetryUploadStats Stats = FTelemetryManager::GetUploadStats() - StartStats;
+            UE_LOG(LogTelemetryVisualizer, Display, TEXT("%.0f s: %lld recorded, %lld dropped, %lld sent in %lld batches"), Now - StartTime, Stats.Recorded, Stats.Dropped, Stats.Sent, Stats.Batches);
+            LastReport = Now;
+        }
+
+        FPlatformProcess::Sleep(0.001f);
+    }
+
+    IsStopping = true;
+    for (TFuture<void> &Thread : Threads)
+    {
+        Thread.Wait();
+    }
+
+    for (uint64 Cycles : ThreadCycles)
+    {
+        RecordCycles += Cycles;
+    }
+
+    //Waits for the last events to be sent and answered
+    FTelemetryManager::Get().Flush();
+
+    const double DrainStart = FPlatformTime::Seconds();
+    double LastFlush = DrainStart;
+    FTelemetryUploadStats Stats;
+
+    for (;;)
+    {
+        const double Now = FPlatformTime::Seconds();
+        PumpGameThread(Now - LastTime);
+        LastTime = Now;
+        MaxMemory = FMath::Max(MaxMemory, FPlatformMemory::GetStats().UsedPhysical);
+
+        Stats = FTelemetryManager::GetUploadStats() - StartStats;
+        const bool IsSent = Stats.Sent + Stats.Dropped >= Stats.Recorded;
+
+        if ((IsSent && Stats.CompletedBatches >= Stats.Batches) || GIsRequestingExit)
+        {
+            break;
+        }
+
+        if (Now - DrainStart > DrainTimeout)
+        {
+            UE_LOG(LogTelemetryVisualizer, Warning, TEXT("Gave up waiting for %lld events to be sent and %lld batches to be answered"),
+                Stats.Recorded - Stats.Sent - Stats.Dropped, Stats.Batches - Stats.CompletedBatches);
+            break;
+        }
+
+        if (!IsSent && Now - LastFlush >= DrainFlushInterval)
+        {
+            FTelemetryManager::Get().Flush();
+            LastFlush = Now;
+        }
+
+        FPlatformProcess::Sleep(0.01f);
+    }
+
+    const double Seconds = LastTime - StartTime;
+    const int64 Delivered = Stats.Sent - Stats.FailedEvents;
+    const double EventsPerSecond = Seconds > 0.0 ? Delivered / Seconds : 0.0;
+    const double DropPercent = Stats.Recorded > 0 ? 100.0 * (Stats.Recorded - Delivered) / Stats.Recorded : 0.0;
+    const double CpuMicroseconds = Stats.Recorded > 0 ? (FPlatformTime::ToSeconds64(RecordCycles) + Stats.SendSeconds) * 1000000.0 / Stats.Recorded : 0.0;
+    const double MemoryMegabytes = (MaxMemory - StartMemory) / BytesPerMegabyte;
+    const double PeakMegabytes = FPlatformMemory::GetStats().PeakUsedPhysical / BytesPerMegabyte;
+
+    UE_LOG(LogTelemetryVisualizer, Display, TEXT("Recorded %lld events in %.1f s, %lld dropped from the buffer, %lld in %lld failed batches"), Stats.Recorded, Seconds, Stats.Dropped, Stats.FailedEvents, Stats.FailedBatches);
+    UE_LOG(LogTelemetryVisualizer, Display, TEXT("Sustained %.0f events per second, %.3f%% not delivered, %.2f us of CPU per event, %.1f KB per batch"),
+        EventsPerSecond, DropPercent, CpuMicroseconds, Stats.Batches > 0 ? Stats.Bytes / 1024.0 / Stats.Batches : 0.0);
+    UE_LOG(LogTelemetryVisualizer, Display, TEXT("Memory grew by at most %.1f MB, peak %.1f MB"), MemoryMegabytes, PeakMegabytes);
+
+    if (Sink.IsValid())
+    {
+        UE_LOG(LogTelemetryVisualizer, Display, TEXT("The local sink received %lld events"), Sink->GetNumIngested());
+    }
+
+    bool Passed = true;
+    auto CheckThreshold = [&Params, &Passed](const TCHAR *Option, const TCHAR *Description, double Value, bool IsMinimum)
+    {
+        float Limit = 0.f;
+        if (FParse::Value(*Params, Option, Limit) && (IsMinimum ? Value < Limit : Value > Limit))
+        {
+            UE_LOG(LogTelemetryVisualizer, Error, TEXT("%s of %.3f is %s the threshold of %.3f"), Description, Value, IsMinimum ? TEXT("below") : TEXT("above"), Limit);
+            Passed = false;
+        }
+    };
+
+    CheckThreshold(TEXT("minrate="), TEXT("Events per second"), EventsPerSecond, true);
+    CheckThreshold(TEXT("maxdrop="), TEXT("Percent not delivered"), DropPercent, false);
+    CheckThreshold(TEXT("maxcpu="), TEXT("Microseconds per event"), CpuMicroseconds, false);
+    CheckThreshold(TEXT("maxmemory="), TEXT("Memory growth in MB"), MemoryMegabytes, false);
+
+    FString ReportPath;
+    if (FParse::Value(*Params, TEXT("report="), ReportPath))
+    {
+        FString Report;
+        TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Report);
+        Writer->WriteObjectStart();
+        Writer->WriteValue(TEXT("clients"), Clients.Num());
+        Writer->WriteValue(TEXT("threads"), NumThreads);
+        Writer->WriteValue(TEXT("rate"), Rate);
+        Writer->WriteValue(TEXT("seconds"), Seconds);
+        Writer->WriteValue(TEXT("recorded"), (double)Stats.Recorded);
+        Writer->WriteValue(TEXT("dropped"), (double)Stats.Dropped);
+        Writer->WriteValue(TEXT("failed"), (double)Stats.FailedEvents);
+        Writer->WriteValue(TEXT("delivered"), (double)Delivered);
+        Writer->WriteValue(TEXT("events_per_second"), EventsPerSecond);
+        Writer->WriteValue(TEXT("drop_percent"), DropPercent);
+        Writer->WriteValue(TEXT("cpu_us_per_event"), CpuMicroseconds);
+        Writer->WriteValue(TEXT("memory_mb"), MemoryMegabytes);
+        Writer->WriteValue(TEXT("peak_memory_mb"), PeakMegabytes);
+        Writer->WriteValue(TEXT("passed"), Passed);
+        Writer->WriteObjectEnd();
+        Writer->Close();
+
+        if (!FFileHelper::SaveStringToFile(Report, *ReportPath))
+        {
+            UE_LOG(LogTelemetryVisualizer, Warning, TEXT("Unable to write %s"), *ReportPath);
+        }
+    }
+
+    FTelemetryManager::Get().Shutdown();
+
+    if (Sink.IsValid())
+    {
+        Sink->Stop();
+    }
+
+    return Passed ? 0 : 1;
+}
@@ -0,0 +1,345 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//--------------------------------------------------------------------------------------
+// TelemetryLocalHttpServer.cpp
+//
+// Serves the local query server over loopback http
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "Query/TelemetryLocalHttpServer.h"
+#include "Query/TelemetryLocalServer.h"
+#include "Query/TelemetryQueryFormat.h"
+#include "TelemetryVisualizerModule.h"
+#include "Async/Async.h"
+#include "Common/TcpListener.h"
+#include "Common/TcpSocketBuilder.h"
+#include "GenericPlatform/GenericPlatformHttp.h"
+#include "HAL/IConsoleManager.h"
+#include "Interfaces/IPv4/IPv4Endpoint.h"
+#include "Sockets.h"
+#include "SocketSubsystem.h"
+
+//A client that sends nothing for this long is dropped
+static const FTimespan ReceiveTimeout = FTimespan::FromSeconds(30);
+
+//Requests with larger headers or bodies are refused
+static const int32 MaxHeaderSize = 64 * 1024;
+static const int32 MaxBodySize = 256 * 1024 * 1024;
+
+struct FLocalHttpRequest
+{
+    FString Verb;
+    FString Path;
+
+    //Lower case names
+    TMap<FString, FString> Headers;
+    TMap<FString, FString> Parameters;
+
+    TArray<uint8> Body;
+};
+
+static int32 FindHeaderEnd(const TArray<uint8> &Data)
+{
+    for (int32 i = 0; i + 3 < Data.Num(); i++)
+    {
+        if (Data[i] == '\r' && Data[i + 1] == '\n' && Data[i + 2] == '\r' && Data[i + 3] == '\n')
+        {
+            return i;
+        }
+    }
+
+    return INDEX_NONE;
+}
+
+static bool ReceiveMore(FSocket &Socket, TArray<uint8> &Data)
+{
+    uint8 Buffer[16 * 1024];
+    int32 Read = 0;
+
+    if (!Socket.Wait(ESocketWaitConditions::WaitForRead, ReceiveTimeout) || !Socket.Recv(Buffer, sizeof(Buffer), Read) || Read <= 0)
+    {
+        return false;
+    }
+
+    Data.Append(Buffer, Read);
+    return true;
+}
+
+static bool ReadRequest(FSocket &Socket, FLocalHttpRequest &OutRequest)
+{
+    TArray<uint8> Received;
+    int32 HeaderEnd = INDEX_NONE;
+
+    while ((HeaderEnd = FindHeaderEnd(Received)) == INDEX_NONE)
+    {
+        if (Received.Num() > MaxHeaderSize || !ReceiveMore(Socket, Received))
+        {
+            return false;
+        }
+    }
+
+    FUTF8ToTCHAR Converted((const ANSICHAR *)Received.GetData(), HeaderEnd);
+    const FString HeaderText(Converted.Length(), Converted.Get());
+    TArray<FString> Lines;
+    HeaderText.ParseIntoArray(Lines, TEXT("\r\n"));
+
+    TArray<FString> RequestLine;
+    if (Lines.Num() == 0 || Lines[0].ParseIntoArrayWS(RequestLine) < 2)
+    {
+        return false;
+    }
+
+    OutRequest.Verb = RequestLine[0];
+
+    FString Query;
+    if (!RequestLine[1].Split(TEXT("?"), &OutRequest.Path, &Query))
+    {
+        OutRequest.Path = RequestLine[1];
+    }
+
+    TArray<FString> Parameters;
+    Query.ParseIntoArray(Parameters, TEXT("&"));
+    for (const FString &Parameter : Parameters)
+    {
+        FString Name;
+        FString Value;
+        if (!Parameter.Split(TEXT("="), &Name, &Value))
+        {
+            Name = Parameter;
+        }
+
+        OutRequest.Parameters.Add(FGenericPlatformHttp::UrlDecode(Name).ToLower(), FGenericPlatformHttp::UrlDecode(Value));
+    }
+
+    for (int32 i = 1; i < Lines.Num(); i++)
+    {
+        FString Name;
+        FString Value;
+        if (Lines[i].Split(TEXT(":"), &Name, &Value))
+        {
+            OutRequest.Headers.Add(Name.TrimStartAndEnd().ToLower(), Value.TrimStartAndEnd());
+        }
+    }
+
+    //Clients of the service always send a length with their body
+    const int32 ContentLength = FCString::Atoi(*OutRequest.Headers.FindRef(TEXT("content-length")));
+    if (ContentLength < 0 || ContentLength > MaxBodySize)
+    {
+        return false;
+    }
+
+    const int32 BodyStart = HeaderEnd + 4;
+    while (Received.Num() - BodyStart < ContentLength)
+    {
+        if (!ReceiveMore(Socket, Received))
+        {
+            return false;
+        }
+    }
+
+    OutRequest.Body.Append(Received.GetData() + BodyStart, ContentLength);
+    return true;
+}
+
+static void SendAll(FSocket &Socket, const uint8 *Data, int32 Size)
+{
+    while (Size > 0)
+    {
+        int32 Sent = 0;
+        if (!Socket.Send(Data, Size, Sent) || Sent <= 0)
+        {
+            return;
+        }
+
+        Data += Sent;
+        Size -= Sent;
+    }
+}
+
+static void SendResponse(FSocket &Socket, int32 Status, const TCHAR *Reason, const FString &ContentType, const TArray<uint8> &Body, bool IsGzip = false)
+{
+    FString Header = FString::Printf(TEXT("HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %d\r\nConnection: close\r\n"), Status, Reason, *ContentType, Body.Num());
+    if (IsGzip)
+    {
+        Header += TEXT("Content-Encoding: gzip\r\n");
+    }
+    Header += TEXT("\r\n");
+
+    FTCHARToUTF8 Utf8(*Header);
+    SendAll(Socket, (const uint8 *)Utf8.Get(), Utf8.Length());
+    SendAll(Socket, Body.GetData(), Body.Num());
+}
+
+static void SendText(FSocket &Socket, int32 Status, const TCHAR *Reason, const FString &Text)
+{
+    FTCHARToUTF8 Utf8(*Text);
+    SendResponse(Socket, Status, Reason, TEXT("application/json"), TArray<uint8>((const uint8 *)Utf8.Get(), Utf8.Length()));
+}
+
+static void AnswerQuery(FTelemetryLocalServer &Server, FSocket &Socket, const FLocalHttpRequest &Request)
+{
+    FUTF8ToTCHAR Converted((const ANSICHAR *)Request.Body.GetData(), Request.Body.Num());
+    const FString QueryText(Converted.Length(), Converted.Get());
+
+    const bool AsColumns = Request.Headers.FindRef(TEXT("accept")).Contains(FQueryResponseFormat::ColumnsContentType);
+    const bool AcceptsGzip = Request.Headers.FindRef(TEXT("accept-encoding")).Contains(TEXT("gzip"));
+
+    TArray<uint8> Response = Server.HandleQuery(
+        QueryText,
+        FCString::Atoi(*Request.Parameters.FindRef(TEXT("take"))),
+        Request.Headers.FindRef(TEXT("x-ms-continuation")),
+        Request.Parameters.FindRef(TEXT("columns")),
+        AsColumns);
+
+    const FString ContentType = FQueryResponseFormat::IsColumns(Response.GetData(), Response.Num()) ? FString(FQueryResponseFormat::ColumnsContentType) : FString(TEXT("application/json"));
+
+    TArray<uint8> Compressed;
+    if (AcceptsGzip && FQueryResponseFormat::Gzip(Response.GetData(), Response.Num(), Compressed))
+    {
+        SendResponse(Socket, 200, TEXT("OK"), ContentType, Compressed, true);
+    }
+    else
+    {
+        SendResponse(Socket, 200, TEXT("OK"), ContentType, Response);
+    }
+}
+
+//Returns the number of events added
+static int32 AnswerIngest(FTelemetryLocalServer &Server, FSocket &Socket, const FLocalHttpRequest &Request)
+{
+    const int32 Count = Server.Ingest(Request.Body.GetData(), Request.Body.Num());
+    if (Count < 0)
+    {
+        SendText(Socket, 400, TEXT("Bad Request"), TEXT("{\"Success\":false}"));
+        return 0;
+    }
+
+    SendText(Socket, 200, TEXT("OK"), FString::Printf(TEXT("{\"Success\":true,\"Count\":%d}"), Count));
+    return Count;
+}
+
+FTelemetryLocalHttpServer::FTelemetryLocalHttpServer(FTelemetryLocalServer &InServer) :
+    Server(InServer)
+{
+}
+
+FTelemetryLocalHttpServer::~FTelemetryLocalHttpServer()
+{
+    Stop();
+}
+
+bool FTelemetryLocalHttpServer::Start(int32 Port)
+{
+    Stop();
+
+    const FIPv4Endpoint Endpoint(FIPv4Address(127, 0, 0, 1), Port);
+    FSocket *Socket = FTcpSocketBuilder(TEXT("TelemetryLocalHttpServer"))
+        .AsReusable()
+        .BoundToEndpoint(Endpoint);
+
+    if (Socket == nullptr)
+    {
+        return false;
+    }
+
+    //The listener starts accepting as soon as it is created, and closes any connection that arrives before its
+    //delegate is bound, so the socket only listens once it is
+    Listener = MakeUnique<FTcpListener>(*Socket, FTimespan::FromMilliseconds(100));
+    Listener->OnConnectionAccepted().BindRaw(this, &FTelemetryLocalHttpServer::OnConnection);
+
+    if (!Socket->Listen(64))
+    {
+        Listener.Reset();
+        return false;
+    }
+
+    return true;
+}
+
+void FTelemetryLocalHttpServer::Stop()
+{
+    if (!Listener.IsValid())
+    {
+        return;
+    }
+
+    //The listener closes its socket, so no more connections arrive while those already accepted finish
+    Listener.Reset();
+
+    while (NumConnections.GetValue() > 0)
+    {
+        FPlatformProcess::Sleep(0.01f);
+    }
+}
+
+bool FTelemetryLocalHttpServer::OnConnection(FSocket *Socket, const FIPv4Endpoint &Endpoint)
+{
+    NumConnections.Increment();
+
+    Async<void>(EAsyncExecution::ThreadPool, [this, Socket]()
+    {
+        Socket->SetNonBlocking(false);
+
+        FLocalHttpRequest Request;
+        if (ReadRequest(*Socket, Request))
+        {
+            NumRequests.Increment();
+
+            if (Request.Path.EndsWith(TEXT("ingest")) && Request.Verb == TEXT("POST"))
+            {
+                NumIngested.Add(AnswerIngest(Server, *Socket, Request));
+            }
+            else if (Request.Path.EndsWith(TEXT("query")))
+            {
+                AnswerQuery(Server, *Socket, Request);
+            }
+            else
+            {
+                SendText(*Socket, 404, TEXT("Not Found"), TEXT("{\"Success\":false}"));
+            }
+        }
+        else
+        {
+            UE_LOG(LogTelemetryVisualizer, Verbose, TEXT("Dropped a connection to the local query server that sent no complete request"));
+        }
+
+        Socket->Close();
+        ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->DestroySocket(Socket);
+        NumConnections.Decrement();
+    });
+
+    return true;
+}
+
+static TUniquePtr<FTelemetryLocalHttpServer> ListenServer;
+
+static FAutoConsoleCommand LocalServerListenCommand(
+    TEXT("Telemetry.LocalServer.Listen"),
+    TEXT("Serves the local query server at http://127.0.0.1:<port>/api/query and /api/ingest, 0 to stop"),
+    FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString> &Args)
+    {
+        const int32 Port = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 0;
+
+        if (Port <= 0)
+        {
+            ListenServer.Reset();
+            return;
+        }
+
+        if (!ListenServer.IsValid())
+        {
+            ListenServer = MakeUnique<FTelemetryLocalHttpServer>(FTelemetryLocalServer::Get());
+        }
+
+        if (ListenServer->Start(Port))
+        {
+            UE_LOG(LogTelemetryVisualizer, Log, TEXT("Local query server listening at http://127.0.0.1:%d/api/query"), Port);
+        }
+        else
+        {
+            UE_LOG(LogTelemetryVisualizer, Warning, TEXT("Unable to listen on port %d"), Port);
+        }
+    }));
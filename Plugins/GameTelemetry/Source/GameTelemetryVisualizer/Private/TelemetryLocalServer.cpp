@@ -0,0 +1,1030 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//--------------------------------------------------------------------------------------
+// TelemetryLocalServer.cpp
+//
+// In process stand-in for the query service
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "Query/TelemetryLocalServer.h"
+#include "Query/TelemetryQueryAggregate.h"
+#include "Query/TelemetryQueryFormat.h"
+#include "TelemetryVisualizerModule.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/ScopeLock.h"
+#include "HAL/PlatformProcess.h"
+#include "Algo/Reverse.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "Policies/CondensedJsonPrintPolicy.h"
+
+//Oldest events are dropped past this, so a generator left running does not grow without bound
+static const int32 DefaultMaxEvents = 1000000;
+
+//Events appended to the store are written in blocks of about this many characters
+static const int32 StoreBlockSize = 4 * 1024 * 1024;
+
+//At most this many seconds of events are generated at once, e.g. after the editor was paused in a debugger
+static const double MaxGenerateSeconds = 60.0;
+
+static const struct
+{
+    const TCHAR *Name;
+    const TCHAR *Category;
+} GeneratedEvents[] =
+{
+    { TEXT("player_death"), TEXT("Gameplay") },
+    { TEXT("item_pickup"), TEXT("Gameplay") },
+    { TEXT("enemy_killed"), TEXT("Combat") },
+    { TEXT("player_position"), TEXT("Movement") },
+};
+
+template <class PrintPolicy>
+static void WriteEvent(const FJsonObject &Event, const TSet<FString> &Columns, TSharedRef<TJsonWriter<TCHAR, PrintPolicy>> &Writer)
+{
+    Writer->WriteObjectStart();
+    for (const auto &Field : Event.Values)
+    {
+        if (Columns.Num() > 0 && !Columns.Contains(Field.Key))
+        {
+            continue;
+        }
+
+        switch (Field.Value->Type)
+        {
+        case EJson::Number: Writer->WriteValue(Field.Key, Field.Value->AsNumber()); break;
+        case EJson::String: Writer->WriteValue(Field.Key, Field.Value->AsString()); break;
+        case EJson::Boolean: Writer->WriteValue(Field.Key, Field.Value->AsBool()); break;
+        default: break;
+        }
+    }
+    Writer->WriteObjectEnd();
+}
+
+static FString GetEventTime(const TSharedPtr<FJsonObject> &Event)
+{
+    FString Time;
+    Event->TryGetStringField(TEXT("client_ts"), Time);
+    return Time;
+}
+
+static void SortNewestFirst(TArray<TSharedPtr<FJsonObject>> &Events)
+{
+    //Times are read once each, rather than at every comparison
+    TArray<TPair<FString, TSharedPtr<FJsonObject>>> Keyed;
+    Keyed.Reserve(Events.Num());
+    for (TSharedPtr<FJsonObject> &Event : Events)
+    {
+        Keyed.Emplace(GetEventTime(Event), MoveTemp(Event));
+    }
+
+    Keyed.StableSort([](const TPair<FString, TSharedPtr<FJsonObject>> &A, const TPair<FString, TSharedPtr<FJsonObject>> &B)
+    {
+        return A.Key.Compare(B.Key, ESearchCase::CaseSensitive) > 0;
+    });
+
+    for (int32 i = 0; i < Keyed.Num(); i++)
+    {
+        Events[i] = MoveTemp(Keyed[i].Value);
+    }
+}
+
+//Writes events as newline delimited Json
+static void AppendToStore(const TArray<TSharedPtr<FJsonObject>> &Events, FArchive &Store)
+{
+    FString Block;
+
+    for (int32 i = 0; i < Events.Num(); i++)
+    {
+        FString Line;
+        TSharedRef<TJsonWriter<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>> Writer = TJsonWriterFactory<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>::Create(&Line);
+        WriteEvent(*Events[i], TSet<FString>(), Writer);
+        Writer->Close();
+
+        Block += Line;
+        Block += TEXT("\n");
+
+        if (Block.Len() >= StoreBlockSize || i == Events.Num() - 1)
+        {
+            FTCHARToUTF8 Utf8(*Block);
+            Store.Serialize(const_cast<ANSICHAR *>(Utf8.Get()), Utf8.Length());
+            Block.Reset();
+        }
+    }
+
+    Store.Flush();
+}
+
+FTelemetryLocalServer &FTelemetryLocalServer::Get()
+{
+    static FTelemetryLocalServer Server;
+    return Server;
+}
+
+FTelemetryLocalServer::FTelemetryLocalServer() :
+    NextSequence(1),
+    MaxEvents(DefaultMaxEvents),
+    Latency(0.f),
+    LatencyPerThousandEvents(0.f),
+    GenerateRate(0.f),
+    Random(FPlatformTime::Cycles())
+{
+    for (int32 i = 0; i < 4; i++)
+    {
+        Sessions.Add(FGuid::NewGuid().ToString(EGuidFormats::DigitsWithHyphens));
+    }
+
+    for (int32 i = 0; i < 5; i++)
+    {
+        Clusters.Add(FVector(Random.FRandRange(-5000.f, 5000.f), Random.FRandRange(-5000.f, 5000.f), Random.FRandRange(0.f, 500.f)));
+    }
+}
+
+void FTelemetryLocalServer::SetGenerateRate(float EventsPerSecond)
+{
+    FScopeLock ScopeLock(&Lock);
+
+    GenerateRate = FMath::Max(EventsPerSecond, 0.f);
+    LastGenerated = FDateTime::UtcNow();
+}
+
+void FTelemetryLocalServer::SetLatency(float Milliseconds, float MillisecondsPerThousandEvents)
+{
+    FScopeLock ScopeLock(&Lock);
+
+    Latency = FMath::Max(Milliseconds, 0.f);
+    LatencyPerThousandEvents = FMath::Max(MillisecondsPerThousandEvents, 0.f);
+}
+
+void FTelemetryLocalServer::SetMaxEvents(int32 InMaxEvents)
+{
+    FScopeLock ScopeLock(&Lock);
+
+    MaxEvents = FMath::Max(InMaxEvents, 1);
+    if (Events.Num() > MaxEvents)
+    {
+        Events.SetNum(MaxEvents);
+    }
+}
+
+void FTelemetryLocalServer::Empty()
+{
+    FScopeLock ScopeLock(&Lock);
+    Events.Empty();
+}
+
+int32 FTelemetryLocalServer::Num()
+{
+    FScopeLock ScopeLock(&Lock);
+    return Events.Num();
+}
+
+void FTelemetryLocalServer::GenerateUntil(const FDateTime &Now)
+{
+    if (GenerateRate <= 0.f || Now <= LastGenerated)
+    {
+        return;
+    }
+
+    const double Seconds = FMath::Min((Now - LastGenerated).GetTotalSeconds(), MaxGenerateSeconds);
+    const int32 Count = (int32)(Seconds * GenerateRate);
+    if (Count == 0)
+    {
+        return;
+    }
+
+    //Spread evenly over the elapsed time, oldest first so each lands in front of the previous one
+    const FTimespan Step = FTimespan::FromSeconds(Seconds / Count);
+    FDateTime Time = Now - FTimespan::FromSeconds(Seconds);
+
+    TArray<TSharedPtr<FJsonObject>> Generated;
+    Generated.Reserve(Count);
+
+    for (int32 i = 0; i < Count; i++)
+    {
+        Time += Step;
+
+        const auto &Type = GeneratedEvents[Random.RandHelper(ARRAY_COUNT(GeneratedEvents))];
+        const FVector Position = Clusters[Random.RandHelper(Clusters.Num())] + Random.GetUnitVector() * Random.FRandRange(0.f, 500.f);
+        const FVector Direction = Random.GetUnitVector();
+
+        TSharedPtr<FJsonObject> Event = MakeShareable(new FJsonObject);
+        Event->SetStringField(TEXT("id"), FGuid::NewGuid().ToString(EGuidFormats::DigitsWithHyphens));
+        Event->SetStringField(TEXT("name"), Type.Name);
+        Event->SetStringField(TEXT("cat"), Type.Category);
+        Event->SetStringField(TEXT("client_ts"), Time.ToIso8601());
+        Event->SetStringField(TEXT("session_id"), Sessions[Random.RandHelper(Sessions.Num())]);
+        Event->SetStringField(TEXT("build_type"), TEXT("Development"));
+        Event->SetStringField(TEXT("build_id"), TEXT("1.0.0"));
+        Event->SetStringField(TEXT("platform"), TEXT("Windows"));
+        Event->SetNumberField(TEXT("pos_x"), Position.X);
+        Event->SetNumberField(TEXT("pos_y"), Position.Y);
+        Event->SetNumberField(TEXT("pos_z"), Position.Z);
+        Event->SetNumberField(TEXT("dir_x"), Direction.X);
+        Event->SetNumberField(TEXT("dir_y"), Direction.Y);
+        Event->SetNumberField(TEXT("dir_z"), Direction.Z);
+        Event->SetNumberField(TEXT("val_health"), Random.FRandRange(0.f, 100.f));
+        Event->SetNumberField(TEXT("pct_progress"), Random.GetFraction());
+
+        Generated.Add(Event);
+    }
+
+    Algo::Reverse(Generated);
+    AddEvents(MoveTemp(Generated));
+
+    LastGenerated = Now;
+}
+
+bool FTelemetryLocalServer::LoadFile(const FString &Path)
+{
+    FString Text;
+    if (!FFileHelper::LoadFileToString(Text, *Path))
+    {
+        return false;
+    }
+
+    TSharedPtr<FJsonObject> Root;
+    TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(Text);
+    if (!FJsonSerializer::Deserialize(Reader, Root) || !Root.IsValid())
+    {
+        return false;
+    }
+
+    const TArray<TSharedPtr<FJsonValue>> *Results;
+    if (!Root->TryGetArrayField(TEXT("Results"), Results))
+    {
+        return false;
+    }
+
+    TArray<TSharedPtr<FJsonObject>> Loaded;
+    for (const TSharedPtr<FJsonValue> &Value : *Results)
+    {
+        if (Value->Type == EJson::Object)
+        {
+            Loaded.Add(Value->AsObject());
+        }
+    }
+
+    SortNewestFirst(Loaded);
+
+    FScopeLock ScopeLock(&Lock);
+    AddEvents(MoveTemp(Loaded));
+
+    return true;
+}
+
+void FTelemetryLocalServer::AddEvents(TArray<TSharedPtr<FJsonObject>> &&Added)
+{
+    if (Added.Num() == 0)
+    {
+        return;
+    }
+
+    if (Store.IsValid())
+    {
+        AppendToStore(Added, *Store);
+    }
+
+    //Every event of a batch is added at once, so they share a sequence number
+    const uint64 Sequence = NextSequence++;
+
+    TArray<FStoredEvent> Stored;
+    Stored.Reserve(Added.Num());
+    for (TSharedPtr<FJsonObject> &Event : Added)
+    {
+        Stored.Add({ MoveTemp(Event), Sequence });
+    }
+
+    //Usually every added event is newer than those already here, e.g. a batch just ingested
+    if (Events.Num() == 0 || GetEventTime(Stored.Last().Object).Compare(GetEventTime(Events[0].Object), ESearchCase::CaseSensitive) >= 0)
+    {
+        Events.Insert(MoveTemp(Stored), 0);
+    }
+    else
+    {
+        TArray<FStoredEvent> Merged;
+        Merged.Reserve(Events.Num() + Stored.Num());
+
+        int32 NextAdded = 0;
+        int32 NextEvent = 0;
+        FString AddedTime = GetEventTime(Stored[0].Object);
+        FString EventTime = GetEventTime(Events[0].Object);
+
+        while (NextAdded < Stored.Num() && NextEvent < Events.Num())
+        {
+            if (AddedTime.Compare(EventTime, ESearchCase::CaseSensitive) >= 0)
+            {
+                Merged.Add(MoveTemp(Stored[NextAdded++]));
+                if (NextAdded < Stored.Num())
+                {
+                    AddedTime = GetEventTime(Stored[NextAdded].Object);
+                }
+            }
+            else
+            {
+                Merged.Add(MoveTemp(Events[NextEvent++]));
+                if (NextEvent < Events.Num())
+                {
+                    EventTime = GetEventTime(Events[NextEvent].Object);
+                }
+            }
+        }
+
+        for (; NextAdded < Stored.Num(); NextAdded++)
+        {
+            Merged.Add(MoveTemp(Stored[NextAdded]));
+        }
+
+        for (; NextEvent < Events.Num(); NextEvent++)
+        {
+            Merged.Add(MoveTemp(Events[NextEvent]));
+        }
+
+        Events = MoveTemp(Merged);
+    }
+
+    if (Events.Num() > MaxEvents)
+    {
+        Events.SetNum(MaxEvents);
+    }
+}
+
+int32 FTelemetryLocalServer::Ingest(const uint8 *Data, int32 Size)
+{
+    TArray<uint8> Inflated;
+    if (FQueryResponseFormat::IsGzip(Data, Size))
+    {
+        if (!FQueryResponseFormat::Gunzip(Data, Size, Inflated))
+        {
+            return -1;
+        }
+
+        Data = Inflated.GetData();
+        Size = Inflated.Num();
+    }
+
+    //The game compresses its payload along with the terminating null
+    while (Size > 0 && Data[Size - 1] == 0)
+    {
+        Size--;
+    }
+
+    FUTF8ToTCHAR Converted((const ANSICHAR *)Data, Size);
+    const FString Text(Converted.Length(), Converted.Get());
+
+    TSharedPtr<FJsonObject> Root;
+    TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(Text);
+    if (!FJsonSerializer::Deserialize(Reader, Root) || !Root.IsValid())
+    {
+        return -1;
+    }
+
+    const TSharedPtr<FJsonObject> *Header;
+    const TArray<TSharedPtr<FJsonValue>> *Batch;
+    if (!Root->TryGetObjectField(TEXT("header"), Header) || !Root->TryGetArrayField(TEXT("events"), Batch))
+    {
+        return -1;
+    }
+
+    TArray<TSharedPtr<FJsonObject>> Added;
+    Added.Reserve(Batch->Num());
+
+    for (const TSharedPtr<FJsonValue> &Value : *Batch)
+    {
+        if (Value->Type != EJson::Object)
+        {
+            continue;
+        }
+
+        //Fields of the event win over those of the header
+        TSharedPtr<FJsonObject> Event = MakeShareable(new FJsonObject);
+        Event->Values = (*Header)->Values;
+        Event->Values.Append(Value->AsObject()->Values);
+
+        if (!Event->HasField(TEXT("id")))
+        {
+            Event->SetStringField(TEXT("id"), FGuid::NewGuid().ToString(EGuidFormats::DigitsWithHyphens));
+        }
+
+        Added.Add(Event);
+    }
+
+    SortNewestFirst(Added);
+    const int32 Count = Added.Num();
+
+    FScopeLock ScopeLock(&Lock);
+    AddEvents(MoveTemp(Added));
+
+    return Count;
+}
+
+bool FTelemetryLocalServer::OpenStore(const FString &Path)
+{
+    TArray<TSharedPtr<FJsonObject>> Loaded;
+    int32 Skipped = 0;
+
+    if (IFileManager::Get().FileExists(*Path))
+    {
+        FString Text;
+        if (!FFileHelper::LoadFileToString(Text, *Path))
+        {
+            return false;
+        }
+
+        //Read a line at a time, so a line cut off by a process stopped while appending loses only that event
+        int32 LineStart = 0;
+        while (LineStart < Text.Len())
+        {
+            int32 LineEnd = Text.Find(TEXT("\n"), ESearchCase::CaseSensitive, ESearchDir::FromStart, LineStart);
+            if (LineEnd == INDEX_NONE)
+            {
+                LineEnd = Text.Len();
+            }
+
+            const FString Line = Text.Mid(LineStart, LineEnd - LineStart).TrimStartAndEnd();
+            LineStart = LineEnd + 1;
+
+            if (Line.IsEmpty())
+            {
+                continue;
+            }
+
+            TSharedPtr<FJsonObject> Event;
+            TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(Line);
+            if (FJsonSerializer::Deserialize(Reader, Event) && Event.IsValid())
+            {
+                Loaded.Add(Event);
+            }
+            else
+            {
+                Skipped++;
+            }
+        }
+    }
+
+    SortNewestFirst(Loaded);
+    const int32 Count = Loaded.Num();
+
+    FScopeLock ScopeLock(&Lock);
+
+    //Events from the file are already in it
+    Store.Reset();
+    AddEvents(MoveTemp(Loaded));
+
+    Store.Reset(IFileManager::Get().CreateFileWriter(*Path, FILEWRITE_Append | FILEWRITE_AllowRead));
+    if (!Store.IsValid())
+    {
+        return false;
+    }
+
+    if (Skipped > 0)
+    {
+        UE_LOG(LogTelemetryVisualizer, Warning, TEXT("Skipped %d lines of %s that were not events"), Skipped, *Path);
+    }
+
+    UE_LOG(LogTelemetryVisualizer, Log, TEXT("Loaded %d events from %s, appending new events to it"), Count, *Path);
+    return true;
+}
+
+//Normally distributed, with a mean of 0 and deviation of 1
+static float RandGaussian(FRandomStream &Stream)
+{
+    const float U = FMath::Max(Stream.GetFraction(), KINDA_SMALL_NUMBER);
+    return FMath::Sqrt(-2.f * FMath::Loge(U)) * FMath::Cos(2.f * PI * Stream.GetFraction());
+}
+
+static FString RandGuid(FRandomStream &Stream)
+{
+    return FGuid(Stream.GetUnsignedInt(), Stream.GetUnsignedInt(), Stream.GetUnsignedInt(), Stream.GetUnsignedInt()).ToString(EGuidFormats::DigitsWithHyphens);
+}
+
+void FTelemetryLocalServer::GenerateDataset(const FTelemetryDatasetOptions &Options)
+{
+    const double StartTime = FPlatformTime::Seconds();
+    const FDateTime Now = FDateTime::UtcNow();
+    FRandomStream Stream(Options.Seed);
+
+    static const TCHAR *Platforms[] = { TEXT("Windows"), TEXT("XboxOne"), TEXT("PS4") };
+    static const TCHAR *Builds[] = { TEXT("1.0.0"), TEXT("1.0.1"), TEXT("1.1.0") };
+    static const TCHAR *BuildTypes[] = { TEXT("Development"), TEXT("Test"), TEXT("Shipping") };
+
+    struct FHotspot
+    {
+        FVector Center;
+        float Radius;
+        float Weight;
+    };
+
+    //A few areas are far busier than the rest
+    TArray<FHotspot> Hotspots;
+    float TotalWeight = 0.f;
+    for (int32 i = 0; i < FMath::Max(Options.Clusters, 1); i++)
+    {
+        FHotspot Hotspot;
+        Hotspot.Center = FVector(Stream.FRandRange(-20000.f, 20000.f), Stream.FRandRange(-20000.f, 20000.f), Stream.FRandRange(0.f, 2000.f));
+        Hotspot.Radius = Stream.FRandRange(300.f, 2000.f);
+        Hotspot.Weight = 1.f / (i + 1);
+        TotalWeight += Hotspot.Weight;
+        Hotspots.Add(Hotspot);
+    }
+
+    auto PickHotspot = [&Stream, &Hotspots, TotalWeight]()
+    {
+        float Pick = Stream.GetFraction() * TotalWeight;
+        for (int32 i = 0; i < Hotspots.Num() - 1; i++)
+        {
+            Pick -= Hotspots[i].Weight;
+            if (Pick <= 0.f)
+            {
+                return i;
+            }
+        }
+        return Hotspots.Num() - 1;
+    };
+
+    //Strings that repeat across events are held once and shared
+    TArray<TSharedPtr<FJsonValue>> Names;
+    TArray<TSharedPtr<FJsonValue>> Categories;
+    for (const auto &Type : GeneratedEvents)
+    {
+        Names.Add(MakeShareable(new FJsonValueString(Type.Name)));
+        Categories.Add(MakeShareable(new FJsonValueString(Type.Category)));
+    }
+
+    const int32 Count = FMath::Max(Options.Count, 0);
+    const int32 NumSessions = FMath::Clamp(Options.Sessions, 1, FMath::Max(Count, 1));
+
+    TArray<TPair<int64, TSharedPtr<FJsonObject>>> Generated;
+    Generated.Reserve(Count);
+
+    for (int32 Session = 0; Session < NumSessions; Session++)
+    {
+        const int32 SessionEvents = Count / NumSessions + (Session < Count % NumSessions ? 1 : 0);
+        if (SessionEvents == 0)
+        {
+            continue;
+        }
+
+        const FTimespan Length = FTimespan::FromMinutes(Stream.FRandRange(5.f, 60.f));
+        const FDateTime SessionStart = Now - Length - FTimespan::FromDays(Stream.GetFraction() * Options.Days);
+        const int64 Step = Length.GetTicks() / SessionEvents;
+
+        const TSharedPtr<FJsonValue> SessionId = MakeShareable(new FJsonValueString(RandGuid(Stream)));
+        const TSharedPtr<FJsonValue> ClientId = MakeShareable(new FJsonValueString(RandGuid(Stream)));
+        const TSharedPtr<FJsonValue> Platform = MakeShareable(new FJsonValueString(Platforms[Stream.RandHelper(ARRAY_COUNT(Platforms))]));
+        const TSharedPtr<FJsonValue> Build = MakeShareable(new FJsonValueString(Builds[Stream.RandHelper(ARRAY_COUNT(Builds))]));
+        const TSharedPtr<FJsonValue> BuildType = MakeShareable(new FJsonValueString(BuildTypes[Stream.RandHelper(ARRAY_COUNT(BuildTypes))]));
+
+        int32 Target = PickHotspot();
+        FVector Position = Hotspots[Target].Center + FVector(RandGaussian(Stream), RandGaussian(Stream), 0.f) * Hotspots[Target].Radius;
+        float Health = 100.f;
+
+        for (int32 i = 0; i < SessionEvents; i++)
+        {
+            //Players wander around one area, now and then heading off to another
+            if (Stream.GetFraction() < 0.01f)
+            {
+                Target = PickHotspot();
+            }
+
+            const FHotspot &Hotspot = Hotspots[Target];
+            const FVector Goal = Hotspot.Center + FVector(RandGaussian(Stream), RandGaussian(Stream), 0.1f * RandGaussian(Stream)) * Hotspot.Radius;
+            const FVector Direction = (Goal - Position).GetSafeNormal();
+            Position = FMath::Lerp(Position, Goal, 0.2f);
+
+            //Mostly movement, then pickups, kills and the odd death, in the order of GeneratedEvents
+            const float Roll = Stream.GetFraction();
+            const int32 Type = Roll < 0.04f ? 0 : (Roll < 0.16f ? 1 : (Roll < 0.3f ? 2 : 3));
+
+            const FDateTime Time = SessionStart + FTimespan(Step * i + Stream.RandHelper(FMath::Max((int32)FMath::Min<int64>(Step, MAX_int32), 1)));
+
+            TSharedPtr<FJsonObject> Event = MakeShareable(new FJsonObject);
+            Event->SetStringField(TEXT("id"), RandGuid(Stream));
+            Event->SetField(TEXT("name"), Names[Type]);
+            Event->SetField(TEXT("cat"), Categories[Type]);
+            Event->SetStringField(TEXT("client_ts"), Time.ToIso8601());
+            Event->SetField(TEXT("session_id"), SessionId);
+            Event->SetField(TEXT("client_id"), ClientId);
+            Event->SetField(TEXT("build_type"), BuildType);
+            Event->SetField(TEXT("build_id"), Build);
+            Event->SetField(TEXT("platform"), Platform);
+            Event->SetNumberField(TEXT("pos_x"), Position.X);
+            Event->SetNumberField(TEXT("pos_y"), Position.Y);
+            Event->SetNumberField(TEXT("pos_z"), Position.Z);
+            Event->SetNumberField(TEXT("dir_x"), Direction.X);
+            Event->SetNumberField(TEXT("dir_y"), Direction.Y);
+            Event->SetNumberField(TEXT("dir_z"), Direction.Z);
+
+            //Frame rate drops in the busiest areas
+            Event->SetNumberField(TEXT("val_fps"), FMath::Clamp(60.f - 30.f * Hotspot.Weight + 4.f * RandGaussian(Stream), 10.f, 120.f));
+            Event->SetNumberField(TEXT("pct_progress"), (float)(i + 1) / SessionEvents);
+
+            if (Type == 2)
+            {
+                const float Damage = Stream.FRandRange(5.f, 40.f);
+                Health = FMath::Max(Health - 0.5f * Damage, 1.f);
+                Event->SetNumberField(TEXT("val_damage"), Damage);
+                Event->SetNumberField(TEXT("pct_accuracy"), FMath::Clamp(0.6f + 0.15f * RandGaussian(Stream), 0.f, 1.f));
+            }
+            else if (Type == 1)
+            {
+                Health = FMath::Min(Health + 15.f, 100.f);
+            }
+            else if (Type == 0)
+            {
+                Health = 0.f;
+            }
+
+            Event->SetNumberField(TEXT("val_health"), Health);
+
+            if (Type == 0)
+            {
+                Health = 100.f;
+            }
+
+            Generated.Emplace(Time.GetTicks(), Event);
+        }
+    }
+
+    Generated.Sort([](const TPair<int64, TSharedPtr<FJsonObject>> &A, const TPair<int64, TSharedPtr<FJsonObject>> &B)
+    {
+        return A.Key > B.Key;
+    });
+
+    TArray<TSharedPtr<FJsonObject>> Added;
+    Added.Reserve(Generated.Num());
+    for (TPair<int64, TSharedPtr<FJsonObject>> &Event : Generated)
+    {
+        Added.Add(MoveTemp(Event.Value));
+    }
+    Generated.Empty();
+
+    {
+        FScopeLock ScopeLock(&Lock);
+        AddEvents(MoveTemp(Added));
+    }
+
+    UE_LOG(LogTelemetryVisualizer, Log, TEXT("Generated %d events in %d sessions in %.1f s"), Count, NumSessions, FPlatformTime::Seconds() - StartTime);
+}
+
+//Compares an event field with a query value.  Returns false if the field is missing or of another type
+static bool CompareField(const FJsonObject &Event, const FString &Column, const TSharedPtr<FJsonValue> &Value, int32 &OutOrder)
+{
+    const TSharedPtr<FJsonValue> Field = Event.Values.FindRef(Column);
+    if (!Field.IsValid() || !Value.IsValid())
+    {
+        return false;
+    }
+
+    if (Value->Type == EJson::Number && Field->Type == EJson::Number)
+    {
+        const double A = Field->AsNumber();
+        const double B = Value->AsNumber();
+        OutOrder = A < B ? -1 : (A > B ? 1 : 0);
+        return true;
+    }
+
+    if (Value->Type == EJson::Boolean && Field->Type == EJson::Boolean)
+    {
+        OutOrder = (int32)Field->AsBool() - (int32)Value->AsBool();
+        return true;
+    }
+
+    if (Value->Type == EJson::String && Field->Type == EJson::String)
+    {
+        OutOrder = Field->AsString().Compare(Value->AsString(), ESearchCase::CaseSensitive);
+        return true;
+    }
+
+    return false;
+}
+
+bool FTelemetryLocalServer::Matches(const FJsonObject &Event, const FJsonObject &Query) const
+{
+    const FString Op = Query.GetStringField(TEXT("op"));
+
+    //An aggregate filters like an and group of its children
+    const FString Type = Query.GetStringField(TEXT("type"));
+    if (Type == TEXT("group") || Type == TEXT("aggregate"))
+    {
+        const TArray<TSharedPtr<FJsonValue>> *Children;
+        if (!Query.TryGetArrayField(TEXT("children"), Children))
+        {
+            return true;
+        }
+
+        const bool IsOr = (Op == TEXT("or"));
+        for (const TSharedPtr<FJsonValue> &Child : *Children)
+        {
+            if (Matches(Event, *Child->AsObject()) == IsOr)
+            {
+                return IsOr;
+            }
+        }
+        return !IsOr;
+    }
+
+    const FString Column = Query.GetStringField(TEXT("column"));
+    int32 Order = 0;
+
+    if (Op == TEXT("in") || Op == TEXT("btwn"))
+    {
+        const TArray<TSharedPtr<FJsonValue>> *Values;
+        if (!Query.TryGetArrayField(TEXT("values"), Values))
+        {
+            return false;
+        }
+
+        if (Op == TEXT("btwn"))
+        {
+            int32 Upper = 0;
+            return Values->Num() == 2 && CompareField(Event, Column, (*Values)[0], Order) && Order >= 0 && CompareField(Event, Column, (*Values)[1], Upper) && Upper <= 0;
+        }
+
+        for (const TSharedPtr<FJsonValue> &Value : *Values)
+        {
+            if (CompareField(Event, Column, Value, Order) && Order == 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    if (!CompareField(Event, Column, Query.Values.FindRef(TEXT("value")), Order))
+    {
+        return false;
+    }
+
+    if (Op == TEXT("eq")) return Order == 0;
+    if (Op == TEXT("neq")) return Order != 0;
+    if (Op == TEXT("gt")) return Order > 0;
+    if (Op == TEXT("gte")) return Order >= 0;
+    if (Op == TEXT("lt")) return Order < 0;
+    if (Op == TEXT("lte")) return Order <= 0;
+
+    return false;
+}
+
+static void WriteCell(const FQueryAggregateCell &Cell, TSharedRef<TJsonWriter<>> &Writer)
+{
+    Writer->WriteObjectStart();
+    Writer->WriteValue(TEXT("cell_x"), Cell.Cell.X);
+    Writer->WriteValue(TEXT("cell_y"), Cell.Cell.Y);
+    Writer->WriteValue(TEXT("cell_z"), Cell.Cell.Z);
+    Writer->WriteValue(TEXT("count"), Cell.Count);
+    Writer->WriteValue(TEXT("dir_x"), Cell.Direction.X);
+    Writer->WriteValue(TEXT("dir_y"), Cell.Direction.Y);
+    Writer->WriteValue(TEXT("dir_z"), Cell.Direction.Z);
+    if (Cell.HasValue())
+    {
+        Writer->WriteValue(TEXT("sum"), Cell.Sum);
+        Writer->WriteValue(TEXT("min"), Cell.Min);
+        Writer->WriteValue(TEXT("max"), Cell.Max);
+    }
+    Writer->WriteObjectEnd();
+}
+
+//Adds an event to the cells of an aggregate query
+static void AggregateEvent(const FJsonObject &Event, const FString &Column, FQueryAggregator &Aggregator)
+{
+    double Count = 1;
+    Event.TryGetNumberField(TEXT("count"), Count);
+
+    double Value = 0;
+    const bool HasValue = !Column.IsEmpty() && Event.TryGetNumberField(Column, Value);
+
+    Aggregator.Add(
+        FVector(Event.GetNumberField(TEXT("pos_x")), Event.GetNumberField(TEXT("pos_y")), Event.GetNumberField(TEXT("pos_z"))),
+        FVector(Event.GetNumberField(TEXT("dir_x")), Event.GetNumberField(TEXT("dir_y")), Event.GetNumberField(TEXT("dir_z"))),
+        (int32)Count,
+        HasValue ? &Value : nullptr);
+}
+
+TArray<uint8> FTelemetryLocalServer::HandleQuery(const FString &QueryText, int32 TakeLimit, const FString &ContinuationToken, const FString &Columns, bool AsColumns)
+{
+    const double StartTime = FPlatformTime::Seconds();
+
+    TArray<FString> ColumnList;
+    Columns.ParseIntoArray(ColumnList, TEXT(","));
+    const TSet<FString> ColumnSet(ColumnList);
+
+    TSharedPtr<FJsonObject> Query;
+    if (!QueryText.IsEmpty())
+    {
+        TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(QueryText);
+
+        //A query that cannot be read is rejected, as the service does, rather than matching every event
+        if (!FJsonSerializer::Deserialize(Reader, Query) || !Query.IsValid())
+        {
+            FTCHARToUTF8 Utf8(TEXT("{\"Results\":[],\"Header\":{\"Success\":false,\"Count\":0,\"QueryTime\":0}}"));
+            return TArray<uint8>((const uint8 *)Utf8.Get(), Utf8.Length());
+        }
+    }
+
+    //The token is the number of matches already returned and the sequence number of the last batch the first page
+    //saw.  Events added while a query is paged through are left out of its later pages rather than shifting them
+    int32 Skip = 0;
+    uint64 Snapshot = 0;
+    FString SkipText;
+    FString SnapshotText;
+    if (ContinuationToken.Split(TEXT("|"), &SkipText, &SnapshotText))
+    {
+        Skip = FMath::Max(FCString::Atoi(*SkipText), 0);
+        Snapshot = FCString::Strtoui64(*SnapshotText, nullptr, 10);
+    }
+
+    const bool IsAggregate = Query.IsValid() && Query->GetStringField(TEXT("type")) == TEXT("aggregate");
+
+    //Matches are found under the lock and written after it is released, so a large page does not hold up
+    //ingestion or other queries
+    TArray<TSharedPtr<FJsonObject>> Matched;
+    bool HasMore = false;
+    float PageLatency = 0.f;
+    float PageLatencyPerThousandEvents = 0.f;
+
+    {
+        FScopeLock ScopeLock(&Lock);
+
+        GenerateUntil(FDateTime::UtcNow());
+
+        if (SnapshotText.IsEmpty())
+        {
+            Snapshot = NextSequence - 1;
+        }
+
+        int32 NumMatched = 0;
+        for (const FStoredEvent &Event : Events)
+        {
+            if (Event.Sequence > Snapshot || (Query.IsValid() && !Matches(*Event.Object, *Query)))
+            {
+                continue;
+            }
+
+            //Aggregates need every match to build their cells, which are then paged
+            if (!IsAggregate)
+            {
+                if (NumMatched++ < Skip)
+                {
+                    continue;
+                }
+
+                if (TakeLimit > 0 && Matched.Num() == TakeLimit)
+                {
+                    HasMore = true;
+                    break;
+                }
+            }
+
+            Matched.Add(Event.Object);
+        }
+
+        PageLatency = Latency;
+        PageLatencyPerThousandEvents = LatencyPerThousandEvents;
+    }
+
+    FString Payload;
+    TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Payload);
+
+    Writer->WriteObjectStart();
+    Writer->WriteArrayStart(TEXT("Results"));
+
+    int32 Count = 0;
+
+    //Aggregates return one result per cell, paged the same way as events
+    if (IsAggregate)
+    {
+        const FString Column = Query->GetStringField(TEXT("column"));
+        FQueryAggregator Aggregator(Query->GetNumberField(TEXT("value")));
+
+        for (const TSharedPtr<FJsonObject> &Event : Matched)
+        {
+            AggregateEvent(*Event, Column, Aggregator);
+        }
+
+        TArray<FQueryAggregateCell> Cells;
+        Aggregator.GetCells(Cells);
+
+        for (int32 i = Skip; i < Cells.Num(); i++)
+        {
+            if (TakeLimit > 0 && Count == TakeLimit)
+            {
+                HasMore = true;
+                break;
+            }
+
+            WriteCell(Cells[i], Writer);
+            Count++;
+        }
+    }
+    else
+    {
+        for (const TSharedPtr<FJsonObject> &Event : Matched)
+        {
+            WriteEvent(*Event, ColumnSet, Writer);
+        }
+        Count = Matched.Num();
+    }
+
+    Writer->WriteArrayEnd();
+
+    //Requests running at once are delayed at once, as they would be by a service
+    const float Delay = PageLatency + PageLatencyPerThousandEvents * Count / 1000.f;
+    if (Delay > 0.f)
+    {
+        FPlatformProcess::Sleep(Delay / 1000.f);
+    }
+
+    Writer->WriteObjectStart(TEXT("Header"));
+    Writer->WriteValue(TEXT("Success"), true);
+    Writer->WriteValue(TEXT("Count"), Count);
+    Writer->WriteValue(TEXT("QueryTime"), (int32)((FPlatformTime::Seconds() - StartTime) * 1000.0));
+    if (HasMore)
+    {
+        Writer->WriteValue(TEXT("ContinuationToken"), FString::Printf(TEXT("%d|%llu"), Skip + Count, Snapshot));
+    }
+    Writer->WriteObjectEnd();
+
+    Writer->WriteObjectEnd();
+    Writer->Close();
+
+    FTCHARToUTF8 Utf8(*Payload);
+    TArray<uint8> Response((const uint8 *)Utf8.Get(), Utf8.Length());
+
+    //Aggregate cells are not events, so they are always sent as Json
+    TArray<uint8> ColumnResponse;
+    if (AsColumns && !IsAggregate && FQueryResponseFormat::JsonToColumns(Response.GetData(), Response.Num(), ColumnResponse))
+    {
+        return ColumnResponse;
+    }
+
+    return Response;
+}
+
+static FAutoConsoleCommand LocalServerLoadCommand(
+    TEXT("Telemetry.LocalServer.Load"),
+    TEXT("Adds the events of a saved query response to the local query server"),
+    FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString> &Args)
+    {
+        if (Args.Num() < 1 || !FTelemetryLocalServer::Get().LoadFile(Args[0]))
+        {
+            UE_LOG(LogTelemetryVisualizer, Warning, TEXT("Usage: Telemetry.LocalServer.Load <saved query response>"));
+            return;
+        }
+
+        UE_LOG(LogTelemetryVisualizer, Log, TEXT("Local query server holds %d events"), FTelemetryLocalServer::Get().Num());
+    }));
+
+static FAutoConsoleCommand LocalServerGenerateCommand(
+    TEXT("Telemetry.LocalServer.Generate"),
+    TEXT("Generates events on the local query server at the given rate per second, 0 to stop"),
+    FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString> &Args)
+    {
+        FTelemetryLocalServer::Get().SetGenerateRate(Args.Num() > 0 ? FCString::Atof(*Args[0]) : 0.f);
+    }));
+
+static FAutoConsoleCommand LocalServerLatencyCommand(
+    TEXT("Telemetry.LocalServer.Latency"),
+    TEXT("Delays each response of the local query server by the given milliseconds, plus optional milliseconds per thousand events returned"),
+    FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString> &Args)
+    {
+        FTelemetryLocalServer::Get().SetLatency(Args.Num() > 0 ? FCString::Atof(*Args[0]) : 0.f, Args.Num() > 1 ? FCString::Atof(*Args[1]) : 0.f);
+    }));
+
+static FAutoConsoleCommand LocalServerEmptyCommand(
+    TEXT("Telemetry.LocalServer.Empty"),
+    TEXT("Removes every event from the local query server"),
+    FConsoleCommandDelegate::CreateLambda([]()
+    {
+        FTelemetryLocalServer::Get().Empty();
+    }));
+
+static FAutoConsoleCommand LocalServerGenerateDatasetCommand(
+    TEXT("Telemetry.LocalServer.GenerateDataset"),
+    TEXT("Adds a synthesized dataset to the local query server: [count] [sessions] [days] [seed]"),
+    FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString> &Args)
+    {
+        FTelemetryDatasetOptions Options;
+        Options.Count = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : Options.Count;
+        Options.Sessions = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : Options.Sessions;
+        Options.Days = Args.Num() > 2 ? FCString::Atof(*Args[2]) : Options.Days;
+        Options.Seed = Args.Num() > 3 ? FCString::Atoi(*Args[3]) : Options.Seed;
+
+        FTelemetryLocalServer::Get().GenerateDataset(Options);
+    }));
+
+static FAutoConsoleCommand LocalServerStoreCommand(
+    TEXT("Telemetry.LocalServer.Store"),
+    TEXT("Adds the events of a newline delimited Json file to the local query server and appends every new event to it"),
+    FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString> &Args)
+    {
+        if (Args.Num() < 1 || !FTelemetryLocalServer::Get().OpenStore(Args[0]))
+        {
+            UE_LOG(LogTelemetryVisualizer, Warning, TEXT("Usage: Telemetry.LocalServer.Store <newline delimited json>"));
+        }
+    }));
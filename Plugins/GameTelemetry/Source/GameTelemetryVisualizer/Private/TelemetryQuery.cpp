@@ -3,23 +3,30 @@
 //--------------------------------------------------------------------------------------
 // TelemetryQuery.cpp
 //
-// Provides implementation of serializer
+// Provides implementation of serializer, time sharding and query execution
 //
 // Advanced Technology Group (ATG)
 // Copyright (C) Microsoft Corporation. All rights reserved.
 //--------------------------------------------------------------------------------------
 
 #include "Query/TelemetryQuery.h"
+#include "Query/TelemetryQueryCache.h"
+#include "Query/TelemetryQueryTransport.h"
 #include "TelemetryVisualizerUI.h"
+#include "TelemetryVisualizerModule.h"
 #include "HttpModule.h"
 #include "Http.h"
+#include "GenericPlatform/GenericPlatformHttp.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
 
 
 // See: EQueryNodeType
 static const FQueryNodeType NodeTypeStrings[] =
 {
     "comparison",
-    "group"
+    "group",
+    "aggregate"
 };
 
 // See: EQueryOp
@@ -105,6 +112,12 @@ void FQuerySerializer::Serialize(const FQueryNodePtr &Node, TSharedRef<TJsonWrit
             Writer->WriteValue("column", Node->Column);
             WriteValue(Node->Value, Writer);
             break;
+
+        case EQueryNodeType::Aggregate:
+            Writer->WriteValue("column", Node->Column);
+            WriteValue(Node->Value, Writer);
+            Serialize(*(Node->Children), Writer);
+            break;
         }
     }
     Writer->WriteObjectEnd();
@@ -122,3 +135,1111 @@ void FQuerySerializer::Serialize(FQueryNodeList &Nodes, TSharedRef<TJsonWriter<>
     Writer->WriteArrayEnd();
 }
 
+FQueryNodePtr FQuerySerializer::Deserialize(const FString &QueryText)
+{
+    TSharedPtr<FJsonObject> Object;
+    TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(QueryText);
+
+    if (!FJsonSerializer::Deserialize(Reader, Object))
+    {
+        return nullptr;
+    }
+
+    return Deserialize(Object);
+}
+
+FQueryNodePtr FQuerySerializer::Deserialize(const TSharedPtr<FJsonObject> &Object)
+{
+    FString Type;
+    FString OpName;
+    if (!Object.IsValid() || !Object->TryGetStringField(TEXT("type"), Type) || !Object->TryGetStringField(TEXT("op"), OpName))
+    {
+        return nullptr;
+    }
+
+    int32 OpIndex = INDEX_NONE;
+    for (int32 i = 0; i < ARRAY_COUNT(QueryOpStrings); i++)
+    {
+        if (QueryOpStrings[i] == OpName)
+        {
+            OpIndex = i;
+            break;
+        }
+    }
+
+    if (OpIndex == INDEX_NONE)
+    {
+        return nullptr;
+    }
+
+    const EQueryOp Op = (EQueryOp)OpIndex;
+
+    const bool IsAggregate = Type == GetType(EQueryNodeType::Aggregate);
+
+    if (Type == GetType(EQueryNodeType::Group) || IsAggregate)
+    {
+        if ((Op != EQueryOp::And && Op != EQueryOp::Or) || (IsAggregate && Op != EQueryOp::And))
+        {
+            return nullptr;
+        }
+
+        FQueryNodeList Children;
+        const TArray<TSharedPtr<FJsonValue>> *Items;
+        if (Object->TryGetArrayField(TEXT("children"), Items))
+        {
+            for (const TSharedPtr<FJsonValue> &Item : *Items)
+            {
+                FQueryNodePtr Child = Deserialize(Item->AsObject());
+                if (!Child.IsValid())
+                {
+                    return nullptr;
+                }
+                Children.Add(Child);
+            }
+        }
+
+        if (IsAggregate)
+        {
+            FString Column;
+            double CellSize = 0;
+            Object->TryGetStringField(TEXT("column"), Column);
+
+            if (!Object->TryGetNumberField(TEXT("value"), CellSize) || CellSize <= 0)
+            {
+                return nullptr;
+            }
+
+            return MakeShareable(new FQueryNode(EQueryNodeType::Aggregate, Column, FJsonValueUtil::Create(CellSize), MoveTemp(Children)));
+        }
+
+        return MakeShareable(new FQueryNode(EQueryNodeType::Group, Op, MoveTemp(Children)));
+    }
+
+    FString Column;
+    if (Type != GetType(EQueryNodeType::Comparison) || !Object->TryGetStringField(TEXT("column"), Column))
+    {
+        return nullptr;
+    }
+
+    TSharedPtr<FJsonValue> Value = Object->Values.FindRef(Op == EQueryOp::In || Op == EQueryOp::Btwn ? TEXT("values") : TEXT("value"));
+    if (!Value.IsValid())
+    {
+        return nullptr;
+    }
+
+    return MakeShareable(new FQueryNode(EQueryNodeType::Comparison, Column, Op, MoveTemp(Value)));
+}
+
+FString FQuerySerializer::SerializeColumns(const TArray<FString> &Columns)
+{
+    TArray<FString> Sorted;
+    for (const FString &Column : Columns)
+    {
+        if (!Column.IsEmpty())
+        {
+            Sorted.AddUnique(Column);
+        }
+    }
+
+    Sorted.Sort();
+    return FString::Join(Sorted, TEXT(","));
+}
+
+//The client_ts range Node requires, as its bounds
+static bool GetTimeRange(const FQueryNodePtr &Node, FString &OutLower, FString &OutUpper)
+{
+    if (!Node.IsValid() || Node->Type != EQueryNodeType::Comparison || Node->Operator != EQueryOp::Btwn || Node->Column != TEXT("client_ts") || !Node->Value.IsValid())
+    {
+        return false;
+    }
+
+    const TArray<TSharedPtr<FJsonValue>> *Values;
+    if (!Node->Value->TryGetArray(Values) || Values->Num() != 2)
+    {
+        return false;
+    }
+
+    return (*Values)[0]->TryGetString(OutLower) && (*Values)[1]->TryGetString(OutUpper);
+}
+
+bool FQueryTimeShards::Split(const FQueryNodePtr &Query, int32 Shards, FQueryNodeList &OutShards)
+{
+    OutShards.Reset();
+
+    if (!Query.IsValid() || Shards < 2)
+    {
+        return false;
+    }
+
+    //Only a range every match must fall in can be split, so Or groups and aggregates are left whole
+    int32 RangeIndex = INDEX_NONE;
+    FString Lower;
+    FString Upper;
+
+    if (Query->Type == EQueryNodeType::Group && Query->Operator == EQueryOp::And && Query->Children.IsValid())
+    {
+        for (int32 i = 0; i < Query->Children->Num() && RangeIndex == INDEX_NONE; i++)
+        {
+            if (GetTimeRange((*Query->Children)[i], Lower, Upper))
+            {
+                RangeIndex = i;
+            }
+        }
+
+        if (RangeIndex == INDEX_NONE)
+        {
+            return false;
+        }
+    }
+    else if (!GetTimeRange(Query, Lower, Upper))
+    {
+        return false;
+    }
+
+    FDateTime LowerTime;
+    FDateTime UpperTime;
+    if (!FDateTime::ParseIso8601(*Lower, LowerTime) || !FDateTime::ParseIso8601(*Upper, UpperTime) || UpperTime <= LowerTime)
+    {
+        return false;
+    }
+
+    //Events are sent with millisecond times, so each shard covers whole milliseconds and the next one starts a
+    //millisecond before it
+    const int64 TicksPerMillisecond = ETimespan::TicksPerMillisecond;
+    const int64 Milliseconds = (UpperTime - LowerTime).GetTicks() / TicksPerMillisecond;
+    Shards = (int32)FMath::Min<int64>(Shards, Milliseconds);
+
+    if (Shards < 2)
+    {
+        return false;
+    }
+
+    const int64 Step = (Milliseconds / Shards) * TicksPerMillisecond;
+    const int64 UpperTicks = UpperTime.GetTicks() - UpperTime.GetTicks() % TicksPerMillisecond;
+
+    //The outer bounds are kept as written, so the shards match the same events at either end as Query does
+    FString ShardUpper = Upper;
+    for (int32 i = 0; i < Shards; i++)
+    {
+        FString ShardLower = Lower;
+        FString NextUpper;
+        if (i < Shards - 1)
+        {
+            const int64 Cut = UpperTicks - (i + 1) * Step;
+            ShardLower = FDateTime(Cut + TicksPerMillisecond).ToIso8601();
+            NextUpper = FDateTime(Cut).ToIso8601();
+        }
+
+        FQueryNodePtr Range = QBuilder::Btwn(TEXT("client_ts"), ShardLower, ShardUpper);
+
+        if (RangeIndex == INDEX_NONE)
+        {
+            OutShards.Add(Range);
+        }
+        else
+        {
+            FQueryNodeList Children = *Query->Children;
+            Children[RangeIndex] = Range;
+            OutShards.Add(QBuilder::And(MoveTemp(Children)));
+        }
+
+        ShardUpper = NextUpper;
+    }
+
+    return true;
+}
+
+//State shared by every page of one query.  Only the game thread changes it, apart from IsCancelled
+struct FQueryExecutor::FPagedQuery : public IQueryOperation
+{
+    FString Url;
+    FString Verb;
+    FString QueryText;
+    FString Columns;
+    QueryResultHandler HandlerFunc;
+    QueryProgressHandler ProgressFunc;
+    FQueryResultSinkFactory SinkFactory;
+    FHttpRequestPtr Request;
+    IQueryTransport *Transport;
+    TSharedPtr<FQueryCache, ESPMode::ThreadSafe> Cache;
+    FString CacheKey;
+    TSharedPtr<FQueryResultColumns, ESPMode::ThreadSafe> CacheColumns;
+    int32 QueryTime;
+    int32 PageSize;
+    int32 MaxResults;
+    int32 Received;
+    int32 PageIndex;
+
+    //Page of the latest request.  The next page is requested as soon as the token of the page being read is known,
+    //so it may be one past the page being read, and arrive before that page is delivered
+    int32 RequestIndex;
+
+    //Pages are read one at a time and in order.  A page that arrives while another is read waits here, with a null
+    //Content if its request failed
+    bool IsReading;
+    bool HasWaiting;
+    FContentPtr WaitingContent;
+    FQueryPageTimings WaitingTimings;
+
+    double RequestTime;
+    double FirstByteTime;
+    bool AcceptGzip;
+    bool AcceptColumns;
+    int32 MaxResponseSize;
+    FThreadSafeBool IsCancelled;
+
+    void Cancel() override
+    {
+        IsCancelled = true;
+
+        //Cancelling completes the request, which releases it
+        FHttpRequestPtr Pending = Request;
+        if (Pending.IsValid())
+        {
+            Pending->CancelRequest();
+        }
+    }
+
+    bool IsRunning() const override
+    {
+        return !IsCancelled;
+    }
+};
+
+//Shards of one query, newest first, and the pages they delivered that are not yet passed on.  Only the game
+//thread uses it.  Shards still running are cancelled when it is destroyed
+struct FQueryExecutor::FShardedQuery : public IQueryOperation
+{
+    QueryResultHandler HandlerFunc;
+    TArray<FPagedQueryRef> Shards;
+    TArray<TArray<TSharedPtr<SQueryResult>>> Pages;
+    TArray<bool> IsDone;
+    int32 Parallelism = 1;
+    int32 MaxResults = 0;
+
+    int32 NextShard = 0;
+    int32 Running = 0;
+
+    //Shard whose pages are passed on as they land.  Older shards are held until it is done
+    int32 DeliverShard = 0;
+    int32 PageIndex = 0;
+    int32 Received = 0;
+
+    //Whether every shard done so far holds all of its matches, and whether any page passed on failed
+    bool IsComplete = true;
+    bool HasFailedShard = false;
+    bool IsCancelled = false;
+
+    ~FShardedQuery()
+    {
+        Cancel();
+    }
+
+    void Cancel() override
+    {
+        IsCancelled = true;
+
+        //Shards that are done are left to store their results in the cache
+        for (int32 i = 0; i < Shards.Num(); i++)
+        {
+            if (!IsDone[i])
+            {
+                Shards[i]->Cancel();
+            }
+        }
+    }
+
+    bool IsRunning() const override
+    {
+        return !IsCancelled;
+    }
+};
+
+//Transports that answer urls in process.  Registered and looked up on the game thread
+static TArray<IQueryTransport*> QueryTransports;
+
+void FQueryExecutor::RegisterTransport(IQueryTransport *Transport)
+{
+    QueryTransports.AddUnique(Transport);
+}
+
+void FQueryExecutor::UnregisterTransport(IQueryTransport *Transport)
+{
+    QueryTransports.Remove(Transport);
+}
+
+IQueryTransport *FQueryExecutor::FindTransport(const FString &Url)
+{
+    for (IQueryTransport *Transport : QueryTransports)
+    {
+        if (Transport->HandlesUrl(Url))
+        {
+            return Transport;
+        }
+    }
+
+    return nullptr;
+}
+
+FQueryHandle FQueryExecutor::ExecuteShardedQuery(const FQueryNodePtr &Query, int32 Shards, QueryResultHandler HandlerFunc, int32 TakeLimit, FQueryResultSinkFactory SinkFactory, bool UseCache, const TArray<FString> &Columns)
+{
+    if (!IsInitialized)
+    {
+        Initialize();
+    }
+
+    CancelQuery();
+
+    if (Shards < 0)
+    {
+        Shards = ConfiguredShards;
+    }
+
+    FQuerySerializer Serializer;
+    FQueryNodeList ShardQueries;
+
+    if (!FQueryTimeShards::Split(Query, Shards, ShardQueries))
+    {
+        return Execute(TEXT("POST"), Serializer.Serialize(Query), HandlerFunc, TakeLimit, MoveTemp(SinkFactory), UseCache, Columns);
+    }
+
+    FShardedQueryRef Sharded = MakeShareable(new FShardedQuery);
+    Sharded->HandlerFunc = HandlerFunc;
+    Sharded->Parallelism = FMath::Max(ShardParallelism, 1);
+    Sharded->MaxResults = MaxResults;
+    Sharded->Pages.SetNum(ShardQueries.Num());
+    Sharded->IsDone.Init(false, ShardQueries.Num());
+
+    TWeakPtr<FShardedQuery, ESPMode::ThreadSafe> WeakSharded = Sharded;
+    for (int32 i = 0; i < ShardQueries.Num(); i++)
+    {
+        QueryResultHandler ShardHandler = QueryResultHandler::CreateLambda([WeakSharded, i](TSharedPtr<SQueryResult> Result)
+        {
+            TSharedPtr<FShardedQuery, ESPMode::ThreadSafe> Pinned = WeakSharded.Pin();
+            if (Pinned.IsValid())
+            {
+                DeliverShardPage(Pinned.ToSharedRef(), i, Result);
+            }
+        });
+
+        Sharded->Shards.Add(CreateQuery(TEXT("POST"), Serializer.Serialize(ShardQueries[i]), ShardHandler, TakeLimit, SinkFactory, UseCache, Columns));
+    }
+
+    ActiveSharded = Sharded;
+    StartShards(Sharded);
+    return FQueryHandle(Sharded);
+}
+
+void FQueryExecutor::CancelQuery()
+{
+    if (ActiveQuery.IsValid())
+    {
+        ActiveQuery->Cancel();
+        ActiveQuery.Reset();
+    }
+
+    if (ActiveSharded.IsValid())
+    {
+        ActiveSharded->Cancel();
+        ActiveSharded.Reset();
+    }
+}
+
+bool FQueryExecutor::IsQueryRunning() const
+{
+    return (ActiveQuery.IsValid() && !ActiveQuery->IsCancelled) || (ActiveSharded.IsValid() && !ActiveSharded->IsCancelled);
+}
+
+FQueryHandle FQueryExecutor::Execute(const FString &Verb, const FString &QueryText, QueryResultHandler HandlerFunc, int32 TakeLimit, FQueryResultSinkFactory SinkFactory, bool UseCache, const TArray<FString> &Columns)
+{
+    CancelQuery();
+
+    FPagedQueryRef Query = CreateQuery(Verb, QueryText, HandlerFunc, TakeLimit, MoveTemp(SinkFactory), UseCache, Columns);
+    ActiveQuery = Query;
+
+    StartQuery(Query);
+    return FQueryHandle(Query);
+}
+
+FQueryExecutor::FPagedQueryRef FQueryExecutor::CreateQuery(const FString &Verb, const FString &QueryText, QueryResultHandler HandlerFunc, int32 TakeLimit, FQueryResultSinkFactory SinkFactory, bool UseCache, const TArray<FString> &Columns)
+{
+    if (!IsInitialized)
+    {
+        Initialize();
+    }
+
+    if (TakeLimit < 0)
+    {
+        TakeLimit = ConfiguredTakeLimit;
+    }
+
+    FPagedQueryRef Query = MakeShareable(new FPagedQuery);
+    Query->Url = QueryUrl;
+    Query->Transport = FindTransport(QueryUrl);
+    Query->Verb = Verb;
+    Query->QueryText = QueryText;
+    Query->Columns = FQuerySerializer::SerializeColumns(Columns);
+    Query->HandlerFunc = HandlerFunc;
+    Query->ProgressFunc = ProgressFunc;
+    Query->SinkFactory = MoveTemp(SinkFactory);
+    Query->PageSize = TakeLimit;
+    Query->MaxResults = MaxResults;
+    Query->Received = 0;
+    Query->PageIndex = 0;
+    Query->RequestIndex = -1;
+    Query->IsReading = false;
+    Query->HasWaiting = false;
+    Query->QueryTime = 0;
+    Query->RequestTime = 0;
+    Query->FirstByteTime = 0;
+    Query->AcceptGzip = Compression;
+    Query->MaxResponseSize = MaxResponseSize;
+    Query->AcceptColumns = ColumnResponses && AllowColumnResponses && Query->SinkFactory;
+
+    if (Query->SinkFactory && UseCache && Cache->IsEnabled())
+    {
+        Query->Cache = Cache;
+        Query->CacheKey = FQueryCache::MakeKey(QueryUrl, Verb, QueryText, TakeLimit, MaxResults, Query->Columns);
+    }
+
+    return Query;
+}
+
+void FQueryExecutor::StartQuery(FPagedQueryRef Query)
+{
+    if (Query->Cache.IsValid())
+    {
+        LoadFromCache(Query);
+    }
+    else
+    {
+        RequestPage(Query, FString(), 0);
+    }
+}
+
+void FQueryExecutor::StartShards(const FShardedQueryRef &Sharded)
+{
+    while (!Sharded->IsCancelled && Sharded->Running < Sharded->Parallelism && Sharded->NextShard < Sharded->Shards.Num())
+    {
+        Sharded->Running++;
+        StartQuery(Sharded->Shards[Sharded->NextShard++]);
+    }
+}
+
+void FQueryExecutor::DeliverShardPage(FShardedQueryRef Sharded, int32 Shard, TSharedPtr<SQueryResult> Result)
+{
+    if (Sharded->IsCancelled)
+    {
+        return;
+    }
+
+    Sharded->Pages[Shard].Add(Result);
+
+    if (Result->IsLastPage)
+    {
+        Sharded->IsDone[Shard] = true;
+        Sharded->IsComplete = Sharded->IsComplete && Result->IsComplete;
+        Sharded->Running--;
+        StartShards(Sharded);
+    }
+
+    //Every page of a shard is older than every page of the shards before it, so passing the shards on in order
+    //keeps the pages time descending
+    while (!Sharded->IsCancelled && Sharded->DeliverShard < Sharded->Shards.Num())
+    {
+        const int32 Current = Sharded->DeliverShard;
+        const bool IsFinalShard = Current == Sharded->Shards.Num() - 1;
+
+        TArray<TSharedPtr<SQueryResult>> Pages = MoveTemp(Sharded->Pages[Current]);
+        Sharded->Pages[Current].Reset();
+
+        for (int32 i = 0; i < Pages.Num() && !Sharded->IsCancelled; i++)
+        {
+            SQueryResult &Page = *Pages[i];
+            Sharded->Received += Page.EventCount;
+
+            //Each shard is limited on its own, so the last one passed on may go past the limit by up to a page
+            const bool IsLimited = Sharded->MaxResults > 0 && Sharded->Received >= Sharded->MaxResults;
+
+            Page.PageIndex = Sharded->PageIndex++;
+            Page.IsLastPage = IsLimited || (IsFinalShard && Page.IsLastPage);
+            Page.IsComplete = Page.IsLastPage && !IsLimited && Sharded->IsComplete;
+
+            //A shard that fails ends with a failed page, which holds no events, so the final page says one was missed
+            if (!Page.Header.Success && !Page.IsLastPage)
+            {
+                Sharded->HasFailedShard = true;
+            }
+            Page.HasFailedShard = Page.IsLastPage && Sharded->HasFailedShard;
+
+            if (Page.IsLastPage)
+            {
+                Sharded->Cancel();
+            }
+
+            Sharded->HandlerFunc.ExecuteIfBound(Pages[i]);
+        }
+
+        if (!Sharded->IsDone[Current])
+        {
+            break;
+        }
+
+        Sharded->DeliverShard++;
+    }
+}
+
+void FQueryExecutor::LoadFromCache(FPagedQueryRef Query)
+{
+    Async<void>(EAsyncExecution::ThreadPool, [Query]()
+    {
+        if (Query->IsCancelled)
+        {
+            return;
+        }
+
+        const double ReadStart = FPlatformTime::Seconds();
+
+        TSharedPtr<SQueryResult> Result;
+        {
+            FQueryResultColumns Columns;
+            int32 QueryTime;
+
+            if (Query->Cache->Load(Query->CacheKey, Columns, QueryTime))
+            {
+                Result = MakeShareable(new SQueryResult);
+
+                TSharedRef<IQueryResultSink> Sink = Query->SinkFactory();
+                Sink->BeginPage(0);
+                Columns.Replay(*Sink);
+                Sink->EndPage();
+
+                Result->Sink = Sink;
+                Result->EventCount = Columns.Num();
+                Result->FromCache = true;
+                Result->Header.Success = true;
+                Result->Header.Count = Columns.Num();
+                Result->Header.QueryTime = QueryTime;
+                Result->Timings.Read = (FPlatformTime::Seconds() - ReadStart) * 1000;
+            }
+            else
+            {
+                Query->CacheColumns = MakeShareable(new FQueryResultColumns);
+            }
+        }
+
+        AsyncTask(ENamedThreads::GameThread, [Query, Result = MoveTemp(Result)]()
+        {
+            if (Result.IsValid())
+            {
+                DeliverPage(Query, Result);
+            }
+            else if (!Query->IsCancelled)
+            {
+                RequestPage(Query, FString(), 0);
+            }
+        });
+    });
+}
+
+void FQueryExecutor::RequestPage(FPagedQueryRef Query, const FString &ContinuationToken, int32 Received)
+{
+    int32 TakeLimit = Query->PageSize;
+    if (Query->MaxResults > 0)
+    {
+        TakeLimit = FMath::Min(TakeLimit, Query->MaxResults - Received);
+    }
+
+    const int32 PageIndex = ++Query->RequestIndex;
+    Query->RequestTime = FPlatformTime::Seconds();
+    Query->FirstByteTime = 0;
+
+    if (Query->Transport != nullptr)
+    {
+        RequestTransportPage(Query, PageIndex, TakeLimit, ContinuationToken);
+        return;
+    }
+
+    FHttpRequestPtr Request = CreateRequest(Query, PageIndex, TakeLimit);
+    Request->SetVerb(Query->Verb);
+
+    if (Query->Verb == TEXT("POST"))
+    {
+        Request->SetContentAsString(Query->QueryText);
+    }
+
+    if (!ContinuationToken.IsEmpty())
+    {
+        Request->SetHeader(TEXT("x-ms-continuation"), ContinuationToken);
+    }
+
+    Query->Request = Request;
+    Request->ProcessRequest();
+}
+
+void FQueryExecutor::RequestTransportPage(FPagedQueryRef Query, int32 PageIndex, int32 TakeLimit, const FString &ContinuationToken)
+{
+    Async<void>(EAsyncExecution::ThreadPool, [Query, PageIndex, TakeLimit, ContinuationToken]()
+    {
+        FContentPtr Content = MakeShareable(new TArray<uint8>(Query->Transport->HandleQuery(Query->QueryText, TakeLimit, ContinuationToken, Query->Columns, Query->AcceptColumns)));
+
+        //The whole response is there at once, so there is no download
+        FQueryPageTimings Timings;
+        Timings.FirstByte = (FPlatformTime::Seconds() - Query->RequestTime) * 1000;
+
+        AsyncTask(ENamedThreads::GameThread, [Query, PageIndex, Content, Timings]()
+        {
+            if (!Query->IsCancelled)
+            {
+                Query->ProgressFunc.ExecuteIfBound(EQueryStage::Reading, PageIndex, Content->Num());
+                ReceivePage(Query, Content, Timings);
+            }
+        });
+    });
+}
+
+FHttpRequestPtr FQueryExecutor::CreateRequest(FPagedQueryRef Query, int32 PageIndex, int32 TakeLimit)
+{
+    auto Request = FTelemetryService::CreateServiceRequest();
+
+    FString Url = FString::Printf(TEXT("%s?take=%i"), *Query->Url, TakeLimit);
+    if (!Query->Columns.IsEmpty())
+    {
+        Url += TEXT("&columns=") + FGenericPlatformHttp::UrlEncode(Query->Columns);
+    }
+
+    Request->SetURL(Url);
+    Request->SetHeader(TEXT("Content-Type"), TEXT("application/json"));
+    Request->SetHeader(TEXT("User-Agent"), "X-UnrealEngine-Agent");
+
+    //Servers that know neither are free to ignore them, since responses are recognized by their first bytes
+    if (Query->AcceptGzip)
+    {
+        Request->SetHeader(TEXT("Accept-Encoding"), TEXT("gzip"));
+    }
+
+    if (Query->AcceptColumns)
+    {
+        Request->SetHeader(TEXT("Accept"), FString::Printf(TEXT("%s, application/json;q=0.9"), FQueryResponseFormat::ColumnsContentType));
+    }
+
+    Request->OnRequestProgress().BindLambda([Query, PageIndex](FHttpRequestPtr Request, int32 BytesSent, int32 BytesReceived)
+    {
+        if (BytesReceived > 0 && Query->FirstByteTime == 0)
+        {
+            Query->FirstByteTime = FPlatformTime::Seconds();
+        }
+
+        if (!Query->IsCancelled)
+        {
+            Query->ProgressFunc.ExecuteIfBound(EQueryStage::Downloading, PageIndex, BytesReceived);
+        }
+    });
+
+    Request->OnProcessRequestComplete().BindLambda([Query, PageIndex](FHttpRequestPtr Request, FHttpResponsePtr Response, bool bWasSuccessful)
+    {
+        Query->Request.Reset();
+
+        if (Query->IsCancelled)
+        {
+            return;
+        }
+
+        if (bWasSuccessful && Response.IsValid())
+        {
+            //Backends that report no progress count the whole response as waiting for the first byte
+            const double Now = FPlatformTime::Seconds();
+            const double FirstByteTime = Query->FirstByteTime > 0 ? Query->FirstByteTime : Now;
+
+            FQueryPageTimings Timings;
+            Timings.FirstByte = (FirstByteTime - Query->RequestTime) * 1000;
+            Timings.Download = (Now - FirstByteTime) * 1000;
+
+            Query->ProgressFunc.ExecuteIfBound(EQueryStage::Reading, PageIndex, Response->GetContent().Num());
+            ReceivePage(Query, FContentPtr(Response, &Response->GetContent()), Timings);
+        }
+        else
+        {
+            ReceivePage(Query, FContentPtr(), FQueryPageTimings());
+        }
+    });
+
+    return Request;
+}
+
+void FQueryExecutor::ReceivePage(FPagedQueryRef Query, FContentPtr ContentPtr, const FQueryPageTimings &Timings)
+{
+    if (Query->IsReading)
+    {
+        Query->HasWaiting = true;
+        Query->WaitingContent = ContentPtr;
+        Query->WaitingTimings = Timings;
+    }
+    else if (ContentPtr.IsValid())
+    {
+        Query->IsReading = true;
+        ReadPage(Query, ContentPtr, Timings);
+    }
+    else
+    {
+        DeliverFailedPage(Query);
+    }
+}
+
+void FQueryExecutor::ReadPage(FPagedQueryRef Query, FContentPtr ContentPtr, const FQueryPageTimings &Timings)
+{
+    const int32 PageIndex = Query->PageIndex;
+
+    Async<void>(EAsyncExecution::ThreadPool, [Query, ContentPtr, PageIndex, Timings]()
+    {
+        if (Query->IsCancelled)
+        {
+            return;
+        }
+
+        const double ReadStart = FPlatformTime::Seconds();
+
+        TSharedPtr<SQueryResult> Result = MakeShareable(new SQueryResult);
+        Result->Timings = Timings;
+        const uint8 *Data = ContentPtr->GetData();
+        int32 Size = ContentPtr->Num();
+
+        //A body that fails to inflate is left empty, so it reads as a failed page
+        TArray<uint8> Inflated;
+        if (FQueryResponseFormat::IsGzip(Data, Size))
+        {
+            FQueryResponseFormat::Gunzip(Data, Size, Inflated, Query->MaxResponseSize);
+            Data = Inflated.GetData();
+            Size = Inflated.Num();
+
+            if (Query->IsCancelled)
+            {
+                return;
+            }
+        }
+
+        //The next page is requested as soon as its token is known, so it downloads while this one is read
+        SQueryResult Header;
+        if (FQueryResponseFormat::ReadHeader(Data, Size, Header) && !Header.Header.ContinuationToken.IsEmpty() && Header.Header.Count > 0)
+        {
+            const FString Token = Header.Header.ContinuationToken;
+            const int32 Count = Header.Header.Count;
+
+            AsyncTask(ENamedThreads::GameThread, [Query, PageIndex, Token, Count]()
+            {
+                RequestNextPage(Query, PageIndex, Token, Count);
+            });
+        }
+
+        if (Query->SinkFactory && Query->CacheColumns.IsValid())
+        {
+            //Pages are also gathered in to columns for the cache
+            TSharedRef<IQueryResultSink> Sink = Query->SinkFactory();
+            FQueryColumnSink ColumnSink(*Query->CacheColumns);
+            FQueryTeeSink TeeSink(*Sink, ColumnSink);
+
+            TeeSink.BeginPage(PageIndex);
+            if (!FQueryResponseFormat::Read(Data, Size, *Result, TeeSink) || !Result->Header.Success)
+            {
+                Query->CacheColumns.Reset();
+            }
+            TeeSink.EndPage();
+            Result->Sink = Sink;
+        }
+        else if (Query->SinkFactory)
+        {
+            TSharedRef<IQueryResultSink> Sink = Query->SinkFactory();
+            Sink->BeginPage(PageIndex);
+            FQueryResponseFormat::Read(Data, Size, *Result, *Sink);
+            Sink->EndPage();
+            Result->Sink = Sink;
+        }
+        else
+        {
+            FQueryResultReader::Read(Data, Size, *Result);
+        }
+
+        Result->Timings.Read = (FPlatformTime::Seconds() - ReadStart) * 1000;
+
+        //The result is moved so its reference count is never touched from two threads
+        AsyncTask(ENamedThreads::GameThread, [Query, Result = MoveTemp(Result)]()
+        {
+            Query->IsReading = false;
+            DeliverPage(Query, Result);
+
+            //A page that arrived during the read is read now
+            if (Query->HasWaiting && !Query->IsCancelled)
+            {
+                FContentPtr Content = MoveTemp(Query->WaitingContent);
+                Query->WaitingContent.Reset();
+                Query->HasWaiting = false;
+                ReceivePage(Query, Content, Query->WaitingTimings);
+            }
+        });
+    });
+}
+
+void FQueryExecutor::RequestNextPage(FPagedQueryRef Query, int32 PageIndex, const FString &ContinuationToken, int32 Count)
+{
+    //Only the page after the one being read is requested early, and only while the result limit leaves room for it
+    const int32 Received = Query->Received + Count;
+
+    if (!Query->IsCancelled && Query->RequestIndex == PageIndex && (Query->MaxResults <= 0 || Received < Query->MaxResults))
+    {
+        RequestPage(Query, ContinuationToken, Received);
+    }
+}
+
+void FQueryExecutor::DeliverFailedPage(FPagedQueryRef Query)
+{
+    TSharedPtr<SQueryResult> Result = MakeShareable(new SQueryResult);
+
+    if (Query->SinkFactory)
+    {
+        TSharedRef<IQueryResultSink> Sink = Query->SinkFactory();
+        Sink->BeginPage(Query->PageIndex);
+        Sink->EndPage();
+        Result->Sink = Sink;
+    }
+
+    Query->CacheColumns.Reset();
+    DeliverPage(Query, Result);
+}
+
+void FQueryExecutor::DeliverPage(FPagedQueryRef Query, TSharedPtr<SQueryResult> Result)
+{
+    if (Query->IsCancelled)
+    {
+        return;
+    }
+
+    Query->Received += Result->EventCount;
+
+    const FString &Token = Result->Header.ContinuationToken;
+    const bool HasMore = !Token.IsEmpty() && Result->EventCount > 0 && (Query->MaxResults <= 0 || Query->Received < Query->MaxResults);
+
+    Result->PageIndex = Query->PageIndex++;
+    Result->IsLastPage = !HasMore;
+
+    //A cached result holds no token, so one that reached the limit may have been cut off when it was stored
+    Result->IsComplete = !HasMore && Result->Header.Success && (Result->FromCache ? (Query->MaxResults <= 0 || Query->Received < Query->MaxResults) : (Token.IsEmpty() || Result->EventCount == 0));
+
+    Query->QueryTime += Result->Header.QueryTime;
+
+    Query->HandlerFunc.ExecuteIfBound(Result);
+
+    if (HasMore && !Query->IsCancelled)
+    {
+        //Unless it was already requested while this page was read
+        if (Query->RequestIndex == Result->PageIndex)
+        {
+            RequestPage(Query, Token, Query->Received);
+        }
+    }
+    else
+    {
+        if (Query->CacheColumns.IsValid() && !Query->IsCancelled)
+        {
+            auto Cache = Query->Cache;
+            auto Columns = Query->CacheColumns;
+            const FString Key = Query->CacheKey;
+            const int32 QueryTime = Query->QueryTime;
+
+            Async<void>(EAsyncExecution::ThreadPool, [Cache, Columns, Key, QueryTime]()
+            {
+                Cache->Store(Key, *Columns, QueryTime);
+            });
+
+            Query->CacheColumns.Reset();
+        }
+
+        //Nothing else will be delivered, so the query is no longer running, and a page requested early is not needed
+        Query->Cancel();
+    }
+}
+
+void FQueryExecutor::Initialize()
+{
+    const FString IniName = FString::Printf(TEXT("%sGameTelemetry.ini"), *FPaths::SourceConfigDir());
+    const FString SectionName = "GameTelemetry";
+
+    GConfig->GetString(*SectionName, TEXT("QueryUrl"), QueryUrl, IniName);
+    if (!GConfig->GetInt(*SectionName, TEXT("QueryTakeLimit"), ConfiguredTakeLimit, IniName))
+    {
+        ConfiguredTakeLimit = DefaultTakeLimit;
+    }
+
+    if (!GConfig->GetInt(*SectionName, TEXT("QueryMaxResults"), MaxResults, IniName))
+    {
+        MaxResults = 0;
+    }
+
+    float CacheTimeToLive = DefaultCacheTimeToLive;
+    int32 CacheMaxSize = DefaultCacheMaxSize;
+    GConfig->GetFloat(*SectionName, TEXT("QueryCacheTTL"), CacheTimeToLive, IniName);
+    GConfig->GetInt(*SectionName, TEXT("QueryCacheMaxSize"), CacheMaxSize, IniName);
+    Cache = MakeShareable(new FQueryCache(CacheTimeToLive, (int64)CacheMaxSize * 1024 * 1024));
+
+    if (!GConfig->GetBool(*SectionName, TEXT("QueryCompression"), Compression, IniName))
+    {
+        Compression = true;
+    }
+
+    int32 MaxResponseMegabytes;
+    if (GConfig->GetInt(*SectionName, TEXT("QueryMaxResponseSize"), MaxResponseMegabytes, IniName) && MaxResponseMegabytes > 0)
+    {
+        MaxResponseSize = (int32)FMath::Min((int64)MaxResponseMegabytes * 1024 * 1024, (int64)MAX_int32);
+    }
+    else
+    {
+        MaxResponseSize = FQueryResponseFormat::DefaultMaxInflatedSize;
+    }
+
+    if (!GConfig->GetBool(*SectionName, TEXT("QueryColumnResponses"), ColumnResponses, IniName))
+    {
+        ColumnResponses = false;
+    }
+
+    if (!GConfig->GetInt(*SectionName, TEXT("QueryShards"), ConfiguredShards, IniName))
+    {
+        ConfiguredShards = 1;
+    }
+
+    if (!GConfig->GetInt(*SectionName, TEXT("QueryShardParallelism"), ShardParallelism, IniName))
+    {
+        ShardParallelism = DefaultShardParallelism;
+    }
+
+    IsInitialized = true;
+}
+
+//Runs a query split in to each number of shards in turn, then logs the round trip of each and its speedup over the
+//unsplit query
+class FShardedQueryBenchmark : public TSharedFromThis<FShardedQueryBenchmark>
+{
+public:
+    FQueryNodePtr Query;
+    int32 MaxShards;
+    int32 RunsLeft;
+
+    void RunNext()
+    {
+        if (RunsLeft-- <= 0)
+        {
+            Report();
+            Active.Reset();
+            return;
+        }
+
+        //Cycling through the shard counts keeps server caching and load from favoring any of them
+        Current = Current % MaxShards + 1;
+        EventCount = 0;
+        StartTime = FPlatformTime::Seconds();
+
+        Executor.ExecuteShardedQuery(Query, Current, QueryResultHandler::CreateSP(this, &FShardedQueryBenchmark::OnPage), -1, []()
+        {
+            return TSharedRef<IQueryResultSink>(MakeShareable(new FQueryDiscardSink()));
+        }, false);
+    }
+
+    static TSharedPtr<FShardedQueryBenchmark> Active;
+
+private:
+    void OnPage(TSharedPtr<SQueryResult> Result)
+    {
+        EventCount += Result->EventCount;
+
+        if (Result->IsLastPage)
+        {
+            RoundTrips.FindOrAdd(Current).Add((FPlatformTime::Seconds() - StartTime) * 1000.0);
+            Events.Add(Current, EventCount);
+            RunNext();
+        }
+    }
+
+    void Report() const
+    {
+        double Unsplit = 0;
+
+        for (int32 Shards = 1; Shards <= MaxShards; Shards++)
+        {
+            const TArray<double> *Times = RoundTrips.Find(Shards);
+            if (Times == nullptr || Times->Num() == 0)
+            {
+                continue;
+            }
+
+            double RoundTrip = 0;
+            for (double Time : *Times)
+            {
+                RoundTrip += Time;
+            }
+            RoundTrip /= Times->Num();
+
+            if (Shards == 1)
+            {
+                Unsplit = RoundTrip;
+            }
+
+            UE_LOG(LogTelemetryVisualizer, Log, TEXT("%d shards: %d runs, %.1f ms round trip, %.2fx speedup, %d events"),
+                Shards, Times->Num(), RoundTrip, RoundTrip > 0 && Unsplit > 0 ? Unsplit / RoundTrip : 0.0, Events.FindRef(Shards));
+
+            if (Events.FindRef(Shards) != Events.FindRef(1))
+            {
+                UE_LOG(LogTelemetryVisualizer, Warning, TEXT("%d shards returned a different event count than the unsplit query"), Shards);
+            }
+        }
+    }
+
+    FQueryExecutor Executor;
+    int32 Current = 0;
+    int32 EventCount = 0;
+    double StartTime = 0;
+    TMap<int32, TArray<double>> RoundTrips;
+    TMap<int32, int32> Events;
+};
+
+TSharedPtr<FShardedQueryBenchmark> FShardedQueryBenchmark::Active;
+
+static void BenchmarkShardedQuery(const TArray<FString> &Args)
+{
+    FString QueryText;
+    if (Args.Num() < 1 || !FFileHelper::LoadFileToString(QueryText, *Args[0]))
+    {
+        UE_LOG(LogTelemetryVisualizer, Warning, TEXT("Usage: Telemetry.BenchmarkShardedQuery <serialized query file> [max shards] [runs]"));
+        return;
+    }
+
+    if (FShardedQueryBenchmark::Active.IsValid())
+    {
+        UE_LOG(LogTelemetryVisualizer, Warning, TEXT("A sharded query benchmark is already running"));
+        return;
+    }
+
+    FQuerySerializer Serializer;
+    FQueryNodePtr Query = Serializer.Deserialize(QueryText);
+    if (!Query.IsValid())
+    {
+        UE_LOG(LogTelemetryVisualizer, Warning, TEXT("%s is not a serialized query"), *Args[0]);
+        return;
+    }
+
+    FQueryNodeList Shards;
+    if (!FQueryTimeShards::Split(Query, 2, Shards))
+    {
+        UE_LOG(LogTelemetryVisualizer, Warning, TEXT("The query has no client_ts btwn range that can be split"));
+        return;
+    }
+
+    TSharedPtr<FShardedQueryBenchmark> Benchmark = MakeShareable(new FShardedQueryBenchmark());
+    Benchmark->Query = Query;
+    Benchmark->MaxShards = Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 2) : 8;
+    Benchmark->RunsLeft = Benchmark->MaxShards * (Args.Num() > 2 ? FMath::Max(FCString::Atoi(*Args[2]), 1) : 3);
+    FShardedQueryBenchmark::Active = Benchmark;
+    Benchmark->RunNext();
+}
+
+static FAutoConsoleCommand BenchmarkShardedQueryCommand(
+    TEXT("Telemetry.BenchmarkShardedQuery"),
+    TEXT("Runs a serialized query split by time in to 1 up to the given number of shards against the configured server, bypassing the query cache, and logs the round trip of each"),
+    FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkShardedQuery));
@@ -0,0 +1,113 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//--------------------------------------------------------------------------------------
+// TelemetryQueryAggregate.cpp
+//
+// Results of aggregate queries
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "Query/TelemetryQueryAggregate.h"
+
+void FQueryAggregateSink::BeginEvent()
+{
+    Current = FQueryAggregateCell();
+    HasCell = false;
+}
+
+void FQueryAggregateSink::EndEvent()
+{
+    if (HasCell)
+    {
+        Cells.Add(Current);
+    }
+    else
+    {
+        NumSkipped++;
+    }
+}
+
+void FQueryAggregateSink::SetNumber(EQueryResultField Field, const FString &Name, double Value)
+{
+    switch (Field)
+    {
+    case EQueryResultField::PlayerDirectionX: Current.Direction.X = Value; return;
+    case EQueryResultField::PlayerDirectionY: Current.Direction.Y = Value; return;
+    case EQueryResultField::PlayerDirectionZ: Current.Direction.Z = Value; return;
+    case EQueryResultField::Count: Current.Count = Value; return;
+    default: break;
+    }
+
+    if (Name == TEXT("cell_x"))
+    {
+        Current.Cell.X = (int32)Value;
+        HasCell = true;
+    }
+    else if (Name == TEXT("cell_y"))
+    {
+        Current.Cell.Y = (int32)Value;
+        HasCell = true;
+    }
+    else if (Name == TEXT("cell_z"))
+    {
+        Current.Cell.Z = (int32)Value;
+        HasCell = true;
+    }
+    else if (Name == TEXT("sum"))
+    {
+        Current.Sum = Value;
+    }
+    else if (Name == TEXT("min"))
+    {
+        Current.Min = Value;
+    }
+    else if (Name == TEXT("max"))
+    {
+        Current.Max = Value;
+    }
+}
+
+void FQueryAggregator::Add(const FVector &Position, const FVector &Direction, int32 Count, const double *Value)
+{
+    const FIntVector Index(FMath::FloorToInt(Position.X / CellSize), FMath::FloorToInt(Position.Y / CellSize), FMath::FloorToInt(Position.Z / CellSize));
+
+    FQueryAggregateCell *Cell = Cells.Find(Index);
+    if (Cell == nullptr)
+    {
+        Cell = &Cells.Add(Index);
+        Cell->Cell = Index;
+    }
+
+    Count = FMath::Max(Count, 1);
+    Cell->Count += Count;
+
+    //Summed until GetCells, which turns it in to the mean
+    Cell->Direction += Direction * Count;
+
+    if (Value != nullptr)
+    {
+        Cell->Sum += *Value * Count;
+        Cell->Min = Cell->HasValue() ? FMath::Min(Cell->Min, *Value) : *Value;
+        Cell->Max = Cell->HasValue() ? FMath::Max(Cell->Max, *Value) : *Value;
+    }
+}
+
+void FQueryAggregator::GetCells(TArray<FQueryAggregateCell> &OutCells) const
+{
+    OutCells.Reset(Cells.Num());
+
+    for (const auto &Cell : Cells)
+    {
+        FQueryAggregateCell &Added = OutCells[OutCells.Add(Cell.Value)];
+        Added.Direction /= Added.Count;
+    }
+
+    OutCells.Sort([](const FQueryAggregateCell &A, const FQueryAggregateCell &B)
+    {
+        if (A.Cell.X != B.Cell.X) return A.Cell.X < B.Cell.X;
+        if (A.Cell.Y != B.Cell.Y) return A.Cell.Y < B.Cell.Y;
+        return A.Cell.Z < B.Cell.Z;
+    });
+}
@@ -0,0 +1,472 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//--------------------------------------------------------------------------------------
+// TelemetryQueryCache.cpp
+//
+// On disk cache of query results
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "Query/TelemetryQueryCache.h"
+#include "TelemetryVisualizerModule.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFilemanager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/SecureHash.h"
+#include "Misc/ScopeLock.h"
+
+static const uint32 CacheMagic = 0x31435154; // "TQC1"
+//Version 2 keeps numbers as doubles
+static const uint32 CacheVersion = 2;
+static const TCHAR *CacheExtension = TEXT(".tqc");
+
+//Entries are only read, written or evicted under this lock, so a mapped entry is never replaced underneath a reader
+static FCriticalSection CacheLock;
+
+//Start of every entry.  Arrays follow, each starting on an 8 byte boundary
+struct FQueryCacheHeader
+{
+    uint32 Magic;
+    uint32 Version;
+    uint32 CharSize;
+    int32 QueryTime;
+    int64 CreatedTicks;
+    int32 NumRows;
+    int32 NumValueColumns;
+};
+
+//Builds an entry in memory
+class FQueryCacheWriter
+{
+public:
+    void Write(const void *Data, int64 Size)
+    {
+        Bytes.Append((const uint8 *)Data, Size);
+    }
+
+    template<typename T>
+    void WriteArray(const TArray<T> &Array)
+    {
+        Write(Array.GetData(), Array.Num() * sizeof(T));
+        Pad();
+    }
+
+    void WriteString(const FString &Value)
+    {
+        const int32 Length = Value.Len();
+        Write(&Length, sizeof(Length));
+        Write(*Value, Length * sizeof(TCHAR));
+        Pad();
+    }
+
+    void WriteColumn(const FQueryStringColumn &Column)
+    {
+        const int32 DictionarySize = Column.GetDictionary().Num();
+        Write(&DictionarySize, sizeof(DictionarySize));
+        Pad();
+
+        for (const FString &Value : Column.GetDictionary())
+        {
+            WriteString(Value);
+        }
+
+        WriteArray(Column.GetIndices());
+    }
+
+    void Pad()
+    {
+        Bytes.AddZeroed(Align(Bytes.Num(), 8) - Bytes.Num());
+    }
+
+    TArray<uint8> Bytes;
+};
+
+//Reads an entry from a mapped or loaded file, checking every array against the end of the data
+class FQueryCacheReader
+{
+public:
+    FQueryCacheReader(const uint8 *Data, int64 Size) : Begin(Data), Current(Data), End(Data + Size) {}
+
+    bool Read(void *Out, int64 Size)
+    {
+        if (Size < 0 || End - Current < Size)
+        {
+            return false;
+        }
+
+        FMemory::Memcpy(Out, Current, Size);
+        Current += Size;
+        return true;
+    }
+
+    template<typename T>
+    bool ReadArray(TArray<T> &Out, int32 Num)
+    {
+        Out.SetNumUninitialized(Num);
+        return Read(Out.GetData(), (int64)Num * sizeof(T)) && Pad();
+    }
+
+    bool ReadString(FString &Out)
+    {
+        int32 Length;
+        if (!Read(&Length, sizeof(Length)) || Length < 0 || End - Current < (int64)Length * (int64)sizeof(TCHAR))
+        {
+            return false;
+        }
+
+        Out = FString(Length, (const TCHAR *)Current);
+        Current += Length * sizeof(TCHAR);
+        return Pad();
+    }
+
+    bool ReadColumn(FQueryStringColumn &Out, int32 NumRows)
+    {
+        int32 DictionarySize;
+        if (!Read(&DictionarySize, sizeof(DictionarySize)) || !Pad() || DictionarySize < 0)
+        {
+            return false;
+        }
+
+        TArray<FString> Dictionary;
+        Dictionary.SetNum(DictionarySize);
+        for (FString &Value : Dictionary)
+        {
+            if (!ReadString(Value))
+            {
+                return false;
+            }
+        }
+
+        TArray<int32> Indices;
+        if (!ReadArray(Indices, NumRows))
+        {
+            return false;
+        }
+
+        for (int32 Index : Indices)
+        {
+            if (!Dictionary.IsValidIndex(Index))
+            {
+                return false;
+            }
+        }
+
+        Out.Set(MoveTemp(Dictionary), MoveTemp(Indices));
+        return true;
+    }
+
+    bool Pad()
+    {
+        const int64 Padding = Align(Current - Begin, 8) - (Current - Begin);
+        if (End - Current < Padding)
+        {
+            return false;
+        }
+
+        Current += Padding;
+        return true;
+    }
+
+private:
+    const uint8 *Begin;
+    const uint8 *Current;
+    const uint8 *End;
+};
+
+static bool ReadEntry(const uint8 *Data, int64 Size, double TimeToLive, FQueryResultColumns &OutColumns, int32 &OutQueryTime)
+{
+    FQueryCacheReader Reader(Data, Size);
+
+    FQueryCacheHeader Header;
+    if (!Reader.Read(&Header, sizeof(Header)) || !Reader.Pad())
+    {
+        return false;
+    }
+
+    if (Header.Magic != CacheMagic || Header.Version != CacheVersion || Header.CharSize != sizeof(TCHAR) || Header.NumRows < 0 || Header.NumValueColumns < 0)
+    {
+        return false;
+    }
+
+    if ((FDateTime::UtcNow() - FDateTime(Header.CreatedTicks)).GetTotalSeconds() > TimeToLive)
+    {
+        return false;
+    }
+
+    const int32 Num = Header.NumRows;
+    FQueryResultColumns &Columns = OutColumns;
+
+    bool Success = Reader.ReadArray(Columns.Position.X, Num) && Reader.ReadArray(Columns.Position.Y, Num) && Reader.ReadArray(Columns.Position.Z, Num) &&
+        Reader.ReadArray(Columns.Direction.X, Num) && Reader.ReadArray(Columns.Direction.Y, Num) && Reader.ReadArray(Columns.Direction.Z, Num) &&
+        Reader.ReadArray(Columns.Ticks, Num) && Reader.ReadArray(Columns.Counts, Num) &&
+        Reader.ReadColumn(Columns.Name, Num) && Reader.ReadColumn(Columns.Category, Num) && Reader.ReadColumn(Columns.Session, Num) &&
+        Reader.ReadColumn(Columns.BuildType, Num) && Reader.ReadColumn(Columns.BuildId, Num) && Reader.ReadColumn(Columns.Platform, Num);
+
+    Columns.Values.SetNum(Header.NumValueColumns);
+    for (int32 i = 0; Success && i < Header.NumValueColumns; i++)
+    {
+        Success = Reader.ReadString(Columns.Values[i].Name) && Reader.ReadArray(Columns.Values[i].Values, Num);
+    }
+
+    OutQueryTime = Header.QueryTime;
+    return Success;
+}
+
+FQueryCache::FQueryCache(double TimeToLive, int64 MaxSize) :
+    TimeToLive(TimeToLive),
+    MaxSize(MaxSize)
+{
+}
+
+FString FQueryCache::Normalize(const FString &QueryText)
+{
+    FString Normalized;
+    Normalized.Reserve(QueryText.Len());
+
+    bool InString = false;
+    bool Escaped = false;
+
+    for (TCHAR Char : QueryText)
+    {
+        if (InString)
+        {
+            if (Escaped)
+            {
+                Escaped = false;
+            }
+            else if (Char == TEXT('\\'))
+            {
+                Escaped = true;
+            }
+            else if (Char == TEXT('"'))
+            {
+                InString = false;
+            }
+        }
+        else if (Char == TEXT('"'))
+        {
+            InString = true;
+        }
+        else if (FChar::IsWhitespace(Char))
+        {
+            continue;
+        }
+
+        Normalized.AppendChar(Char);
+    }
+
+    return Normalized;
+}
+
+FString FQueryCache::MakeKey(const FString &Url, const FString &Verb, const FString &QueryText, int32 TakeLimit, int32 MaxResults, const FString &Columns)
+{
+    const FString Source = FString::Printf(TEXT("%s\n%s\n%d\n%d\n%s\n%s"), *Url, *Verb, TakeLimit, MaxResults, *Columns, *Normalize(QueryText));
+    const FTCHARToUTF8 Utf8(*Source);
+
+    FSHAHash Hash;
+    FSHA1::HashBuffer(Utf8.Get(), Utf8.Length(), Hash.Hash);
+    return Hash.ToString();
+}
+
+FString FQueryCache::GetDirectory()
+{
+    return FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Telemetry"), TEXT("QueryCache"));
+}
+
+FString FQueryCache::GetPath(const FString &Key) const
+{
+    return FPaths::Combine(GetDirectory(), Key + CacheExtension);
+}
+
+bool FQueryCache::Load(const FString &Key, FQueryResultColumns &OutColumns, int32 &OutQueryTime) const
+{
+    if (!IsEnabled())
+    {
+        return false;
+    }
+
+    FScopeLock Lock(&CacheLock);
+
+    const FString Path = GetPath(Key);
+    IPlatformFile &PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+
+    if (!PlatformFile.FileExists(*Path))
+    {
+        return false;
+    }
+
+    bool Success = false;
+
+    //Map the file where the platform supports it, so the columns are copied straight out of the page cache
+    TUniquePtr<IMappedFileHandle> MappedFile(PlatformFile.OpenMapped(*Path));
+    if (MappedFile.IsValid())
+    {
+        TUniquePtr<IMappedFileRegion> Region(MappedFile->MapRegion());
+        if (Region.IsValid())
+        {
+            Success = ReadEntry(Region->GetMappedPtr(), Region->GetMappedSize(), TimeToLive, OutColumns, OutQueryTime);
+        }
+    }
+    else
+    {
+        TArray<uint8> Data;
+        if (FFileHelper::LoadFileToArray(Data, *Path))
+        {
+            Success = ReadEntry(Data.GetData(), Data.Num(), TimeToLive, OutColumns, OutQueryTime);
+        }
+    }
+
+    if (Success)
+    {
+        //The file time is when the entry was last used, for evicting the least recently used entries
+        PlatformFile.SetTimeStamp(*Path, FDateTime::UtcNow());
+    }
+    else
+    {
+        //Entries of an older version, expired or damaged are never read again
+        OutColumns.Empty();
+        MappedFile.Reset();
+        PlatformFile.DeleteFile(*Path);
+    }
+
+    return Success;
+}
+
+void FQueryCache::Store(const FString &Key, const FQueryResultColumns &Columns, int32 QueryTime) const
+{
+    if (!IsEnabled())
+    {
+        return;
+    }
+
+    FQueryCacheHeader Header;
+    Header.Magic = CacheMagic;
+    Header.Version = CacheVersion;
+    Header.CharSize = sizeof(TCHAR);
+    Header.QueryTime = QueryTime;
+    Header.CreatedTicks = FDateTime::UtcNow().GetTicks();
+    Header.NumRows = Columns.Num();
+    Header.NumValueColumns = Columns.Values.Num();
+
+    FQueryCacheWriter Writer;
+    Writer.Write(&Header, sizeof(Header));
+    Writer.Pad();
+    Writer.WriteArray(Columns.Position.X);
+    Writer.WriteArray(Columns.Position.Y);
+    Writer.WriteArray(Columns.Position.Z);
+    Writer.WriteArray(Columns.Direction.X);
+    Writer.WriteArray(Columns.Direction.Y);
+    Writer.WriteArray(Columns.Direction.Z);
+    Writer.WriteArray(Columns.Ticks);
+    Writer.WriteArray(Columns.Counts);
+    Writer.WriteColumn(Columns.Name);
+    Writer.WriteColumn(Columns.Category);
+    Writer.WriteColumn(Columns.Session);
+    Writer.WriteColumn(Columns.BuildType);
+    Writer.WriteColumn(Columns.BuildId);
+    Writer.WriteColumn(Columns.Platform);
+
+    for (const FQueryValueColumn &Column : Columns.Values)
+    {
+        Writer.WriteString(Column.Name);
+        Writer.WriteArray(Column.Values);
+    }
+
+    FScopeLock Lock(&CacheLock);
+
+    //Written under another name first so a reader never maps a partly written entry
+    const FString Path = GetPath(Key);
+    const FString TempPath = Path + TEXT(".tmp");
+
+    if (!FFileHelper::SaveArrayToFile(Writer.Bytes, *TempPath) || !IFileManager::Get().Move(*Path, *TempPath, true, true))
+    {
+        UE_LOG(LogTelemetryVisualizer, Warning, TEXT("Unable to write query cache entry %s"), *Path);
+        IFileManager::Get().Delete(*TempPath, false, false, true);
+        return;
+    }
+
+    Evict();
+}
+
+void FQueryCache::Evict() const
+{
+    struct FEntry
+    {
+        FString Path;
+        FDateTime LastUsed;
+        int64 Size;
+    };
+
+    TArray<FString> Files;
+    IFileManager::Get().FindFiles(Files, *FPaths::Combine(GetDirectory(), FString(TEXT("*")) + CacheExtension), true, false);
+
+    TArray<FEntry> Entries;
+    int64 TotalSize = 0;
+
+    for (const FString &File : Files)
+    {
+        FEntry Entry;
+        Entry.Path = FPaths::Combine(GetDirectory(), File);
+        Entry.Size = IFileManager::Get().FileSize(*Entry.Path);
+
+        //Expired entries go first, whatever the size of the cache
+        bool Expired = true;
+        {
+            TUniquePtr<FArchive> Reader(IFileManager::Get().CreateFileReader(*Entry.Path));
+            if (Reader.IsValid() && Reader->TotalSize() >= (int64)sizeof(FQueryCacheHeader))
+            {
+                FQueryCacheHeader Header;
+                Reader->Serialize(&Header, sizeof(Header));
+                Expired = (FDateTime::UtcNow() - FDateTime(Header.CreatedTicks)).GetTotalSeconds() > TimeToLive;
+            }
+        }
+
+        if (Expired)
+        {
+            IFileManager::Get().Delete(*Entry.Path, false, false, true);
+            continue;
+        }
+
+        Entry.LastUsed = IFileManager::Get().GetTimeStamp(*Entry.Path);
+        TotalSize += Entry.Size;
+        Entries.Add(Entry);
+    }
+
+    if (TotalSize <= MaxSize)
+    {
+        return;
+    }
+
+    Entries.Sort([](const FEntry &A, const FEntry &B) { return A.LastUsed < B.LastUsed; });
+
+    for (const FEntry &Entry : Entries)
+    {
+        if (TotalSize <= MaxSize)
+        {
+            break;
+        }
+
+        if (IFileManager::Get().Delete(*Entry.Path, false, false, true))
+        {
+            TotalSize -= Entry.Size;
+        }
+    }
+}
+
+void FQueryCache::Clear() const
+{
+    FScopeLock Lock(&CacheLock);
+    IFileManager::Get().DeleteDirectory(*GetDirectory(), false, true);
+}
+
+static FAutoConsoleCommand ClearQueryCacheCommand(
+    TEXT("Telemetry.ClearQueryCache"),
+    TEXT("Deletes every cached query result"),
+    FConsoleCommandDelegate::CreateLambda([]()
+    {
+        FQueryCache(1, 0).Clear();
+    }));
@@ -0,0 +1,473 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//--------------------------------------------------------------------------------------
+// TelemetryQueryColumns.cpp
+//
+// Column storage for query results
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "Query/TelemetryQueryColumns.h"
+#include "Query/TelemetryQuery.h"
+#include "TelemetryVisualizerModule.h"
+#include "TelemetryVisualizerUI.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+
+template<typename T>
+static void ReorderArray(TArray<T> &Array, const TArray<int32> &Order)
+{
+    TArray<T> Sorted;
+    Sorted.Reserve(Order.Num());
+
+    for (int32 Row : Order)
+    {
+        Sorted.Add(MoveTemp(Array[Row]));
+    }
+
+    Array = MoveTemp(Sorted);
+}
+
+void FQueryStringColumn::Set(TArray<FString> &&InDictionary, TArray<int32> &&InIndices)
+{
+    Dictionary = MoveTemp(InDictionary);
+    Indices = MoveTemp(InIndices);
+
+    Lookup.Empty(Dictionary.Num());
+    for (int32 i = 0; i < Dictionary.Num(); i++)
+    {
+        Lookup.Add(Dictionary[i], i);
+    }
+}
+
+void FQueryStringColumn::Append(const FQueryStringColumn &Other)
+{
+    TArray<int32> Remap;
+    Remap.Reserve(Other.Dictionary.Num());
+
+    for (const FString &Value : Other.Dictionary)
+    {
+        const int32 *Index = Lookup.Find(Value);
+        Remap.Add(Index != nullptr ? *Index : Lookup.Add(Value, Dictionary.Add(Value)));
+    }
+
+    Indices.Reserve(Indices.Num() + Other.Indices.Num());
+    for (int32 Index : Other.Indices)
+    {
+        Indices.Add(Remap[Index]);
+    }
+}
+
+void FQueryStringColumn::Reorder(const TArray<int32> &Order)
+{
+    ReorderArray(Indices, Order);
+}
+
+void FQueryStringColumn::Empty()
+{
+    Dictionary.Empty();
+    Lookup.Empty();
+    Indices.Empty();
+}
+
+SIZE_T FQueryStringColumn::GetAllocatedSize() const
+{
+    SIZE_T Size = Dictionary.GetAllocatedSize() + Lookup.GetAllocatedSize() + Indices.GetAllocatedSize();
+
+    //Each string is held twice, once in the dictionary and once as the lookup key
+    for (const FString &Value : Dictionary)
+    {
+        Size += Value.GetAllocatedSize() * 2;
+    }
+
+    return Size;
+}
+
+void FQueryVectorColumn::Reorder(const TArray<int32> &Order)
+{
+    ReorderArray(X, Order);
+    ReorderArray(Y, Order);
+    ReorderArray(Z, Order);
+}
+
+void FQueryVectorColumn::Empty()
+{
+    X.Empty();
+    Y.Empty();
+    Z.Empty();
+}
+
+void FQueryResultColumns::SortByTimeDescending()
+{
+    TArray<int32> Order;
+    Order.Reserve(Num());
+
+    bool IsSorted = true;
+    for (int32 i = 0; i < Num(); i++)
+    {
+        Order.Add(i);
+        IsSorted = IsSorted && (i == 0 || Ticks[i - 1] >= Ticks[i]);
+    }
+
+    if (IsSorted)
+    {
+        return;
+    }
+
+    const TArray<int64> &SortTicks = Ticks;
+    Order.StableSort([&SortTicks](int32 A, int32 B) { return SortTicks[A] > SortTicks[B]; });
+
+    Reorder(Order);
+}
+
+void FQueryResultColumns::Reorder(const TArray<int32> &Order)
+{
+    Position.Reorder(Order);
+    Direction.Reorder(Order);
+    ReorderArray(Ticks, Order);
+    ReorderArray(Counts, Order);
+    Name.Reorder(Order);
+    Category.Reorder(Order);
+    Session.Reorder(Order);
+    BuildType.Reorder(Order);
+    BuildId.Reorder(Order);
+    Platform.Reorder(Order);
+
+    for (FQueryValueColumn &Column : Values)
+    {
+        ReorderArray(Column.Values, Order);
+    }
+}
+
+void FQueryResultColumns::Replay(IQueryResultSink &Sink, const TArray<uint8> *Selection) const
+{
+    static const FString PositionNames[] = { TEXT("pos_x"), TEXT("pos_y"), TEXT("pos_z") };
+    static const FString DirectionNames[] = { TEXT("dir_x"), TEXT("dir_y"), TEXT("dir_z") };
+    static const FString TimeName = TEXT("client_ts");
+    static const FString CountName = TEXT("count");
+    static const FString NameName = TEXT("name");
+    static const FString CategoryName = TEXT("cat");
+    static const FString SessionName = TEXT("session_id");
+    static const FString BuildTypeName = TEXT("build_type");
+    static const FString BuildIdName = TEXT("build_id");
+    static const FString PlatformName = TEXT("platform");
+
+    auto SetString = [&Sink](EQueryResultField Field, const FString &FieldName, const FString &Value)
+    {
+        Sink.SetString(Field, FieldName, *Value, Value.Len());
+    };
+
+    for (int32 Row = 0; Row < Num(); Row++)
+    {
+        if (Selection != nullptr && (*Selection)[Row] == 0)
+        {
+            continue;
+        }
+
+        Sink.BeginEvent();
+
+        Sink.SetNumber(EQueryResultField::PlayerPositionX, PositionNames[0], Position.X[Row]);
+        Sink.SetNumber(EQueryResultField::PlayerPositionY, PositionNames[1], Position.Y[Row]);
+        Sink.SetNumber(EQueryResultField::PlayerPositionZ, PositionNames[2], Position.Z[Row]);
+        Sink.SetNumber(EQueryResultField::PlayerDirectionX, DirectionNames[0], Direction.X[Row]);
+        Sink.SetNumber(EQueryResultField::PlayerDirectionY, DirectionNames[1], Direction.Y[Row]);
+        Sink.SetNumber(EQueryResultField::PlayerDirectionZ, DirectionNames[2], Direction.Z[Row]);
+        Sink.SetNumber(EQueryResultField::Count, CountName, Counts[Row]);
+
+        SetString(EQueryResultField::ClientTimestamp, TimeName, GetTime(Row).ToIso8601());
+        SetString(EQueryResultField::Name, NameName, Name.Get(Row));
+        SetString(EQueryResultField::Category, CategoryName, Category.Get(Row));
+        SetString(EQueryResultField::SessionId, SessionName, Session.Get(Row));
+        SetString(EQueryResultField::BuildType, BuildTypeName, BuildType.Get(Row));
+        SetString(EQueryResultField::BuildId, BuildIdName, BuildId.Get(Row));
+        SetString(EQueryResultField::Platform, PlatformName, Platform.Get(Row));
+
+        for (const FQueryValueColumn &Column : Values)
+        {
+            if (Column.HasValue(Row))
+            {
+                Sink.SetNumber(EQueryResultField::Other, Column.Name, Column.Values[Row]);
+            }
+        }
+
+        Sink.EndEvent();
+    }
+}
+
+void FQueryResultColumns::Append(const FQueryResultColumns &Other)
+{
+    const int32 Previous = Num();
+
+    Position.X.Append(Other.Position.X);
+    Position.Y.Append(Other.Position.Y);
+    Position.Z.Append(Other.Position.Z);
+    Direction.X.Append(Other.Direction.X);
+    Direction.Y.Append(Other.Direction.Y);
+    Direction.Z.Append(Other.Direction.Z);
+    Ticks.Append(Other.Ticks);
+    Counts.Append(Other.Counts);
+    Name.Append(Other.Name);
+    Category.Append(Other.Category);
+    Session.Append(Other.Session);
+    BuildType.Append(Other.BuildType);
+    BuildId.Append(Other.BuildId);
+    Platform.Append(Other.Platform);
+
+    for (const FQueryValueColumn &OtherColumn : Other.Values)
+    {
+        FQueryValueColumn *Column = Values.FindByPredicate([&OtherColumn](const FQueryValueColumn &Each) { return Each.Name == OtherColumn.Name; });
+
+        if (Column == nullptr)
+        {
+            Column = &Values[Values.AddDefaulted()];
+            Column->Name = OtherColumn.Name;
+            Column->Values.Init(NAN, Previous);
+        }
+
+        Column->Values.Append(OtherColumn.Values);
+    }
+
+    //Attributes only this side had are missing from the new rows
+    for (FQueryValueColumn &Column : Values)
+    {
+        while (Column.Values.Num() < Num())
+        {
+            Column.Values.Add(NAN);
+        }
+    }
+}
+
+void FQueryResultColumns::Empty()
+{
+    Position.Empty();
+    Direction.Empty();
+    Ticks.Empty();
+    Counts.Empty();
+    Name.Empty();
+    Category.Empty();
+    Session.Empty();
+    BuildType.Empty();
+    BuildId.Empty();
+    Platform.Empty();
+    Values.Empty();
+}
+
+SIZE_T FQueryResultColumns::GetAllocatedSize() const
+{
+    SIZE_T Size = Position.GetAllocatedSize() + Direction.GetAllocatedSize() + Ticks.GetAllocatedSize() + Counts.GetAllocatedSize();
+    Size += Name.GetAllocatedSize() + Category.GetAllocatedSize() + Session.GetAllocatedSize();
+    Size += BuildType.GetAllocatedSize() + BuildId.GetAllocatedSize() + Platform.GetAllocatedSize();
+    Size += Values.GetAllocatedSize();
+
+    for (const FQueryValueColumn &Column : Values)
+    {
+        Size += Column.Name.GetAllocatedSize() + Column.Values.GetAllocatedSize();
+    }
+
+    return Size;
+}
+
+void FQueryColumnSink::BeginEvent()
+{
+    FMemory::Memzero(Position);
+    FMemory::Memzero(Direction);
+    Time = FDateTime(0);
+    Count = 1;
+    Name.Reset();
+    Category.Reset();
+    Session.Reset();
+    BuildType.Reset();
+    BuildId.Reset();
+    Platform.Reset();
+
+    PendingValues.Reset();
+    PendingValues.Init(NAN, Columns.Values.Num());
+}
+
+void FQueryColumnSink::EndEvent()
+{
+    Columns.Position.Add(Position[0], Position[1], Position[2]);
+    Columns.Direction.Add(Direction[0], Direction[1], Direction[2]);
+    Columns.Ticks.Add(Time.GetTicks());
+    Columns.Counts.Add(Count);
+    Columns.Name.Add(Name);
+    Columns.Category.Add(Category);
+    Columns.Session.Add(Session);
+    Columns.BuildType.Add(BuildType);
+    Columns.BuildId.Add(BuildId);
+    Columns.Platform.Add(Platform);
+
+    for (int32 i = 0; i < Columns.Values.Num(); i++)
+    {
+        Columns.Values[i].Values.Add(PendingValues[i]);
+    }
+}
+
+void FQueryColumnSink::SetNumber(EQueryResultField Field, const FString &FieldName, double Value)
+{
+    switch (Field)
+    {
+    case EQueryResultField::PlayerPositionX: Position[0] = Value; break;
+    case EQueryResultField::PlayerPositionY: Position[1] = Value; break;
+    case EQueryResultField::PlayerPositionZ: Position[2] = Value; break;
+    case EQueryResultField::PlayerDirectionX: Direction[0] = Value; break;
+    case EQueryResultField::PlayerDirectionY: Direction[1] = Value; break;
+    case EQueryResultField::PlayerDirectionZ: Direction[2] = Value; break;
+    case EQueryResultField::Count: Count = Value >= 1 ? (int32)Value : 1; break;
+    case EQueryResultField::Other: SetValue(FieldName, Value); break;
+    default: break;
+    }
+}
+
+void FQueryColumnSink::SetString(EQueryResultField Field, const FString &FieldName, const TCHAR *Value, int32 Length)
+{
+    switch (Field)
+    {
+    case EQueryResultField::Name: Name.AppendChars(Value, Length); break;
+    case EQueryResultField::Category: Category.AppendChars(Value, Length); break;
+    case EQueryResultField::SessionId: Session.AppendChars(Value, Length); break;
+    case EQueryResultField::BuildType: BuildType.AppendChars(Value, Length); break;
+    case EQueryResultField::BuildId: BuildId.AppendChars(Value, Length); break;
+    case EQueryResultField::Platform: Platform.AppendChars(Value, Length); break;
+    case EQueryResultField::ClientTimestamp: FDateTime::ParseIso8601(Value, Time); break;
+    case EQueryResultField::Other: SetValue(FieldName, FCString::Atod(Value)); break;
+    default: break;
+    }
+}
+
+void FQueryColumnSink::SetBool(EQueryResultField Field, const FString &FieldName, bool Value)
+{
+    if (Field == EQueryResultField::Other)
+    {
+        SetValue(FieldName, Value ? 1.0 : 0.0);
+    }
+}
+
+bool FQueryColumnSink::AddColumns(const FQueryResultColumns &Other)
+{
+    Columns.Append(Other);
+    return true;
+}
+
+void FQueryColumnSink::SetValue(const FString &FieldName, double Value)
+{
+    if (!FieldName.StartsWith(TEXT("val_")) && !FieldName.StartsWith(TEXT("pct_")))
+    {
+        return;
+    }
+
+    int32 *Index = ValueIndex.Find(FieldName);
+    if (Index == nullptr)
+    {
+        int32 Existing = Columns.Values.IndexOfByPredicate([&FieldName](const FQueryValueColumn &Column) { return Column.Name == FieldName; });
+
+        if (Existing == INDEX_NONE)
+        {
+            //Events before the first one with this attribute do not have it
+            Existing = Columns.Values.AddDefaulted();
+            Columns.Values[Existing].Name = FieldName;
+            Columns.Values[Existing].Values.Init(NAN, Columns.Num());
+        }
+
+        Index = &ValueIndex.Add(FieldName, Existing);
+    }
+
+    if (!PendingValues.IsValidIndex(*Index))
+    {
+        const int32 Previous = PendingValues.Num();
+        PendingValues.AddUninitialized(*Index + 1 - Previous);
+
+        for (int32 i = Previous; i < PendingValues.Num(); i++)
+        {
+            PendingValues[i] = NAN;
+        }
+    }
+
+    PendingValues[*Index] = Value;
+}
+
+//Reads a saved query response in to each storage layout and logs the bytes held per event
+static void ReportQueryMemory(const TArray<FString> &Args)
+{
+    TArray<uint8> Content;
+    if (Args.Num() < 1 || !FFileHelper::LoadFileToArray(Content, *Args[0]))
+    {
+        UE_LOG(LogTelemetryVisualizer, Warning, TEXT("Usage: Telemetry.ReportQueryMemory <saved query response>"));
+        return;
+    }
+
+    SIZE_T SimpleSize = 0;
+    int32 SimpleEvents = 0;
+    {
+        SQueryResult Result;
+        FQueryResultReader::Read(Content.GetData(), Content.Num(), Result);
+
+        SimpleSize = Result.Events.GetAllocatedSize();
+        for (const FSimpleEvent &Event : Result.Events)
+        {
+            SimpleSize += Event.GetAllocatedSize() - sizeof(FSimpleEvent);
+        }
+        SimpleEvents = Result.Events.Num();
+    }
+
+    SIZE_T EditorSize = 0;
+    int32 EditorEvents = 0;
+    {
+        FEventCollectionBuilder Builder;
+        SQueryResult Result;
+        FQueryResultReader::Read(Content.GetData(), Content.Num(), Result, Builder);
+
+        for (const SEventEditorContainer &Container : Builder.GetCollection())
+        {
+            EditorSize += sizeof(SEventEditorContainer) + Container.GetAllocatedSize();
+            EditorEvents += Container.Num();
+        }
+    }
+
+    SIZE_T ColumnSize = 0;
+    int32 ColumnEvents = 0;
+    {
+        FQueryResultColumns Columns;
+        FQueryColumnSink Sink(Columns);
+        SQueryResult Result;
+        FQueryResultReader::Read(Content.GetData(), Content.Num(), Result, Sink);
+
+        //Trim the slack of growing arrays so the report shows what a settled dataset holds
+        Columns.Position.X.Shrink();
+        Columns.Position.Y.Shrink();
+        Columns.Position.Z.Shrink();
+        Columns.Direction.X.Shrink();
+        Columns.Direction.Y.Shrink();
+        Columns.Direction.Z.Shrink();
+        Columns.Ticks.Shrink();
+        Columns.Counts.Shrink();
+        for (FQueryValueColumn &Column : Columns.Values)
+        {
+            Column.Values.Shrink();
+        }
+
+        ColumnSize = Columns.GetAllocatedSize();
+        ColumnEvents = Columns.Num();
+
+        UE_LOG(LogTelemetryVisualizer, Log, TEXT("Columns: %d names, %d categories, %d sessions, %d build ids, %d value columns"),
+            Columns.Name.GetDictionary().Num(), Columns.Category.GetDictionary().Num(), Columns.Session.GetDictionary().Num(), Columns.BuildId.GetDictionary().Num(), Columns.Values.Num());
+    }
+
+    auto Log = [](const TCHAR *Label, SIZE_T Size, int32 Events)
+    {
+        UE_LOG(LogTelemetryVisualizer, Log, TEXT("%s: %d events, %.1f MB, %.1f bytes per event"), Label, Events, Size / (1024.0 * 1024.0), Events > 0 ? (double)Size / Events : 0.0);
+    };
+
+    Log(TEXT("FSimpleEvent attribute maps (approximate)"), SimpleSize, SimpleEvents);
+    Log(TEXT("Grouped editor containers"), EditorSize, EditorEvents);
+    UE_LOG(LogTelemetryVisualizer, Log, TEXT("Shared string table: %d strings, %.1f KB"),
+        FTelemetryStringTable::Get().Num(), FTelemetryStringTable::Get().GetAllocatedSize() / 1024.0);
+    Log(TEXT("Result columns"), ColumnSize, ColumnEvents);
+}
+
+static FAutoConsoleCommand ReportQueryMemoryCommand(
+    TEXT("Telemetry.ReportQueryMemory"),
+    TEXT("Reads a saved query response as attribute maps, grouped editor events and result columns, and logs the memory per event of each"),
+    FConsoleCommandWithArgsDelegate::CreateStatic(&ReportQueryMemory));
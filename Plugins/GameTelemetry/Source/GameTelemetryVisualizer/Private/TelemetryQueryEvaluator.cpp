@@ -0,0 +1,511 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//--------------------------------------------------------------------------------------
+// TelemetryQueryEvaluator.cpp
+//
+// Evaluates queries over loaded result columns
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "Query/TelemetryQueryEvaluator.h"
+
+//Same ordering the service uses: numbers, bools and strings compare with their own type and nothing else
+bool FQueryEvaluator::CompareValues(const TSharedPtr<FJsonValue> &A, const TSharedPtr<FJsonValue> &B, int32 &OutOrder)
+{
+    if (!A.IsValid() || !B.IsValid() || A->Type != B->Type)
+    {
+        return false;
+    }
+
+    switch (A->Type)
+    {
+    case EJson::Number:
+        OutOrder = A->AsNumber() < B->AsNumber() ? -1 : (A->AsNumber() > B->AsNumber() ? 1 : 0);
+        return true;
+    case EJson::Boolean:
+        OutOrder = (int32)A->AsBool() - (int32)B->AsBool();
+        return true;
+    case EJson::String:
+        OutOrder = A->AsString().Compare(B->AsString(), ESearchCase::CaseSensitive);
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool MatchesOrder(EQueryOp Op, int32 Order)
+{
+    switch (Op)
+    {
+    case EQueryOp::Eq: return Order == 0;
+    case EQueryOp::Neq: return Order != 0;
+    case EQueryOp::Gt: return Order > 0;
+    case EQueryOp::Gte: return Order >= 0;
+    case EQueryOp::Lt: return Order < 0;
+    case EQueryOp::Lte: return Order <= 0;
+    default: return false;
+    }
+}
+
+TArray<TSharedPtr<FJsonValue>> FQueryEvaluator::GetValues(const FQueryNode &Node)
+{
+    if (!Node.Value.IsValid())
+    {
+        return TArray<TSharedPtr<FJsonValue>>();
+    }
+
+    if (Node.Value->Type == EJson::Array)
+    {
+        return Node.Value->AsArray();
+    }
+
+    return TArray<TSharedPtr<FJsonValue>>({ Node.Value });
+}
+
+bool FQueryEvaluator::Satisfies(const TSharedPtr<FJsonValue> &Value, const FQueryNode &Node)
+{
+    const TArray<TSharedPtr<FJsonValue>> Values = GetValues(Node);
+    int32 Order = 0;
+
+    switch (Node.Operator)
+    {
+    case EQueryOp::In:
+        return Values.ContainsByPredicate([&](const TSharedPtr<FJsonValue> &Each) { return CompareValues(Value, Each, Order) && Order == 0; });
+
+    case EQueryOp::Btwn:
+    {
+        int32 Upper = 0;
+        return Values.Num() == 2 && CompareValues(Value, Values[0], Order) && Order >= 0 && CompareValues(Value, Values[1], Upper) && Upper <= 0;
+    }
+
+    default:
+        return Values.Num() == 1 && CompareValues(Value, Values[0], Order) && MatchesOrder(Node.Operator, Order);
+    }
+}
+
+static bool IsEqual(const FQueryNode &A, const FQueryNode &B)
+{
+    if (A.Type != B.Type || A.Operator != B.Operator)
+    {
+        return false;
+    }
+
+    if (A.Type == EQueryNodeType::Group)
+    {
+        const int32 Num = A.Children.IsValid() ? A.Children->Num() : 0;
+        if (Num != (B.Children.IsValid() ? B.Children->Num() : 0))
+        {
+            return false;
+        }
+
+        for (int32 i = 0; i < Num; i++)
+        {
+            if (!IsEqual(*(*A.Children)[i], *(*B.Children)[i]))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const TArray<TSharedPtr<FJsonValue>> ValuesA = FQueryEvaluator::GetValues(A);
+    const TArray<TSharedPtr<FJsonValue>> ValuesB = FQueryEvaluator::GetValues(B);
+    int32 Order = 0;
+
+    if (A.Column != B.Column || ValuesA.Num() != ValuesB.Num())
+    {
+        return false;
+    }
+
+    for (int32 i = 0; i < ValuesA.Num(); i++)
+    {
+        if (!FQueryEvaluator::CompareValues(ValuesA[i], ValuesB[i], Order) || Order != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+//Interval a range comparison matches.  A missing bound is unbounded
+struct FQueryRange
+{
+    TSharedPtr<FJsonValue> Lower;
+    TSharedPtr<FJsonValue> Upper;
+    bool LowerInclusive = false;
+    bool UpperInclusive = false;
+};
+
+static bool GetRange(const FQueryNode &Node, FQueryRange &OutRange)
+{
+    const TArray<TSharedPtr<FJsonValue>> Values = FQueryEvaluator::GetValues(Node);
+
+    switch (Node.Operator)
+    {
+    case EQueryOp::Gt:
+    case EQueryOp::Gte:
+        OutRange.Lower = Values.Num() == 1 ? Values[0] : nullptr;
+        OutRange.LowerInclusive = (Node.Operator == EQueryOp::Gte);
+        return OutRange.Lower.IsValid();
+
+    case EQueryOp::Lt:
+    case EQueryOp::Lte:
+        OutRange.Upper = Values.Num() == 1 ? Values[0] : nullptr;
+        OutRange.UpperInclusive = (Node.Operator == EQueryOp::Lte);
+        return OutRange.Upper.IsValid();
+
+    case EQueryOp::Btwn:
+        if (Values.Num() != 2)
+        {
+            return false;
+        }
+        OutRange.Lower = Values[0];
+        OutRange.Upper = Values[1];
+        OutRange.LowerInclusive = true;
+        OutRange.UpperInclusive = true;
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+//Whether the bound Inner lies within the bound Outer.  IsLower selects which side of the range they are
+static bool IsWithin(const TSharedPtr<FJsonValue> &Inner, bool InnerInclusive, const TSharedPtr<FJsonValue> &Outer, bool OuterInclusive, bool IsLower)
+{
+    if (!Outer.IsValid())
+    {
+        return true;
+    }
+
+    int32 Order = 0;
+    if (!Inner.IsValid() || !FQueryEvaluator::CompareValues(Inner, Outer, Order))
+    {
+        return false;
+    }
+
+    if (Order == 0)
+    {
+        return OuterInclusive || !InnerInclusive;
+    }
+
+    return IsLower ? Order > 0 : Order < 0;
+}
+
+bool FQueryEvaluator::Implies(const FQueryNode &Query, const FQueryNode &Loaded)
+{
+    if (IsEqual(Query, Loaded))
+    {
+        return true;
+    }
+
+    if (Loaded.Type == EQueryNodeType::Group && Loaded.Operator == EQueryOp::And)
+    {
+        return !Loaded.Children.IsValid() || !Loaded.Children->ContainsByPredicate([&Query](const FQueryNodePtr &Child) { return !Implies(Query, *Child); });
+    }
+
+    if (Query.Type == EQueryNodeType::Group && Query.Operator == EQueryOp::Or)
+    {
+        return !Query.Children.IsValid() || !Query.Children->ContainsByPredicate([&Loaded](const FQueryNodePtr &Child) { return !Implies(*Child, Loaded); });
+    }
+
+    if (Query.Type == EQueryNodeType::Group)
+    {
+        return Query.Children.IsValid() && Query.Children->ContainsByPredicate([&Loaded](const FQueryNodePtr &Child) { return Implies(*Child, Loaded); });
+    }
+
+    if (Loaded.Type == EQueryNodeType::Group)
+    {
+        return Loaded.Children.IsValid() && Loaded.Children->ContainsByPredicate([&Query](const FQueryNodePtr &Child) { return Implies(Query, *Child); });
+    }
+
+    if (Query.Column != Loaded.Column)
+    {
+        return false;
+    }
+
+    //A query for a few values narrows anything all of those values match
+    if (Query.Operator == EQueryOp::Eq || Query.Operator == EQueryOp::In)
+    {
+        const TArray<TSharedPtr<FJsonValue>> Values = GetValues(Query);
+        return !Values.ContainsByPredicate([&Loaded](const TSharedPtr<FJsonValue> &Value) { return !Satisfies(Value, Loaded); });
+    }
+
+    FQueryRange QueryRange;
+    if (!GetRange(Query, QueryRange))
+    {
+        return false;
+    }
+
+    if (Loaded.Operator == EQueryOp::Neq)
+    {
+        return Loaded.Value.IsValid() && !Satisfies(Loaded.Value, Query);
+    }
+
+    FQueryRange LoadedRange;
+    return GetRange(Loaded, LoadedRange) &&
+        IsWithin(QueryRange.Lower, QueryRange.LowerInclusive, LoadedRange.Lower, LoadedRange.LowerInclusive, true) &&
+        IsWithin(QueryRange.Upper, QueryRange.UpperInclusive, LoadedRange.Upper, LoadedRange.UpperInclusive, false);
+}
+
+bool FQueryEvaluator::IsNarrowing(const FQueryNodePtr &Query, const FQueryNodePtr &Loaded)
+{
+    if (!Loaded.IsValid())
+    {
+        return true;
+    }
+
+    return Query.IsValid() && Implies(*Query, *Loaded);
+}
+
+static const FQueryStringColumn *FindStringColumn(const FString &Column, const FQueryResultColumns &Columns)
+{
+    if (Column == TEXT("name")) return &Columns.Name;
+    if (Column == TEXT("cat")) return &Columns.Category;
+    if (Column == TEXT("session_id")) return &Columns.Session;
+    if (Column == TEXT("build_type")) return &Columns.BuildType;
+    if (Column == TEXT("build_id")) return &Columns.BuildId;
+    if (Column == TEXT("platform")) return &Columns.Platform;
+    return nullptr;
+}
+
+static const TArray<double> *FindNumberColumn(const FString &Column, const FQueryResultColumns &Columns)
+{
+    if (Column == TEXT("pos_x")) return &Columns.Position.X;
+    if (Column == TEXT("pos_y")) return &Columns.Position.Y;
+    if (Column == TEXT("pos_z")) return &Columns.Position.Z;
+    if (Column == TEXT("dir_x")) return &Columns.Direction.X;
+    if (Column == TEXT("dir_y")) return &Columns.Direction.Y;
+    if (Column == TEXT("dir_z")) return &Columns.Direction.Z;
+
+    const FQueryValueColumn *Values = Columns.FindValues(Column);
+    return Values != nullptr ? &Values->Values : nullptr;
+}
+
+bool FQueryEvaluator::CompileStep(const FQueryNode &Node, const FQueryResultColumns &Columns, const TArray<FString> *Projection, FStep &OutStep)
+{
+    OutStep.Operator = Node.Operator;
+
+    //Cells are only counted by the server
+    if (Node.Type == EQueryNodeType::Aggregate)
+    {
+        return false;
+    }
+
+    if (Node.Type == EQueryNodeType::Group)
+    {
+        OutStep.Kind = EColumnKind::Group;
+
+        if (Node.Children.IsValid())
+        {
+            for (const FQueryNodePtr &Child : *Node.Children)
+            {
+                if (!Child.IsValid() || !CompileStep(*Child, Columns, Projection, OutStep.Children[OutStep.Children.AddDefaulted()]))
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    const TArray<TSharedPtr<FJsonValue>> Values = GetValues(Node);
+    if (Values.Num() == 0 || (Node.Operator == EQueryOp::Btwn && Values.Num() != 2))
+    {
+        return false;
+    }
+
+    //A field the server did not return reads as missing, which would match nothing
+    if (Projection != nullptr && Projection->Num() > 0 && !Projection->Contains(Node.Column))
+    {
+        return false;
+    }
+
+    if (Node.Column == TEXT("client_ts"))
+    {
+        //Times are kept as ticks, so bounds are parsed once and compared as integers
+        OutStep.Kind = EColumnKind::Ticks;
+        OutStep.Ticks = &Columns.Ticks;
+
+        for (const TSharedPtr<FJsonValue> &Value : Values)
+        {
+            FDateTime Time;
+            if (Value->Type != EJson::String || !FDateTime::ParseIso8601(*Value->AsString(), Time))
+            {
+                return false;
+            }
+            OutStep.TickNumbers.Add(Time.GetTicks());
+        }
+        return true;
+    }
+
+    if (const FQueryStringColumn *Strings = FindStringColumn(Node.Column, Columns))
+    {
+        OutStep.Kind = EColumnKind::String;
+        OutStep.Strings = Strings;
+
+        if (Values.ContainsByPredicate([](const TSharedPtr<FJsonValue> &Value) { return Value->Type != EJson::String; }))
+        {
+            return false;
+        }
+
+        //Empty strings are events without the field, which match nothing
+        const TArray<FString> &Dictionary = Strings->GetDictionary();
+        OutStep.DictionaryMatch.SetNumZeroed(Dictionary.Num());
+
+        for (int32 i = 0; i < Dictionary.Num(); i++)
+        {
+            OutStep.DictionaryMatch[i] = !Dictionary[i].IsEmpty() && Satisfies(FJsonValueUtil::Create(Dictionary[i]), Node);
+        }
+        return true;
+    }
+
+    const bool IsValue = Node.Column.StartsWith(TEXT("val_")) || Node.Column.StartsWith(TEXT("pct_"));
+    const TArray<double> *Column = FindNumberColumn(Node.Column, Columns);
+
+    if (Column == nullptr && !IsValue)
+    {
+        //Fields the columns do not keep, e.g. ids, can only be answered by the server
+        return false;
+    }
+
+    if (Values.ContainsByPredicate([](const TSharedPtr<FJsonValue> &Value) { return Value->Type != EJson::Number; }))
+    {
+        return false;
+    }
+
+    //A value no loaded event has leaves the column null, and matches nothing
+    OutStep.Kind = EColumnKind::Number;
+    OutStep.Values = Column;
+
+    for (const TSharedPtr<FJsonValue> &Value : Values)
+    {
+        OutStep.Numbers.Add(Value->AsNumber());
+    }
+    return true;
+}
+
+TSharedPtr<FQueryEvaluator> FQueryEvaluator::Compile(const FQueryNodePtr &Query, const FQueryResultColumns &Columns, const TArray<FString> *Projection)
+{
+    TSharedPtr<FQueryEvaluator> Evaluator = MakeShareable(new FQueryEvaluator());
+    Evaluator->NumRows = Columns.Num();
+
+    if (!Query.IsValid())
+    {
+        //No query matches every event, the same as an empty and
+        return Evaluator;
+    }
+
+    return CompileStep(*Query, Columns, Projection, Evaluator->Root) ? Evaluator : nullptr;
+}
+
+static inline bool IsPresent(double Value) { return Value == Value; }
+static inline bool IsPresent(int64 Value) { return Value != 0; }
+
+//One comparison over a whole column.  The loops are branch free so the compiler can vectorize them
+template<typename ColumnType, typename NumberType>
+static void ScanColumn(const ColumnType *Data, int32 Num, EQueryOp Op, const TArray<NumberType> &Numbers, uint8 *Out)
+{
+    const NumberType First = Numbers[0];
+
+    switch (Op)
+    {
+    case EQueryOp::Eq:
+        for (int32 i = 0; i < Num; i++) { Out[i] = IsPresent(Data[i]) & (Data[i] == First); }
+        break;
+    case EQueryOp::Neq:
+        for (int32 i = 0; i < Num; i++) { Out[i] = IsPresent(Data[i]) & (Data[i] != First); }
+        break;
+    case EQueryOp::Gt:
+        for (int32 i = 0; i < Num; i++) { Out[i] = IsPresent(Data[i]) & (Data[i] > First); }
+        break;
+    case EQueryOp::Gte:
+        for (int32 i = 0; i < Num; i++) { Out[i] = IsPresent(Data[i]) & (Data[i] >= First); }
+        break;
+    case EQueryOp::Lt:
+        for (int32 i = 0; i < Num; i++) { Out[i] = IsPresent(Data[i]) & (Data[i] < First); }
+        break;
+    case EQueryOp::Lte:
+        for (int32 i = 0; i < Num; i++) { Out[i] = IsPresent(Data[i]) & (Data[i] <= First); }
+        break;
+    case EQueryOp::Btwn:
+    {
+        const NumberType Last = Numbers[1];
+        for (int32 i = 0; i < Num; i++) { Out[i] = IsPresent(Data[i]) & (Data[i] >= First) & (Data[i] <= Last); }
+        break;
+    }
+    case EQueryOp::In:
+        FMemory::Memzero(Out, Num);
+        for (const NumberType Number : Numbers)
+        {
+            for (int32 i = 0; i < Num; i++) { Out[i] |= IsPresent(Data[i]) & (Data[i] == Number); }
+        }
+        break;
+    default:
+        FMemory::Memzero(Out, Num);
+        break;
+    }
+}
+
+void FQueryEvaluator::EvaluateStep(const FStep &Step, TArray<uint8> &OutMask) const
+{
+    OutMask.SetNumUninitialized(NumRows);
+    uint8 *Out = OutMask.GetData();
+
+    switch (Step.Kind)
+    {
+    case EColumnKind::Group:
+    {
+        const bool IsOr = (Step.Operator == EQueryOp::Or);
+        FMemory::Memset(Out, IsOr ? 0 : 1, NumRows);
+
+        TArray<uint8> ChildMask;
+        for (const FStep &Child : Step.Children)
+        {
+            EvaluateStep(Child, ChildMask);
+            const uint8 *In = ChildMask.GetData();
+
+            if (IsOr)
+            {
+                for (int32 i = 0; i < NumRows; i++) { Out[i] |= In[i]; }
+            }
+            else
+            {
+                for (int32 i = 0; i < NumRows; i++) { Out[i] &= In[i]; }
+            }
+        }
+        break;
+    }
+
+    case EColumnKind::Number:
+        if (Step.Values != nullptr)
+        {
+            ScanColumn(Step.Values->GetData(), NumRows, Step.Operator, Step.Numbers, Out);
+        }
+        else
+        {
+            FMemory::Memzero(Out, NumRows);
+        }
+        break;
+
+    case EColumnKind::Ticks:
+        ScanColumn(Step.Ticks->GetData(), NumRows, Step.Operator, Step.TickNumbers, Out);
+        break;
+
+    case EColumnKind::String:
+    {
+        const int32 *Indices = Step.Strings->GetIndices().GetData();
+        const uint8 *Match = Step.DictionaryMatch.GetData();
+
+        for (int32 i = 0; i < NumRows; i++) { Out[i] = Match[Indices[i]]; }
+        break;
+    }
+    }
+}
+
+void FQueryEvaluator::Evaluate(TArray<uint8> &OutMask) const
+{
+    EvaluateStep(Root, OutMask);
+}
@@ -0,0 +1,504 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//--------------------------------------------------------------------------------------
+// TelemetryQueryFormat.cpp
+//
+// Compressed and columnar query responses
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "Query/TelemetryQueryFormat.h"
+#include "Query/TelemetryQuery.h"
+#include "Query/TelemetryLocalServer.h"
+#include "TelemetryVisualizerModule.h"
+#include "TelemetryVisualizerUI.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/Compression.h"
+#include "Misc/FileHelper.h"
+
+THIRD_PARTY_INCLUDES_START
+#include "zlib.h"
+THIRD_PARTY_INCLUDES_END
+
+const TCHAR *FQueryResponseFormat::ColumnsContentType = TEXT("application/vnd.telemetry.columns");
+const int32 FQueryResponseFormat::DefaultMaxInflatedSize = 512 * 1024 * 1024;
+
+static const uint32 ColumnsMagic = 0x31525154; // "TQR1"
+//Version 2 sends numbers as doubles
+static const uint32 ColumnsVersion = 2;
+
+//Start of every columnar response.  The continuation token follows, then the columns in the order of
+//FQueryResultColumns, then each value column as its name and values
+struct FQueryColumnsHeader
+{
+    uint32 Magic;
+    uint32 Version;
+    uint32 Success;
+    int32 QueryTime;
+    int32 NumRows;
+    int32 NumValueColumns;
+};
+
+//Builds a columnar response in memory
+class FQueryColumnsWriter
+{
+public:
+    FQueryColumnsWriter(TArray<uint8> &Bytes) : Bytes(Bytes) {}
+
+    void Write(const void *Data, int64 Size)
+    {
+        Bytes.Append((const uint8 *)Data, Size);
+    }
+
+    template<typename T>
+    void WriteArray(const TArray<T> &Array)
+    {
+        Write(Array.GetData(), Array.Num() * sizeof(T));
+    }
+
+    void WriteString(const FString &Value)
+    {
+        FTCHARToUTF8 Utf8(*Value);
+        const int32 Length = Utf8.Length();
+        Write(&Length, sizeof(Length));
+        Write(Utf8.Get(), Length);
+    }
+
+    void WriteColumn(const FQueryStringColumn &Column)
+    {
+        const int32 DictionarySize = Column.GetDictionary().Num();
+        Write(&DictionarySize, sizeof(DictionarySize));
+
+        for (const FString &Value : Column.GetDictionary())
+        {
+            WriteString(Value);
+        }
+
+        WriteArray(Column.GetIndices());
+    }
+
+private:
+    TArray<uint8> &Bytes;
+};
+
+//Reads a columnar response, checking every array against the end of the data
+class FQueryColumnsReader
+{
+public:
+    FQueryColumnsReader(const uint8 *Data, int32 Size) : Current(Data), End(Data + Size) {}
+
+    bool Read(void *Out, int64 Size)
+    {
+        if (Size < 0 || End - Current < Size)
+        {
+            return false;
+        }
+
+        FMemory::Memcpy(Out, Current, Size);
+        Current += Size;
+        return true;
+    }
+
+    template<typename T>
+    bool ReadArray(TArray<T> &Out, int32 Num)
+    {
+        if (Num < 0 || End - Current < (int64)Num * (int64)sizeof(T))
+        {
+            return false;
+        }
+
+        Out.SetNumUninitialized(Num);
+        return Read(Out.GetData(), (int64)Num * sizeof(T));
+    }
+
+    bool ReadString(FString &Out)
+    {
+        int32 Length;
+        if (!Read(&Length, sizeof(Length)) || Length < 0 || End - Current < Length)
+        {
+            return false;
+        }
+
+        FUTF8ToTCHAR Text((const ANSICHAR *)Current, Length);
+        Out = FString(Text.Length(), Text.Get());
+        Current += Length;
+        return true;
+    }
+
+    bool ReadColumn(FQueryStringColumn &Out, int32 NumRows)
+    {
+        int32 DictionarySize;
+        if (!Read(&DictionarySize, sizeof(DictionarySize)) || DictionarySize < 0 || End - Current < (int64)DictionarySize * sizeof(int32))
+        {
+            return false;
+        }
+
+        TArray<FString> Dictionary;
+        Dictionary.SetNum(DictionarySize);
+        for (FString &Value : Dictionary)
+        {
+            if (!ReadString(Value))
+            {
+                return false;
+            }
+        }
+
+        TArray<int32> Indices;
+        if (!ReadArray(Indices, NumRows))
+        {
+            return false;
+        }
+
+        for (int32 Index : Indices)
+        {
+            if (!Dictionary.IsValidIndex(Index))
+            {
+                return false;
+            }
+        }
+
+        Out.Set(MoveTemp(Dictionary), MoveTemp(Indices));
+        return true;
+    }
+
+private:
+    const uint8 *Current;
+    const uint8 *End;
+};
+
+bool FQueryResponseFormat::IsGzip(const uint8 *Data, int32 Size)
+{
+    return Size >= 18 && Data[0] == 0x1f && Data[1] == 0x8b && Data[2] == 0x08;
+}
+
+bool FQueryResponseFormat::IsColumns(const uint8 *Data, int32 Size)
+{
+    uint32 Magic;
+    if (Size < (int32)sizeof(FQueryColumnsHeader))
+    {
+        return false;
+    }
+
+    FMemory::Memcpy(&Magic, Data, sizeof(Magic));
+    return Magic == ColumnsMagic;
+}
+
+bool FQueryResponseFormat::Gunzip(const uint8 *Data, int32 Size, TArray<uint8> &OutData, int32 MaxSize)
+{
+    OutData.Reset();
+
+    if (!IsGzip(Data, Size))
+    {
+        return false;
+    }
+
+    //The size in the trailer is only the size modulo 4 GB, and comes from the sender, so the output grows as it is
+    //inflated instead.  Text usually compresses around 10:1
+    const int32 ChunkSize = 256 * 1024;
+    OutData.Reserve((int32)FMath::Min((int64)Size * 8 + ChunkSize, (int64)MaxSize));
+
+    z_stream Stream;
+    FMemory::Memzero(Stream);
+    Stream.next_in = (Bytef *)Data;
+    Stream.avail_in = (uInt)Size;
+
+    //Window bits past 15 take a gzip header rather than a zlib one
+    if (inflateInit2(&Stream, 16 + MAX_WBITS) != Z_OK)
+    {
+        return false;
+    }
+
+    bool Success = false;
+    for (;;)
+    {
+        if (OutData.Num() >= MaxSize)
+        {
+            UE_LOG(LogTelemetryVisualizer, Warning, TEXT("Query response inflates past the %d MB limit"), MaxSize / (1024 * 1024));
+            break;
+        }
+
+        const int32 Start = OutData.Num();
+        const int32 Available = FMath::Min(ChunkSize, MaxSize - Start);
+        OutData.AddUninitialized(Available);
+
+        Stream.next_out = OutData.GetData() + Start;
+        Stream.avail_out = (uInt)Available;
+
+        const int Status = inflate(&Stream, Z_NO_FLUSH);
+        OutData.SetNum(Start + Available - (int32)Stream.avail_out, false);
+
+        if (Status == Z_STREAM_END)
+        {
+            //A body may be several gzip members one after another, which inflate to their concatenation
+            if (Stream.avail_in > 0 && IsGzip(Stream.next_in, (int32)Stream.avail_in))
+            {
+                inflateReset(&Stream);
+                continue;
+            }
+
+            //Anything else after the last member is only allowed to be padding
+            Success = true;
+            for (uInt i = 0; i < Stream.avail_in; i++)
+            {
+                Success &= (Stream.next_in[i] == 0);
+            }
+            break;
+        }
+
+        //Z_BUF_ERROR with input left only means the output was full
+        if (Status != Z_OK && !(Status == Z_BUF_ERROR && Stream.avail_out == 0))
+        {
+            break;
+        }
+
+        if (Stream.avail_in == 0 && Stream.avail_out > 0)
+        {
+            //Truncated stream
+            break;
+        }
+    }
+
+    inflateEnd(&Stream);
+
+    if (!Success)
+    {
+        OutData.Empty();
+    }
+    return Success;
+}
+
+bool FQueryResponseFormat::Gzip(const uint8 *Data, int32 Size, TArray<uint8> &OutData)
+{
+    int32 CompressedSize = FCompression::CompressMemoryBound(COMPRESS_GZIP, Size);
+    OutData.SetNumUninitialized(CompressedSize);
+
+    if (!FCompression::CompressMemory(COMPRESS_GZIP, OutData.GetData(), CompressedSize, Data, Size))
+    {
+        OutData.Reset();
+        return false;
+    }
+
+    OutData.SetNum(CompressedSize, false);
+    return true;
+}
+
+bool FQueryResponseFormat::Read(const uint8 *Data, int32 Size, SQueryResult &OutResult, IQueryResultSink &Sink)
+{
+    if (IsGzip(Data, Size))
+    {
+        TArray<uint8> Inflated;
+        return Gunzip(Data, Size, Inflated) && Read(Inflated.GetData(), Inflated.Num(), OutResult, Sink);
+    }
+
+    if (!IsColumns(Data, Size))
+    {
+        return FQueryResultReader::Read(Data, Size, OutResult, Sink);
+    }
+
+    FQueryColumnsReader Reader(Data, Size);
+
+    FQueryColumnsHeader Header;
+    FString ContinuationToken;
+    if (!Reader.Read(&Header, sizeof(Header)) || Header.Version != ColumnsVersion || Header.NumRows < 0 || Header.NumValueColumns < 0 || Header.NumValueColumns > Size || !Reader.ReadString(ContinuationToken))
+    {
+        return false;
+    }
+
+    const int32 Num = Header.NumRows;
+    FQueryResultColumns Columns;
+
+    bool Success = Reader.ReadArray(Columns.Position.X, Num) && Reader.ReadArray(Columns.Position.Y, Num) && Reader.ReadArray(Columns.Position.Z, Num) &&
+        Reader.ReadArray(Columns.Direction.X, Num) && Reader.ReadArray(Columns.Direction.Y, Num) && Reader.ReadArray(Columns.Direction.Z, Num) &&
+        Reader.ReadArray(Columns.Ticks, Num) && Reader.ReadArray(Columns.Counts, Num) &&
+        Reader.ReadColumn(Columns.Name, Num) && Reader.ReadColumn(Columns.Category, Num) && Reader.ReadColumn(Columns.Session, Num) &&
+        Reader.ReadColumn(Columns.BuildType, Num) && Reader.ReadColumn(Columns.BuildId, Num) && Reader.ReadColumn(Columns.Platform, Num);
+
+    Columns.Values.SetNum(Header.NumValueColumns);
+    for (int32 i = 0; Success && i < Header.NumValueColumns; i++)
+    {
+        Success = Reader.ReadString(Columns.Values[i].Name) && Reader.ReadArray(Columns.Values[i].Values, Num);
+    }
+
+    if (!Success)
+    {
+        return false;
+    }
+
+    OutResult.Header.Success = Header.Success != 0;
+    OutResult.Header.Count = Num;
+    OutResult.Header.QueryTime = Header.QueryTime;
+    OutResult.Header.ContinuationToken = ContinuationToken;
+    OutResult.EventCount = Num;
+
+    if (!Sink.AddColumns(Columns))
+    {
+        Columns.Replay(Sink);
+    }
+
+    return true;
+}
+
+bool FQueryResponseFormat::ReadHeader(const uint8 *Data, int32 Size, SQueryResult &OutResult)
+{
+    if (!IsColumns(Data, Size))
+    {
+        return FQueryResultReader::ReadHeader(Data, Size, OutResult);
+    }
+
+    FQueryColumnsReader Reader(Data, Size);
+
+    FQueryColumnsHeader Header;
+    FString ContinuationToken;
+    if (!Reader.Read(&Header, sizeof(Header)) || Header.Version != ColumnsVersion || Header.NumRows < 0 || !Reader.ReadString(ContinuationToken))
+    {
+        return false;
+    }
+
+    OutResult.Header.Success = Header.Success != 0;
+    OutResult.Header.Count = Header.NumRows;
+    OutResult.Header.QueryTime = Header.QueryTime;
+    OutResult.Header.ContinuationToken = ContinuationToken;
+    return true;
+}
+
+void FQueryResponseFormat::WriteColumns(const FQueryResultColumns &Columns, bool Success, int32 QueryTime, const FString &ContinuationToken, TArray<uint8> &OutData)
+{
+    FQueryColumnsHeader Header;
+    Header.Magic = ColumnsMagic;
+    Header.Version = ColumnsVersion;
+    Header.Success = Success ? 1 : 0;
+    Header.QueryTime = QueryTime;
+    Header.NumRows = Columns.Num();
+    Header.NumValueColumns = Columns.Values.Num();
+
+    OutData.Reset();
+    FQueryColumnsWriter Writer(OutData);
+    Writer.Write(&Header, sizeof(Header));
+    Writer.WriteString(ContinuationToken);
+    Writer.WriteArray(Columns.Position.X);
+    Writer.WriteArray(Columns.Position.Y);
+    Writer.WriteArray(Columns.Position.Z);
+    Writer.WriteArray(Columns.Direction.X);
+    Writer.WriteArray(Columns.Direction.Y);
+    Writer.WriteArray(Columns.Direction.Z);
+    Writer.WriteArray(Columns.Ticks);
+    Writer.WriteArray(Columns.Counts);
+    Writer.WriteColumn(Columns.Name);
+    Writer.WriteColumn(Columns.Category);
+    Writer.WriteColumn(Columns.Session);
+    Writer.WriteColumn(Columns.BuildType);
+    Writer.WriteColumn(Columns.BuildId);
+    Writer.WriteColumn(Columns.Platform);
+
+    for (const FQueryValueColumn &Column : Columns.Values)
+    {
+        Writer.WriteString(Column.Name);
+        Writer.WriteArray(Column.Values);
+    }
+}
+
+bool FQueryResponseFormat::JsonToColumns(const uint8 *Data, int32 Size, TArray<uint8> &OutData)
+{
+    FQueryResultColumns Columns;
+    FQueryColumnSink Sink(Columns);
+    SQueryResult Result;
+
+    if (!FQueryResultReader::Read(Data, Size, Result, Sink))
+    {
+        return false;
+    }
+
+    WriteColumns(Columns, Result.Header.Success, Result.Header.QueryTime, Result.Header.ContinuationToken, OutData);
+    return true;
+}
+
+//Reads one response the way the visualizer does, in to grouped events that keep their columns, and returns the
+//fastest of Runs in milliseconds
+static double TimeDecode(const TArray<uint8> &Content, int32 Runs, int32 &OutEvents)
+{
+    double Best = MAX_dbl;
+
+    for (int32 Run = 0; Run < Runs; Run++)
+    {
+        const double Start = FPlatformTime::Seconds();
+
+        FEventCollectionBuilder Builder(true);
+        SQueryResult Result;
+        Builder.BeginPage(0);
+        FQueryResponseFormat::Read(Content.GetData(), Content.Num(), Result, Builder);
+        Builder.EndPage();
+
+        Best = FMath::Min(Best, (FPlatformTime::Seconds() - Start) * 1000.0);
+        OutEvents = Result.EventCount;
+    }
+
+    return Best;
+}
+
+static void BenchmarkQueryFormats(const TArray<FString> &Args)
+{
+    TArray<uint8> Json;
+    if (Args.Num() > 0)
+    {
+        if (!FFileHelper::LoadFileToArray(Json, *Args[0]))
+        {
+            UE_LOG(LogTelemetryVisualizer, Warning, TEXT("Usage: Telemetry.BenchmarkQueryFormats [saved query response] [runs]"));
+            return;
+        }
+    }
+    else
+    {
+        //Up to 100k events of the local query server, from Telemetry.LocalServer.Load or Generate
+        Json = FTelemetryLocalServer::Get().HandleQuery(FString(), 100000, FString());
+    }
+
+    const int32 Runs = Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 1) : 5;
+
+    TArray<uint8> Columns;
+    if (!FQueryResponseFormat::JsonToColumns(Json.GetData(), Json.Num(), Columns))
+    {
+        UE_LOG(LogTelemetryVisualizer, Warning, TEXT("The query response could not be read"));
+        return;
+    }
+
+    TArray<uint8> JsonGzip;
+    TArray<uint8> ColumnsGzip;
+    FQueryResponseFormat::Gzip(Json.GetData(), Json.Num(), JsonGzip);
+    FQueryResponseFormat::Gzip(Columns.GetData(), Columns.Num(), ColumnsGzip);
+
+    struct FFormat
+    {
+        const TCHAR *Label;
+        const TArray<uint8> *Content;
+    };
+
+    const FFormat Formats[] =
+    {
+        { TEXT("Json"), &Json },
+        { TEXT("Json, gzip"), &JsonGzip },
+        { TEXT("Columns"), &Columns },
+        { TEXT("Columns, gzip"), &ColumnsGzip }
+    };
+
+    for (const FFormat &Format : Formats)
+    {
+        if (Format.Content->Num() == 0)
+        {
+            UE_LOG(LogTelemetryVisualizer, Warning, TEXT("%s: could not be encoded"), Format.Label);
+            continue;
+        }
+
+        int32 Events = 0;
+        const double DecodeTime = TimeDecode(*Format.Content, Runs, Events);
+
+        UE_LOG(LogTelemetryVisualizer, Log, TEXT("%s: %d events, %.2f MB, %.1f bytes per event, %.1f ms to decode"),
+            Format.Label, Events, Format.Content->Num() / (1024.0 * 1024.0), Events > 0 ? (double)Format.Content->Num() / Events : 0.0, DecodeTime);
+    }
+}
+
+static FAutoConsoleCommand BenchmarkQueryFormatsCommand(
+    TEXT("Telemetry.BenchmarkQueryFormats"),
+    TEXT("Encodes a saved query response, or up to 100k events of the local query server, as Json and columns with and without gzip, and logs the size and decode time of each"),
+    FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkQueryFormats));
@@ -0,0 +1,355 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//--------------------------------------------------------------------------------------
+// TelemetryQueryImport.cpp
+//
+// Reads event files without a server
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "Query/TelemetryQueryImport.h"
+#include "Query/TelemetryQueryFormat.h"
+#include "TelemetryVisualizerModule.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFilemanager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+
+const uint32 FQueryFileImport::FileMagic = 0x31465154; // "TQF1"
+
+//Newline delimited Json is split in to chunks of about this many bytes, ending at a line break
+static const int64 LineChunkSize = 8 * 1024 * 1024;
+
+FQueryFileImport::FQueryFileImport() :
+    Data(nullptr),
+    Size(0),
+    IsColumns(false),
+    NextChunk(0),
+    NextDeliver(0),
+    Running(0),
+    Parallelism(1),
+    Skipped(0),
+    IsComplete(true),
+    StartTime(0)
+{
+}
+
+FQueryFileImport::~FQueryFileImport()
+{
+}
+
+TSharedPtr<FQueryFileImport, ESPMode::ThreadSafe> FQueryFileImport::Start(const FString &Path, QueryResultHandler HandlerFunc, FQueryResultSinkFactory SinkFactory)
+{
+    TSharedPtr<FQueryFileImport, ESPMode::ThreadSafe> Import = MakeShareable(new FQueryFileImport);
+    if (!Import->Open(Path))
+    {
+        return nullptr;
+    }
+
+    Import->HandlerFunc = HandlerFunc;
+    Import->SinkFactory = MoveTemp(SinkFactory);
+    Import->Parallelism = FMath::Max(FPlatformMisc::NumberOfWorkerThreadsToSpawn(), 1);
+    Import->StartTime = FPlatformTime::Seconds();
+    Import->Split();
+    Import->StartChunks();
+    return Import;
+}
+
+bool FQueryFileImport::Open(const FString &InPath)
+{
+    Path = InPath;
+    IPlatformFile &PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+
+    if (!PlatformFile.FileExists(*Path))
+    {
+        return false;
+    }
+
+    //Mapped where the platform supports it, so archives larger than memory can be read
+    MappedFile.Reset(PlatformFile.OpenMapped(*Path));
+    if (MappedFile.IsValid())
+    {
+        MappedRegion.Reset(MappedFile->MapRegion());
+    }
+
+    if (MappedRegion.IsValid())
+    {
+        Data = MappedRegion->GetMappedPtr();
+        Size = MappedRegion->GetMappedSize();
+    }
+    else
+    {
+        MappedFile.Reset();
+
+        if (!FFileHelper::LoadFileToArray(Loaded, *Path))
+        {
+            return false;
+        }
+
+        Data = Loaded.GetData();
+        Size = Loaded.Num();
+    }
+
+    uint32 Magic = 0;
+    if (Size >= (int64)sizeof(Magic))
+    {
+        FMemory::Memcpy(&Magic, Data, sizeof(Magic));
+    }
+
+    IsColumns = Magic == FileMagic;
+    return true;
+}
+
+void FQueryFileImport::Split()
+{
+    if (IsColumns)
+    {
+        int64 Offset = sizeof(FileMagic);
+
+        while (Size - Offset >= (int64)sizeof(int32))
+        {
+            int32 PageSize;
+            FMemory::Memcpy(&PageSize, Data + Offset, sizeof(PageSize));
+            Offset += sizeof(PageSize);
+
+            if (PageSize < 0 || Size - Offset < PageSize)
+            {
+                UE_LOG(LogTelemetryVisualizer, Warning, TEXT("%s is cut off after %d pages"), *Path, Chunks.Num());
+                IsComplete = false;
+                break;
+            }
+
+            Chunks.Add(TPair<int64, int64>(Offset, PageSize));
+            Offset += PageSize;
+        }
+    }
+    else
+    {
+        int64 Offset = 0;
+
+        while (Offset < Size)
+        {
+            int64 ChunkEnd = FMath::Min(Offset + LineChunkSize, Size);
+            while (ChunkEnd < Size && Data[ChunkEnd - 1] != '\n')
+            {
+                ChunkEnd++;
+            }
+
+            Chunks.Add(TPair<int64, int64>(Offset, ChunkEnd - Offset));
+            Offset = ChunkEnd;
+        }
+    }
+
+    //An empty file still delivers one empty page, so the handler sees the import finish
+    if (Chunks.Num() == 0)
+    {
+        Chunks.Add(TPair<int64, int64>(0, 0));
+    }
+}
+
+//Reads chunks on worker threads.  Chunks read ahead of the next one to deliver are limited, so a slow chunk does
+//not leave the whole file held in sinks
+void FQueryFileImport::StartChunks()
+{
+    while (!IsCancelled && Running < Parallelism && NextChunk < Chunks.Num() && NextChunk - NextDeliver < Parallelism * 2)
+    {
+        const int32 Chunk = NextChunk++;
+        Running++;
+
+        TSharedRef<FQueryFileImport, ESPMode::ThreadSafe> Import = AsShared();
+
+        Async<void>(EAsyncExecution::ThreadPool, [Import, Chunk]()
+        {
+            if (Import->IsCancelled)
+            {
+                return;
+            }
+
+            int32 ChunkSkipped = 0;
+            const TPair<int64, int64> &Range = Import->Chunks[Chunk];
+            TSharedPtr<SQueryResult> Result = ReadChunk(Import->Data + Range.Key, Range.Value, Import->IsColumns, Chunk, Import->SinkFactory, ChunkSkipped);
+
+            //The result is moved so its reference count is never touched from two threads
+            AsyncTask(ENamedThreads::GameThread, [Import, Chunk, ChunkSkipped, Result = MoveTemp(Result)]()
+            {
+                Import->Running--;
+                Import->Skipped += ChunkSkipped;
+                Import->DeliverChunk(Chunk, Result);
+            });
+        });
+    }
+}
+
+TSharedPtr<SQueryResult> FQueryFileImport::ReadChunk(const uint8 *ChunkData, int64 ChunkSize, bool IsColumns, int32 Chunk, const FQueryResultSinkFactory &SinkFactory, int32 &OutSkipped)
+{
+    const double ChunkStart = FPlatformTime::Seconds();
+
+    TSharedPtr<SQueryResult> Result = MakeShareable(new SQueryResult);
+    TSharedRef<IQueryResultSink> Sink = SinkFactory();
+    Sink->BeginPage(Chunk);
+
+    if (IsColumns)
+    {
+        Result->Header.Success = FQueryResponseFormat::Read(ChunkData, (int32)ChunkSize, *Result, *Sink);
+    }
+    else
+    {
+        Result->EventCount = FQueryResultReader::ReadLines(ChunkData, (int32)ChunkSize, *Sink, OutSkipped);
+        Result->Header.Success = true;
+    }
+
+    Sink->EndPage();
+
+    Result->Sink = Sink;
+    Result->Header.Count = Result->EventCount;
+    Result->Header.QueryTime = (FPlatformTime::Seconds() - ChunkStart) * 1000;
+    Result->Timings.Read = Result->Header.QueryTime;
+    return Result;
+}
+
+void FQueryFileImport::DeliverChunk(int32 Chunk, TSharedPtr<SQueryResult> Result)
+{
+    if (IsCancelled)
+    {
+        return;
+    }
+
+    Finished.Add(Chunk, Result);
+
+    TSharedPtr<SQueryResult> Next;
+    while (!IsCancelled && Finished.RemoveAndCopyValue(NextDeliver, Next))
+    {
+        IsComplete = IsComplete && Next->Header.Success;
+
+        Next->PageIndex = NextDeliver++;
+        Next->IsLastPage = NextDeliver == Chunks.Num();
+        Next->IsComplete = Next->IsLastPage && IsComplete;
+
+        if (Next->IsLastPage)
+        {
+            if (Skipped > 0)
+            {
+                UE_LOG(LogTelemetryVisualizer, Warning, TEXT("Skipped %d lines of %s that were not events"), Skipped, *Path);
+            }
+
+            UE_LOG(LogTelemetryVisualizer, Log, TEXT("Imported %s (%.1f MB) in %.1f s"), *Path, Size / (1024.0 * 1024.0), FPlatformTime::Seconds() - StartTime);
+
+            //Nothing else will be delivered, so the import is no longer running
+            IsCancelled = true;
+        }
+
+        HandlerFunc.ExecuteIfBound(Next);
+    }
+
+    StartChunks();
+}
+
+void FQueryFileImport::WriteFileHeader(FArchive &Writer)
+{
+    uint32 Magic = FileMagic;
+    Writer.Serialize(&Magic, sizeof(Magic));
+}
+
+void FQueryFileImport::WritePage(FArchive &Writer, const TArray<uint8> &Page)
+{
+    int32 PageSize = Page.Num();
+    Writer.Serialize(&PageSize, sizeof(PageSize));
+    Writer.Serialize(const_cast<uint8 *>(Page.GetData()), PageSize);
+}
+
+//Keeps the columns its sink reads in to, so each chunk can be written as a page
+struct FQueryColumnsHolder
+{
+    FQueryResultColumns Columns;
+};
+
+class FQueryOwnedColumnSink : private FQueryColumnsHolder, public FQueryColumnSink
+{
+public:
+    FQueryOwnedColumnSink() : FQueryColumnSink(FQueryColumnsHolder::Columns) {}
+
+    const FQueryResultColumns &GetColumns() const { return FQueryColumnsHolder::Columns; }
+};
+
+//Converts newline delimited Json in to an event file, a page per chunk
+class FQueryFileExport : public TSharedFromThis<FQueryFileExport>
+{
+public:
+    static TSharedPtr<FQueryFileExport> Active;
+
+    bool Start(const FString &InputPath, const FString &OutputPath)
+    {
+        Writer.Reset(IFileManager::Get().CreateFileWriter(*OutputPath));
+        if (!Writer.IsValid())
+        {
+            return false;
+        }
+
+        FQueryFileImport::WriteFileHeader(*Writer);
+        NumEvents = 0;
+
+        Import = FQueryFileImport::Start(InputPath, QueryResultHandler::CreateSP(this, &FQueryFileExport::OnPage), []()
+        {
+            return TSharedRef<IQueryResultSink>(MakeShareable(new FQueryOwnedColumnSink()));
+        });
+
+        return Import.IsValid();
+    }
+
+private:
+    void OnPage(TSharedPtr<SQueryResult> Result)
+    {
+        const FQueryOwnedColumnSink &Sink = static_cast<const FQueryOwnedColumnSink &>(*Result->Sink);
+
+        TArray<uint8> Page;
+        FQueryResponseFormat::WriteColumns(Sink.GetColumns(), true, 0, FString(), Page);
+        FQueryFileImport::WritePage(*Writer, Page);
+        NumEvents += Result->EventCount;
+
+        if (Result->IsLastPage)
+        {
+            const int64 WrittenSize = Writer->TotalSize();
+            Writer->Close();
+
+            UE_LOG(LogTelemetryVisualizer, Log, TEXT("Wrote %d events in %d pages, %.1f MB from %.1f MB"), NumEvents, Result->PageIndex + 1, WrittenSize / (1024.0 * 1024.0), Import->GetFileSize() / (1024.0 * 1024.0));
+            Active.Reset();
+        }
+    }
+
+    TUniquePtr<FArchive> Writer;
+    TSharedPtr<FQueryFileImport, ESPMode::ThreadSafe> Import;
+    int32 NumEvents;
+};
+
+TSharedPtr<FQueryFileExport> FQueryFileExport::Active;
+
+static void ConvertEventFile(const TArray<FString> &Args)
+{
+    if (Args.Num() < 2)
+    {
+        UE_LOG(LogTelemetryVisualizer, Warning, TEXT("Usage: Telemetry.ConvertEventFile <newline delimited json> <event file>"));
+        return;
+    }
+
+    if (FQueryFileExport::Active.IsValid())
+    {
+        UE_LOG(LogTelemetryVisualizer, Warning, TEXT("An event file is already being converted"));
+        return;
+    }
+
+    TSharedPtr<FQueryFileExport> Export = MakeShareable(new FQueryFileExport());
+    FQueryFileExport::Active = Export;
+
+    if (!Export->Start(Args[0], Args[1]))
+    {
+        UE_LOG(LogTelemetryVisualizer, Warning, TEXT("Unable to convert %s to %s"), *Args[0], *Args[1]);
+        FQueryFileExport::Active.Reset();
+    }
+}
+
+static FAutoConsoleCommand ConvertEventFileCommand(
+    TEXT("Telemetry.ConvertEventFile"),
+    TEXT("Converts a newline delimited Json file of events in to the binary event file the visualizer imports fastest"),
+    FConsoleCommandWithArgsDelegate::CreateStatic(&ConvertEventFile));
@@ -0,0 +1,573 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//--------------------------------------------------------------------------------------
+// TelemetryQueryOptimizer.cpp
+//
+// Simplifies query trees before they are sent
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "Query/TelemetryQueryOptimizer.h"
+#include "Query/TelemetryQueryEvaluator.h"
+#include "TelemetryVisualizerModule.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+
+static FQueryNodePtr MakeGroup(EQueryOp Op, FQueryNodeList &&Children)
+{
+    return MakeShareable(new FQueryNode(EQueryNodeType::Group, Op, MoveTemp(Children)));
+}
+
+static FQueryNodePtr MakeComparison(const FString &Column, EQueryOp Op, const TSharedPtr<FJsonValue> &Value)
+{
+    return MakeShareable(new FQueryNode(EQueryNodeType::Comparison, Column, Op, CopyTemp(Value)));
+}
+
+static bool IsComparison(const FQueryNodePtr &Node, EQueryOp Op)
+{
+    return Node->Type == EQueryNodeType::Comparison && Node->Operator == Op;
+}
+
+static bool IsPoints(const FQueryNodePtr &Node)
+{
+    return IsComparison(Node, EQueryOp::Eq) || IsComparison(Node, EQueryOp::In);
+}
+
+static bool IsRange(const FQueryNodePtr &Node)
+{
+    return Node->Type == EQueryNodeType::Comparison &&
+        (Node->Operator == EQueryOp::Gt || Node->Operator == EQueryOp::Gte || Node->Operator == EQueryOp::Lt || Node->Operator == EQueryOp::Lte || Node->Operator == EQueryOp::Btwn);
+}
+
+//Orders values of different types by type, so any list of values has one sorted order
+static bool IsValueLess(const TSharedPtr<FJsonValue> &A, const TSharedPtr<FJsonValue> &B)
+{
+    int32 Order = 0;
+    if (FQueryEvaluator::CompareValues(A, B, Order))
+    {
+        return Order < 0;
+    }
+
+    return A->Type < B->Type;
+}
+
+//Eq for a single value, otherwise an In of the sorted distinct values.  No values is the empty query
+static FQueryNodePtr MakePoints(const FString &Column, TArray<TSharedPtr<FJsonValue>> Values)
+{
+    Values.Sort([](const TSharedPtr<FJsonValue> &A, const TSharedPtr<FJsonValue> &B) { return IsValueLess(A, B); });
+
+    TArray<TSharedPtr<FJsonValue>> Distinct;
+    for (const TSharedPtr<FJsonValue> &Value : Values)
+    {
+        if (Distinct.Num() == 0 || IsValueLess(Distinct.Last(), Value))
+        {
+            Distinct.Add(Value);
+        }
+    }
+
+    if (Distinct.Num() == 0)
+    {
+        return MakeGroup(EQueryOp::Or, FQueryNodeList());
+    }
+
+    if (Distinct.Num() == 1)
+    {
+        return MakeComparison(Column, EQueryOp::Eq, Distinct[0]);
+    }
+
+    return MakeComparison(Column, EQueryOp::In, FJsonValueUtil::Create(Distinct));
+}
+
+FQueryNodePtr FQueryOptimizer::Optimize(const FQueryNodePtr &Query)
+{
+    return Query.IsValid() ? OptimizeNode(Query) : Query;
+}
+
+bool FQueryOptimizer::IsEmpty(const FQueryNodePtr &Query)
+{
+    return Query.IsValid() && Query->Type == EQueryNodeType::Group && Query->Operator == EQueryOp::Or && (!Query->Children.IsValid() || Query->Children->Num() == 0);
+}
+
+bool FQueryOptimizer::IsTautology(const FQueryNodePtr &Query)
+{
+    return !Query.IsValid() || (Query->Type == EQueryNodeType::Group && Query->Operator == EQueryOp::And && (!Query->Children.IsValid() || Query->Children->Num() == 0));
+}
+
+FString FQueryOptimizer::GetCanonicalText(const FQueryNodePtr &Query)
+{
+    FQuerySerializer Serializer;
+    return Query.IsValid() ? Serializer.Serialize(Optimize(Query)) : FString();
+}
+
+int32 FQueryOptimizer::CountNodes(const FQueryNodePtr &Query)
+{
+    int32 Count = Query.IsValid() ? 1 : 0;
+
+    if (Query.IsValid() && Query->Children.IsValid())
+    {
+        for (const FQueryNodePtr &Child : *Query->Children)
+        {
+            Count += CountNodes(Child);
+        }
+    }
+
+    return Count;
+}
+
+FQueryNodePtr FQueryOptimizer::OptimizeNode(const FQueryNodePtr &Node)
+{
+    if (Node->Type == EQueryNodeType::Aggregate)
+    {
+        //Only the filter of an aggregate is simplified.  Its cell size and column are kept
+        FQueryNodeList Children;
+        Children.Add(OptimizeGroup(MakeGroup(EQueryOp::And, CopyTemp(*Node->Children))));
+
+        return MakeShareable(new FQueryNode(EQueryNodeType::Aggregate, Node->Column, CopyTemp(Node->Value), MoveTemp(Children)));
+    }
+
+    return Node->Type == EQueryNodeType::Group ? OptimizeGroup(Node) : OptimizeComparison(Node);
+}
+
+FQueryNodePtr FQueryOptimizer::OptimizeComparison(const FQueryNodePtr &Node)
+{
+    const TArray<TSharedPtr<FJsonValue>> Values = FQueryEvaluator::GetValues(*Node);
+
+    if (Node->Operator == EQueryOp::In)
+    {
+        return MakePoints(Node->Column, Values);
+    }
+
+    if (Node->Operator == EQueryOp::Btwn && Values.Num() == 2)
+    {
+        int32 Order = 0;
+        if (FQueryEvaluator::CompareValues(Values[0], Values[1], Order))
+        {
+            if (Order > 0)
+            {
+                return MakeGroup(EQueryOp::Or, FQueryNodeList());
+            }
+
+            if (Order == 0)
+            {
+                return MakeComparison(Node->Column, EQueryOp::Eq, Values[0]);
+            }
+        }
+    }
+
+    return Node;
+}
+
+FQueryNodePtr FQueryOptimizer::OptimizeGroup(const FQueryNodePtr &Node)
+{
+    const bool IsAnd = (Node->Operator == EQueryOp::And);
+    FQueryNodeList Children;
+
+    if (Node->Children.IsValid())
+    {
+        for (const FQueryNodePtr &Child : *Node->Children)
+        {
+            if (!Child.IsValid())
+            {
+                continue;
+            }
+
+            FQueryNodePtr Optimized = OptimizeNode(Child);
+
+            //A child with the same operator is merged in, which also drops matching empty groups
+            if (Optimized->Type == EQueryNodeType::Group && Optimized->Operator == Node->Operator)
+            {
+                if (Optimized->Children.IsValid())
+                {
+                    Children.Append(*Optimized->Children);
+                }
+                continue;
+            }
+
+            //An And with a child that matches nothing matches nothing, and an Or with a child that matches everything
+            //matches everything
+            if (IsAnd ? IsEmpty(Optimized) : IsTautology(Optimized))
+            {
+                return Optimized;
+            }
+
+            Children.Add(Optimized);
+        }
+    }
+
+    if (IsAnd)
+    {
+        if (!IntersectColumns(Children))
+        {
+            return MakeGroup(EQueryOp::Or, FQueryNodeList());
+        }
+    }
+    else
+    {
+        FoldPoints(Children);
+    }
+
+    RemoveImplied(Children, IsAnd);
+
+    if (Children.Num() == 1)
+    {
+        return Children[0];
+    }
+
+    //Sorted by serialized form, so the order clauses were added in does not change the query text
+    FQuerySerializer Serializer;
+    TArray<TPair<FString, FQueryNodePtr>> Sorted;
+    for (const FQueryNodePtr &Child : Children)
+    {
+        Sorted.Emplace(Serializer.Serialize(Child), Child);
+    }
+
+    Sorted.Sort([](const TPair<FString, FQueryNodePtr> &A, const TPair<FString, FQueryNodePtr> &B) { return A.Key < B.Key; });
+
+    Children.Reset();
+    for (const TPair<FString, FQueryNodePtr> &Child : Sorted)
+    {
+        Children.Add(Child.Value);
+    }
+
+    return MakeGroup(Node->Operator, MoveTemp(Children));
+}
+
+//Under an Or, every Eq and In on a column become one In of all their values
+void FQueryOptimizer::FoldPoints(FQueryNodeList &Children)
+{
+    TArray<FString> Columns;
+    TMap<FString, TArray<TSharedPtr<FJsonValue>>> Points;
+    FQueryNodeList Others;
+
+    for (const FQueryNodePtr &Child : Children)
+    {
+        if (IsPoints(Child))
+        {
+            Columns.AddUnique(Child->Column);
+            Points.FindOrAdd(Child->Column).Append(FQueryEvaluator::GetValues(*Child));
+        }
+        else
+        {
+            Others.Add(Child);
+        }
+    }
+
+    Children = MoveTemp(Others);
+
+    for (const FString &Column : Columns)
+    {
+        Children.Add(MakePoints(Column, Points[Column]));
+    }
+}
+
+//Under an And, the comparisons on each column are intersected.  Returns false if a column can match no value
+bool FQueryOptimizer::IntersectColumns(FQueryNodeList &Children)
+{
+    TArray<FString> Columns;
+    for (const FQueryNodePtr &Child : Children)
+    {
+        if (Child->Type == EQueryNodeType::Comparison)
+        {
+            Columns.AddUnique(Child->Column);
+        }
+    }
+
+    for (const FString &Column : Columns)
+    {
+        FQueryNodeList Comparisons;
+        FQueryNodeList Others;
+
+        for (const FQueryNodePtr &Child : Children)
+        {
+            (Child->Type == EQueryNodeType::Comparison && Child->Column == Column ? Comparisons : Others).Add(Child);
+        }
+
+        //With an Eq or In, the column can only hold the values every other comparison also matches
+        const FQueryNodePtr *First = Comparisons.FindByPredicate(&IsPoints);
+        if (First != nullptr)
+        {
+            TArray<TSharedPtr<FJsonValue>> Values;
+
+            for (const TSharedPtr<FJsonValue> &Value : FQueryEvaluator::GetValues(**First))
+            {
+                if (!Comparisons.ContainsByPredicate([&Value](const FQueryNodePtr &Comparison) { return !FQueryEvaluator::Satisfies(Value, *Comparison); }))
+                {
+                    Values.Add(Value);
+                }
+            }
+
+            if (Values.Num() == 0)
+            {
+                return false;
+            }
+
+            Others.Add(MakePoints(Column, Values));
+            Children = MoveTemp(Others);
+            continue;
+        }
+
+        //Otherwise the ranges are narrowed to the highest lower bound and the lowest upper bound
+        TSharedPtr<FJsonValue> Lower;
+        TSharedPtr<FJsonValue> Upper;
+        bool LowerInclusive = false;
+        bool UpperInclusive = false;
+        bool IsComparable = true;
+        FQueryNodeList Unchanged;
+
+        auto Narrow = [&IsComparable](TSharedPtr<FJsonValue> &Bound, bool &BoundInclusive, const TSharedPtr<FJsonValue> &Value, bool Inclusive, int32 Tighter)
+        {
+            int32 Order = 0;
+            if (!Bound.IsValid())
+            {
+                Bound = Value;
+                BoundInclusive = Inclusive;
+            }
+            else if (!FQueryEvaluator::CompareValues(Value, Bound, Order))
+            {
+                IsComparable = false;
+            }
+            else if (FMath::Sign(Order) == Tighter || (Order == 0 && !Inclusive))
+            {
+                Bound = Value;
+                BoundInclusive = Inclusive && (Order != 0 || BoundInclusive);
+            }
+        };
+
+        for (const FQueryNodePtr &Comparison : Comparisons)
+        {
+            const TArray<TSharedPtr<FJsonValue>> Values = FQueryEvaluator::GetValues(*Comparison);
+
+            if (!IsRange(Comparison) || Values.Num() != (Comparison->Operator == EQueryOp::Btwn ? 2 : 1))
+            {
+                Unchanged.Add(Comparison);
+                continue;
+            }
+
+            switch (Comparison->Operator)
+            {
+            case EQueryOp::Gt:
+            case EQueryOp::Gte:
+                Narrow(Lower, LowerInclusive, Values[0], Comparison->Operator == EQueryOp::Gte, 1);
+                break;
+            case EQueryOp::Lt:
+            case EQueryOp::Lte:
+                Narrow(Upper, UpperInclusive, Values[0], Comparison->Operator == EQueryOp::Lte, -1);
+                break;
+            default:
+                Narrow(Lower, LowerInclusive, Values[0], true, 1);
+                Narrow(Upper, UpperInclusive, Values[1], true, -1);
+                break;
+            }
+        }
+
+        int32 Order = 0;
+        if (!Lower.IsValid() && !Upper.IsValid())
+        {
+            continue;
+        }
+
+        if (!IsComparable || (Lower.IsValid() && Upper.IsValid() && !FQueryEvaluator::CompareValues(Lower, Upper, Order)))
+        {
+            //Bounds of different types never match the same field, but the server is left to decide that
+            continue;
+        }
+
+        if (Lower.IsValid() && Upper.IsValid())
+        {
+            if (Order > 0 || (Order == 0 && !(LowerInclusive && UpperInclusive)))
+            {
+                return false;
+            }
+
+            if (Order == 0)
+            {
+                Others.Add(MakeComparison(Column, EQueryOp::Eq, Lower));
+            }
+            else if (LowerInclusive && UpperInclusive)
+            {
+                Others.Add(MakeShareable(new FQueryNode(EQueryNodeType::Comparison, Column, EQueryOp::Btwn, CopyTemp(Lower), CopyTemp(Upper))));
+            }
+            else
+            {
+                Others.Add(MakeComparison(Column, LowerInclusive ? EQueryOp::Gte : EQueryOp::Gt, Lower));
+                Others.Add(MakeComparison(Column, UpperInclusive ? EQueryOp::Lte : EQueryOp::Lt, Upper));
+            }
+        }
+        else if (Lower.IsValid())
+        {
+            Others.Add(MakeComparison(Column, LowerInclusive ? EQueryOp::Gte : EQueryOp::Gt, Lower));
+        }
+        else
+        {
+            Others.Add(MakeComparison(Column, UpperInclusive ? EQueryOp::Lte : EQueryOp::Lt, Upper));
+        }
+
+        Others.Append(Unchanged);
+        Children = MoveTemp(Others);
+    }
+
+    return true;
+}
+
+//Drops clauses that do not change the result: under an And ones another clause implies, under an Or ones another
+//clause already covers.  Of two equal clauses the last is kept
+void FQueryOptimizer::RemoveImplied(FQueryNodeList &Children, bool IsAnd)
+{
+    TArray<bool> Removed;
+    Removed.Init(false, Children.Num());
+
+    for (int32 i = 0; i < Children.Num(); i++)
+    {
+        for (int32 j = 0; j < Children.Num(); j++)
+        {
+            if (i != j && !Removed[j] && (IsAnd ? FQueryEvaluator::Implies(*Children[j], *Children[i]) : FQueryEvaluator::Implies(*Children[i], *Children[j])))
+            {
+                Removed[i] = true;
+                break;
+            }
+        }
+    }
+
+    FQueryNodeList Kept;
+    for (int32 i = 0; i < Children.Num(); i++)
+    {
+        if (!Removed[i])
+        {
+            Kept.Add(Children[i]);
+        }
+    }
+
+    Children = MoveTemp(Kept);
+}
+
+//Runs a query as written and optimized in turn, then logs the server query time and round trip of each
+class FQueryOptimizerBenchmark : public TSharedFromThis<FQueryOptimizerBenchmark>
+{
+public:
+    FString Text[2];
+    int32 RunsLeft;
+
+    void RunNext()
+    {
+        if (RunsLeft-- <= 0)
+        {
+            Report();
+            Active.Reset();
+            return;
+        }
+
+        //Alternating keeps server caching and load from favoring either form
+        Current = (Current + 1) % 2;
+        QueryTime = 0;
+        EventCount = 0;
+        StartTime = FPlatformTime::Seconds();
+
+        Executor.ExecuteCustomQuery(Text[Current], QueryResultHandler::CreateSP(this, &FQueryOptimizerBenchmark::OnPage), -1, []()
+        {
+            return TSharedRef<IQueryResultSink>(MakeShareable(new FQueryDiscardSink()));
+        }, false);
+    }
+
+    static TSharedPtr<FQueryOptimizerBenchmark> Active;
+
+private:
+    void OnPage(TSharedPtr<SQueryResult> Result)
+    {
+        QueryTime += Result->Header.QueryTime;
+        EventCount += Result->EventCount;
+
+        if (Result->IsLastPage)
+        {
+            ServerTimes[Current].Add(QueryTime);
+            RoundTrips[Current].Add((FPlatformTime::Seconds() - StartTime) * 1000.0);
+            Events[Current] = EventCount;
+            RunNext();
+        }
+    }
+
+    void Report() const
+    {
+        static const TCHAR *Labels[] = { TEXT("Raw"), TEXT("Optimized") };
+
+        for (int32 i = 0; i < 2; i++)
+        {
+            double Server = 0;
+            double RoundTrip = 0;
+            for (int32 Run = 0; Run < ServerTimes[i].Num(); Run++)
+            {
+                Server += ServerTimes[i][Run];
+                RoundTrip += RoundTrips[i][Run];
+            }
+
+            const int32 Runs = FMath::Max(ServerTimes[i].Num(), 1);
+            UE_LOG(LogTelemetryVisualizer, Log, TEXT("%s: %d runs, %.1f ms server query time, %.1f ms round trip, %d events"), Labels[i], ServerTimes[i].Num(), Server / Runs, RoundTrip / Runs, Events[i]);
+        }
+
+        if (Events[0] != Events[1])
+        {
+            UE_LOG(LogTelemetryVisualizer, Warning, TEXT("Raw and optimized queries returned different event counts"));
+        }
+    }
+
+    FQueryExecutor Executor;
+    int32 Current = 1;
+    int32 QueryTime = 0;
+    int32 EventCount = 0;
+    double StartTime = 0;
+    TArray<double> ServerTimes[2];
+    TArray<double> RoundTrips[2];
+    int32 Events[2] = { 0, 0 };
+};
+
+TSharedPtr<FQueryOptimizerBenchmark> FQueryOptimizerBenchmark::Active;
+
+static void BenchmarkQueryOptimizer(const TArray<FString> &Args)
+{
+    FString QueryText;
+    if (Args.Num() < 1 || !FFileHelper::LoadFileToString(QueryText, *Args[0]))
+    {
+        UE_LOG(LogTelemetryVisualizer, Warning, TEXT("Usage: Telemetry.BenchmarkQueryOptimizer <serialized query file> [runs]"));
+        return;
+    }
+
+    if (FQueryOptimizerBenchmark::Active.IsValid())
+    {
+        UE_LOG(LogTelemetryVisualizer, Warning, TEXT("A query optimizer benchmark is already running"));
+        return;
+    }
+
+    FQuerySerializer Serializer;
+    FQueryNodePtr Raw = Serializer.Deserialize(QueryText);
+    if (!Raw.IsValid())
+    {
+        UE_LOG(LogTelemetryVisualizer, Warning, TEXT("%s is not a serialized query"), *Args[0]);
+        return;
+    }
+
+    FQueryNodePtr Optimized = FQueryOptimizer::Optimize(Raw);
+
+    TSharedPtr<FQueryOptimizerBenchmark> Benchmark = MakeShareable(new FQueryOptimizerBenchmark());
+    Benchmark->Text[0] = Serializer.Serialize(Raw);
+    Benchmark->Text[1] = Serializer.Serialize(Optimized);
+
+    UE_LOG(LogTelemetryVisualizer, Log, TEXT("Query optimizer: %d nodes to %d, %d characters to %d"),
+        FQueryOptimizer::CountNodes(Raw), FQueryOptimizer::CountNodes(Optimized), Benchmark->Text[0].Len(), Benchmark->Text[1].Len());
+    UE_LOG(LogTelemetryVisualizer, Log, TEXT("Optimized query: %s"), *Benchmark->Text[1]);
+
+    if (FQueryOptimizer::IsEmpty(Optimized))
+    {
+        UE_LOG(LogTelemetryVisualizer, Log, TEXT("The query matches no events, so the optimized form is never sent"));
+        return;
+    }
+
+    Benchmark->RunsLeft = 2 * (Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 1) : 5);
+    FQueryOptimizerBenchmark::Active = Benchmark;
+    Benchmark->RunNext();
+}
+
+static FAutoConsoleCommand BenchmarkQueryOptimizerCommand(
+    TEXT("Telemetry.BenchmarkQueryOptimizer"),
+    TEXT("Runs a serialized query as written and optimized in turn against the configured server, bypassing the query cache, and logs the query time of each"),
+    FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkQueryOptimizer));
@@ -0,0 +1,829 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//--------------------------------------------------------------------------------------
+// TelemetryQueryReader.cpp
+//
+// Streaming reader for query responses
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "Query/TelemetryQueryReader.h"
+#include "Query/TelemetryQuery.h"
+#include "TelemetryVisualizerModule.h"
+#include "TelemetryVisualizerUI.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+
+//Names of the recognized fields, see EQueryResultField
+static const struct
+{
+    const TCHAR *Name;
+    EQueryResultField Field;
+} KnownFields[] =
+{
+    { TEXT("pos_x"), EQueryResultField::PlayerPositionX },
+    { TEXT("pos_y"), EQueryResultField::PlayerPositionY },
+    { TEXT("pos_z"), EQueryResultField::PlayerPositionZ },
+    { TEXT("dir_x"), EQueryResultField::PlayerDirectionX },
+    { TEXT("dir_y"), EQueryResultField::PlayerDirectionY },
+    { TEXT("dir_z"), EQueryResultField::PlayerDirectionZ },
+    { TEXT("client_ts"), EQueryResultField::ClientTimestamp },
+    { TEXT("name"), EQueryResultField::Name },
+    { TEXT("cat"), EQueryResultField::Category },
+    { TEXT("session_id"), EQueryResultField::SessionId },
+    { TEXT("build_type"), EQueryResultField::BuildType },
+    { TEXT("build_id"), EQueryResultField::BuildId },
+    { TEXT("platform"), EQueryResultField::Platform },
+    { TEXT("count"), EQueryResultField::Count },
+};
+
+//Tokenizer state for one response
+class FQueryResponseTokenizer
+{
+public:
+    FQueryResponseTokenizer(const uint8 *Data, int32 Size, IQueryResultSink &Sink) :
+        Current((const ANSICHAR *)Data),
+        End((const ANSICHAR *)Data + Size),
+        Sink(Sink),
+        NextKeyHint(0)
+    {
+    }
+
+    bool Read(SQueryResult &OutResult)
+    {
+        if (!BeginResponse())
+        {
+            return false;
+        }
+
+        //Top level and header names are matched without case, the same as the Json DOM lookups they replace
+        return ReadMembers([this, &OutResult](const ANSICHAR *Key, int32 KeyLength)
+        {
+            if (IsKey(Key, KeyLength, "Header"))
+            {
+                return ReadHeader(OutResult);
+            }
+            else if (IsKey(Key, KeyLength, "Results"))
+            {
+                return ReadEvents(OutResult);
+            }
+
+            return SkipValue();
+        });
+    }
+
+    //Reads the members of the response up to and including the header, and stops there
+    bool ReadHeaderOnly(SQueryResult &OutResult)
+    {
+        if (!BeginResponse())
+        {
+            return false;
+        }
+
+        bool HasHeader = false;
+        ReadMembers([this, &OutResult, &HasHeader](const ANSICHAR *Key, int32 KeyLength)
+        {
+            if (IsKey(Key, KeyLength, "Header"))
+            {
+                HasHeader = ReadHeader(OutResult);
+                return false;
+            }
+
+            return SkipValue();
+        });
+
+        return HasHeader;
+    }
+
+    //Reads one event object per line.  Lines that do not hold a complete object, such as the last line of a file
+    //that is still being written, are skipped
+    int32 ReadLines(int32 &OutSkipped)
+    {
+        int32 NumEvents = 0;
+        OutSkipped = 0;
+
+        if (End - Current >= 3 && (uint8)Current[0] == 0xEF && (uint8)Current[1] == 0xBB && (uint8)Current[2] == 0xBF)
+        {
+            Current += 3;
+        }
+
+        const ANSICHAR *FileEnd = End;
+
+        while (Current < FileEnd)
+        {
+            const ANSICHAR *LineEnd = Current;
+            while (LineEnd < FileEnd && *LineEnd != '\n')
+            {
+                LineEnd++;
+            }
+
+            const ANSICHAR *Last = LineEnd;
+            while (Last > Current && (Last[-1] == ' ' || Last[-1] == '\t' || Last[-1] == '\r'))
+            {
+                Last--;
+            }
+
+            //The tokenizer stops at the end of the line, so a malformed line cannot run in to the next one
+            End = LineEnd;
+            SkipWhitespace();
+
+            if (Current < End)
+            {
+                if (*Current == '{' && Last[-1] == '}' && ReadEvent())
+                {
+                    NumEvents++;
+                }
+                else
+                {
+                    OutSkipped++;
+                }
+            }
+
+            End = FileEnd;
+            Current = LineEnd < FileEnd ? LineEnd + 1 : FileEnd;
+        }
+
+        return NumEvents;
+    }
+
+private:
+    //A field name seen in the response, kept so repeated names are only decoded once
+    struct FKeyEntry
+    {
+        TArray<ANSICHAR> Bytes;
+        FString Name;
+        EQueryResultField Field;
+    };
+
+    static bool IsKey(const ANSICHAR *Key, int32 KeyLength, const ANSICHAR *Expected)
+    {
+        return FCStringAnsi::Strlen(Expected) == KeyLength && FCStringAnsi::Strnicmp(Key, Expected, KeyLength) == 0;
+    }
+
+    void SkipWhitespace()
+    {
+        while (Current < End && (*Current == ' ' || *Current == '\t' || *Current == '\r' || *Current == '\n'))
+        {
+            Current++;
+        }
+    }
+
+    bool Expect(ANSICHAR Char)
+    {
+        SkipWhitespace();
+        if (Current < End && *Current == Char)
+        {
+            Current++;
+            return true;
+        }
+
+        return false;
+    }
+
+    ANSICHAR Peek()
+    {
+        SkipWhitespace();
+        return (Current < End) ? *Current : '\0';
+    }
+
+    //Calls ReadMember for each name in an object, with Current on the value.  The opening brace is already read
+    template<typename FunctionType>
+    bool ReadMembers(FunctionType ReadMember)
+    {
+        if (Expect('}'))
+        {
+            return true;
+        }
+
+        do
+        {
+            const ANSICHAR *Key;
+            int32 KeyLength;
+            bool HasEscapes;
+            if (!ReadRawString(Key, KeyLength, HasEscapes) || !Expect(':'))
+            {
+                return false;
+            }
+
+            if (!ReadMember(Key, KeyLength))
+            {
+                return false;
+            }
+        }
+        while (Expect(','));
+
+        return Expect('}');
+    }
+
+    //Finds the bounds of a string without decoding it
+    bool ReadRawString(const ANSICHAR *&OutStart, int32 &OutLength, bool &OutHasEscapes)
+    {
+        if (!Expect('"'))
+        {
+            return false;
+        }
+
+        OutStart = Current;
+        OutHasEscapes = false;
+
+        while (Current < End && *Current != '"')
+        {
+            if (*Current == '\\')
+            {
+                OutHasEscapes = true;
+                Current++;
+            }
+            Current++;
+        }
+
+        if (Current >= End)
+        {
+            return false;
+        }
+
+        OutLength = (int32)(Current - OutStart);
+        Current++;
+        return true;
+    }
+
+    static int32 HexValue(ANSICHAR Char)
+    {
+        if (Char >= '0' && Char <= '9') return Char - '0';
+        if (Char >= 'a' && Char <= 'f') return Char - 'a' + 10;
+        if (Char >= 'A' && Char <= 'F') return Char - 'A' + 10;
+        return -1;
+    }
+
+    static bool ReadHex4(const ANSICHAR *Text, uint32 &OutValue)
+    {
+        OutValue = 0;
+        for (int32 i = 0; i < 4; i++)
+        {
+            const int32 Digit = HexValue(Text[i]);
+            if (Digit < 0)
+            {
+                return false;
+            }
+            OutValue = (OutValue << 4) | Digit;
+        }
+
+        return true;
+    }
+
+    void AppendUtf8(uint32 CodePoint)
+    {
+        if (CodePoint < 0x80)
+        {
+            Utf8Scratch.Add((ANSICHAR)CodePoint);
+        }
+        else if (CodePoint < 0x800)
+        {
+            Utf8Scratch.Add((ANSICHAR)(0xC0 | (CodePoint >> 6)));
+            Utf8Scratch.Add((ANSICHAR)(0x80 | (CodePoint & 0x3F)));
+        }
+        else if (CodePoint < 0x10000)
+        {
+            Utf8Scratch.Add((ANSICHAR)(0xE0 | (CodePoint >> 12)));
+            Utf8Scratch.Add((ANSICHAR)(0x80 | ((CodePoint >> 6) & 0x3F)));
+            Utf8Scratch.Add((ANSICHAR)(0x80 | (CodePoint & 0x3F)));
+        }
+        else
+        {
+            Utf8Scratch.Add((ANSICHAR)(0xF0 | (CodePoint >> 18)));
+            Utf8Scratch.Add((ANSICHAR)(0x80 | ((CodePoint >> 12) & 0x3F)));
+            Utf8Scratch.Add((ANSICHAR)(0x80 | ((CodePoint >> 6) & 0x3F)));
+            Utf8Scratch.Add((ANSICHAR)(0x80 | (CodePoint & 0x3F)));
+        }
+    }
+
+    //Decodes a raw string in to TextScratch, which is null terminated.  Returns the length
+    int32 DecodeString(const ANSICHAR *Start, int32 Length, bool HasEscapes)
+    {
+        TextScratch.Reset();
+
+        //Most values are plain ASCII and can be widened directly
+        bool IsAscii = !HasEscapes;
+        for (int32 i = 0; IsAscii && i < Length; i++)
+        {
+            IsAscii = (uint8)Start[i] < 0x80;
+        }
+
+        if (IsAscii)
+        {
+            TextScratch.AddUninitialized(Length + 1);
+            for (int32 i = 0; i < Length; i++)
+            {
+                TextScratch[i] = (TCHAR)Start[i];
+            }
+            TextScratch[Length] = TEXT('\0');
+            return Length;
+        }
+
+        Utf8Scratch.Reset();
+        for (int32 i = 0; i < Length; i++)
+        {
+            if (Start[i] != '\\' || i + 1 >= Length)
+            {
+                Utf8Scratch.Add(Start[i]);
+                continue;
+            }
+
+            const ANSICHAR Escaped = Start[++i];
+            switch (Escaped)
+            {
+            case 'b': Utf8Scratch.Add('\b'); break;
+            case 'f': Utf8Scratch.Add('\f'); break;
+            case 'n': Utf8Scratch.Add('\n'); break;
+            case 'r': Utf8Scratch.Add('\r'); break;
+            case 't': Utf8Scratch.Add('\t'); break;
+            case 'u':
+            {
+                uint32 CodePoint;
+                if (i + 4 < Length && ReadHex4(Start + i + 1, CodePoint))
+                {
+                    i += 4;
+
+                    //Combine surrogate pairs
+                    uint32 Low;
+                    if (CodePoint >= 0xD800 && CodePoint <= 0xDBFF && i + 6 < Length && Start[i + 1] == '\\' && Start[i + 2] == 'u' &&
+                        ReadHex4(Start + i + 3, Low) && Low >= 0xDC00 && Low <= 0xDFFF)
+                    {
+                        CodePoint = 0x10000 + ((CodePoint - 0xD800) << 10) + (Low - 0xDC00);
+                        i += 6;
+                    }
+
+                    AppendUtf8(CodePoint);
+                }
+                break;
+            }
+            default:
+                //Covers \" \\ and \/
+                Utf8Scratch.Add(Escaped);
+                break;
+            }
+        }
+
+        FUTF8ToTCHAR Converted(Utf8Scratch.GetData(), Utf8Scratch.Num());
+        TextScratch.Append(Converted.Get(), Converted.Length());
+        TextScratch.Add(TEXT('\0'));
+        return Converted.Length();
+    }
+
+    bool ReadString(FString &OutString)
+    {
+        const ANSICHAR *Start;
+        int32 Length;
+        bool HasEscapes;
+        if (!ReadRawString(Start, Length, HasEscapes))
+        {
+            return false;
+        }
+
+        const int32 TextLength = DecodeString(Start, Length, HasEscapes);
+        OutString = FString(TextLength, TextScratch.GetData());
+        return true;
+    }
+
+    bool ReadNumber(double &OutValue)
+    {
+        SkipWhitespace();
+
+        const ANSICHAR *Start = Current;
+        bool IsInteger = true;
+        while (Current < End)
+        {
+            const ANSICHAR Char = *Current;
+            if (Char == '.' || Char == 'e' || Char == 'E' || Char == '+')
+            {
+                IsInteger = false;
+            }
+            else if (!(Char >= '0' && Char <= '9') && Char != '-')
+            {
+                break;
+            }
+            Current++;
+        }
+
+        const int32 Length = (int32)(Current - Start);
+        if (Length == 0)
+        {
+            return false;
+        }
+
+        //Short integers are exact in a double and do not need the general conversion
+        if (IsInteger && Length <= 15)
+        {
+            const bool Negative = (*Start == '-');
+            int64 Value = 0;
+            for (const ANSICHAR *Digit = Negative ? Start + 1 : Start; Digit < Current; Digit++)
+            {
+                if (*Digit < '0' || *Digit > '9')
+                {
+                    return false;
+                }
+                Value = Value * 10 + (*Digit - '0');
+            }
+
+            OutValue = (double)(Negative ? -Value : Value);
+            return true;
+        }
+
+        ANSICHAR Text[64];
+        if (Length >= ARRAY_COUNT(Text))
+        {
+            return false;
+        }
+
+        FMemory::Memcpy(Text, Start, Length);
+        Text[Length] = '\0';
+        OutValue = FCStringAnsi::Atod(Text);
+        return true;
+    }
+
+    bool ReadLiteral(const ANSICHAR *Literal)
+    {
+        SkipWhitespace();
+
+        const int32 Length = FCStringAnsi::Strlen(Literal);
+        if (End - Current < Length || FCStringAnsi::Strncmp(Current, Literal, Length) != 0)
+        {
+            return false;
+        }
+
+        Current += Length;
+        return true;
+    }
+
+    bool SkipValue()
+    {
+        switch (Peek())
+        {
+        case '"':
+        {
+            const ANSICHAR *Start;
+            int32 Length;
+            bool HasEscapes;
+            return ReadRawString(Start, Length, HasEscapes);
+        }
+        case '{':
+            Current++;
+            return ReadMembers([this](const ANSICHAR *, int32) { return SkipValue(); });
+        case '[':
+            Current++;
+            return ReadElements([this]() { return SkipValue(); });
+        case 't':
+            return ReadLiteral("true");
+        case 'f':
+            return ReadLiteral("false");
+        case 'n':
+            return ReadLiteral("null");
+        default:
+        {
+            double Unused;
+            return ReadNumber(Unused);
+        }
+        }
+    }
+
+    //Calls ReadElement for each value in an array.  The opening bracket is already read
+    template<typename FunctionType>
+    bool ReadElements(FunctionType ReadElement)
+    {
+        if (Expect(']'))
+        {
+            return true;
+        }
+
+        do
+        {
+            if (!ReadElement())
+            {
+                return false;
+            }
+        }
+        while (Expect(','));
+
+        return Expect(']');
+    }
+
+    bool BeginResponse()
+    {
+        //Skip a UTF-8 byte order mark
+        if (End - Current >= 3 && (uint8)Current[0] == 0xEF && (uint8)Current[1] == 0xBB && (uint8)Current[2] == 0xBF)
+        {
+            Current += 3;
+        }
+
+        return Expect('{');
+    }
+
+    bool ReadHeader(SQueryResult &OutResult)
+    {
+        if (!Expect('{'))
+        {
+            return SkipValue();
+        }
+
+        return ReadMembers([this, &OutResult](const ANSICHAR *Key, int32 KeyLength)
+        {
+            double Number;
+
+            if (IsKey(Key, KeyLength, "Success"))
+            {
+                OutResult.Header.Success = (Peek() == 't');
+                return SkipValue();
+            }
+            else if (IsKey(Key, KeyLength, "Count") && Peek() != 'n')
+            {
+                if (!ReadNumber(Number)) return false;
+                OutResult.Header.Count = (int)Number;
+                return true;
+            }
+            else if (IsKey(Key, KeyLength, "QueryTime") && Peek() != 'n')
+            {
+                if (!ReadNumber(Number)) return false;
+                OutResult.Header.QueryTime = (long)Number;
+                return true;
+            }
+            else if (IsKey(Key, KeyLength, "ContinuationToken") && Peek() == '"')
+            {
+                return ReadString(OutResult.Header.ContinuationToken);
+            }
+
+            return SkipValue();
+        });
+    }
+
+    //Finds the name entry for a key.  Events usually repeat the same names in the same order, so the entry after the
+    //previous match is tried first
+    const FKeyEntry &ResolveKey(const ANSICHAR *Key, int32 KeyLength, bool HasEscapes)
+    {
+        auto Matches = [Key, KeyLength](const FKeyEntry &Entry)
+        {
+            return Entry.Bytes.Num() == KeyLength && FMemory::Memcmp(Entry.Bytes.GetData(), Key, KeyLength) == 0;
+        };
+
+        if (Keys.IsValidIndex(NextKeyHint) && Matches(Keys[NextKeyHint]))
+        {
+            return Keys[NextKeyHint++];
+        }
+
+        for (int32 i = 0; i < Keys.Num(); i++)
+        {
+            if (Matches(Keys[i]))
+            {
+                NextKeyHint = i + 1;
+                return Keys[i];
+            }
+        }
+
+        FKeyEntry &Entry = Keys[Keys.AddDefaulted()];
+        Entry.Bytes.Append(Key, KeyLength);
+        Entry.Name = FString(DecodeString(Key, KeyLength, HasEscapes), TextScratch.GetData());
+        Entry.Field = EQueryResultField::Other;
+
+        for (const auto &Known : KnownFields)
+        {
+            if (Entry.Name == Known.Name)
+            {
+                Entry.Field = Known.Field;
+                break;
+            }
+        }
+
+        NextKeyHint = Keys.Num();
+        return Entry;
+    }
+
+    bool ReadEvent()
+    {
+        if (!Expect('{'))
+        {
+            return SkipValue();
+        }
+
+        Sink.BeginEvent();
+        NextKeyHint = 0;
+
+        const bool Success = ReadMembers([this](const ANSICHAR *RawKey, int32 RawKeyLength)
+        {
+            //The key is looked up before reading the value, since decoding the value reuses the scratch buffers
+            bool KeyHasEscapes = false;
+            for (int32 i = 0; i < RawKeyLength && !KeyHasEscapes; i++)
+            {
+                KeyHasEscapes = RawKey[i] == '\\';
+            }
+
+            const FKeyEntry &Key = ResolveKey(RawKey, RawKeyLength, KeyHasEscapes);
+
+            switch (Peek())
+            {
+            case '"':
+            {
+                const ANSICHAR *Start;
+                int32 Length;
+                bool HasEscapes;
+                if (!ReadRawString(Start, Length, HasEscapes)) return false;
+
+                const int32 TextLength = DecodeString(Start, Length, HasEscapes);
+                Sink.SetString(Key.Field, Key.Name, TextScratch.GetData(), TextLength);
+                return true;
+            }
+            case 't':
+            case 'f':
+            {
+                const bool Value = (Peek() == 't');
+                if (!ReadLiteral(Value ? "true" : "false")) return false;
+
+                Sink.SetBool(Key.Field, Key.Name, Value);
+                return true;
+            }
+            case 'n':
+            case '{':
+            case '[':
+                return SkipValue();
+            default:
+            {
+                double Value;
+                if (!ReadNumber(Value)) return false;
+
+                Sink.SetNumber(Key.Field, Key.Name, Value);
+                return true;
+            }
+            }
+        });
+
+        Sink.EndEvent();
+        return Success;
+    }
+
+    bool ReadEvents(SQueryResult &OutResult)
+    {
+        if (!Expect('['))
+        {
+            return SkipValue();
+        }
+
+        return ReadElements([this, &OutResult]()
+        {
+            //Entries that are not objects are skipped, so only events given to the sink are counted
+            if (Peek() != '{')
+            {
+                return SkipValue();
+            }
+
+            OutResult.EventCount++;
+            return ReadEvent();
+        });
+    }
+
+private:
+    const ANSICHAR *Current;
+    const ANSICHAR *End;
+    IQueryResultSink &Sink;
+
+    TArray<FKeyEntry> Keys;
+    int32 NextKeyHint;
+
+    TArray<ANSICHAR> Utf8Scratch;
+    TArray<TCHAR> TextScratch;
+};
+
+//Fills FSimpleEvent attributes for callers that do not provide their own sink
+class FSimpleEventSink : public IQueryResultSink
+{
+public:
+    FSimpleEventSink(TArray<FSimpleEvent> &Events) : Events(Events), Current(nullptr) {}
+
+    void BeginEvent() override
+    {
+        Current = &Events[Events.AddDefaulted()];
+    }
+
+    void EndEvent() override
+    {
+        Current = nullptr;
+    }
+
+    void SetNumber(EQueryResultField Field, const FString &Name, double Value) override
+    {
+        Current->SetAttribute(Name, FJsonValueUtil::Create(Value));
+    }
+
+    void SetString(EQueryResultField Field, const FString &Name, const TCHAR *Value, int32 Length) override
+    {
+        Current->SetAttribute(Name, FJsonValueUtil::Create(FString(Length, Value)));
+    }
+
+    void SetBool(EQueryResultField Field, const FString &Name, bool Value) override
+    {
+        Current->SetAttribute(Name, MakeShareable(new FJsonValueBoolean(Value)));
+    }
+
+private:
+    TArray<FSimpleEvent> &Events;
+    FSimpleEvent *Current;
+};
+
+bool FQueryResultReader::Read(const uint8 *Data, int32 Size, SQueryResult &OutResult, IQueryResultSink &Sink)
+{
+    FQueryResponseTokenizer Tokenizer(Data, Size, Sink);
+    return Tokenizer.Read(OutResult);
+}
+
+int32 FQueryResultReader::ReadLines(const uint8 *Data, int32 Size, IQueryResultSink &Sink, int32 &OutSkipped)
+{
+    FQueryResponseTokenizer Tokenizer(Data, Size, Sink);
+    return Tokenizer.ReadLines(OutSkipped);
+}
+
+bool FQueryResultReader::Read(const uint8 *Data, int32 Size, SQueryResult &OutResult)
+{
+    FSimpleEventSink Sink(OutResult.Events);
+    return Read(Data, Size, OutResult, Sink);
+}
+
+bool FQueryResultReader::ReadHeader(const uint8 *Data, int32 Size, SQueryResult &OutResult)
+{
+    FQueryDiscardSink Sink;
+    FQueryResponseTokenizer Tokenizer(Data, Size, Sink);
+    return Tokenizer.ReadHeaderOnly(OutResult);
+}
+
+//Compares the Json DOM path against the streaming reader on a saved query response
+static void CompareQueryReaders(const TArray<FString> &Args)
+{
+    TArray<uint8> Content;
+    if (Args.Num() < 1 || !FFileHelper::LoadFileToArray(Content, *Args[0]))
+    {
+        UE_LOG(LogTelemetryVisualizer, Warning, TEXT("Usage: Telemetry.CompareQueryReaders <saved query response>"));
+        return;
+    }
+
+    int32 DomEvents = 0;
+    int32 StreamEvents = 0;
+    int32 StreamCounted = 0;
+
+    const int64 DomMemoryStart = (int64)FPlatformMemory::GetStats().UsedPhysical;
+    const double DomStart = FPlatformTime::Seconds();
+    double DomTime;
+    int64 DomMemory;
+    {
+        TArray<SEventEditorContainer> Collection;
+
+        FUTF8ToTCHAR Text((const ANSICHAR *)Content.GetData(), Content.Num());
+        TSharedPtr<SQueryResult> Result = SQueryResult::Parse(FString(Text.Length(), Text.Get()));
+
+        for (FSimpleEvent &Event : Result->Events)
+        {
+            const FString Name = Event.GetName();
+            SEventEditorContainer *Container = Collection.FindByPredicate([&Name](const SEventEditorContainer &Each) { return Each.eventname == Name; });
+            if (Container == nullptr)
+            {
+                Container = &Collection[Collection.Emplace(SEventEditorContainer(Name, Collection.Num()))];
+            }
+
+            Container->AddEvent(Event);
+            DomEvents++;
+        }
+
+        DomTime = FPlatformTime::Seconds() - DomStart;
+        DomMemory = (int64)FPlatformMemory::GetStats().UsedPhysical - DomMemoryStart;
+    }
+
+    const int64 StreamMemoryStart = (int64)FPlatformMemory::GetStats().UsedPhysical;
+    const double StreamStart = FPlatformTime::Seconds();
+    double StreamTime;
+    int64 StreamMemory;
+    {
+        FEventCollectionBuilder Builder;
+
+        SQueryResult Result;
+        FQueryResultReader::Read(Content.GetData(), Content.Num(), Result, Builder);
+        Builder.EndPage();
+        StreamCounted = Result.EventCount;
+
+        StreamTime = FPlatformTime::Seconds() - StreamStart;
+        StreamMemory = (int64)FPlatformMemory::GetStats().UsedPhysical - StreamMemoryStart;
+
+        for (const SEventEditorContainer &Container : Builder.GetCollection())
+        {
+            StreamEvents += Container.Num();
+        }
+    }
+
+    UE_LOG(LogTelemetryVisualizer, Log, TEXT("Json DOM: %d events in %.1f ms, %.1f MB held while grouped"), DomEvents, DomTime * 1000.0, DomMemory / (1024.0 * 1024.0));
+    UE_LOG(LogTelemetryVisualizer, Log, TEXT("Streaming reader: %d events in %.1f ms, %.1f MB held while grouped"), StreamEvents, StreamTime * 1000.0, StreamMemory / (1024.0 * 1024.0));
+
+    if (StreamCounted != StreamEvents || StreamEvents != DomEvents)
+    {
+        UE_LOG(LogTelemetryVisualizer, Warning, TEXT("Readers disagree: Json DOM grouped %d events, streaming reader grouped %d and counted %d"), DomEvents, StreamEvents, StreamCounted);
+    }
+}
+
+static FAutoConsoleCommand CompareQueryReadersCommand(
+    TEXT("Telemetry.CompareQueryReaders"),
+    TEXT("Reads a saved query response with the Json DOM and with the streaming reader, and logs the time and memory of each"),
+    FConsoleCommandWithArgsDelegate::CreateStatic(&CompareQueryReaders));
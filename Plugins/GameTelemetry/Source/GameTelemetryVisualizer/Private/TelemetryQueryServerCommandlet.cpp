@@ -0,0 +1,114 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//--------------------------------------------------------------------------------------
+// TelemetryQueryServerCommandlet.cpp
+//
+// Headless local query server, for benchmarking without a backend
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "TelemetryQueryServerCommandlet.h"
+#include "Query/TelemetryLocalServer.h"
+#include "Query/TelemetryLocalHttpServer.h"
+#include "TelemetryVisualizerModule.h"
+#include "Misc/Parse.h"
+
+//Seconds between reports of the requests answered
+static const double ReportInterval = 10.0;
+
+UTelemetryQueryServerCommandlet::UTelemetryQueryServerCommandlet(const FObjectInitializer& ObjectInitializer)
+    : Super(ObjectInitializer)
+{
+    IsClient = false;
+    IsEditor = false;
+    IsServer = false;
+    LogToConsole = true;
+}
+
+int32 UTelemetryQueryServerCommandlet::Main(const FString &Params)
+{
+    FTelemetryLocalServer &Server = FTelemetryLocalServer::Get();
+
+    int32 Port = 8080;
+    FParse::Value(*Params, TEXT("port="), Port);
+
+    FTelemetryDatasetOptions Dataset;
+    Dataset.Count = 0;
+    FParse::Value(*Params, TEXT("generate="), Dataset.Count);
+    FParse::Value(*Params, TEXT("sessions="), Dataset.Sessions);
+    FParse::Value(*Params, TEXT("clusters="), Dataset.Clusters);
+    FParse::Value(*Params, TEXT("days="), Dataset.Days);
+    FParse::Value(*Params, TEXT("seed="), Dataset.Seed);
+
+    int32 MaxEvents = 0;
+    if (FParse::Value(*Params, TEXT("max="), MaxEvents) || Dataset.Count > 0)
+    {
+        Server.SetMaxEvents(FMath::Max(MaxEvents, Dataset.Count));
+    }
+
+    FString StorePath;
+    if (FParse::Value(*Params, TEXT("store="), StorePath) && !Server.OpenStore(StorePath))
+    {
+        UE_LOG(LogTelemetryVisualizer, Error, TEXT("Unable to open the event store %s"), *StorePath);
+        return 1;
+    }
+
+    FString LoadPath;
+    if (FParse::Value(*Params, TEXT("load="), LoadPath) && !Server.LoadFile(LoadPath))
+    {
+        UE_LOG(LogTelemetryVisualizer, Error, TEXT("Unable to load the query response %s"), *LoadPath);
+        return 1;
+    }
+
+    if (Dataset.Count > 0)
+    {
+        Server.GenerateDataset(Dataset);
+    }
+
+    float Latency = 0.f;
+    float LatencyPerThousand = 0.f;
+    FParse::Value(*Params, TEXT("latency="), Latency);
+    FParse::Value(*Params, TEXT("latencyperthousand="), LatencyPerThousand);
+    Server.SetLatency(Latency, LatencyPerThousand);
+
+    float Rate = 0.f;
+    FParse::Value(*Params, TEXT("rate="), Rate);
+    Server.SetGenerateRate(Rate);
+
+    FTelemetryLocalHttpServer HttpServer(Server);
+    if (!HttpServer.Start(Port))
+    {
+        UE_LOG(LogTelemetryVisualizer, Error, TEXT("Unable to listen on port %d"), Port);
+        return 1;
+    }
+
+    UE_LOG(LogTelemetryVisualizer, Display, TEXT("Serving %d events at http://127.0.0.1:%d/api/query and /api/ingest"), Server.Num(), Port);
+
+    float Duration = 0.f;
+    FParse::Value(*Params, TEXT("duration="), Duration);
+
+    const double StartTime = FPlatformTime::Seconds();
+    double LastReport = StartTime;
+    int32 LastRequests = 0;
+
+    while (!GIsRequestingExit && (Duration <= 0.f || FPlatformTime::Seconds() - StartTime < Duration))
+    {
+        FPlatformProcess::Sleep(0.1f);
+
+        const double Now = FPlatformTime::Seconds();
+        if (Now - LastReport >= ReportInterval)
+        {
+            const int32 Requests = HttpServer.GetNumRequests();
+            UE_LOG(LogTelemetryVisualizer, Display, TEXT("%d requests in the last %.0f s, %d events held"), Requests - LastRequests, Now - LastReport, Server.Num());
+
+            LastReport = Now;
+            LastRequests = Requests;
+        }
+    }
+
+    HttpServer.Stop();
+    UE_LOG(LogTelemetryVisualizer, Display, TEXT("Answered %d requests"), HttpServer.GetNumRequests());
+    return 0;
+}
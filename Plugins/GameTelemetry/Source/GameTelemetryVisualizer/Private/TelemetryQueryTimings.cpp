@@ -0,0 +1,96 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//--------------------------------------------------------------------------------------
+// TelemetryQueryTimings.cpp
+//
+// Where the time of each query went
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "Query/TelemetryQueryTimings.h"
+#include "TelemetryVisualizerModule.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+void FQueryTimingRecord::AddPage(const SQueryResult &Page, double GroupTime)
+{
+    if (Pages == 0)
+    {
+        FirstByte = Page.Timings.FirstByte;
+        Download += Page.Timings.Download;
+    }
+    else
+    {
+        Download += Page.Timings.FirstByte + Page.Timings.Download;
+    }
+
+    Pages++;
+    Events += Page.EventCount;
+    Server += Page.Header.QueryTime;
+    Parse += FMath::Max(Page.Timings.Read - GroupTime, 0.0);
+    Group += GroupTime;
+    Success = Success && Page.Header.Success;
+}
+
+FString FQueryTimingRecord::ToString() const
+{
+    return FString::Printf(TEXT("%d events from %s in %.0f ms: server %.0f, first byte %.0f, download %.0f, parse %.0f, group %.0f, filter %.0f, draw %.0f ms"),
+        Events, *Source, Total, Server, FirstByte, Download, Parse, Group, Filter, Draw);
+}
+
+FQueryTimingHistory &FQueryTimingHistory::Get()
+{
+    static FQueryTimingHistory History;
+    return History;
+}
+
+void FQueryTimingHistory::Add(const FQueryTimingRecord &Record)
+{
+    UE_LOG(LogTelemetryQueryTiming, Log, TEXT("%s%s"), Record.Success ? TEXT("") : TEXT("Failed: "), *Record.ToString());
+    UE_LOG(LogTelemetryQueryTiming, Verbose, TEXT("Query: %s"), *Record.Query);
+
+    if (Records.Num() >= MaxRecords)
+    {
+        Records.RemoveAt(0, Records.Num() - MaxRecords + 1);
+    }
+
+    Records.Add(Record);
+}
+
+bool FQueryTimingHistory::ExportCsv(const FString &Path) const
+{
+    FString Csv = TEXT("started,source,success,pages,events,total_ms,server_ms,first_byte_ms,download_ms,parse_ms,group_ms,filter_ms,draw_ms,query\n");
+
+    for (const FQueryTimingRecord &Record : Records)
+    {
+        Csv += FString::Printf(TEXT("%s,%s,%d,%d,%d,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,\"%s\"\n"),
+            *Record.Started.ToIso8601(), *Record.Source, Record.Success ? 1 : 0, Record.Pages, Record.Events,
+            Record.Total, Record.Server, Record.FirstByte, Record.Download, Record.Parse, Record.Group, Record.Filter, Record.Draw,
+            *Record.Query.Replace(TEXT("\""), TEXT("\"\"")));
+    }
+
+    return FFileHelper::SaveStringToFile(Csv, *Path, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM);
+}
+
+static void ExportQueryTimings(const TArray<FString> &Args)
+{
+    const FString Path = Args.Num() > 0 ? Args[0] : FPaths::ProjectSavedDir() / TEXT("QueryTimings.csv");
+    const FQueryTimingHistory &History = FQueryTimingHistory::Get();
+
+    if (History.ExportCsv(Path))
+    {
+        UE_LOG(LogTelemetryQueryTiming, Log, TEXT("Wrote the timings of %d queries to %s"), History.GetRecords().Num(), *Path);
+    }
+    else
+    {
+        UE_LOG(LogTelemetryQueryTiming, Warning, TEXT("Unable to write %s"), *Path);
+    }
+}
+
+static FAutoConsoleCommand ExportQueryTimingsCommand(
+    TEXT("Telemetry.ExportQueryTimings"),
+    TEXT("Writes the phase timings of recent queries to a csv file, Saved/QueryTimings.csv by default"),
+    FConsoleCommandWithArgsDelegate::CreateStatic(&ExportQueryTimings));
@@ -12,6 +12,8 @@
 #pragma once
 
 #include "TelemetryVisualizerUI.h"
+#include "DesktopPlatformModule.h"
+#include "IDesktopPlatform.h"
 
 #define LOCTEXT_NAMESPACE "Telemetry"
 
@@ -20,7 +22,22 @@ TSharedRef<SDockTab> FTelemetryVisualizerUI::SpawnDataTab(const FSpawnTabArgs& T
 {
     //Handler for query returns
     m_queryResultHandler.BindRaw(this, &FTelemetryVisualizerUI::QueryResults);
+    m_liveResultHandler.BindRaw(this, &FTelemetryVisualizerUI::LiveQueryResults);
+    m_queryExecuter.SetProgressHandler(QueryProgressHandler::CreateRaw(this, &FTelemetryVisualizerUI::QueryProgress));
+
+    //Event queries are read in to grouped events, which can be built straight from columnar responses
+    m_queryExecuter.SetAllowColumnResponses(true);
     m_isWaiting = false;
+    m_isTimingQuery = false;
+    m_isTimingDraw = false;
+    m_loadedFromFile = false;
+    m_liveMode = false;
+    m_isLivePolling = false;
+    m_loadedColumns = MakeShareable(new FQueryResultColumns);
+    m_loadedComplete = false;
+    m_livePollInterval = MinLivePollInterval;
+    m_liveNextPoll = 0;
+    m_liveReceived = 0;
 
     TSharedRef<SDockTab> retTab = SNew(SDockTab)
         .Label(LOCTEXT("Data_Viewer", "Data Viewer"))
@@ -94,6 +111,46 @@ TSharedRef<SDockTab> FTelemetryVisualizerUI::SpawnDataTab(const FSpawnTabArgs& T
                                 .OnClicked_Raw(this, &FTelemetryVisualizerUI::SubmitQuery)
                                 .Text_Raw(this, &FTelemetryVisualizerUI::GetButtonString)
                         ]
+                        + SHorizontalBox::Slot()
+                            .Padding(2.f, 0.f, 0.f, 0.f)
+                            .VAlign(VAlign_Center)
+                            .HAlign(HAlign_Fill)
+                        [
+                            SNew(SButton)
+                                .HAlign(HAlign_Center)
+                                .VAlign(VAlign_Center)
+                                .IsEnabled_Lambda([this]() { return m_isWaiting; })
+                                .OnClicked_Raw(this, &FTelemetryVisualizerUI::CancelQuery)
+                                .Text(LOCTEXT("Cancel", "Cancel"))
+                        ]
+                        + SHorizontalBox::Slot()
+                            .Padding(2.f, 0.f, 0.f, 0.f)
+                            .VAlign(VAlign_Center)
+                            .HAlign(HAlign_Fill)
+                        [
+                            SNew(SButton)
+                                .HAlign(HAlign_Center)
+                                .VAlign(VAlign_Center)
+                                .OnClicked_Raw(this, &FTelemetryVisualizerUI::ImportFile)
+                                .Text(LOCTEXT("Import_File", "Import File"))
+                        ]
+                        + SHorizontalBox::Slot()
+                            .AutoWidth()
+                            .Padding(6.f, 0.f, 0.f, 0.f)
+                            .VAlign(VAlign_Center)
+                        [
+                            SNew(SCheckBox)
+                                .IsChecked_Lambda([this]() -> ECheckBoxState
+                                {
+                                    if (m_liveMode) return ECheckBoxState::Checked;
+                                    return ECheckBoxState::Unchecked;
+                                })
+                                .OnCheckStateChanged_Raw(this, &FTelemetryVisualizerUI::OnLiveChecked)
+                            [
+                                SNew(STextBlock)
+                                    .Text(LOCTEXT("Live", "Live"))
+                            ]
+                        ]
                     ]
                 ]
             ]
@@ -706,7 +763,7 @@ FReply FTelemetryVisualizerUI::SubmitQuery()
         }
         else if (m_queryCollection[i].Value.IsNumeric())
         {
-            finalValue = FJsonValueUtil::Create(FCString::Atof(*m_queryCollection[i].Value));
+            finalValue = FJsonValueUtil::Create(FCString::Atod(*m_queryCollection[i].Value));
         }
         else
         {
@@ -859,51 +916,669 @@ void FTelemetryVisualizerUI::UpdateClauseValue(const FText& text, int index)
     return;
 }
 
-//Call to execute query
+//Call to execute query.  A query still running is replaced, and none of its pages are shown after this
 void FTelemetryVisualizerUI::CollectEvents(FQueryNodePtr query)
 {
-    if (!m_isWaiting)
+    if (m_isWaiting)
+    {
+        StopQuery();
+    }
+
+    //A new query replaces any live update in flight.  Pages it already merged are not in the loaded columns
+    if (m_isLivePolling)
+    {
+        m_queryExecuter.CancelQuery();
+        m_isLivePolling = false;
+        m_loadedComplete = m_loadedComplete && m_liveReceived == 0;
+    }
+
+    //Sent in canonical form, so the same query built in another order shares its cache entry
+    query = FQueryOptimizer::Optimize(query);
+
+    m_isWaiting = true;
+    m_liveQuery = query;
+    BeginQueryTiming(m_querySerializer.Serialize(query), TEXT("server"));
+
+    //A query that can match nothing is answered without the server
+    if (FQueryOptimizer::IsEmpty(query))
+    {
+        m_queryTiming.Source = TEXT("local");
+
+        TSharedPtr<SQueryResult> result = MakeShareable(new SQueryResult);
+        result->Sink = MakeShareable(new FEventCollectionBuilder());
+        result->Header.Success = true;
+        result->IsComplete = true;
+        QueryResults(result);
+
+        if (m_messageText.IsValid())
+        {
+            m_messageText->SetText(LOCTEXT("Query_Empty", "No event can match this query"));
+        }
+        return;
+    }
+
+    TArray<FString> columns = GetQueryColumns();
+
+    //Queries that only narrow the last complete result are answered from its columns, as long as they hold
+    //every field that is shown
+    bool hasColumns = m_loadedProjection.Num() == 0;
+    if (!hasColumns)
+    {
+        hasColumns = true;
+        for (auto& column : columns)
+        {
+            hasColumns = hasColumns && m_loadedProjection.Contains(column);
+        }
+    }
+
+    if (m_loadedComplete && hasColumns && FQueryEvaluator::IsNarrowing(query, m_loadedQuery))
+    {
+        TSharedPtr<FQueryEvaluator> evaluator = FQueryEvaluator::Compile(query, *m_loadedColumns, &m_loadedProjection);
+
+        if (evaluator.IsValid())
+        {
+            m_queryTiming.Source = TEXT("local");
+            RefineEvents(query, evaluator);
+            return;
+        }
+    }
+
+    m_loadedComplete = false;
+    m_loadedFromFile = false;
+    m_queryColumns = columns;
+    AsyncTask(ENamedThreads::GameThread, [this, query, columns]()
+    {
+        //Cancelled or replaced before it started
+        if (!m_isWaiting || m_liveQuery != query)
+        {
+            return;
+        }
+
+        //Each page is read and grouped on a worker thread by its own builder, which also keeps its columns.
+        //Only the fields drawn are requested, and the rest of an event is fetched when it is selected.
+        //Queries over a time range are split in to the configured number of shards, whose pages still arrive
+        //newest first
+        m_queryHandle = m_queryExecuter.ExecuteShardedQuery(query, -1, m_queryResultHandler, -1, []()
+        {
+            return TSharedRef<IQueryResultSink>(MakeShareable(new FEventCollectionBuilder(true)));
+        }, true, columns);
+    });
+}
+
+//Fields the server is asked for: those needed to draw events, plus the attribute a value heatmap is built from
+TArray<FString> FTelemetryVisualizerUI::GetQueryColumns() const
+{
+    TArray<FString> columns = QueryViewportColumns;
+
+    if ((m_heatmapType == HeatmapType::Value || m_heatmapType == HeatmapType::Value_Bar) && m_subVizSelection.IsValid() && !m_subVizSelection->IsEmpty())
+    {
+        columns.Add(*m_subVizSelection);
+    }
+
+    return columns;
+}
+
+//Events are fetched without their attributes, so the names offered for value heatmaps come from one page of the
+//group with every field
+void FTelemetryVisualizerUI::RequestAttributeNames(const FString& eventName)
+{
+    if (m_queryColumns.Num() == 0 || !m_liveQuery.IsValid() || m_sampledGroups.Contains(eventName))
+    {
+        return;
+    }
+
+    m_sampledGroups.Add(eventName);
+
+    FQueryNodeList nodes;
+    nodes.Add(m_liveQuery);
+    nodes.Add(QBuilder::Eq(TEXT("name"), eventName));
+
+    m_attributeExecuter.CancelQuery();
+    m_attributeExecuter.ExecuteCustomQuery(m_querySerializer.Serialize(FQueryOptimizer::Optimize(QBuilder::And(MoveTemp(nodes)))), QueryResultHandler::CreateLambda([this, eventName](TSharedPtr<SQueryResult> results)
+    {
+        //The first page is enough to find the names in use
+        m_attributeExecuter.CancelQuery();
+
+        SEventEditorContainer* group = m_queryEventCollection.FindByPredicate([&eventName](const SEventEditorContainer& each) { return each.eventname == eventName; });
+        if (group == nullptr)
+        {
+            return;
+        }
+
+        for (auto& event : results->Events)
+        {
+            TMap<FString, TSharedPtr<FJsonValue>> attributes;
+            event.GetAttributes(attributes);
+
+            for (auto& attr : attributes)
+            {
+                if (group->FindAttribute(attr.Key) != INDEX_NONE)
+                {
+                    continue;
+                }
+
+                //The loaded events were fetched without it, so they hold NaN until a query fetches it
+                group->AddAttribute(attr.Key);
+
+                //Offered straight away if the group is still selected, keeping the current choice
+                if (m_vizSelection.IsValid() && *m_vizSelection == eventName)
+                {
+                    m_eventgroupSubList.Add(MakeShareable<FString>(new FString(attr.Key)));
+                }
+            }
+        }
+
+        if (m_vizSubChoice.IsValid())
+        {
+            m_vizSubChoice->RefreshOptions();
+        }
+    }), AttributeSampleSize, FQueryResultSinkFactory(), false);
+}
+
+//Filters the loaded columns on a worker thread and shows the matching events as the result of query.
+//The worker holds its own reference to the columns, which are copied before they are changed while it runs, so a
+//query that replaces this one does not have to wait for it.
+void FTelemetryVisualizerUI::RefineEvents(FQueryNodePtr query, TSharedPtr<FQueryEvaluator> evaluator)
+{
+    const double startTime = FPlatformTime::Seconds();
+    TSharedPtr<FQueryResultColumns, ESPMode::ThreadSafe> loadedColumns = m_loadedColumns;
+
+    Async<void>(EAsyncExecution::ThreadPool, [this, query, evaluator, loadedColumns, startTime]()
     {
-        m_isWaiting = true;
-        AsyncTask(ENamedThreads::GameThread, [this, query]()
+        TArray<uint8> mask;
+        evaluator->Evaluate(mask);
+        const double filterTime = (FPlatformTime::Seconds() - startTime) * 1000;
+
+        TSharedPtr<FEventCollectionBuilder> builder = MakeShareable(new FEventCollectionBuilder());
+        builder->BeginPage(0);
+        loadedColumns->Replay(*builder, &mask);
+        builder->EndPage();
+
+        TSharedPtr<SQueryResult> result = MakeShareable(new SQueryResult);
+        result->Sink = builder;
+        result->Header.Success = true;
+        result->Header.QueryTime = (FPlatformTime::Seconds() - startTime) * 1000;
+
+        for (uint8 match : mask)
+        {
+            result->EventCount += match;
+        }
+
+        result->Header.Count = result->EventCount;
+        result->IsComplete = true;
+
+        AsyncTask(ENamedThreads::GameThread, [this, query, result, filterTime]()
         {
-            m_queryExecuter.ExecuteCustomQuery(m_querySerializer.Serialize(query), m_queryResultHandler);
+            //Cancelled or replaced while filtering
+            if (!m_isWaiting || m_liveQuery != query)
+            {
+                return;
+            }
+
+            m_queryTiming.Filter += filterTime;
+
+            QueryResults(result);
+
+            if (m_messageText.IsValid())
+            {
+                m_messageText->SetText(FText::Format(LOCTEXT("Event_Count_Local", "Found {0} events (filtered locally in {1} ms)"), FText::AsNumber(result->EventCount), FText::AsNumber((int32)result->Header.QueryTime)));
+            }
         });
+    });
+}
+
+//Stops the running query, keeping any pages that already arrived
+FReply FTelemetryVisualizerUI::CancelQuery()
+{
+    if (m_isWaiting)
+    {
+        StopQuery();
+
+        if (m_messageText.IsValid())
+        {
+            m_messageText->SetText(LOCTEXT("Query_Cancelled", "Query cancelled"));
+        }
     }
+
+    return FReply::Handled();
 }
 
-//Called when the query request completes.  Converts results to a local collection
-void FTelemetryVisualizerUI::QueryResults(TSharedPtr<SQueryResult> results)
+//Stops whatever m_isWaiting is set for: a server query, an import or local filtering, whose results are dropped
+//when they arrive
+void FTelemetryVisualizerUI::StopQuery()
 {
-    m_queryEventCollection.Empty();
+    m_queryHandle.Cancel();
 
-    FString currentName;
+    if (m_fileImport.IsValid())
+    {
+        m_fileImport->Cancel();
+        m_fileImport.Reset();
+    }
+
+    m_isWaiting = false;
+    m_heatmapPending = false;
+    m_isTimingQuery = false;
+    m_isTimingDraw = false;
+}
+
+//Starts recording the phases of a query, replacing any record that was not finished
+void FTelemetryVisualizerUI::BeginQueryTiming(const FString& query, const FString& source)
+{
+    m_queryTiming = FQueryTimingRecord();
+    m_queryTiming.Started = FDateTime::UtcNow();
+    m_queryTiming.Query = query;
+    m_queryTiming.Source = source;
+    m_queryTimingStart = FPlatformTime::Seconds();
+    m_isTimingQuery = true;
+    m_isTimingDraw = false;
+}
+
+//Called once the events of the last page are drawn.  Adds the record to the history and shows it under the status
+void FTelemetryVisualizerUI::FinishQueryTiming()
+{
+    m_queryTiming.Total = (FPlatformTime::Seconds() - m_queryTimingStart) * 1000;
+    m_isTimingQuery = false;
+    m_isTimingDraw = false;
+
+    FQueryTimingHistory::Get().Add(m_queryTiming);
 
-    for (auto newEvent : results->Events)
+    if (m_messageText.IsValid())
     {
-        int currentIdx = -1;
-        currentName = newEvent.GetName();
+        m_messageText->SetText(FText::Format(LOCTEXT("Query_Timing", "{0}\n{1}"), m_messageText->GetText(), FText::FromString(m_queryTiming.ToString())));
+    }
+}
 
-        for (int i = 0; i < m_queryEventCollection.Num(); i++)
+//Copy of the loaded columns that may be changed.  They are shared with local filtering while it runs
+FQueryResultColumns& FTelemetryVisualizerUI::GetMutableLoadedColumns()
+{
+    if (!m_loadedColumns.IsUnique())
+    {
+        m_loadedColumns = MakeShareable(new FQueryResultColumns(*m_loadedColumns));
+    }
+
+    return *m_loadedColumns;
+}
+
+//Asks for a file of events to show in place of a query
+FReply FTelemetryVisualizerUI::ImportFile()
+{
+    IDesktopPlatform* desktopPlatform = FDesktopPlatformModule::Get();
+    if (desktopPlatform == nullptr)
+    {
+        return FReply::Handled();
+    }
+
+    TArray<FString> files;
+    const void* parentWindow = FSlateApplication::Get().FindBestParentWindowHandleForDialogs(nullptr);
+
+    if (desktopPlatform->OpenFileDialog(parentWindow, TEXT("Import Telemetry Events"), FPaths::ProjectSavedDir(), TEXT(""),
+        TEXT("Telemetry events (*.tqf;*.json;*.ndjson)|*.tqf;*.json;*.ndjson|All files (*.*)|*.*"), EFileDialogFlags::None, files) && files.Num() > 0)
+    {
+        ImportEventFile(files[0]);
+    }
+
+    return FReply::Handled();
+}
+
+//Reads an event file in to the loaded events.  Pages arrive through QueryResults as a query's would, and the events
+//are treated as the complete result of a query matching everything, so later queries that can be are answered from them
+void FTelemetryVisualizerUI::ImportEventFile(const FString& path)
+{
+    if (m_isWaiting)
+    {
+        StopQuery();
+    }
+
+    if (m_isLivePolling)
+    {
+        m_queryExecuter.CancelQuery();
+        m_isLivePolling = false;
+    }
+
+    m_fileImport = FQueryFileImport::Start(path, m_queryResultHandler, []()
+    {
+        return TSharedRef<IQueryResultSink>(MakeShareable(new FEventCollectionBuilder(true)));
+    });
+
+    if (!m_fileImport.IsValid())
+    {
+        if (m_messageText.IsValid())
+        {
+            m_messageText->SetText(FText::Format(LOCTEXT("Import_Failed", "Unable to open {0}"), FText::FromString(path)));
+        }
+        return;
+    }
+
+    m_isWaiting = true;
+    m_liveMode = false;
+    m_liveQuery = nullptr;
+    BeginQueryTiming(path, TEXT("file"));
+    m_loadedComplete = false;
+    m_loadedFromFile = true;
+    m_queryColumns.Empty();
+
+    if (m_messageText.IsValid())
+    {
+        m_messageText->SetText(FText::Format(LOCTEXT("Import_Started", "Importing {0}..."), FText::FromString(FPaths::GetCleanFilename(path))));
+    }
+}
+
+//Shows how far along the running query is
+void FTelemetryVisualizerUI::QueryProgress(EQueryStage stage, int32 pageIndex, int32 bytesReceived)
+{
+    if (!m_messageText.IsValid())
+    {
+        return;
+    }
+
+    if (stage == EQueryStage::Downloading)
+    {
+        m_messageText->SetText(FText::Format(LOCTEXT("Query_Downloading", "Downloading page {0}: {1} KB"), FText::AsNumber(pageIndex + 1), FText::AsNumber(bytesReceived / 1024)));
+    }
+    else
+    {
+        m_messageText->SetText(FText::Format(LOCTEXT("Query_Reading", "Reading page {0}..."), FText::AsNumber(pageIndex + 1)));
+    }
+}
+
+//Called on the game thread as each page of the query request completes, with the page already read and grouped.
+//The first page replaces the previous query so drawing can start early, and later pages are merged in to it.
+void FTelemetryVisualizerUI::QueryResults(TSharedPtr<SQueryResult> results)
+{
+    //A failed page holds no events and is not merged, so a query that fails on its first page leaves the events
+    //already shown
+    const bool failed = !results->Header.Success;
+    double groupTime = 0;
+
+    if (results->Sink.IsValid() && !failed)
+    {
+        TSharedPtr<FEventCollectionBuilder> builder = StaticCastSharedPtr<FEventCollectionBuilder>(results->Sink);
+        TArray<SEventEditorContainer>& page = builder->GetCollection();
+        const double mergeStart = FPlatformTime::Seconds();
+
+        //Results filtered locally have no columns of their own and leave the loaded ones as they were
+        FQueryResultColumns* columns = builder->GetColumns();
+        if (columns != nullptr)
         {
-            if (m_queryEventCollection[i].eventname == currentName)
+            if (results->PageIndex == 0)
             {
-                currentIdx = i;
-                break;
+                m_loadedColumns = MakeShareable(new FQueryResultColumns(MoveTemp(*columns)));
+                m_loadedQuery = m_liveQuery;
+                m_loadedProjection = m_queryColumns;
+            }
+            else
+            {
+                GetMutableLoadedColumns().Append(*columns);
             }
+
+            m_loadedComplete = results->IsComplete;
         }
 
-        if (currentIdx == -1)
+        if (results->PageIndex == 0)
         {
-            currentIdx = m_queryEventCollection.Emplace(SEventEditorContainer(currentName, m_queryEventCollection.Num()));
+            m_filterCollection.Empty();
+            m_queryEventCollection = MoveTemp(page);
+            m_sampledGroups.Empty();
+        }
+        else
+        {
+            for (auto& group : page)
+            {
+                SEventEditorContainer* existing = m_queryEventCollection.FindByPredicate([&group](const SEventEditorContainer& each) { return each.eventname == group.eventname; });
+
+                if (existing != nullptr)
+                {
+                    existing->Append(group);
+                }
+                else
+                {
+                    group.SetColor(DefaultColors[m_queryEventCollection.Num() % DefaultColors.Num()]);
+                    m_queryEventCollection.Add(MoveTemp(group));
+                }
+            }
+        }
+
+        groupTime = builder->GetGroupTime() + (FPlatformTime::Seconds() - mergeStart) * 1000;
+    }
+
+    if (m_isTimingQuery)
+    {
+        if (results->FromCache)
+        {
+            m_queryTiming.Source = TEXT("cache");
         }
 
-        m_queryEventCollection[currentIdx].AddEvent(newEvent);
+        m_queryTiming.AddPage(*results, groupTime);
     }
 
+    const double filterStart = FPlatformTime::Seconds();
     int count = FilterEvents();
     GenerateScrollBoxes(count);
+
+    if (m_isTimingQuery)
+    {
+        m_queryTiming.Filter += (FPlatformTime::Seconds() - filterStart) * 1000;
+    }
+
+    if (results->FromCache && m_messageText.IsValid())
+    {
+        m_messageText->SetText(FText::Format(LOCTEXT("Event_Count_Cached", "Found {0} events (cached)"), FText::AsNumber(count)));
+    }
+
+    //Live updates continue from the newest event of this query
+    m_liveLastSeen = GetNewestEventTime();
+    m_livePollInterval = MinLivePollInterval;
+    m_liveNextPoll = FPlatformTime::Seconds() + m_livePollInterval;
+
+    if (!results->IsLastPage)
+    {
+        if (m_messageText.IsValid())
+        {
+            m_messageText->SetText(FText::Format(LOCTEXT("Event_Count_Loading", "Found {0} events, loading more..."), FText::AsNumber(count)));
+        }
+        return;
+    }
+
     m_isWaiting = false;
+
+    //Finished once the events are drawn on the next update
+    m_isTimingDraw = m_isTimingQuery;
+
+    if (failed)
+    {
+        m_heatmapPending = false;
+
+        if (m_messageText.IsValid())
+        {
+            m_messageText->SetText(FText::Format(LOCTEXT("Query_Failed", "Query failed, showing {0} events"), FText::AsNumber(count)));
+        }
+    }
+    else if (results->HasFailedShard && m_messageText.IsValid())
+    {
+        m_messageText->SetText(FText::Format(LOCTEXT("Query_Partial", "Part of the query failed, showing {0} events"), FText::AsNumber(count)));
+    }
+
+    //A heatmap that was waiting for its attribute to load
+    if (m_heatmapPending)
+    {
+        m_heatmapPending = false;
+        GenerateHeatmap();
+    }
+}
+
+void FTelemetryVisualizerUI::OnLiveChecked(ECheckBoxState NewState)
+{
+    m_liveMode = (NewState == ECheckBoxState::Checked);
+    m_livePollInterval = MinLivePollInterval;
+    m_liveNextPoll = FPlatformTime::Seconds();
+
+    if (!m_liveMode && m_isLivePolling)
+    {
+        m_queryExecuter.CancelQuery();
+        m_isLivePolling = false;
+        m_loadedComplete = m_loadedComplete && m_liveReceived == 0;
+    }
+}
+
+//Newest event time across all groups, which are each kept newest first
+FDateTime FTelemetryVisualizerUI::GetNewestEventTime() const
+{
+    FDateTime newest = FDateTime::MinValue();
+
+    for (auto& group : m_queryEventCollection)
+    {
+        if (group.Num() > 0 && group.GetTime(0) > newest)
+        {
+            newest = group.GetTime(0);
+        }
+    }
+
+    return newest;
+}
+
+//Called each tick.  Re-issues the last query for events newer than the newest one already shown
+void FTelemetryVisualizerUI::UpdateLiveQuery()
+{
+    if (!m_liveMode || m_isWaiting || m_isLivePolling || m_loadedFromFile || !m_liveQuery.IsValid() || FQueryOptimizer::IsEmpty(m_liveQuery) || FPlatformTime::Seconds() < m_liveNextPoll)
+    {
+        return;
+    }
+
+    FQueryNodeList nodes;
+    nodes.Add(m_liveQuery);
+
+    if (m_liveLastSeen > FDateTime::MinValue())
+    {
+        nodes.Add(QBuilder::Gt(TEXT("client_ts"), m_liveLastSeen.ToIso8601()));
+    }
+
+    m_isLivePolling = true;
+    m_liveReceived = 0;
+
+    //Updates to the loaded query keep its columns current, so later narrower queries still see every event
+    const bool keepColumns = m_loadedComplete && m_liveQuery == m_loadedQuery;
+
+    //Each update is only run once, so it is not worth caching
+    m_queryExecuter.ExecuteCustomQuery(m_querySerializer.Serialize(FQueryOptimizer::Optimize(QBuilder::And(MoveTemp(nodes)))), m_liveResultHandler, -1, [keepColumns]()
+    {
+        return TSharedRef<IQueryResultSink>(MakeShareable(new FEventCollectionBuilder(keepColumns)));
+    }, false, m_queryColumns);
+}
+
+//Merges each page of a live update in to the shown events and spawns actors for only the new events
+void FTelemetryVisualizerUI::LiveQueryResults(TSharedPtr<SQueryResult> results)
+{
+    if (!m_isLivePolling)
+    {
+        return;
+    }
+
+    m_liveReceived += results->EventCount;
+
+    if (results->Sink.IsValid())
+    {
+        //New events of a group that was already shown are drawn from the page, which the builder keeps until this returns
+        struct FNewEvents
+        {
+            FString eventname;
+            const SEventEditorContainer* events;
+            int previousCount;
+        };
+
+        TArray<FNewEvents> newEvents;
+        bool addedGroups = false;
+
+        TSharedPtr<FEventCollectionBuilder> builder = StaticCastSharedPtr<FEventCollectionBuilder>(results->Sink);
+        FQueryResultColumns* columns = builder->GetColumns();
+
+        if (columns != nullptr)
+        {
+            GetMutableLoadedColumns().Append(*columns);
+        }
+        else if (results->EventCount > 0)
+        {
+            //Only the new events of a narrower query were fetched, so the loaded columns are missing newer events
+            m_loadedComplete = false;
+        }
+
+        for (auto& group : builder->GetCollection())
+        {
+            FNewEvents& added = newEvents[newEvents.AddDefaulted()];
+            added.eventname = group.eventname;
+            added.events = nullptr;
+            added.previousCount = 0;
+
+            SEventEditorContainer* existing = m_queryEventCollection.FindByPredicate([&group](const SEventEditorContainer& each) { return each.eventname == group.eventname; });
+
+            if (existing != nullptr)
+            {
+                added.events = &group;
+                added.previousCount = existing->Num();
+                existing->Append(group);
+            }
+            else
+            {
+                group.SetColor(DefaultColors[m_queryEventCollection.Num() % DefaultColors.Num()]);
+                m_queryEventCollection.Add(MoveTemp(group));
+                addedGroups = true;
+            }
+        }
+
+        //Adding groups can move the containers, so the filtered pointers are always rebuilt
+        int count = FilterEvents();
+
+        if (addedGroups)
+        {
+            GenerateScrollBox();
+            GenerateEventBox();
+        }
+
+        //Existing actors are kept.  Only a full redraw that is already pending or a running animation skips this
+        UWorld* drawTarget = GetLocalWorld();
+        if (drawTarget != nullptr && m_anim_Control.IsStopped() && !m_needsActorUpdate)
+        {
+            for (auto& added : newEvents)
+            {
+                SEventEditorContainer** shown = m_filterCollection.FindByPredicate([&added](const SEventEditorContainer* each) { return each->eventname == added.eventname; });
+
+                if (shown != nullptr && (*shown)->ShouldDraw())
+                {
+                    //A new group was moved in whole, so all of its events are new
+                    const SEventEditorContainer& events = added.events != nullptr ? *added.events : **shown;
+
+                    //Names continue after the existing actors of the group so they stay unique
+                    for (int i = 0; i < events.Num(); i++)
+                    {
+                        CreateActor(drawTarget, added.previousCount + i, FTelemetryEventView(events, i), (*shown)->GetColor(), (*shown)->GetShapeType());
+                    }
+                }
+            }
+        }
+
+        if (m_messageText.IsValid())
+        {
+            m_messageText->SetText(FText::Format(LOCTEXT("Event_Count_Live", "Found {0} events, live"), FText::AsNumber(count)));
+        }
+    }
+
+    if (!results->IsLastPage)
+    {
+        return;
+    }
+
+    //Poll faster while events are arriving and back off while they are not
+    if (m_liveReceived > 0)
+    {
+        m_liveLastSeen = GetNewestEventTime();
+        m_livePollInterval = FMath::Max(m_livePollInterval * 0.5f, MinLivePollInterval);
+    }
+    else
+    {
+        m_livePollInterval = FMath::Min(m_livePollInterval * 2.f, MaxLivePollInterval);
+    }
+
+    m_liveNextPoll = FPlatformTime::Seconds() + m_livePollInterval;
+    m_isLivePolling = false;
 }
 
 /////////////////////////////////EVENT COLLECTION/////////////////////////////////
@@ -991,7 +1666,7 @@ int FTelemetryVisualizerUI::FilterEvents()
         for (int i = 0; i < m_queryEventCollection.Num(); i++)
         {
             m_filterCollection.Emplace(&m_queryEventCollection[i]);
-            count += m_queryEventCollection[i].events.Num();
+            count += m_queryEventCollection[i].Num();
         }
     }
     else
@@ -1001,7 +1676,7 @@ int FTelemetryVisualizerUI::FilterEvents()
             if (m_queryEventCollection[i].eventname.Contains(searchText))
             {
                 m_filterCollection.Emplace(&m_queryEventCollection[i]);
-                count += m_queryEventCollection[i].events.Num();
+                count += m_queryEventCollection[i].Num();
             }
         }
     }
@@ -1158,18 +1833,26 @@ void FTelemetryVisualizerUI::OnTypeSelectionChanged(TSharedPtr<FString> NewValue
 
 void FTelemetryVisualizerUI::GenerateEventBox()
 {
+    //Keep the current selection if it is still available, since this is rebuilt as each page of results arrives
+    FString currentSelection = m_vizSelection.IsValid() ? *m_vizSelection : "";
+
     m_eventgroupList.Empty();
     m_eventgroupList.Add(MakeShareable<FString>(new FString("")));
     m_vizSelection = m_eventgroupList[0];
 
     for (int i = 0; i < m_filterCollection.Num(); i++)
     {
-        m_eventgroupList.Add(MakeShareable<FString>(new FString(m_filterCollection[i]->eventname)));
+        int index = m_eventgroupList.Add(MakeShareable<FString>(new FString(m_filterCollection[i]->eventname)));
+
+        if (currentSelection != "" && m_filterCollection[i]->eventname == currentSelection)
+        {
+            m_vizSelection = m_eventgroupList[index];
+        }
     }
 
     if (m_vizChoice.IsValid())
     {
-        m_vizChoice->SetSelectedItem(m_eventgroupList[0]);
+        m_vizChoice->SetSelectedItem(m_vizSelection);
         m_vizChoice->RefreshOptions();
     }
 }
@@ -1185,6 +1868,8 @@ void FTelemetryVisualizerUI::GenerateSubEventBox(int index)
         m_eventgroupSubList.Add(MakeShareable<FString>(new FString(name)));
     }
 
+    RequestAttributeNames(m_queryEventCollection[index].eventname);
+
     if (m_subVizSelection.IsValid())
     {
         m_vizSubChoice->SetSelectedItem(m_eventgroupSubList[0]);
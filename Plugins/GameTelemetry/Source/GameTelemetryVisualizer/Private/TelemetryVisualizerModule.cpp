@@ -11,12 +11,16 @@
 
 #include "TelemetryVisualizerModule.h"
 #include "TelemetryVisualizerUI.h"
+#include "Query/TelemetryLocalServer.h"
 
 DEFINE_LOG_CATEGORY(LogTelemetryVisualizer);
+DEFINE_LOG_CATEGORY(LogTelemetryQueryTiming);
 IMPLEMENT_MODULE(FTelemetryVisualizerModule, TelemetryVisualizerModule);
 
 void FTelemetryVisualizerModule::StartupModule()
 {
+    FQueryExecutor::RegisterTransport(&FTelemetryLocalServer::Get());
+
     EditorUI = TUniquePtr<FTelemetryVisualizerUI>(new FTelemetryVisualizerUI);
     EditorUI->Initialize();
 }
@@ -24,4 +28,6 @@ void FTelemetryVisualizerModule::StartupModule()
 void FTelemetryVisualizerModule::ShutdownModule()
 {
     EditorUI->Shutdown();
+
+    FQueryExecutor::UnregisterTransport(&FTelemetryLocalServer::Get());
 }
\ No newline at end of file
@@ -979,7 +979,35 @@ FReply FTelemetryVisualizerUI::GenerateHeatmap()
         return FReply::Handled();
     }
 
-    return GenerateHeatmap(collection, 0, collection->events.Num() - 1);
+    const bool isValueHeatmap = m_heatmapType == HeatmapType::Value || m_heatmapType == HeatmapType::Value_Bar;
+    if (isValueHeatmap && m_subVizSelection->IsEmpty())
+    {
+        return FReply::Handled();
+    }
+
+    //The server bins every event the query matches, so only the cells are downloaded
+    if (m_heatmapAggregates && !m_heatmapBinLoaded && !m_loadedFromFile && m_liveQuery.IsValid() && !FQueryOptimizer::IsEmpty(m_liveQuery))
+    {
+        RequestHeatmap(collection->eventname);
+        return FReply::Handled();
+    }
+
+    //Events are fetched with only the attribute the last heatmap used, so another one is loaded first
+    if (isValueHeatmap && !m_isWaiting && m_queryColumns.Num() > 0 && !m_subVizSelection->IsEmpty() && !m_queryColumns.Contains(*m_subVizSelection))
+    {
+        m_heatmapPending = true;
+        CollectEvents(m_liveQuery);
+
+        if (m_messageText.IsValid())
+        {
+            m_messageText->SetText(FText::Format(LOCTEXT("Heatmap_Loading", "Loading {0} for the heatmap..."), FText::FromString(*m_subVizSelection)));
+        }
+
+        return FReply::Handled();
+    }
+
+    m_heatmapBinLoaded = false;
+    return GenerateHeatmap(collection, 0, collection->Num() - 1);
 }
 
 //Generate a heatmap for the range of events
@@ -991,26 +1019,23 @@ FReply FTelemetryVisualizerUI::GenerateHeatmap(SEventEditorContainer* collection
     if (currentTarget != nullptr && collection != nullptr &&
 		!(*m_subVizSelection == "" && (m_heatmapType == HeatmapType::Value || m_heatmapType == HeatmapType::Value_Bar)))
     {
-        if ((first == 0 && first == last) || (first == collection->events.Num() - 1 && first == last))
+        if ((first == 0 && first == last) || (first == collection->Num() - 1 && first == last))
         {
             first = 0;
-            last = collection->events.Num() - 1;
+            last = collection->Num() - 1;
         }
 
         //Segment the world in to blocks of the specified size encompassing all points
         FVector origin = collection->GetPointRange(first, last).GetCenter();
         FVector size(m_heatmapSize, m_heatmapSize, m_heatmapSize);
 
+        //Values are read straight from the column of the selected attribute
+        const int32 attribute = collection->FindAttribute(*m_subVizSelection);
+
         //For each segment, collect all of the points inside and decide what data to watch based on the heatmap type
-        float scaledHeatmapSize = m_heatmapSize / 100;
-        ATelemetryEvent* tempActor;
-        FString tempName = "Heatmap";
         FVector tempPoint;
         TMap<FVector, HeatmapNode> heatmapNodes;
 
-        FActorSpawnParameters params;
-        params.Name = *tempName;
-
         if (m_heatmapMinValue == -1 && m_heatmapMaxValue == -1)
         {
             double largestValue = 0;
@@ -1021,16 +1046,17 @@ FReply FTelemetryVisualizerUI::GenerateHeatmap(SEventEditorContainer* collection
             {
                 for (int j = first; j <= last; j++)
                 {
-                    tempPoint = (collection->events[j]->point - origin) / size;
+                    tempPoint = (collection->points[j] - origin) / size;
                     tempPoint.X = FMath::FloorToFloat(tempPoint.X);
                     tempPoint.Y = FMath::FloorToFloat(tempPoint.Y);
                     tempPoint.Z = FMath::FloorToFloat(tempPoint.Z);
 
                     HeatmapNode& tempEvent = heatmapNodes.FindOrAdd(tempPoint);
 
-                    tempEvent.numValues++;
-                    tempEvent.values += collection->events[j]->GetValue(*m_subVizSelection);
-                    tempEvent.orientation += collection->events[j]->orientation;
+                    //Coalesced events count once for every event they stand for
+                    tempEvent.numValues += collection->counts[j];
+                    tempEvent.values += collection->GetValue(attribute, j) * collection->counts[j];
+                    tempEvent.orientation += collection->orientations[j] * collection->counts[j];
 
                     smallestValue = FMath::Min(smallestValue, tempEvent.values / tempEvent.numValues);
                     largestValue = FMath::Max(largestValue, tempEvent.values / tempEvent.numValues);
@@ -1046,15 +1072,15 @@ FReply FTelemetryVisualizerUI::GenerateHeatmap(SEventEditorContainer* collection
             {
                 for (int j = first; j <= last; j++)
                 {
-                    tempPoint = (collection->events[j]->point - origin) / size;
+                    tempPoint = (collection->points[j] - origin) / size;
                     tempPoint.X = FMath::FloorToFloat(tempPoint.X);
                     tempPoint.Y = FMath::FloorToFloat(tempPoint.Y);
                     tempPoint.Z = FMath::FloorToFloat(tempPoint.Z);
 
                     HeatmapNode& tempEvent = heatmapNodes.FindOrAdd(tempPoint);
 
-                    tempEvent.numValues++;
-                    tempEvent.values += collection->events[j]->GetValue(*m_subVizSelection);
+                    tempEvent.numValues += collection->counts[j];
+                    tempEvent.values += collection->GetValue(attribute, j) * collection->counts[j];
 
                     smallestValue = FMath::Min(smallestValue, tempEvent.values / tempEvent.numValues);
                     largestValue = FMath::Max(largestValue, tempEvent.values / tempEvent.numValues);
@@ -1062,28 +1088,7 @@ FReply FTelemetryVisualizerUI::GenerateHeatmap(SEventEditorContainer* collection
                 }
             }
 
-            m_heatmapMinValue = 0;
-
-            if (m_heatmapType == HeatmapType::Value || m_heatmapType == HeatmapType::Value_Bar)
-            {
-                if (m_subVizSelection->StartsWith("pct_"))
-                {
-                    m_heatmapMinValue = 0;
-                    m_heatmapMaxValue = 100;
-                }
-                else
-                {
-                    m_heatmapMinValue = smallestValue;
-                    m_heatmapMaxValue = largestValue;
-                }
-            }
-            else
-            {
-                m_heatmapMaxValue = largestNumValue;
-            }
-
-            m_heatmapMinValueText->SetText(FText::FromString(FString::SanitizeFloat(m_heatmapMinValue)));
-            m_heatmapMaxValueText->SetText(FText::FromString(FString::SanitizeFloat(m_heatmapMaxValue)));
+            SetHeatmapRange(smallestValue, largestValue, largestNumValue);
         }
         else
         {
@@ -1091,16 +1096,16 @@ FReply FTelemetryVisualizerUI::GenerateHeatmap(SEventEditorContainer* collection
             {
                 for (int j = first; j <= last; j++)
                 {
-                    tempPoint = (collection->events[j]->point - origin) / size;
+                    tempPoint = (collection->points[j] - origin) / size;
                     tempPoint.X = FMath::FloorToFloat(tempPoint.X);
                     tempPoint.Y = FMath::FloorToFloat(tempPoint.Y);
                     tempPoint.Z = FMath::FloorToFloat(tempPoint.Z);
 
                     HeatmapNode& tempEvent = heatmapNodes.FindOrAdd(tempPoint);
 
-                    tempEvent.numValues++;
-                    tempEvent.values += collection->events[j]->GetValue(*m_subVizSelection);
-                    tempEvent.orientation += collection->events[j]->orientation;
+                    tempEvent.numValues += collection->counts[j];
+                    tempEvent.values += collection->GetValue(attribute, j) * collection->counts[j];
+                    tempEvent.orientation += collection->orientations[j] * collection->counts[j];
                 }
 
                 for (auto& node : heatmapNodes)
@@ -1112,87 +1117,235 @@ FReply FTelemetryVisualizerUI::GenerateHeatmap(SEventEditorContainer* collection
             {
                 for (int j = first; j <= last; j++)
                 {
-                    tempPoint = (collection->events[j]->point - origin) / size;
+                    tempPoint = (collection->points[j] - origin) / size;
                     tempPoint.X = FMath::FloorToFloat(tempPoint.X);
                     tempPoint.Y = FMath::FloorToFloat(tempPoint.Y);
                     tempPoint.Z = FMath::FloorToFloat(tempPoint.Z);
 
                     HeatmapNode& tempEvent = heatmapNodes.FindOrAdd(tempPoint);
 
-                    tempEvent.numValues++;
-                    tempEvent.values += collection->events[j]->GetValue(*m_subVizSelection);
+                    tempEvent.numValues += collection->counts[j];
+                    tempEvent.values += collection->GetValue(attribute, j) * collection->counts[j];
                 }
             }
         }
 
-        if(heatmapNodes.Num() > 0)
+        DrawHeatmap(currentTarget, heatmapNodes, origin);
+    }
+
+    return FReply::Handled();
+}
+
+//Sets the range colors are scaled to from the values of a new heatmap
+void FTelemetryVisualizerUI::SetHeatmapRange(double smallestValue, double largestValue, int largestNumValue)
+{
+    m_heatmapMinValue = 0;
+
+    if (m_heatmapType == HeatmapType::Value || m_heatmapType == HeatmapType::Value_Bar)
+    {
+        if (m_subVizSelection->StartsWith("pct_"))
+        {
+            m_heatmapMinValue = 0;
+            m_heatmapMaxValue = 100;
+        }
+        else
         {
-            //For each section, add instanced mesh to the master mesh and set its shape and color as needed
-            tempActor = currentTarget->SpawnActor<ATelemetryEvent>(FVector::ZeroVector, FRotator::ZeroRotator, params);
-            tempActor->SetActorLabel(*tempName);
+            m_heatmapMinValue = smallestValue;
+            m_heatmapMaxValue = largestValue;
+        }
+    }
+    else
+    {
+        m_heatmapMaxValue = largestNumValue;
+    }
+
+    m_heatmapMinValueText->SetText(FText::FromString(FString::SanitizeFloat(m_heatmapMinValue)));
+    m_heatmapMaxValueText->SetText(FText::FromString(FString::SanitizeFloat(m_heatmapMaxValue)));
+}
+
+//Spawns the heatmap actor with one mesh per segment.  Segment keys are in heatmap sized steps from origin
+void FTelemetryVisualizerUI::DrawHeatmap(UWorld* drawTarget, const TMap<FVector, HeatmapNode>& heatmapNodes, FVector origin)
+{
+    FVector size(m_heatmapSize, m_heatmapSize, m_heatmapSize);
+    float scaledHeatmapSize = m_heatmapSize / 100;
+    ATelemetryEvent* tempActor;
+    FString tempName = "Heatmap";
+
+    FActorSpawnParameters params;
+    params.Name = *tempName;
 
-            double tempValue;
-            float tempColorValue;
+    if (heatmapNodes.Num() > 0)
+    {
+        //For each section, add instanced mesh to the master mesh and set its shape and color as needed
+        tempActor = drawTarget->SpawnActor<ATelemetryEvent>(FVector::ZeroVector, FRotator::ZeroRotator, params);
+        tempActor->SetActorLabel(*tempName);
+
+        double tempValue;
+        float tempColorValue;
 
-            if (m_heatmapType == HeatmapType::Value)
+        if (m_heatmapType == HeatmapType::Value)
+        {
+            for (auto& node : heatmapNodes)
             {
-                for (auto& node : heatmapNodes)
-                {
-                    tempValue = (double)node.Value.values / node.Value.numValues;
-                    tempColorValue = (tempValue - m_heatmapMinValue) / (m_heatmapMaxValue - m_heatmapMinValue);
-                    tempColorValue = FMath::Clamp(tempColorValue, 0.f, 1.f);
+                tempValue = (double)node.Value.values / node.Value.numValues;
+                tempColorValue = (tempValue - m_heatmapMinValue) / (m_heatmapMaxValue - m_heatmapMinValue);
+                tempColorValue = FMath::Clamp(tempColorValue, 0.f, 1.f);
 
-                    tempActor->AddEvent((node.Key * size) + origin, node.Value.orientation, m_heatmapColor.GetColorFromRange(tempColorValue), m_heatmapShapeType, scaledHeatmapSize, tempValue);
-                }
+                tempActor->AddEvent((node.Key * size) + origin, node.Value.orientation, m_heatmapColor.GetColorFromRange(tempColorValue), m_heatmapShapeType, scaledHeatmapSize, tempValue);
             }
-            else if (m_heatmapType == HeatmapType::Population)
+        }
+        else if (m_heatmapType == HeatmapType::Population)
+        {
+            for (auto& node : heatmapNodes)
             {
-                for (auto& node : heatmapNodes)
-                {
-                    tempValue = (double)node.Value.numValues / m_heatmapMaxValue;
-                    tempColorValue = (float)(node.Value.numValues - m_heatmapMinValue) / (m_heatmapMaxValue - m_heatmapMinValue);
-                    tempColorValue = FMath::Clamp(tempColorValue, 0.f, 1.f);
+                tempValue = (double)node.Value.numValues / m_heatmapMaxValue;
+                tempColorValue = (float)(node.Value.numValues - m_heatmapMinValue) / (m_heatmapMaxValue - m_heatmapMinValue);
+                tempColorValue = FMath::Clamp(tempColorValue, 0.f, 1.f);
 
-                    tempActor->AddEvent((node.Key * size) + origin, node.Value.orientation, m_heatmapColor.GetColorFromRange(tempColorValue), m_heatmapShapeType, scaledHeatmapSize, tempValue);
-                }
+                tempActor->AddEvent((node.Key * size) + origin, node.Value.orientation, m_heatmapColor.GetColorFromRange(tempColorValue), m_heatmapShapeType, scaledHeatmapSize, tempValue);
             }
-            else if (m_heatmapType == HeatmapType::Value_Bar)
-            {
-                float tempHeight;
+        }
+        else if (m_heatmapType == HeatmapType::Value_Bar)
+        {
+            float tempHeight;
 
-                for (auto& node : heatmapNodes)
-                {
-                    tempValue = (double)node.Value.values / node.Value.numValues;
-                    tempColorValue = (tempValue - m_heatmapMinValue) / (m_heatmapMaxValue - m_heatmapMinValue);
-                    tempColorValue = FMath::Clamp(tempColorValue, 0.f, 1.f);
-                    tempHeight = (((double)node.Value.values / node.Value.numValues) / m_heatmapMaxValue) * scaledHeatmapSize;
+            for (auto& node : heatmapNodes)
+            {
+                tempValue = (double)node.Value.values / node.Value.numValues;
+                tempColorValue = (tempValue - m_heatmapMinValue) / (m_heatmapMaxValue - m_heatmapMinValue);
+                tempColorValue = FMath::Clamp(tempColorValue, 0.f, 1.f);
+                tempHeight = (((double)node.Value.values / node.Value.numValues) / m_heatmapMaxValue) * scaledHeatmapSize;
 
-                    tempActor->AddEvent((node.Key * size) + origin, FVector::ZeroVector, m_heatmapColor.GetColorFromRange(tempColorValue), EventType::Cube,
-                        FBox::BuildAABB(FVector(0, 0, (tempHeight / 2) * 100), FVector(scaledHeatmapSize, scaledHeatmapSize, tempHeight)), tempValue);
-                }
+                tempActor->AddEvent((node.Key * size) + origin, FVector::ZeroVector, m_heatmapColor.GetColorFromRange(tempColorValue), EventType::Cube,
+                    FBox::BuildAABB(FVector(0, 0, (tempHeight / 2) * 100), FVector(scaledHeatmapSize, scaledHeatmapSize, tempHeight)), tempValue);
             }
-            else if (m_heatmapType == HeatmapType::Population_Bar)
-            {
-                float tempHeight;
+        }
+        else if (m_heatmapType == HeatmapType::Population_Bar)
+        {
+            float tempHeight;
 
-                for (auto& node : heatmapNodes)
-                {
-                    tempValue = (double)node.Value.numValues / m_heatmapMaxValue;
-                    tempColorValue = (float)(node.Value.numValues - m_heatmapMinValue) / (m_heatmapMaxValue - m_heatmapMinValue);
-                    tempColorValue = FMath::Clamp(tempColorValue, 0.f, 1.f);
-                    tempHeight = ((double)node.Value.numValues / m_heatmapMaxValue) * scaledHeatmapSize;
+            for (auto& node : heatmapNodes)
+            {
+                tempValue = (double)node.Value.numValues / m_heatmapMaxValue;
+                tempColorValue = (float)(node.Value.numValues - m_heatmapMinValue) / (m_heatmapMaxValue - m_heatmapMinValue);
+                tempColorValue = FMath::Clamp(tempColorValue, 0.f, 1.f);
+                tempHeight = ((double)node.Value.numValues / m_heatmapMaxValue) * scaledHeatmapSize;
 
-                    tempActor->AddEvent((node.Key * size) + origin, FVector::ZeroVector, m_heatmapColor.GetColorFromRange(tempColorValue), EventType::Cube,
-                        FBox::BuildAABB(FVector(0, 0, (tempHeight / 2) * 100), FVector(scaledHeatmapSize, scaledHeatmapSize, tempHeight)), tempValue);
-                }
+                tempActor->AddEvent((node.Key * size) + origin, FVector::ZeroVector, m_heatmapColor.GetColorFromRange(tempColorValue), EventType::Cube,
+                    FBox::BuildAABB(FVector(0, 0, (tempHeight / 2) * 100), FVector(scaledHeatmapSize, scaledHeatmapSize, tempHeight)), tempValue);
             }
+        }
+
+        tempName = "/TelemetryEvents";
+        tempActor->SetFolderPath(*tempName);
+
+        m_eventActors.Add(tempActor);
+    }
+}
+
+//Asks the server for the selected heatmap as cells of the heatmap size, covering every event of the query in the group
+void FTelemetryVisualizerUI::RequestHeatmap(const FString& eventName)
+{
+    const bool isValueHeatmap = m_heatmapType == HeatmapType::Value || m_heatmapType == HeatmapType::Value_Bar;
+
+    FQueryNodeList nodes;
+    nodes.Add(m_liveQuery);
+    nodes.Add(QBuilder::Eq(TEXT("name"), eventName));
+
+    FQueryNodePtr aggregate = QBuilder::Aggregate(FQueryOptimizer::Optimize(QBuilder::And(MoveTemp(nodes))), m_heatmapSize, isValueHeatmap ? *m_subVizSelection : FString());
+
+    m_heatmapCells.Empty();
+
+    if (m_messageText.IsValid())
+    {
+        m_messageText->SetText(LOCTEXT("Heatmap_Aggregating", "Building heatmap..."));
+    }
+
+    //Cells depend on the heatmap settings as well as the events, so they are not cached
+    m_heatmapExecuter.CancelQuery();
+    m_heatmapExecuter.ExecuteCustomQuery(m_querySerializer.Serialize(aggregate), QueryResultHandler::CreateRaw(this, &FTelemetryVisualizerUI::HeatmapResults), -1, []()
+    {
+        return TSharedRef<IQueryResultSink>(MakeShareable(new FQueryAggregateSink()));
+    }, false);
+}
+
+//Called as each page of cells arrives.  The heatmap is drawn once every cell is in
+void FTelemetryVisualizerUI::HeatmapResults(TSharedPtr<SQueryResult> results)
+{
+    TSharedPtr<FQueryAggregateSink> sink = StaticCastSharedPtr<FQueryAggregateSink>(results->Sink);
 
-            tempName = "/TelemetryEvents";
-            tempActor->SetFolderPath(*tempName);
+    //A server without aggregates ignores the aggregate node and returns events, so later heatmaps are all binned from
+    //the loaded events.  A request that fails may only have hit a network or server error, so only this one is
+    if (!results->Header.Success || !sink.IsValid() || sink->GetNumSkipped() > 0)
+    {
+        m_heatmapExecuter.CancelQuery();
 
-            m_eventActors.Add(tempActor);
+        if (results->Header.Success)
+        {
+            UE_LOG(LogTelemetryVisualizer, Log, TEXT("Query server does not aggregate, heatmaps are built from the loaded events"));
+            m_heatmapAggregates = false;
+        }
+        else
+        {
+            UE_LOG(LogTelemetryVisualizer, Warning, TEXT("Heatmap aggregate query failed, this heatmap is built from the loaded events"));
         }
+
+        m_heatmapCells.Empty();
+        m_heatmapBinLoaded = true;
+        GenerateHeatmap();
+        return;
     }
 
-    return FReply::Handled();
+    m_heatmapCells.Append(sink->GetCells());
+
+    if (!results->IsLastPage)
+    {
+        return;
+    }
+
+    UWorld* currentTarget = GetLocalWorld();
+    if (currentTarget == nullptr)
+    {
+        return;
+    }
+
+    DestroyActors();
+
+    //Cells start at the world origin rather than the center of the events
+    TMap<FVector, HeatmapNode> heatmapNodes;
+    double largestValue = 0;
+    double smallestValue = 0;
+    int largestNumValue = 0;
+    double eventCount = 0;
+
+    for (auto& cell : m_heatmapCells)
+    {
+        HeatmapNode& node = heatmapNodes.FindOrAdd(FVector(cell.Cell));
+        node.numValues = (int)cell.Count;
+        node.values = cell.Sum;
+        node.orientation = m_heatmapOrientation ? cell.Direction : FVector::ZeroVector;
+
+        if (node.numValues > 0)
+        {
+            smallestValue = FMath::Min(smallestValue, node.values / node.numValues);
+            largestValue = FMath::Max(largestValue, node.values / node.numValues);
+            largestNumValue = FMath::Max(largestNumValue, node.numValues);
+        }
+
+        eventCount += cell.Count;
+    }
+
+    if (m_heatmapMinValue == -1 && m_heatmapMaxValue == -1)
+    {
+        SetHeatmapRange(smallestValue, largestValue, largestNumValue);
+    }
+
+    DrawHeatmap(currentTarget, heatmapNodes, FVector::ZeroVector);
+
+    if (m_messageText.IsValid())
+    {
+        m_messageText->SetText(FText::Format(LOCTEXT("Heatmap_Cells", "Heatmap of {0} events in {1} cells"), FText::AsNumber((int64)eventCount), FText::AsNumber(m_heatmapCells.Num())));
+    }
+
+    m_heatmapCells.Empty();
 }
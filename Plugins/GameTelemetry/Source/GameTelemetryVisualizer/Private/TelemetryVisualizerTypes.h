@@ -11,6 +11,7 @@
 
 #pragma once
 #include "Brushes/SlateColorBrush.h"
+#include "Misc/ScopeRWLock.h"
 #include "Query/TelemetryQuery.h"
 
 //Setting whether to draw recieved events by default
@@ -32,21 +33,210 @@ static const TArray<FColor> DefaultColors =
     FColor::Emerald
 };
 
-//Primary container for events managed by the UI
+//Handle of a string in FTelemetryStringTable.  0 is the empty string
+typedef uint32 FTelemetryStringHandle;
+
+//Not a string in the table, e.g. the end of a chain of strings sharing a hash
+static const FTelemetryStringHandle InvalidStringHandle = MAX_uint32;
+
+//Names, categories, sessions and builds repeat across nearly every event, so events hold a handle to one copy of each.
+//Builders intern from worker threads while the UI reads.  Strings are kept in fixed size chunks that never move and
+//are never removed, so GetString reads without a lock and a handle stays valid for the rest of the editor session.
+//Only the distinct values of those fields are held, which stay few however many events are loaded
+class FTelemetryStringTable
+{
+public:
+    //The table events use.  Other tables are only for tests, whose strings then do not outlive them
+    static FTelemetryStringTable& Get()
+    {
+        static FTelemetryStringTable table;
+        return table;
+    }
+
+    FTelemetryStringTable() :
+        count(0)
+    {
+        FMemory::Memzero(chunks);
+        chunks[0] = new FChunk;
+        chunks[0]->nextWithHash[0] = InvalidStringHandle;
+        count = 1;
+    }
+
+    ~FTelemetryStringTable()
+    {
+        for (FChunk* chunk : chunks)
+        {
+            delete chunk;
+        }
+    }
+
+    FTelemetryStringTable(const FTelemetryStringTable&) = delete;
+    FTelemetryStringTable& operator=(const FTelemetryStringTable&) = delete;
+
+    FTelemetryStringHandle Intern(const TCHAR* text, int32 length)
+    {
+        if (length <= 0)
+        {
+            return 0;
+        }
+
+        const uint32 hash = FCrc::MemCrc32(text, length * sizeof(TCHAR));
+
+        {
+            FReadScopeLock readLock(lock);
+
+            const FTelemetryStringHandle found = Find(hash, text, length);
+            if (found != InvalidStringHandle)
+            {
+                return found;
+            }
+        }
+
+        FWriteScopeLock writeLock(lock);
+
+        //Another thread may have added it between the locks
+        const FTelemetryStringHandle found = Find(hash, text, length);
+        if (found != InvalidStringHandle)
+        {
+            return found;
+        }
+
+        const FTelemetryStringHandle handle = (FTelemetryStringHandle)count;
+        //Every string a session could reasonably load fits many times over
+        if (!ensureMsgf(handle < (uint32)(MaxChunks * ChunkSize), TEXT("Telemetry string table is full")))
+        {
+            return 0;
+        }
+
+        FChunk*& chunk = chunks[handle >> ChunkBits];
+        if (chunk == nullptr)
+        {
+            chunk = new FChunk;
+        }
+
+        chunk->strings[handle & ChunkMask] = FString(length, text);
+        chunk->nextWithHash[handle & ChunkMask] = Publish(hash, handle);
+
+        //The string is written before the count that lets readers see it
+        FPlatformAtomics::InterlockedExchange(&count, count + 1);
+
+        return handle;
+    }
+
+    FTelemetryStringHandle Intern(const FString& text)
+    {
+        return Intern(*text, text.Len());
+    }
+
+    //A handle is only ever handed out once its string is written, so no lock is needed to read it
+    const FString& GetString(FTelemetryStringHandle handle) const
+    {
+        return chunks[handle >> ChunkBits]->strings[handle & ChunkMask];
+    }
+
+    int32 Num() const
+    {
+        return count;
+    }
+
+    SIZE_T GetAllocatedSize() const
+    {
+        const int32 num = Num();
+
+        SIZE_T size = sizeof(chunks) + lookup.GetAllocatedSize();
+        for (int32 i = 0; i < num; i += ChunkSize)
+        {
+            size += sizeof(FChunk);
+        }
+        for (int32 i = 0; i < num; i++)
+        {
+            size += GetString(i).GetAllocatedSize();
+        }
+        return size;
+    }
+
+private:
+    static const int32 ChunkBits = 12;
+    static const int32 ChunkSize = 1 << ChunkBits;
+    static const int32 ChunkMask = ChunkSize - 1;
+    static const int32 MaxChunks = 4096;
+
+    struct FChunk
+    {
+        FString strings[ChunkSize];
+        FTelemetryStringHandle nextWithHash[ChunkSize];
+    };
+
+    //Makes handle the head of the chain of strings sharing the hash, returning the previous head
+    FTelemetryStringHandle Publish(uint32 hash, FTelemetryStringHandle handle)
+    {
+        const FTelemetryStringHandle* head = lookup.Find(hash);
+        const FTelemetryStringHandle previous = head != nullptr ? *head : InvalidStringHandle;
+        lookup.Add(hash, handle);
+        return previous;
+    }
+
+    //Walks the chain of strings sharing the hash, returning InvalidStringHandle if none matches.  Called under the lock
+    FTelemetryStringHandle Find(uint32 hash, const TCHAR* text, int32 length) const
+    {
+        const FTelemetryStringHandle* head = lookup.Find(hash);
+
+        for (FTelemetryStringHandle candidate = head != nullptr ? *head : InvalidStringHandle; candidate != InvalidStringHandle;
+            candidate = chunks[candidate >> ChunkBits]->nextWithHash[candidate & ChunkMask])
+        {
+            const FString& each = GetString(candidate);
+            if (each.Len() == length && FMemory::Memcmp(*each, text, length * sizeof(TCHAR)) == 0)
+            {
+                return candidate;
+            }
+        }
+
+        return InvalidStringHandle;
+    }
+
+    //Chunks are allocated as strings are added and never moved, so a reference returned by GetString stays valid
+    FChunk* chunks[MaxChunks];
+    volatile int32 count;
+
+    //Only used to intern, under the lock
+    TMap<uint32, FTelemetryStringHandle> lookup;
+    FRWLock lock;
+};
+
+//Remembers the last string interned for one field, since the events of a page tend to repeat it
+struct FTelemetryStringCache
+{
+    FString text;
+    FTelemetryStringHandle handle = 0;
+
+    FTelemetryStringHandle Intern(const TCHAR* value, int32 length)
+    {
+        if (text.Len() != length || FMemory::Memcmp(*text, value, length * sizeof(TCHAR)) != 0)
+        {
+            text = FString(length, value);
+            handle = FTelemetryStringTable::Get().Intern(value, length);
+        }
+
+        return handle;
+    }
+};
+
+//One event as it is read, before it is added to the columns of an SEventEditorContainer
 struct STelemetryEvent
 {
-    TCHAR build[128];
-    TCHAR eventname[128];
-    TCHAR category[128];
-    TCHAR session[38];
     FVector point;
     FVector orientation;
     FDateTime time;
-    TMap<FString, TSharedPtr<FJsonValue>> values;
-
-    STelemetryEvent() : eventname(TEXT("\0")), category(TEXT("\0")), session(TEXT("\0")), build(TEXT("\0")), point(FVector::ZeroVector), orientation(FVector::ZeroVector), time(0) {};
-    STelemetryEvent(FString inName, FString inCategory, FString inSession, FString inBuild, FVector point, FVector orientation, FDateTime time)
-        : point(point), orientation(orientation), time(time)
+    int32 count;
+    FTelemetryStringHandle name;
+    FTelemetryStringHandle category;
+    FTelemetryStringHandle session;
+    FTelemetryStringHandle build;
+    TMap<FString, double> values;
+
+    STelemetryEvent() : point(FVector::ZeroVector), orientation(FVector::ZeroVector), time(0), count(1), name(0), category(0), session(0), build(0) {};
+    STelemetryEvent(const FString& inName, const FString& inCategory, const FString& inSession, const FString& inBuild, FVector point, FVector orientation, FDateTime time, int32 count = 1)
+        : point(point), orientation(orientation), time(time), count(count)
     {
         SetName(inName);
         SetCategory(inCategory);
@@ -54,72 +244,70 @@ struct STelemetryEvent
         SetBuild(inBuild);
     };
 
-    void SetName(FString inName)
+    //Clears the event so it can be filled again, keeping the memory of its values
+    void Reset()
     {
-        if (inName.Len() < 128)
-        {
-            FCString::Strcpy(eventname, *inName);
-        }
+        point = FVector::ZeroVector;
+        orientation = FVector::ZeroVector;
+        time = FDateTime(0);
+        count = 1;
+        name = 0;
+        category = 0;
+        session = 0;
+        build = 0;
+        values.Reset();
     }
 
-    FString GetName()
+    void SetName(const FString& inName)
     {
-        return FString(eventname);
+        name = FTelemetryStringTable::Get().Intern(inName);
     }
 
-    void SetCategory(FString inCategory)
+    const FString& GetName() const
     {
-        if (inCategory.Len() < 128)
-        {
-            FCString::Strcpy(category, *inCategory);
-        }
+        return FTelemetryStringTable::Get().GetString(name);
     }
 
-    FString GetCategory()
+    void SetCategory(const FString& inCategory)
     {
-        return FString(category);
+        category = FTelemetryStringTable::Get().Intern(inCategory);
     }
 
-    void SetBuild(FString inBuild)
+    const FString& GetCategory() const
     {
-        if (inBuild.Len() < 128)
-        {
-            FCString::Strcpy(build, *inBuild);
-        }
+        return FTelemetryStringTable::Get().GetString(category);
     }
 
-    FString GetBuild()
+    void SetBuild(const FString& inBuild)
     {
-        return FString(build);
+        build = FTelemetryStringTable::Get().Intern(inBuild);
     }
 
-    void SetSession(FString inSession)
+    const FString& GetBuild() const
     {
-        if (inSession.Len() < 38)
-        {
-            FCString::Strcpy(session, *inSession);
-        }
+        return FTelemetryStringTable::Get().GetString(build);
     }
 
-    FString GetSession()
+    void SetSession(const FString& inSession)
     {
-        return FString(session);
+        session = FTelemetryStringTable::Get().Intern(inSession);
     }
 
-    double GetValue(FString key)
+    const FString& GetSession() const
     {
-        double value = 0;
-
-        if (values.Contains(key))
-        {
-            values[key]->TryGetNumber(value);
-        }
+        return FTelemetryStringTable::Get().GetString(session);
+    }
 
-        return value;
+    double GetValue(FString key)
+    {
+        const double* value = values.Find(key);
+        return value != nullptr ? *value : 0;
     }
 };
 
 //Wrapper for the event container with draw information
+//Events are held as one array per field, newest first, so event i is element i of every array.  Drawing, heatmaps
+//and animation walk only the arrays they need rather than an allocation per event.
 struct SEventEditorContainer
 {
 private:
@@ -134,8 +322,17 @@ private:
 public:
     FString eventname;
     FString session;
-    TArray<TSharedPtr<STelemetryEvent>> events;
+    TArray<FVector> points;
+    TArray<FVector> orientations;
+    TArray<int64> ticks;
+    TArray<int32> counts;
+    TArray<FTelemetryStringHandle> categories;
+    TArray<FTelemetryStringHandle> sessions;
+    TArray<FTelemetryStringHandle> builds;
+
+    //One column per attribute, in the order of attributeNames.  Events without the attribute hold NaN
     TArray<FString> attributeNames;
+    TArray<TArray<double>> attributeValues;
 
     SEventEditorContainer() : shouldDraw(DefaultDrawSetting), shouldAnimate(false), color(FColor::Red), colorBrush((FSlateBrush)FSlateColorBrush(FColor::Red)), type(EventType::Sphere)
     {
@@ -157,23 +354,206 @@ public:
         }
     }
 
+    int32 Num() const
+    {
+        return ticks.Num();
+    }
+
+    FDateTime GetTime(int32 i) const
+    {
+        return FDateTime(ticks[i]);
+    }
+
+    const FString& GetCategory(int32 i) const
+    {
+        return FTelemetryStringTable::Get().GetString(categories[i]);
+    }
+
+    const FString& GetSession(int32 i) const
+    {
+        return FTelemetryStringTable::Get().GetString(sessions[i]);
+    }
+
+    const FString& GetBuild(int32 i) const
+    {
+        return FTelemetryStringTable::Get().GetString(builds[i]);
+    }
+
+    //Index of the attribute's column, or INDEX_NONE if no event has it
+    int32 FindAttribute(const FString& name) const
+    {
+        return attributeNames.IndexOfByKey(name);
+    }
+
+    //Adds a column for an attribute no event had yet, missing from the events already added.  Names must only be
+    //added here, so there is always one column per name
+    void AddAttribute(const FString& name)
+    {
+        if (FindAttribute(name) == INDEX_NONE)
+        {
+            attributeNames.Add(name);
+            attributeValues[attributeValues.AddDefaulted()].Init(NAN, Num());
+        }
+    }
+
+    //Value of an attribute found with FindAttribute, or 0 if the event does not have it
+    double GetValue(int32 attribute, int32 i) const
+    {
+        if (attribute == INDEX_NONE)
+        {
+            return 0;
+        }
+
+        const double value = attributeValues[attribute][i];
+        return FMath::IsNaN(value) ? 0 : value;
+    }
+
+    bool HasValue(int32 attribute, int32 i) const
+    {
+        return attribute != INDEX_NONE && !FMath::IsNaN(attributeValues[attribute][i]);
+    }
+
     void AddEvent(FSimpleEvent newEvent)
     {
-        int index = events.Emplace(MakeShareable(new STelemetryEvent(
+        STelemetryEvent event(
             newEvent.GetName(),
             newEvent.GetCategory(),
             newEvent.GetSessionId(),
             newEvent.GetBuildType() + L" " + newEvent.GetBuildId() + L" " + newEvent.GetPlatform(),
             newEvent.GetPlayerPosition(),
             newEvent.GetPlayerDirection(),
-            newEvent.GetTime())));
+            newEvent.GetTime(),
+            newEvent.GetCount());
+
+        TMap<FString, TSharedPtr<FJsonValue>> attributes;
+        newEvent.GetAttributes(attributes);
+
+        for (auto& attr : attributes)
+        {
+            double value = 0;
+            attr.Value->TryGetNumber(value);
+            event.values.Add(attr.Key, value);
+        }
+
+        AddEvent(event);
+        SetupTimes();
+    }
+
+    //Add an event that was already built, e.g. by FEventCollectionBuilder.  Times are set up once all are added
+    void AddEvent(const STelemetryEvent& newEvent)
+    {
+        for (auto& attr : newEvent.values)
+        {
+            AddAttribute(attr.Key);
+        }
+
+        points.Add(newEvent.point);
+        orientations.Add(newEvent.orientation);
+        ticks.Add(newEvent.time.GetTicks());
+        counts.Add(newEvent.count);
+        categories.Add(newEvent.category);
+        sessions.Add(newEvent.session);
+        builds.Add(newEvent.build);
+
+        for (int32 i = 0; i < attributeNames.Num(); i++)
+        {
+            const double* value = newEvent.values.Find(attributeNames[i]);
+            attributeValues[i].Add(value != nullptr ? *value : NAN);
+        }
+    }
+
+    //Add the events of the same group from a later page or a live update, keeping the newest first
+    void Append(const SEventEditorContainer& other)
+    {
+        if (other.Num() == 0)
+        {
+            return;
+        }
+
+        const bool inOrder = Num() == 0 || ticks.Last() >= other.ticks[0];
+        const bool allNewer = Num() > 0 && other.ticks.Last() >= ticks[0];
+        const int32 at = allNewer ? 0 : Num();
+
+        for (auto& attr : other.attributeNames)
+        {
+            AddAttribute(attr);
+        }
+
+        points.Insert(other.points, at);
+        orientations.Insert(other.orientations, at);
+        ticks.Insert(other.ticks, at);
+        counts.Insert(other.counts, at);
+        categories.Insert(other.categories, at);
+        sessions.Insert(other.sessions, at);
+        builds.Insert(other.builds, at);
+
+        for (int32 i = 0; i < attributeNames.Num(); i++)
+        {
+            const int32 otherIndex = other.FindAttribute(attributeNames[i]);
+
+            if (otherIndex != INDEX_NONE)
+            {
+                attributeValues[i].Insert(other.attributeValues[otherIndex], at);
+            }
+            else
+            {
+                //Attributes only this side had are missing from the new events
+                attributeValues[i].InsertUninitialized(at, other.Num());
+
+                for (int32 j = at; j < at + other.Num(); j++)
+                {
+                    attributeValues[i][j] = NAN;
+                }
+            }
+        }
+
+        if (!inOrder && !allNewer)
+        {
+            SortEvents();
+        }
+
         SetupTimes();
+    }
 
-        newEvent.GetAttributes(events[index]->values);
+    //Order events newest first, which the timeline and animation depend on
+    void SortEvents()
+    {
+        //Servers return events newest first, so most pages are already in order
+        bool isSorted = true;
+        for (int32 i = 1; i < ticks.Num() && isSorted; i++)
+        {
+            isSorted = ticks[i - 1] >= ticks[i];
+        }
 
-        for (auto& attr : events[index]->values)
+        if (isSorted)
         {
-            attributeNames.AddUnique(attr.Key);
+            return;
+        }
+
+        TArray<int32> order;
+        order.SetNumUninitialized(Num());
+        for (int32 i = 0; i < order.Num(); i++)
+        {
+            order[i] = i;
+        }
+
+        const TArray<int64>& times = ticks;
+        order.StableSort([&times](int32 a, int32 b)
+        {
+            return times[a] > times[b];
+        });
+
+        Reorder(points, order);
+        Reorder(orientations, order);
+        Reorder(ticks, order);
+        Reorder(counts, order);
+        Reorder(categories, order);
+        Reorder(sessions, order);
+        Reorder(builds, order);
+
+        for (auto& column : attributeValues)
+        {
+            Reorder(column, order);
         }
     }
 
@@ -189,8 +569,25 @@ public:
     //Keep a timespan for the event collection
     void SetupTimes()
     {
-        timeStart = events[events.Num() - 1]->time;
-        timeEnd = events[0]->time;
+        if (Num() > 0)
+        {
+            timeStart = GetTime(Num() - 1);
+            timeEnd = GetTime(0);
+        }
+    }
+
+    //Bytes held by the event arrays
+    SIZE_T GetAllocatedSize() const
+    {
+        SIZE_T size = points.GetAllocatedSize() + orientations.GetAllocatedSize() + ticks.GetAllocatedSize() + counts.GetAllocatedSize() +
+            categories.GetAllocatedSize() + sessions.GetAllocatedSize() + builds.GetAllocatedSize() + attributeNames.GetAllocatedSize() + attributeValues.GetAllocatedSize();
+
+        for (int32 i = 0; i < attributeNames.Num(); i++)
+        {
+            size += attributeNames[i].GetAllocatedSize() + attributeValues[i].GetAllocatedSize();
+        }
+
+        return size;
     }
 
     //Provides the total timespan for all events
@@ -208,21 +605,33 @@ public:
     //Provides a percent location based on the element
     float GetEventTimeScale(int i)
     {
-        return (float)FTimespan::Ratio(events[events.Num() - 1 - i]->time - timeStart, timeEnd - timeStart);
+        return (float)FTimespan::Ratio(GetTime(Num() - 1 - i) - timeStart, timeEnd - timeStart);
     }
 
-    //Provides an element based on the percent location
+    //Provides an element based on the percent location, the oldest event after that time
     int GetEventIndexForTimeScale(float scale)
     {
-        int i;
-        FDateTime targetValue = timeStart + ((timeEnd - timeStart) * scale);
+        const int64 targetValue = (timeStart + ((timeEnd - timeStart) * scale)).GetTicks();
+
+        //Events are newest first, so those after the target are the ones before the first index at or before it
+        int low = 0;
+        int high = Num();
 
-        for (i = events.Num() - 1; i > 0; i--)
+        while (low < high)
         {
-            if (events[i]->time > targetValue) break;
+            const int middle = low + (high - low) / 2;
+
+            if (ticks[middle] > targetValue)
+            {
+                low = middle + 1;
+            }
+            else
+            {
+                high = middle;
+            }
         }
 
-        return i;
+        return FMath::Max(low - 1, 0);
     }
 
     FSlateBrush* GetBrush()
@@ -274,7 +683,7 @@ public:
     //Gets the box for where events happen (for heatmap)
     FBox GetPointRange()
     {
-        return GetPointRange(0, events.Num() - 1);
+        return GetPointRange(0, Num() - 1);
     }
 
     //Gets the box for where specified events happen (for heatmap animations)
@@ -284,16 +693,289 @@ public:
 
         for (int i = start; i <= end; i++)
         {
-            range.Min.X = FMath::Min(range.Min.X, events[i]->point.X);
-            range.Min.Y = FMath::Min(range.Min.Y, events[i]->point.Y);
-            range.Min.Z = FMath::Min(range.Min.Z, events[i]->point.Z);
-            range.Max.X = FMath::Max(range.Max.X, events[i]->point.X);
-            range.Max.Y = FMath::Max(range.Max.Y, events[i]->point.Y);
-            range.Max.Z = FMath::Max(range.Max.Z, events[i]->point.Z);
+            range.Min = range.Min.ComponentMin(points[i]);
+            range.Max = range.Max.ComponentMax(points[i]);
         }
 
         return range;
     }
+
+private:
+    template<typename T>
+    static void Reorder(TArray<T>& column, const TArray<int32>& order)
+    {
+        TArray<T> sorted;
+        sorted.Reserve(order.Num());
+
+        for (int32 i : order)
+        {
+            sorted.Add(column[i]);
+        }
+
+        column = MoveTemp(sorted);
+    }
+};
+
+//One event of a container, passed to the draw and animation functions in place of a copy of the event.
+//Valid only while the container is neither changed nor moved.
+struct FTelemetryEventView
+{
+    const SEventEditorContainer* container;
+    int32 index;
+
+    FTelemetryEventView(const SEventEditorContainer& inContainer, int32 inIndex) : container(&inContainer), index(inIndex) {}
+
+    const FVector& GetPoint() const { return container->points[index]; }
+    const FVector& GetOrientation() const { return container->orientations[index]; }
+    FDateTime GetTime() const { return container->GetTime(index); }
+    int32 GetCount() const { return container->counts[index]; }
+    const FString& GetName() const { return container->eventname; }
+    const FString& GetCategory() const { return container->GetCategory(index); }
+    const FString& GetSession() const { return container->GetSession(index); }
+    const FString& GetBuild() const { return container->GetBuild(index); }
+};
+
+//Builds event containers straight from a query response, grouping events by name
+//Recognized fields go to their typed slots and "val_"/"pct_" fields become numeric values.
+//A builder holds one page and runs on a worker thread, so it only touches its own collection until it is handed over.
+class FEventCollectionBuilder : public IQueryResultSink
+{
+private:
+    TArray<SEventEditorContainer> collection;
+    STelemetryEvent current;
+    FString buildType;
+    FString buildId;
+    FString platform;
+    int lastIndex;
+
+    //Name of each group in the collection, so events are grouped by comparing handles
+    TArray<FTelemetryStringHandle> collectionNames;
+
+    FTelemetryStringCache nameCache;
+    FTelemetryStringCache categoryCache;
+    FTelemetryStringCache sessionCache;
+    FTelemetryStringCache buildCache;
+
+    //Time spent grouping and sorting events, as opposed to reading them
+    uint64 groupCycles;
+
+    //Optional column copy of the page, so later queries can be answered from it locally
+    FQueryResultColumns columns;
+    TSharedPtr<FQueryColumnSink> columnSink;
+
+public:
+    FEventCollectionBuilder(bool keepColumns = false) : lastIndex(-1), groupCycles(0)
+    {
+        if (keepColumns)
+        {
+            columnSink = MakeShareable(new FQueryColumnSink(columns));
+        }
+    }
+
+    //Grouped events of the page, ready once EndPage has run
+    TArray<SEventEditorContainer>& GetCollection()
+    {
+        return collection;
+    }
+
+    //Milliseconds of the page spent grouping events
+    double GetGroupTime() const
+    {
+        return FPlatformTime::ToMilliseconds64(groupCycles);
+    }
+
+    //Column copy of the page, or nullptr if the builder was not asked to keep one
+    FQueryResultColumns* GetColumns()
+    {
+        return columnSink.IsValid() ? &columns : nullptr;
+    }
+
+    void BeginEvent() override
+    {
+        if (columnSink.IsValid())
+        {
+            columnSink->BeginEvent();
+        }
+
+        current.Reset();
+        buildType.Reset();
+        buildId.Reset();
+        platform.Reset();
+    }
+
+    void SetNumber(EQueryResultField field, const FString& name, double value) override
+    {
+        if (columnSink.IsValid())
+        {
+            columnSink->SetNumber(field, name, value);
+        }
+
+        switch (field)
+        {
+        case EQueryResultField::PlayerPositionX: current.point.X = value; break;
+        case EQueryResultField::PlayerPositionY: current.point.Y = value; break;
+        case EQueryResultField::PlayerPositionZ: current.point.Z = value; break;
+        case EQueryResultField::PlayerDirectionX: current.orientation.X = value; break;
+        case EQueryResultField::PlayerDirectionY: current.orientation.Y = value; break;
+        case EQueryResultField::PlayerDirectionZ: current.orientation.Z = value; break;
+        case EQueryResultField::Count: current.count = value >= 1 ? (int32)value : 1; break;
+        case EQueryResultField::Other:
+            if (IsAttribute(name))
+            {
+                current.values.Add(name, value);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    void SetString(EQueryResultField field, const FString& name, const TCHAR* value, int32 length) override
+    {
+        if (columnSink.IsValid())
+        {
+            columnSink->SetString(field, name, value, length);
+        }
+
+        switch (field)
+        {
+        case EQueryResultField::Name: current.name = nameCache.Intern(value, length); break;
+        case EQueryResultField::Category: current.category = categoryCache.Intern(value, length); break;
+        case EQueryResultField::SessionId: current.session = sessionCache.Intern(value, length); break;
+        case EQueryResultField::BuildType: buildType.AppendChars(value, length); break;
+        case EQueryResultField::BuildId: buildId.AppendChars(value, length); break;
+        case EQueryResultField::Platform: platform.AppendChars(value, length); break;
+        case EQueryResultField::ClientTimestamp: FDateTime::ParseIso8601(value, current.time); break;
+        case EQueryResultField::Other:
+            if (IsAttribute(name))
+            {
+                current.values.Add(name, FCString::Atod(value));
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    void SetBool(EQueryResultField field, const FString& name, bool value) override
+    {
+        if (columnSink.IsValid())
+        {
+            columnSink->SetBool(field, name, value);
+        }
+
+        if (field == EQueryResultField::Other && IsAttribute(name))
+        {
+            current.values.Add(name, value ? 1.0 : 0.0);
+        }
+    }
+
+    void EndEvent() override
+    {
+        if (columnSink.IsValid())
+        {
+            columnSink->EndEvent();
+        }
+
+        const FString build = buildType + L" " + buildId + L" " + platform;
+        current.build = buildCache.Intern(*build, build.Len());
+        AddToCollection(current);
+    }
+
+    //Builds the events straight from the columns, without formatting and parsing every field again
+    bool AddColumns(const FQueryResultColumns& other) override
+    {
+        if (columnSink.IsValid())
+        {
+            columnSink->AddColumns(other);
+        }
+
+        //Each dictionary entry of the columns is interned once
+        FTelemetryStringTable& table = FTelemetryStringTable::Get();
+        auto internAll = [&table](const FQueryStringColumn& column, TArray<FTelemetryStringHandle>& handles)
+        {
+            for (const FString& text : column.GetDictionary())
+            {
+                handles.Add(table.Intern(text));
+            }
+        };
+
+        TArray<FTelemetryStringHandle> names;
+        TArray<FTelemetryStringHandle> categories;
+        TArray<FTelemetryStringHandle> sessions;
+        internAll(other.Name, names);
+        internAll(other.Category, categories);
+        internAll(other.Session, sessions);
+
+        STelemetryEvent event;
+
+        for (int32 row = 0; row < other.Num(); row++)
+        {
+            event.Reset();
+            const FString build = other.GetBuild(row);
+
+            event.name = names[other.Name.GetIndex(row)];
+            event.category = categories[other.Category.GetIndex(row)];
+            event.session = sessions[other.Session.GetIndex(row)];
+            event.build = buildCache.Intern(*build, build.Len());
+            event.point = other.Position.Get(row);
+            event.orientation = other.Direction.Get(row);
+            event.time = other.GetTime(row);
+            event.count = FMath::Max(other.Counts[row], 1);
+
+            for (const FQueryValueColumn& column : other.Values)
+            {
+                if (column.HasValue(row))
+                {
+                    event.values.Add(column.Name, column.Values[row]);
+                }
+            }
+
+            AddToCollection(event);
+        }
+
+        return true;
+    }
+
+    void EndPage() override
+    {
+        const uint64 startCycles = FPlatformTime::Cycles64();
+
+        for (auto& container : collection)
+        {
+            container.SortEvents();
+            container.SetupTimes();
+        }
+
+        groupCycles += FPlatformTime::Cycles64() - startCycles;
+    }
+
+private:
+    static bool IsAttribute(const FString& name)
+    {
+        return name.StartsWith("pct_") || name.StartsWith("val_");
+    }
+
+    void AddToCollection(const STelemetryEvent& event)
+    {
+        const uint64 startCycles = FPlatformTime::Cycles64();
+
+        //Events of the same name tend to arrive together, so check the last group first
+        if (!collectionNames.IsValidIndex(lastIndex) || collectionNames[lastIndex] != event.name)
+        {
+            lastIndex = collectionNames.Find(event.name);
+
+            if (lastIndex == INDEX_NONE)
+            {
+                lastIndex = collection.Emplace(SEventEditorContainer(event.GetName(), collection.Num()));
+                collectionNames.Add(event.name);
+            }
+        }
+
+        collection[lastIndex].AddEvent(event);
+
+        groupCycles += FPlatformTime::Cycles64() - startCycles;
+    }
 };
 
 //Types of heatmaps offered
@@ -450,6 +1132,21 @@ static const TArray<FString> QueryExpectedStrings =
     "session_id"
 };
 
+//Fields every query asks the server for.  Enough to place, animate and group events, and to find one again later
+static const TArray<FString> QueryViewportColumns =
+{
+    "pos_x",
+    "pos_y",
+    "pos_z",
+    "dir_x",
+    "dir_y",
+    "dir_z",
+    "client_ts",
+    "name",
+    "session_id",
+    "count"
+};
+
 static enum QueryField
 {
     Category,
@@ -592,7 +1289,7 @@ public:
 
             if (nextIndexDraw > 0)
             {
-                localStartTime -= eventContainer->events[nextIndexDraw]->time - eventContainer->events[eventContainer->events.Num() - 1]->time;
+                localStartTime -= eventContainer->GetTime(nextIndexDraw) - eventContainer->GetTime(eventContainer->Num() - 1);
             }
         }
         else if (state == AnimationState::Stopped)
@@ -602,7 +1299,7 @@ public:
 
             if(speed >= 0)
             {
-                nextIndexDraw = eventContainer->events.Num() - 1;
+                nextIndexDraw = eventContainer->Num() - 1;
             }
             else
             {
@@ -620,7 +1317,7 @@ public:
 
             if (nextIndexDraw > 0)
             {
-                localStartTime -= eventContainer->events[nextIndexDraw]->time - eventContainer->events[eventContainer->events.Num() - 1]->time;
+                localStartTime -= eventContainer->GetTime(nextIndexDraw) - eventContainer->GetTime(eventContainer->Num() - 1);
             }
 
             state = AnimationState::Playing;
@@ -642,7 +1339,7 @@ public:
         if (eventContainer == nullptr) return;
         state = AnimationState::Stopped;
         playSpeed = 0;
-        nextIndexDraw = eventContainer->events.Num() - 1;
+        nextIndexDraw = eventContainer->Num() - 1;
         eventContainer->SetShouldAnimate(false);
     }
 
@@ -655,14 +1352,14 @@ public:
     {
         if (nextIndexDraw <= 0)
         {
-            return eventContainer->events.Num() - 1;
+            return eventContainer->Num() - 1;
         }
 
         return nextIndexDraw - 1;
     }
 
-    //Provides an array of pointers to events that are ready to draw for the animation
-    TArray<TSharedPtr<STelemetryEvent>> GetNextEvents()
+    //Provides views of the events that are ready to draw for the animation
+    TArray<FTelemetryEventView> GetNextEvents()
     {
         if (nextIndexDraw <= 0)
         {
@@ -670,22 +1367,22 @@ public:
             eventContainer->SetShouldDraw(true);
         }
 
-        TArray<TSharedPtr<STelemetryEvent>> newArray;
+        TArray<FTelemetryEventView> newArray;
 
         if (playSpeed >= 0)
         {
-            FDateTime tempTime = eventContainer->events[eventContainer->events.Num() - 1]->time + ((FDateTime::UtcNow() - localStartTime) * playSpeed);
+            FDateTime tempTime = eventContainer->GetTime(eventContainer->Num() - 1) + ((FDateTime::UtcNow() - localStartTime) * playSpeed);
 
-            while (nextIndexDraw >= 0 && eventContainer->events[nextIndexDraw]->time < tempTime)
+            while (nextIndexDraw >= 0 && eventContainer->GetTime(nextIndexDraw) < tempTime)
             {
-                newArray.Add(eventContainer->events[nextIndexDraw]);
+                newArray.Add(FTelemetryEventView(*eventContainer, nextIndexDraw));
                 nextIndexDraw--;
             }
 
             if (newArray.Num() == 0 && nextIndexDraw >= 0)
             {
                 //Skip ahead if the gap between events is too long
-                FTimespan timeToNext = eventContainer->events[nextIndexDraw]->time - tempTime;
+                FTimespan timeToNext = eventContainer->GetTime(nextIndexDraw) - tempTime;
                 if (timeToNext > FTimespan(0, 0, 30))
                 {
                     localStartTime -= timeToNext - FTimespan(0, 0, 5);
@@ -709,9 +1406,9 @@ public:
 
         if (playSpeed >= 0)
         {
-            FDateTime tempTime = eventContainer->events[eventContainer->events.Num() - 1]->time + ((FDateTime::UtcNow() - localStartTime) * playSpeed);
+            FDateTime tempTime = eventContainer->GetTime(eventContainer->Num() - 1) + ((FDateTime::UtcNow() - localStartTime) * playSpeed);
 
-            while (nextIndexDraw >= 0 && eventContainer->events[nextIndexDraw]->time < tempTime)
+            while (nextIndexDraw >= 0 && eventContainer->GetTime(nextIndexDraw) < tempTime)
             {
                 newEvents = true;
                 nextIndexDraw--;
@@ -720,7 +1417,7 @@ public:
             if (!newEvents && nextIndexDraw >= 0)
             {
                 //Skip ahead if the gap between events is too long
-                FTimespan timeToNext = eventContainer->events[nextIndexDraw]->time - tempTime;
+                FTimespan timeToNext = eventContainer->GetTime(nextIndexDraw) - tempTime;
                 if (timeToNext > FTimespan(0, 0, 30))
                 {
                     localStartTime -= timeToNext - FTimespan(0, 0, 5);
@@ -736,31 +1433,31 @@ public:
         return nextIndexDraw;
     }
 
-    //Provides an array of pointers to events that are ready to draw for the animation (in reverse)
-    TArray<TSharedPtr<STelemetryEvent>> GetPrevEvents()
+    //Provides views of the events that are ready to draw for the animation (in reverse)
+    TArray<FTelemetryEventView> GetPrevEvents()
     {
-        TArray<TSharedPtr<STelemetryEvent>> newArray;
+        TArray<FTelemetryEventView> newArray;
 
         if (playSpeed < 0)
         {
-            if (nextIndexDraw >= eventContainer->events.Num() - 1)
+            if (nextIndexDraw >= eventContainer->Num() - 1)
             {
                 Stop();
                 eventContainer->SetShouldDraw(false);
             }
 
-            FDateTime tempTime = eventContainer->events[0]->time + ((FDateTime::UtcNow() - localStartTime) * playSpeed);
+            FDateTime tempTime = eventContainer->GetTime(0) + ((FDateTime::UtcNow() - localStartTime) * playSpeed);
 
-            while (nextIndexDraw < eventContainer->events.Num() && eventContainer->events[nextIndexDraw]->time > tempTime)
+            while (nextIndexDraw < eventContainer->Num() && eventContainer->GetTime(nextIndexDraw) > tempTime)
             {
-                newArray.Add(eventContainer->events[nextIndexDraw]);
+                newArray.Add(FTelemetryEventView(*eventContainer, nextIndexDraw));
                 nextIndexDraw++;
             }
 
-            if (newArray.Num() == 0 && nextIndexDraw < eventContainer->events.Num())
+            if (newArray.Num() == 0 && nextIndexDraw < eventContainer->Num())
             {
                 //Skip ahead if the gap between events is too long
-                FTimespan timeToNext = eventContainer->events[nextIndexDraw]->time - tempTime;
+                FTimespan timeToNext = eventContainer->GetTime(nextIndexDraw) - tempTime;
                 if (timeToNext > FTimespan(0, 0, 30))
                 {
                     localStartTime += timeToNext - FTimespan(0, 0, 5);
@@ -776,34 +1473,34 @@ public:
     {
         if (playSpeed < 0)
         {
-            if (nextIndexDraw >= eventContainer->events.Num() - 1)
+            if (nextIndexDraw >= eventContainer->Num() - 1)
             {
                 Stop();
                 //eventContainer->SetShouldDraw(false);
             }
 
-            FDateTime tempTime = eventContainer->events[0]->time + ((FDateTime::UtcNow() - localStartTime) * playSpeed);
+            FDateTime tempTime = eventContainer->GetTime(0) + ((FDateTime::UtcNow() - localStartTime) * playSpeed);
             bool newEvents = false;
 
-            while (nextIndexDraw < eventContainer->events.Num() && eventContainer->events[nextIndexDraw]->time > tempTime)
+            while (nextIndexDraw < eventContainer->Num() && eventContainer->GetTime(nextIndexDraw) > tempTime)
             {
                 newEvents = true;
                 nextIndexDraw++;
             }
 
-            if (!newEvents && nextIndexDraw < eventContainer->events.Num())
+            if (!newEvents && nextIndexDraw < eventContainer->Num())
             {
                 //Skip ahead if the gap between events is too long
-                FTimespan timeToNext = eventContainer->events[nextIndexDraw]->time - tempTime;
+                FTimespan timeToNext = eventContainer->GetTime(nextIndexDraw) - tempTime;
                 if (timeToNext > FTimespan(0, 0, 30))
                 {
                     localStartTime += timeToNext - FTimespan(0, 0, 5);
                 }
             }
 
-            if (nextIndexDraw >= eventContainer->events.Num())
+            if (nextIndexDraw >= eventContainer->Num())
             {
-                nextIndexDraw = eventContainer->events.Num() - 1;
+                nextIndexDraw = eventContainer->Num() - 1;
             }
         }
 
@@ -819,9 +1516,9 @@ public:
 
         localStartTime = FDateTime::UtcNow();
 
-        if (newIndexDraw > 0 && newIndexDraw < eventContainer->events.Num() - 1)
+        if (newIndexDraw > 0 && newIndexDraw < eventContainer->Num() - 1)
         {
-            localStartTime -= eventContainer->events[newIndexDraw]->time - eventContainer->events[eventContainer->events.Num() - 1]->time;
+            localStartTime -= eventContainer->GetTime(newIndexDraw) - eventContainer->GetTime(eventContainer->Num() - 1);
         }
 
         needRefresh = true;
@@ -14,6 +14,7 @@
 #include "IMeshMergeUtilities.h"
 #include "MeshMergeModule.h"
 #include "Engine/StaticMeshActor.h"
+#include "Engine/Selection.h"
 #include "Materials/MaterialInstanceDynamic.h"
 #include "UObject/ConstructorHelpers.h"
 #include "Async/Async.h"
@@ -29,6 +30,8 @@ void FTelemetryVisualizerUI::Initialize()
     m_PIEDrawTarget = nullptr;
     m_registeredWidget = false;
     m_needsActorUpdate = true;
+    m_isTimingQuery = false;
+    m_isTimingDraw = false;
 
     //Default event list
     m_anim_scrollBarLocation = 0.f;
@@ -46,6 +49,9 @@ void FTelemetryVisualizerUI::Initialize()
     m_heatmapMaxValue = -1;
     m_heatmapOrientation = false;
     m_heatmapAnimation = false;
+    m_heatmapPending = false;
+    m_heatmapAggregates = true;
+    m_heatmapBinLoaded = false;
 
     //Default list of render shapes
     for (int i = 0; i < ShapeListStrings.Num(); i++)
@@ -127,6 +133,7 @@ void FTelemetryVisualizerUI::Initialize()
     m_tickDelegateHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(this, &FTelemetryVisualizerUI::UpdateDraw));
     m_startPIEDelegateHandle = FEditorDelegates::PostPIEStarted.AddRaw(this, &FTelemetryVisualizerUI::PIEStarted);
     m_endPIEDelegateHandle = FEditorDelegates::EndPIE.AddRaw(this, &FTelemetryVisualizerUI::PIEEnded);
+    m_selectObjectDelegateHandle = USelection::SelectObjectEvent.AddRaw(this, &FTelemetryVisualizerUI::OnObjectSelected);
 }
 
 void FTelemetryVisualizerUI::Shutdown()
@@ -134,6 +141,7 @@ void FTelemetryVisualizerUI::Shutdown()
     FTicker::GetCoreTicker().RemoveTicker(m_tickDelegateHandle);
     FEditorDelegates::PostPIEStarted.Remove(m_startPIEDelegateHandle);
     FEditorDelegates::PostPIEStarted.Remove(m_endPIEDelegateHandle);
+    USelection::SelectObjectEvent.Remove(m_selectObjectDelegateHandle);
 
     FGlobalTabmanager::Get()->UnregisterTabSpawner(TelemetryDataIndirectTabName);
     FGlobalTabmanager::Get()->UnregisterTabSpawner(TelemetryVizIndirectTabName);
@@ -169,6 +177,62 @@ TSharedRef<SWidget> FTelemetryVisualizerUI::MakeWidgetForOption(TSharedPtr<FStri
 }
 
 /////////////////////////////////DRAW TO WORLD/////////////////////////////////
+//Events are drawn from only the fields needed to place them, so the rest of an event is fetched once it is selected
+void FTelemetryVisualizerUI::OnObjectSelected(UObject* object)
+{
+    ATelemetryEvent* actor = Cast<ATelemetryEvent>(object);
+
+    //Heatmap actors stand for many events and have no session of their own
+    if (actor == nullptr || actor->HasDetails() || actor->session.IsEmpty() || m_queryColumns.Num() == 0)
+    {
+        return;
+    }
+
+    //Times are kept to the millisecond, so the session and time find the event along with any sent in the same millisecond
+    FQueryNodeList nodes;
+    nodes.Add(QBuilder::Eq(TEXT("session_id"), actor->session));
+    nodes.Add(QBuilder::Btwn(TEXT("client_ts"), actor->time.ToIso8601(), (actor->time + FTimespan::FromMilliseconds(1)).ToIso8601()));
+
+    TWeakObjectPtr<ATelemetryEvent> weakActor(actor);
+
+    m_detailExecuter.CancelQuery();
+    m_detailExecuter.ExecuteCustomQuery(m_querySerializer.Serialize(QBuilder::And(MoveTemp(nodes))), QueryResultHandler::CreateLambda([this, weakActor](TSharedPtr<SQueryResult> results)
+    {
+        m_detailExecuter.CancelQuery();
+
+        ATelemetryEvent* selected = weakActor.Get();
+        if (selected == nullptr || selected->HasDetails())
+        {
+            return;
+        }
+
+        //The event drawn at the actor is the one selected
+        FSimpleEvent* nearest = nullptr;
+        float nearestDistance = MAX_FLT;
+
+        for (auto& event : results->Events)
+        {
+            float distance = FVector::DistSquared(event.GetPlayerPosition(), selected->location);
+            if (distance < nearestDistance)
+            {
+                nearest = &event;
+                nearestDistance = distance;
+            }
+        }
+
+        if (nearest != nullptr)
+        {
+            selected->SetDetails(*nearest);
+
+            //Shows the new values in the details panel
+            if (GEditor != nullptr)
+            {
+                GEditor->NoteSelectionChange();
+            }
+        }
+    }), DetailQueryTakeLimit, FQueryResultSinkFactory(), false);
+}
+
 UWorld* FTelemetryVisualizerUI::GetLocalWorld()
 {
     UWorld* foundWorld = nullptr;
@@ -191,6 +255,8 @@ UWorld* FTelemetryVisualizerUI::GetLocalWorld()
 
 bool FTelemetryVisualizerUI::UpdateDraw(float val)
 {
+    UpdateLiveQuery();
+
     UWorld* currentTarget = GetLocalWorld();
 
     if (currentTarget == nullptr)
@@ -203,6 +269,11 @@ bool FTelemetryVisualizerUI::UpdateDraw(float val)
         DrawTelemetry(currentTarget, m_filterCollection);
     }
 
+    if (m_isTimingDraw)
+    {
+        FinishQueryTiming();
+    }
+
     return true;
 }
 
@@ -237,85 +308,63 @@ void FTelemetryVisualizerUI::UpdateGameState(bool allowPIE)
     }
 }
 
-void FTelemetryVisualizerUI::CreateActor(UWorld* drawTarget, int index, TSharedPtr<STelemetryEvent> data, FColor color, EventType shape)
+void FTelemetryVisualizerUI::CreateActor(UWorld* drawTarget, int index, const FTelemetryEventView& data, FColor color, EventType shape)
 {
     ATelemetryEvent* tempActor;
     FString tempName;
 
-    tempName = data->eventname + FString::FromInt(index);
+    tempName = data.GetName() + FString::FromInt(index);
 
     FActorSpawnParameters params;
     params.Name = *tempName;
 
     FRotator tempRot = FRotator::ZeroRotator;
-    if (data->orientation != FVector::ZeroVector)
+    if (data.GetOrientation() != FVector::ZeroVector)
     {
-        tempRot = data->orientation.Rotation();
+        tempRot = data.GetOrientation().Rotation();
     }
 
-    tempActor = drawTarget->SpawnActor<ATelemetryEvent>(data->point, tempRot, params);
+    tempActor = drawTarget->SpawnActor<ATelemetryEvent>(data.GetPoint(), tempRot, params);
     tempActor->SetActorLabel(*tempName);
 
-    tempActor->AddEvent(data->point, data->orientation, color, shape);
+    tempActor->AddEvent(data.GetPoint(), data.GetOrientation(), color, shape);
     tempActor->SetEvent(data);
 
-    tempName = "/TelemetryEvents/" + FString(data->eventname);
+    tempName = "/TelemetryEvents/" + data.GetName();
     tempActor->SetFolderPath(*tempName);
 
     m_eventActors.Add(tempActor);
 }
 
-void FTelemetryVisualizerUI::CreateActors(UWorld* drawTarget, TArray<TSharedPtr<STelemetryEvent>> data, FColor color, EventType shape)
+void FTelemetryVisualizerUI::CreateActors(UWorld* drawTarget, const SEventEditorContainer& data, FColor color, EventType shape)
 {
-    ATelemetryEvent* tempActor;
-    FString tempName;
-
     for (int i = 0; i < data.Num(); i++)
     {
-        tempName = data[i]->eventname + FString::FromInt(i);
-
-        FActorSpawnParameters params;
-        params.Name = *tempName;
-
-        FRotator tempRot = FRotator::ZeroRotator;
-        if (data[i]->orientation != FVector::ZeroVector)
-        {
-            tempRot = data[i]->orientation.Rotation();
-        }
-
-        tempActor = drawTarget->SpawnActor<ATelemetryEvent>(data[i]->point, tempRot, params);
-        tempActor->SetActorLabel(*tempName);
-
-        tempActor->AddEvent(data[i]->point, data[i]->orientation, color, shape);
-        tempActor->SetEvent(data[i]);
-
-        tempName = "/TelemetryEvents/" + FString(data[i]->eventname);
-        tempActor->SetFolderPath(*tempName);
-
-        m_eventActors.Add(tempActor);
+        CreateActor(drawTarget, i, FTelemetryEventView(data, i), color, shape);
     }
 }
 
-void FTelemetryVisualizerUI::CreateActors(UWorld* drawTarget, TArray<TSharedPtr<STelemetryEvent>> data, int start, int end, FColor color, EventType shape)
+void FTelemetryVisualizerUI::CreateActors(UWorld* drawTarget, const SEventEditorContainer& data, int start, int end, FColor color, EventType shape)
 {
     ATelemetryEvent* tempActor;
+
+    //Every event of the group shares its name and folder
+    const FString folder = "/TelemetryEvents/" + data.eventname;
     FString tempName;
 
     for (int i = start; i < end; i++)
     {
-        tempName = data[i]->eventname + FString::FromInt(i);
+        tempName = data.eventname + FString::FromInt(i);
 
         FActorSpawnParameters params;
         params.Name = *tempName;
 
-        tempActor = drawTarget->SpawnActor<ATelemetryEvent>(data[i]->point, FRotator::ZeroRotator, params);
+        tempActor = drawTarget->SpawnActor<ATelemetryEvent>(data.points[i], FRotator::ZeroRotator, params);
         tempActor->SetActorLabel(*tempName);
 
-        tempActor->AddEvent(data[i]->point, data[i]->orientation, color, shape);
-        tempActor->SetEvent(data[i]);
-
-        tempName = "/TelemetryEvents/" + FString(data[i]->eventname);
-        tempActor->SetFolderPath(*tempName);
+        tempActor->AddEvent(data.points[i], data.orientations[i], color, shape);
+        tempActor->SetEvent(FTelemetryEventView(data, i));
+        tempActor->SetFolderPath(*folder);
 
         m_eventActors.Add(tempActor);
     }
@@ -347,57 +396,57 @@ void FTelemetryVisualizerUI::DestroyLastActor()
     }
 }
 
-void FTelemetryVisualizerUI::DrawPoint(UWorld* drawTarget, TSharedPtr<STelemetryEvent> data, FColor color)
+void FTelemetryVisualizerUI::DrawPoint(UWorld* drawTarget, const FTelemetryEventView& data, FColor color)
 {
-    DrawDebugPoint(drawTarget, data->point, 5.f, color, true);
+    DrawDebugPoint(drawTarget, data.GetPoint(), 5.f, color, true);
 }
 
-void FTelemetryVisualizerUI::DrawPoints(UWorld* drawTarget, TArray<TSharedPtr<STelemetryEvent>> data, FColor color)
+void FTelemetryVisualizerUI::DrawPoints(UWorld* drawTarget, const SEventEditorContainer& data, FColor color)
 {
     DrawPoints(drawTarget, data, 0, data.Num(), color);
 }
 
-void FTelemetryVisualizerUI::DrawPoints(UWorld* drawTarget, TArray<TSharedPtr<STelemetryEvent>> data, int start, int end, FColor color)
+void FTelemetryVisualizerUI::DrawPoints(UWorld* drawTarget, const SEventEditorContainer& data, int start, int end, FColor color)
 {
     for (int i = start; i < end; i++)
     {
-        DrawPoint(drawTarget, (TSharedPtr<STelemetryEvent>)data[i], color);
+        DrawDebugPoint(drawTarget, data.points[i], 5.f, color, true);
     }
 }
 
-void FTelemetryVisualizerUI::DrawSphere(UWorld* drawTarget, TSharedPtr<STelemetryEvent> data, FColor color)
+void FTelemetryVisualizerUI::DrawSphere(UWorld* drawTarget, const FTelemetryEventView& data, FColor color)
 {
-    DrawDebugSphere(drawTarget, data->point, 26.f, 12, color, true);
+    DrawDebugSphere(drawTarget, data.GetPoint(), 26.f, 12, color, true);
 }
 
-void FTelemetryVisualizerUI::DrawSpheres(UWorld* drawTarget, TArray<TSharedPtr<STelemetryEvent>> data, FColor color)
+void FTelemetryVisualizerUI::DrawSpheres(UWorld* drawTarget, const SEventEditorContainer& data, FColor color)
 {
     DrawSpheres(drawTarget, data, 0, data.Num(), color);
 }
 
-void FTelemetryVisualizerUI::DrawSpheres(UWorld* drawTarget, TArray<TSharedPtr<STelemetryEvent>> data, int start, int end, FColor color)
+void FTelemetryVisualizerUI::DrawSpheres(UWorld* drawTarget, const SEventEditorContainer& data, int start, int end, FColor color)
 {
     for (int i = start; i < end; i++)
     {
-        DrawSphere(drawTarget, (TSharedPtr<STelemetryEvent>)data[i], color);
+        DrawDebugSphere(drawTarget, data.points[i], 26.f, 12, color, true);
     }
 }
 
-void FTelemetryVisualizerUI::DrawCube(UWorld* drawTarget, TSharedPtr<STelemetryEvent> data, FColor color)
+void FTelemetryVisualizerUI::DrawCube(UWorld* drawTarget, const FTelemetryEventView& data, FColor color)
 {
-    DrawDebugBox(drawTarget, data->point, FVector(5.f, 5.f, 5.f), color, true);
+    DrawDebugBox(drawTarget, data.GetPoint(), FVector(5.f, 5.f, 5.f), color, true);
 }
 
-void FTelemetryVisualizerUI::DrawCubes(UWorld* drawTarget, TArray<TSharedPtr<STelemetryEvent>> data, FColor color)
+void FTelemetryVisualizerUI::DrawCubes(UWorld* drawTarget, const SEventEditorContainer& data, FColor color)
 {
     DrawCubes(drawTarget, data, 0, data.Num(), color);
 }
 
-void FTelemetryVisualizerUI::DrawCubes(UWorld* drawTarget, TArray<TSharedPtr<STelemetryEvent>> data, int start, int end, FColor color)
+void FTelemetryVisualizerUI::DrawCubes(UWorld* drawTarget, const SEventEditorContainer& data, int start, int end, FColor color)
 {
     for (int i = start; i < end; i++)
     {
-        DrawCube(drawTarget, (TSharedPtr<STelemetryEvent>)data[i], color);
+        DrawDebugBox(drawTarget, data.points[i], FVector(5.f, 5.f, 5.f), color, true);
     }
 }
 
@@ -418,10 +467,9 @@ void FTelemetryVisualizerUI::DrawTelemetry(UWorld* drawTarget, TArray<SEventEdit
                     int j = 0;
                     if (eventContainer != nullptr)
                     {
-                        for (auto currEvent : eventContainer->events)
+                        for (j = 0; j < eventContainer->Num(); j++)
                         {
-                            CreateActor(drawTarget, j, (TSharedPtr<STelemetryEvent>)currEvent, m_anim_Control.GetColor(), m_anim_Control.GetShapeType());
-                            j++;
+                            CreateActor(drawTarget, j, FTelemetryEventView(*eventContainer, j), m_anim_Control.GetColor(), m_anim_Control.GetShapeType());
                         }
                     }
                 }
@@ -429,7 +477,7 @@ void FTelemetryVisualizerUI::DrawTelemetry(UWorld* drawTarget, TArray<SEventEdit
                 FlushPersistentDebugLines(drawTarget);
             }
 
-            TArray<TSharedPtr<STelemetryEvent>> tempArray;
+            TArray<FTelemetryEventView> tempArray;
 
             if (m_anim_Control.GetPlaySpeed() >= 0)
             {
@@ -442,7 +490,7 @@ void FTelemetryVisualizerUI::DrawTelemetry(UWorld* drawTarget, TArray<SEventEdit
                     m_anim_scrollBarLocation = m_anim_Control.GetTimeScaleFromTime();
                     if (start != next)
                     {
-                        GenerateHeatmap(tempContainer, next, tempContainer->events.Num() - 1);
+                        GenerateHeatmap(tempContainer, next, tempContainer->Num() - 1);
                     }
                 }
                 else
@@ -451,9 +499,9 @@ void FTelemetryVisualizerUI::DrawTelemetry(UWorld* drawTarget, TArray<SEventEdit
                     tempArray = m_anim_Control.GetNextEvents();
                     int i = m_anim_Control.GetNextIndex();
                     m_anim_scrollBarLocation = m_anim_Control.GetTimeScaleFromTime();
-                    for (auto currEvent : tempArray)
+                    for (auto& currEvent : tempArray)
                     {
-                        CreateActor(drawTarget, i, (TSharedPtr<STelemetryEvent>)currEvent, m_anim_Control.GetColor(), m_anim_Control.GetShapeType());
+                        CreateActor(drawTarget, i, currEvent, m_anim_Control.GetColor(), m_anim_Control.GetShapeType());
                         i++;
                     }
                 }
@@ -469,7 +517,7 @@ void FTelemetryVisualizerUI::DrawTelemetry(UWorld* drawTarget, TArray<SEventEdit
                     m_anim_scrollBarLocation = 1 + m_anim_Control.GetTimeScaleFromTime();
                     if (start != next)
                     {
-                        GenerateHeatmap(tempContainer, next, tempContainer->events.Num() - 1);
+                        GenerateHeatmap(tempContainer, next, tempContainer->Num() - 1);
                     }
                 }
                 else
@@ -513,6 +561,8 @@ void FTelemetryVisualizerUI::DrawTelemetry(UWorld* drawTarget, TArray<SEventEdit
     {
         if (m_needsActorUpdate)
         {
+            const double drawStart = FPlatformTime::Seconds();
+
             //Draw data points
             m_needsActorUpdate = false;
             DestroyActors();
@@ -523,11 +573,16 @@ void FTelemetryVisualizerUI::DrawTelemetry(UWorld* drawTarget, TArray<SEventEdit
                 if (events->ShouldDraw())
                 {
                     int startIndex = 0;
-                    int endIndex = events->events.Num();
+                    int endIndex = events->Num();
 
-                    CreateActors(drawTarget, events->events, startIndex, endIndex, events->GetColor(), events->GetShapeType());
+                    CreateActors(drawTarget, *events, startIndex, endIndex, events->GetColor(), events->GetShapeType());
                 }
             }
+
+            if (m_isTimingDraw)
+            {
+                m_queryTiming.Draw += (FPlatformTime::Seconds() - drawStart) * 1000;
+            }
         }
     }
 
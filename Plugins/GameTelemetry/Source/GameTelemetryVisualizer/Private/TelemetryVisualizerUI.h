@@ -24,12 +24,22 @@
 #include "DrawDebugHelpers.h"
 #include "Containers/Ticker.h"
 #include "TelemetryEvent.h"
+#include "TelemetryVisualizerTypes.h"
 #include "Query/TelemetryQuery.h"
+#include "Query/TelemetryQueryEvaluator.h"
+#include "Query/TelemetryQueryOptimizer.h"
+#include "Query/TelemetryQueryAggregate.h"
+#include "Query/TelemetryQueryImport.h"
+#include "Query/TelemetryQueryTimings.h"
 #include "Slate.h"
 #include "Query/TelemetryQuery.h"
 
 static const float MinHeatmapSize = 50.f;
 static const float MaxHeatmapSize = 1000.f;
+static const float MinLivePollInterval = 1.f;
+static const float MaxLivePollInterval = 30.f;
+static const int32 AttributeSampleSize = 100;
+static const int32 DetailQueryTakeLimit = 10;
 
 class FTelemetryVisualizerUI
 {
@@ -65,9 +75,15 @@ public:
 
     //Event Collection
     void QueryResults(TSharedPtr<SQueryResult> results);
+    void QueryProgress(EQueryStage stage, int32 pageIndex, int32 bytesReceived);
     FReply UpdateFilterEvents();
     int FilterEvents();
     void CollectEvents(FQueryNodePtr query);
+    void RefineEvents(FQueryNodePtr query, TSharedPtr<FQueryEvaluator> evaluator);
+    FQueryResultColumns& GetMutableLoadedColumns();
+    TArray<FString> GetQueryColumns() const;
+    void RequestAttributeNames(const FString& eventName);
+    void OnObjectSelected(UObject* object);
     void GenerateScrollBoxes(int count);
 
     //Viz tab event selection
@@ -89,6 +105,18 @@ public:
     FReply AddClause(int index);
     FReply RemoveClause(int index);
     FReply SubmitQuery();
+    FReply CancelQuery();
+    void StopQuery();
+    void BeginQueryTiming(const FString& query, const FString& source);
+    void FinishQueryTiming();
+    FReply ImportFile();
+    void ImportEventFile(const FString& path);
+
+    //Live updates
+    void OnLiveChecked(ECheckBoxState NewState);
+    void UpdateLiveQuery();
+    void LiveQueryResults(TSharedPtr<SQueryResult> results);
+    FDateTime GetNewestEventTime() const;
     FText GetButtonString() const;
 
     //Event filter Scroll box
@@ -116,6 +144,10 @@ public:
     FText GetHeatmapShapeTypeItem() const;
     FReply GenerateHeatmap();
     FReply GenerateHeatmap(SEventEditorContainer* collection, int first, int last);
+    void RequestHeatmap(const FString& eventName);
+    void HeatmapResults(TSharedPtr<SQueryResult> results);
+    void SetHeatmapRange(double smallestValue, double largestValue, int largestNumValue);
+    void DrawHeatmap(UWorld* drawTarget, const TMap<FVector, HeatmapNode>& heatmapNodes, FVector origin);
     void SelectHeatmapDrawColor(FLinearColor NewColor);
     void HeatmapSizeScrolled(float NewLevel);
     void ResetRange();
@@ -126,18 +158,18 @@ public:
 
     //Draw calls
     void DrawTelemetry(UWorld* drawTarget, TArray<SEventEditorContainer*> data);
-    void DrawPoint(UWorld* drawTarget, TSharedPtr<STelemetryEvent> data, FColor color);
-    void DrawPoints(UWorld* drawTarget, TArray<TSharedPtr<STelemetryEvent>> data, FColor color);
-    void DrawPoints(UWorld* drawTarget, TArray<TSharedPtr<STelemetryEvent>> data, int start, int end, FColor color);
-    void DrawSphere(UWorld* drawTarget, TSharedPtr<STelemetryEvent> data, FColor color);
-    void DrawSpheres(UWorld* drawTarget, TArray<TSharedPtr<STelemetryEvent>> data, FColor color);
-    void DrawSpheres(UWorld* drawTarget, TArray<TSharedPtr<STelemetryEvent>> data, int start, int end, FColor color);
-    void DrawCube(UWorld* drawTarget, TSharedPtr<STelemetryEvent> data, FColor color);
-    void DrawCubes(UWorld* drawTarget, TArray<TSharedPtr<STelemetryEvent>> data, FColor color);
-    void DrawCubes(UWorld* drawTarget, TArray<TSharedPtr<STelemetryEvent>> data, int start, int end, FColor color);
-    void CreateActor(UWorld* drawTarget, int index, TSharedPtr<STelemetryEvent> data, FColor color, EventType shape);
-    void CreateActors(UWorld* drawTarget, TArray<TSharedPtr<STelemetryEvent>> data, FColor color, EventType shape);
-    void CreateActors(UWorld* drawTarget, TArray<TSharedPtr<STelemetryEvent>> data, int start, int end, FColor color, EventType shape);
+    void DrawPoint(UWorld* drawTarget, const FTelemetryEventView& data, FColor color);
+    void DrawPoints(UWorld* drawTarget, const SEventEditorContainer& data, FColor color);
+    void DrawPoints(UWorld* drawTarget, const SEventEditorContainer& data, int start, int end, FColor color);
+    void DrawSphere(UWorld* drawTarget, const FTelemetryEventView& data, FColor color);
+    void DrawSpheres(UWorld* drawTarget, const SEventEditorContainer& data, FColor color);
+    void DrawSpheres(UWorld* drawTarget, const SEventEditorContainer& data, int start, int end, FColor color);
+    void DrawCube(UWorld* drawTarget, const FTelemetryEventView& data, FColor color);
+    void DrawCubes(UWorld* drawTarget, const SEventEditorContainer& data, FColor color);
+    void DrawCubes(UWorld* drawTarget, const SEventEditorContainer& data, int start, int end, FColor color);
+    void CreateActor(UWorld* drawTarget, int index, const FTelemetryEventView& data, FColor color, EventType shape);
+    void CreateActors(UWorld* drawTarget, const SEventEditorContainer& data, FColor color, EventType shape);
+    void CreateActors(UWorld* drawTarget, const SEventEditorContainer& data, int start, int end, FColor color, EventType shape);
     void DestroyActors();
     void DestroyLastActor();
 
@@ -150,9 +182,45 @@ public:
     //Query tools
     FQuerySerializer m_querySerializer;
     FQueryExecutor m_queryExecuter;
+    FQueryHandle m_queryHandle;
     QueryResultHandler m_queryResultHandler;
     bool m_isWaiting;
 
+    //Phases of the query being shown, recorded once its events are drawn
+    FQueryTimingRecord m_queryTiming;
+    double m_queryTimingStart;
+    bool m_isTimingQuery;
+    bool m_isTimingDraw;
+
+    //Fields the last query asked the server for.  Attribute names and the details of a selected event are fetched
+    //separately when they are needed
+    TArray<FString> m_queryColumns;
+    FQueryExecutor m_attributeExecuter;
+    FQueryExecutor m_detailExecuter;
+    TSet<FString> m_sampledGroups;
+
+    //Columns of the last query sent to the server.  While they hold all of its results, narrower queries are
+    //answered from them instead of the server
+    TSharedPtr<FQueryResultColumns, ESPMode::ThreadSafe> m_loadedColumns;
+    FQueryNodePtr m_loadedQuery;
+    TArray<FString> m_loadedProjection;
+    bool m_loadedComplete;
+
+    //Events read from a file instead of the server.  Queries narrowing them are still answered locally, but nothing
+    //is asked of the server about them until a wider query is sent
+    TSharedPtr<FQueryFileImport, ESPMode::ThreadSafe> m_fileImport;
+    bool m_loadedFromFile;
+
+    //Live update state
+    QueryResultHandler m_liveResultHandler;
+    FQueryNodePtr m_liveQuery;
+    FDateTime m_liveLastSeen;
+    double m_liveNextPoll;
+    float m_livePollInterval;
+    int32 m_liveReceived;
+    bool m_liveMode;
+    bool m_isLivePolling;
+
     //Animation state
     float m_anim_scrollBarLocation;
     AnimationController m_anim_Control;
@@ -167,6 +235,14 @@ public:
     double m_heatmapMaxValue;
     bool m_heatmapOrientation;
     bool m_heatmapAnimation;
+    bool m_heatmapPending;
+
+    //Heatmaps are built from cells the server aggregates, unless it has been seen not to support them.  A heatmap
+    //whose aggregate request failed is binned from the loaded events instead
+    FQueryExecutor m_heatmapExecuter;
+    TArray<FQueryAggregateCell> m_heatmapCells;
+    bool m_heatmapAggregates;
+    bool m_heatmapBinLoaded;
 
     //Draw targets
     UWorld* m_editorDrawTarget;
@@ -204,6 +280,7 @@ public:
     FDelegateHandle m_tickDelegateHandle;
     FDelegateHandle m_startPIEDelegateHandle;
     FDelegateHandle m_endPIEDelegateHandle;
+    FDelegateHandle m_selectObjectDelegateHandle;
 
     //Editor flags/data
     void AddMenuExtensions(FMenuBuilder &);
@@ -0,0 +1,100 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//--------------------------------------------------------------------------------------
+// TelemetryEventContainerTest.cpp
+//
+// Checks that grouped events keep one value column per attribute as names and pages are added
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "TelemetryVisualizerTypes.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+static STelemetryEvent MakeTestEvent(int64 Ticks, const TCHAR *Attribute, double Value)
+{
+    STelemetryEvent Event(TEXT("test event"), TEXT("test"), TEXT("session"), TEXT("build"), FVector::ZeroVector, FVector::ZeroVector, FDateTime(Ticks));
+
+    if (Attribute != nullptr)
+    {
+        Event.values.Add(Attribute, Value);
+    }
+
+    return Event;
+}
+
+static bool HasColumnPerAttribute(const SEventEditorContainer &Group)
+{
+    if (Group.attributeValues.Num() != Group.attributeNames.Num())
+    {
+        return false;
+    }
+
+    for (const TArray<double> &Column : Group.attributeValues)
+    {
+        if (Column.Num() != Group.Num())
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTelemetryEventContainerTest, "Telemetry.Visualizer.EventContainer", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FTelemetryEventContainerTest::RunTest(const FString &Parameters)
+{
+    //A first page fetched without attributes, newest first
+    SEventEditorContainer Group;
+    Group.AddEvent(MakeTestEvent(400, nullptr, 0));
+    Group.AddEvent(MakeTestEvent(300, nullptr, 0));
+    Group.SetupTimes();
+
+    //Names sampled from a page of the group with every field
+    Group.AddAttribute(TEXT("health"));
+    Group.AddAttribute(TEXT("damage"));
+    Group.AddAttribute(TEXT("health"));
+
+    TestEqual(TEXT("A sampled name is added once"), Group.attributeNames.Num(), 2);
+    TestTrue(TEXT("Sampled names have a column for every loaded event"), HasColumnPerAttribute(Group));
+    TestFalse(TEXT("Loaded events have no value for a sampled name"), Group.HasValue(Group.FindAttribute(TEXT("health")), 0));
+    TestTrue(TEXT("A missing value reads as 0"), Group.GetValue(Group.FindAttribute(TEXT("damage")), 1) == 0);
+
+    //The next page has one of the sampled names and one of its own
+    SEventEditorContainer Page;
+    Page.AddEvent(MakeTestEvent(200, TEXT("health"), 50));
+    Page.AddEvent(MakeTestEvent(100, TEXT("armor"), 5));
+    Page.SetupTimes();
+
+    Group.Append(Page);
+
+    TestEqual(TEXT("Every event is kept"), Group.Num(), 4);
+    TestEqual(TEXT("Names of the page are added"), Group.attributeNames.Num(), 3);
+    TestTrue(TEXT("Every name has a column for every event after a page"), HasColumnPerAttribute(Group));
+
+    const int32 Health = Group.FindAttribute(TEXT("health"));
+    const int32 Armor = Group.FindAttribute(TEXT("armor"));
+    const int32 Damage = Group.FindAttribute(TEXT("damage"));
+    TestTrue(TEXT("A sampled name takes the values of the page"), Group.HasValue(Health, 2) && Group.GetValue(Health, 2) == 50);
+    TestFalse(TEXT("Events without a value stay without it"), Group.HasValue(Health, 3));
+    TestTrue(TEXT("A name of the page keeps its value"), Group.HasValue(Armor, 3) && Group.GetValue(Armor, 3) == 5);
+    TestFalse(TEXT("Earlier events have no value for a name of the page"), Group.HasValue(Armor, 0));
+    TestFalse(TEXT("A name no page had stays without values"), Group.HasValue(Damage, 2) || Group.HasValue(Damage, 3));
+
+    //A live update adds a newer event
+    Group.AddEvent(MakeTestEvent(500, TEXT("damage"), 7));
+    Group.SortEvents();
+    Group.SetupTimes();
+
+    TestTrue(TEXT("Every name has a column for every event after a live update"), HasColumnPerAttribute(Group));
+    TestTrue(TEXT("Events stay newest first"), Group.GetTime(0) == FDateTime(500));
+    TestTrue(TEXT("The newest event keeps its value"), Group.HasValue(Damage, 0) && Group.GetValue(Damage, 0) == 7);
+
+    return true;
+}
+
+#endif //WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,109 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//--------------------------------------------------------------------------------------
+// TelemetryQueryCacheTest.cpp
+//
+// Checks the keys, expiry and damage handling of the query cache
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "Query/TelemetryQueryCache.h"
+#include "Tests/TelemetryQueryTestServer.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/FileHelper.h"
+#include "HAL/FileManager.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQueryCacheKeyTest, "Telemetry.Query.Cache.Key", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FQueryCacheKeyTest::RunTest(const FString &Parameters)
+{
+    const FString Url = TEXT("https://telemetry.example.com/query/events");
+    const FString Query = TEXT("{\"op\": \"and\", \"children\": [{\"op\": \"eq\", \"column\": \"name\", \"value\": \"player death\"}]}");
+    const FString Key = FQueryCache::MakeKey(Url, TEXT("POST"), Query, 100, 10000, FString());
+
+    //Whitespace outside of strings is formatting, inside them it is part of the value
+    TestEqual(TEXT("Whitespace outside strings is removed"), FQueryCache::Normalize(Query), FString(TEXT("{\"op\":\"and\",\"children\":[{\"op\":\"eq\",\"column\":\"name\",\"value\":\"player death\"}]}")));
+    TestEqual(TEXT("Escaped quotes do not end a string"), FQueryCache::Normalize(TEXT("{\"a\": \"x\\\" y\"}")), FString(TEXT("{\"a\":\"x\\\" y\"}")));
+    TestEqual(TEXT("Formatting does not change the key"), FQueryCache::MakeKey(Url, TEXT("POST"), FQueryCache::Normalize(Query), 100, 10000, FString()), Key);
+
+    TestNotEqual(TEXT("The url is part of the key"), FQueryCache::MakeKey(TEXT("https://other.example.com/query/events"), TEXT("POST"), Query, 100, 10000, FString()), Key);
+    TestNotEqual(TEXT("The verb is part of the key"), FQueryCache::MakeKey(Url, TEXT("GET"), Query, 100, 10000, FString()), Key);
+    TestNotEqual(TEXT("The page size is part of the key"), FQueryCache::MakeKey(Url, TEXT("POST"), Query, 200, 10000, FString()), Key);
+    TestNotEqual(TEXT("The result limit is part of the key"), FQueryCache::MakeKey(Url, TEXT("POST"), Query, 100, 5000, FString()), Key);
+    TestNotEqual(TEXT("The columns are part of the key"), FQueryCache::MakeKey(Url, TEXT("POST"), Query, 100, 10000, TEXT("name,pos")), Key);
+    TestNotEqual(TEXT("A space in a value is part of the key"), FQueryCache::MakeKey(Url, TEXT("POST"), Query.Replace(TEXT("player death"), TEXT("playerdeath")), 100, 10000, FString()), Key);
+
+    TestFalse(TEXT("A time to live of 0 turns the cache off"), FQueryCache(0, MAX_int64).IsEnabled());
+
+    return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQueryCacheEntryTest, "Telemetry.Query.Cache.Entry", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FQueryCacheEntryTest::RunTest(const FString &Parameters)
+{
+    FQueryTestServer Server(1000);
+
+    FQueryResultColumns Stored;
+    if (!Server.QueryColumns(nullptr, Stored))
+    {
+        AddError(TEXT("Server did not return the loaded events"));
+        return false;
+    }
+
+    //Entries of the test have a key of their own, and a time to live and size long enough that storing them does
+    //not evict the entries of the editor
+    const FQueryCache Cache(FTimespan::FromDays(365).GetTotalSeconds(), MAX_int64);
+    const FString Key = FQueryCache::MakeKey(TEXT("test://Telemetry.Query.Cache.Entry"), TEXT("POST"), FGuid::NewGuid().ToString(), 0, 0, FString());
+    const FString Path = FPaths::Combine(FQueryCache::GetDirectory(), Key + TEXT(".tqc"));
+
+    FQueryResultColumns Loaded;
+    int32 QueryTime = 0;
+    TestFalse(TEXT("A key never stored is not found"), Cache.Load(Key, Loaded, QueryTime));
+
+    Cache.Store(Key, Stored, 42);
+    TestTrue(TEXT("A stored entry is found"), Cache.Load(Key, Loaded, QueryTime));
+    TestTrue(TEXT("A stored entry holds the same events"), FQueryTestServer::AreColumnsEqual(Stored, Loaded));
+    TestEqual(TEXT("A stored entry keeps its query time"), QueryTime, 42);
+
+    //Expired entries are not returned, and are deleted
+    FPlatformProcess::Sleep(0.05f);
+    FQueryResultColumns Expired;
+    TestFalse(TEXT("An expired entry is not found"), FQueryCache(0.01, MAX_int64).Load(Key, Expired, QueryTime));
+    TestEqual(TEXT("An expired entry is left empty"), Expired.Num(), 0);
+    TestFalse(TEXT("An expired entry is deleted"), IFileManager::Get().FileExists(*Path));
+
+    //Entries of another version, or cut short, are not read, and are deleted
+    Cache.Store(Key, Stored, 42);
+    TArray<uint8> Data;
+    if (!FFileHelper::LoadFileToArray(Data, *Path))
+    {
+        AddError(FString::Printf(TEXT("Entry %s was not written"), *Path));
+        return false;
+    }
+
+    TArray<uint8> OtherVersion = Data;
+    OtherVersion[sizeof(uint32)] ^= 0xff;
+    FFileHelper::SaveArrayToFile(OtherVersion, *Path);
+    FQueryResultColumns Damaged;
+    TestFalse(TEXT("An entry of another version is not read"), Cache.Load(Key, Damaged, QueryTime));
+    TestFalse(TEXT("An entry of another version is deleted"), IFileManager::Get().FileExists(*Path));
+
+    FFileHelper::SaveArrayToFile(TArray<uint8>(Data.GetData(), Data.Num() - 1), *Path);
+    TestFalse(TEXT("A truncated entry is not read"), Cache.Load(Key, Damaged, QueryTime));
+    TestEqual(TEXT("A truncated entry is left empty"), Damaged.Num(), 0);
+    TestFalse(TEXT("A truncated entry is deleted"), IFileManager::Get().FileExists(*Path));
+
+    //Nothing is stored while the cache is off
+    FQueryCache(0, MAX_int64).Store(Key, Stored, 42);
+    TestFalse(TEXT("A cache that is off stores nothing"), IFileManager::Get().FileExists(*Path));
+
+    IFileManager::Get().Delete(*Path, false, false, true);
+    return true;
+}
+
+#endif //WITH_DEV_AUTOMATION_TESTS
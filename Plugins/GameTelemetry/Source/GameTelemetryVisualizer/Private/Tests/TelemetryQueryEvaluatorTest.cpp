@@ -0,0 +1,249 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//--------------------------------------------------------------------------------------
+// TelemetryQueryEvaluatorTest.cpp
+//
+// Checks that queries answered over loaded columns match the events the server returns
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "Query/TelemetryQueryEvaluator.h"
+#include "Tests/TelemetryQueryTestServer.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+//Values that differ only past the precision of a float, or of the text they are sent as
+static const double EvaluatorTestValues[] = { 0.1, 0.1000000001, 0.3, 0.30000000000000004, 16777216.0, 16777217.0, -0.0, 1e-40 };
+
+//Loads one event per test value in to Server, each with its own time so the events can be told apart
+static void AddEvaluatorTestEvents(FTelemetryLocalServer &Server)
+{
+    const FDateTime Start(2018, 1, 1);
+
+    TArray<TSharedPtr<FJsonValue>> Events;
+    for (int32 i = 0; i < ARRAY_COUNT(EvaluatorTestValues); i++)
+    {
+        TSharedPtr<FJsonObject> Event = MakeShareable(new FJsonObject);
+        Event->SetStringField(TEXT("client_ts"), (Start + FTimespan::FromSeconds(i)).ToIso8601());
+        Event->SetStringField(TEXT("name"), i % 2 ? TEXT("Death") : TEXT("Heartbeat"));
+        Event->SetNumberField(TEXT("pos_x"), EvaluatorTestValues[i]);
+        Event->SetNumberField(TEXT("pos_y"), 0.0);
+        Event->SetNumberField(TEXT("pos_z"), 0.0);
+
+        //Every third event leaves the attribute out, which matches no comparison
+        if (i % 3 != 2)
+        {
+            Event->SetNumberField(TEXT("val_health"), EvaluatorTestValues[i]);
+        }
+
+        Events.Add(MakeShareable(new FJsonValueObject(Event)));
+    }
+
+    TSharedPtr<FJsonObject> Header = MakeShareable(new FJsonObject);
+    Header->SetStringField(TEXT("session_id"), TEXT("evaluator-test"));
+
+    TSharedPtr<FJsonObject> Batch = MakeShareable(new FJsonObject);
+    Batch->SetObjectField(TEXT("header"), Header);
+    Batch->SetArrayField(TEXT("events"), Events);
+
+    FString Text;
+    TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Text);
+    FJsonSerializer::Serialize(Batch.ToSharedRef(), Writer);
+
+    FTCHARToUTF8 Converted(*Text);
+    Server.Ingest((const uint8 *)Converted.Get(), Converted.Length());
+}
+
+//Evaluates Query over Loaded and checks the rows against the server running it again.  Returns false if the
+//evaluator could not compile it
+static bool TestMatchesServer(FAutomationTestBase &Test, FQueryTestServer &Server, const FQueryNodePtr &Query, const FQueryResultColumns &Loaded,
+    const TArray<FString> *Projection = nullptr, const FString &Columns = FString())
+{
+    const FString Text = FQueryTestServer::Serialize(Query);
+
+    TSharedPtr<FQueryEvaluator> Evaluator = FQueryEvaluator::Compile(Query, Loaded, Projection);
+    if (!Evaluator.IsValid())
+    {
+        return false;
+    }
+
+    TArray<uint8> Mask;
+    Evaluator->Evaluate(Mask);
+    const TArray<int64> LocalTicks = FQueryTestServer::GetSortedTicks(Loaded, &Mask);
+
+    FQueryResultColumns Requeried;
+    if (!Server.QueryColumns(Query, Requeried, Columns))
+    {
+        Test.AddError(FString::Printf(TEXT("Server did not answer %s"), *Text));
+        return true;
+    }
+
+    const TArray<int64> ServerTicks = FQueryTestServer::GetSortedTicks(Requeried);
+    Test.TestTrue(FString::Printf(TEXT("Local rows match the server for %s (%d local, %d server)"), *Text, LocalTicks.Num(), ServerTicks.Num()), LocalTicks == ServerTicks);
+    return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQueryEvaluatorServerTest, "Telemetry.Query.Evaluator.MatchesServer", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FQueryEvaluatorServerTest::RunTest(const FString &Parameters)
+{
+    FQueryTestServer Server;
+    AddEvaluatorTestEvents(Server);
+
+    FQueryResultColumns Loaded;
+    if (!Server.QueryColumns(nullptr, Loaded))
+    {
+        AddError(TEXT("Server did not return the loaded events"));
+        return false;
+    }
+    TestEqual(TEXT("Loaded events"), Loaded.Num(), (int32)ARRAY_COUNT(EvaluatorTestValues));
+
+    FQueryNodeList Queries;
+    for (const double Value : EvaluatorTestValues)
+    {
+        Queries.Add(QBuilder::Eq(TEXT("pos_x"), Value));
+        Queries.Add(QBuilder::Neq(TEXT("pos_x"), Value));
+        Queries.Add(QBuilder::Gt(TEXT("pos_x"), Value));
+        Queries.Add(QBuilder::Gte(TEXT("val_health"), Value));
+        Queries.Add(QBuilder::Lt(TEXT("val_health"), Value));
+        Queries.Add(QBuilder::Lte(TEXT("val_health"), Value));
+        Queries.Add(QBuilder::Neq(TEXT("val_health"), Value));
+        Queries.Add(QBuilder::Btwn(TEXT("val_health"), Value, 16777216.0));
+        Queries.Add(QBuilder::And({ QBuilder::Eq(TEXT("name"), FString(TEXT("Death"))), QBuilder::Lte(TEXT("pos_x"), Value) }));
+        Queries.Add(QBuilder::Or({ QBuilder::Eq(TEXT("val_health"), Value), QBuilder::Gt(TEXT("pos_x"), Value) }));
+    }
+    Queries.Add(QBuilder::Gt(TEXT("val_missing"), 0.0));
+
+    for (const FQueryNodePtr &Query : Queries)
+    {
+        if (!TestMatchesServer(*this, Server, Query, Loaded))
+        {
+            AddError(FString::Printf(TEXT("Could not compile %s"), *FQueryTestServer::Serialize(Query)));
+        }
+    }
+
+    //A query the server cannot read is rejected rather than matching every event
+    const TArray<uint8> Rejected = Server.HandleQuery(TEXT("{\"op\": \"eq\", \"column\""), 0, FString());
+    SQueryResult RejectedResult;
+    const bool IsRead = FQueryResultReader::Read(Rejected.GetData(), Rejected.Num(), RejectedResult);
+    TestFalse(TEXT("A query that cannot be read is not successful"), IsRead && RejectedResult.Header.Success);
+    TestEqual(TEXT("A query that cannot be read returns no events"), RejectedResult.EventCount, 0);
+
+    return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQueryEvaluatorProjectionTest, "Telemetry.Query.Evaluator.Projection", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FQueryEvaluatorProjectionTest::RunTest(const FString &Parameters)
+{
+    FQueryTestServer Server(5000);
+
+    //What the viewport loads for a heatmap of one attribute
+    TArray<FString> Projection = { TEXT("client_ts"), TEXT("name"), TEXT("pos_x"), TEXT("pos_y"), TEXT("pos_z"), TEXT("dir_x"), TEXT("dir_y"), TEXT("dir_z"), TEXT("val_fps") };
+    Projection.Sort();
+    const FString Columns = FQuerySerializer::SerializeColumns(Projection);
+
+    FQueryResultColumns Loaded;
+    if (!Server.QueryColumns(nullptr, Loaded, Columns))
+    {
+        AddError(TEXT("Server did not return the loaded events"));
+        return false;
+    }
+
+    TestTrue(TEXT("Projected columns leave out the other attributes"), Loaded.FindValues(TEXT("val_damage")) == nullptr);
+
+    //Fields in the projection are answered locally, and match the server
+    const FQueryNodeList Local =
+    {
+        QBuilder::Gt(TEXT("val_fps"), 45.0),
+        QBuilder::And({ QBuilder::Eq(TEXT("name"), FString(TEXT("player_position"))), QBuilder::Lt(TEXT("val_fps"), 40.0) }),
+        QBuilder::Or({ QBuilder::Lt(TEXT("pos_x"), 0.0), QBuilder::Gte(TEXT("val_fps"), 60.0) }),
+    };
+
+    for (const FQueryNodePtr &Query : Local)
+    {
+        TestTrue(FString::Printf(TEXT("%s compiles over the projection"), *FQueryTestServer::Serialize(Query)), TestMatchesServer(*this, Server, Query, Loaded, &Projection, Columns));
+    }
+
+    //Fields outside it are left to the server, rather than matching nothing because no loaded event has them
+    const FQueryNodeList Remote =
+    {
+        QBuilder::Gt(TEXT("val_damage"), 20.0),
+        QBuilder::Eq(TEXT("cat"), FString(TEXT("Combat"))),
+        QBuilder::And({ QBuilder::Gt(TEXT("val_fps"), 45.0), QBuilder::Eq(TEXT("platform"), FString(TEXT("PC"))) }),
+    };
+
+    for (const FQueryNodePtr &Query : Remote)
+    {
+        TestFalse(FString::Printf(TEXT("%s is not compiled over the projection"), *FQueryTestServer::Serialize(Query)), FQueryEvaluator::Compile(Query, Loaded, &Projection).IsValid());
+    }
+
+    return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQueryEvaluatorNarrowingTest, "Telemetry.Query.Evaluator.IsNarrowing", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FQueryEvaluatorNarrowingTest::RunTest(const FString &Parameters)
+{
+    FQueryTestServer Server(5000);
+
+    const FQueryNodeList Queries =
+    {
+        nullptr,
+        QBuilder::Eq(TEXT("cat"), FString(TEXT("Combat"))),
+        QBuilder::Eq(TEXT("name"), FString(TEXT("enemy_killed"))),
+        QBuilder::Gt(TEXT("val_damage"), 10.0),
+        QBuilder::Gt(TEXT("val_damage"), 20.0),
+        QBuilder::Btwn(TEXT("val_damage"), 15.0, 30.0),
+        QBuilder::And({ QBuilder::Eq(TEXT("cat"), FString(TEXT("Combat"))), QBuilder::Gt(TEXT("val_damage"), 20.0) }),
+        QBuilder::Or({ QBuilder::Eq(TEXT("cat"), FString(TEXT("Combat"))), QBuilder::Eq(TEXT("cat"), FString(TEXT("Movement"))) }),
+        QBuilder::Neq(TEXT("cat"), FString(TEXT("Movement"))),
+        QBuilder::Lt(TEXT("pct_accuracy"), 0.5),
+    };
+
+    TArray<TArray<FString>> Ids;
+    for (const FQueryNodePtr &Query : Queries)
+    {
+        if (!Server.QueryIds(Query, Ids[Ids.AddDefaulted()]))
+        {
+            AddError(FString::Printf(TEXT("Server did not answer %s"), *FQueryTestServer::Serialize(Query)));
+            return false;
+        }
+    }
+
+    //Whenever a query is reported to narrow another, every event it matches was in the other's results
+    int32 Narrowing = 0;
+    for (int32 i = 0; i < Queries.Num(); i++)
+    {
+        for (int32 j = 0; j < Queries.Num(); j++)
+        {
+            if (!FQueryEvaluator::IsNarrowing(Queries[i], Queries[j]))
+            {
+                continue;
+            }
+
+            Narrowing++;
+            const TSet<FString> Loaded(Ids[j]);
+            const bool IsSubset = !Ids[i].ContainsByPredicate([&Loaded](const FString &Id) { return !Loaded.Contains(Id); });
+
+            TestTrue(FString::Printf(TEXT("%s narrows %s"), *FQueryTestServer::Serialize(Queries[i]), *FQueryTestServer::Serialize(Queries[j])), IsSubset);
+        }
+    }
+
+    //Ones the evaluator is expected to recognize
+    TestTrue(TEXT("Every query narrows no query"), FQueryEvaluator::IsNarrowing(Queries[3], Queries[0]));
+    TestTrue(TEXT("A tighter bound narrows a looser one"), FQueryEvaluator::IsNarrowing(Queries[4], Queries[3]));
+    TestTrue(TEXT("A range inside a bound narrows it"), FQueryEvaluator::IsNarrowing(Queries[5], Queries[3]));
+    TestTrue(TEXT("An added clause narrows"), FQueryEvaluator::IsNarrowing(Queries[6], Queries[1]));
+    TestTrue(TEXT("A value narrows an Or holding it"), FQueryEvaluator::IsNarrowing(Queries[1], Queries[7]));
+    TestFalse(TEXT("A looser bound does not narrow a tighter one"), FQueryEvaluator::IsNarrowing(Queries[3], Queries[4]));
+    TestFalse(TEXT("No query does not narrow a query"), FQueryEvaluator::IsNarrowing(Queries[0], Queries[1]));
+
+    AddInfo(FString::Printf(TEXT("%d narrowing pairs checked against the server"), Narrowing));
+    return true;
+}
+
+#endif //WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,156 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//--------------------------------------------------------------------------------------
+// TelemetryQueryFormatTest.cpp
+//
+// Checks that compressed and columnar responses read back as they were written, and that damaged ones are rejected
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "Query/TelemetryQueryFormat.h"
+#include "Tests/TelemetryQueryTestServer.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+static bool ReadColumns(const TArray<uint8> &Response, FQueryResultColumns &OutColumns, SQueryResult &OutResult)
+{
+    FQueryColumnSink Sink(OutColumns);
+    return FQueryResponseFormat::Read(Response.GetData(), Response.Num(), OutResult, Sink);
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQueryFormatRoundTripTest, "Telemetry.Query.Format.RoundTrip", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FQueryFormatRoundTripTest::RunTest(const FString &Parameters)
+{
+    FQueryTestServer Server(2000);
+
+    const TArray<uint8> Json = Server.HandleQuery(FString(), 0, FString());
+
+    FQueryResultColumns FromJson;
+    SQueryResult JsonResult;
+    if (!ReadColumns(Json, FromJson, JsonResult))
+    {
+        AddError(TEXT("The Json response could not be read"));
+        return false;
+    }
+    TestEqual(TEXT("Every event is read from Json"), FromJson.Num(), 2000);
+
+    //Written as columns and read back
+    TArray<uint8> Columns;
+    FQueryResponseFormat::WriteColumns(FromJson, true, 42, TEXT("17|3"), Columns);
+
+    FQueryResultColumns FromColumns;
+    SQueryResult ColumnsResult;
+    TestTrue(TEXT("Columns are recognized"), FQueryResponseFormat::IsColumns(Columns.GetData(), Columns.Num()));
+    TestTrue(TEXT("Columns are read"), ReadColumns(Columns, FromColumns, ColumnsResult));
+    TestTrue(TEXT("Columns read back as written"), FQueryTestServer::AreColumnsEqual(FromJson, FromColumns));
+    TestEqual(TEXT("The continuation token is kept"), ColumnsResult.Header.ContinuationToken, FString(TEXT("17|3")));
+    TestEqual(TEXT("The query time is kept"), (int32)ColumnsResult.Header.QueryTime, 42);
+    TestEqual(TEXT("Every event is counted"), ColumnsResult.EventCount, 2000);
+
+    //Json converted to columns holds the same events
+    TArray<uint8> Converted;
+    FQueryResultColumns FromConverted;
+    SQueryResult ConvertedResult;
+    TestTrue(TEXT("Json converts to columns"), FQueryResponseFormat::JsonToColumns(Json.GetData(), Json.Num(), Converted));
+    TestTrue(TEXT("Converted columns are read"), ReadColumns(Converted, FromConverted, ConvertedResult));
+    TestTrue(TEXT("Converted columns hold the Json events"), FQueryTestServer::AreColumnsEqual(FromJson, FromConverted));
+
+    //Either format compressed reads the same
+    const TArray<uint8> *Contents[] = { &Json, &Columns };
+    for (const TArray<uint8> *Content : Contents)
+    {
+        TArray<uint8> Compressed;
+        TestTrue(TEXT("Response compresses"), FQueryResponseFormat::Gzip(Content->GetData(), Content->Num(), Compressed));
+        TestTrue(TEXT("Compressed response is recognized"), FQueryResponseFormat::IsGzip(Compressed.GetData(), Compressed.Num()));
+
+        FQueryResultColumns FromCompressed;
+        SQueryResult CompressedResult;
+        TestTrue(TEXT("Compressed response is read"), ReadColumns(Compressed, FromCompressed, CompressedResult));
+        TestTrue(TEXT("Compressed response holds the same events"), FQueryTestServer::AreColumnsEqual(FromJson, FromCompressed));
+    }
+
+    return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQueryFormatCorruptTest, "Telemetry.Query.Format.CorruptInput", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FQueryFormatCorruptTest::RunTest(const FString &Parameters)
+{
+    FQueryTestServer Server(500);
+
+    FQueryResultColumns Loaded;
+    if (!Server.QueryColumns(nullptr, Loaded))
+    {
+        AddError(TEXT("Server did not return the loaded events"));
+        return false;
+    }
+
+    TArray<uint8> Columns;
+    FQueryResponseFormat::WriteColumns(Loaded, true, 0, FString(), Columns);
+
+    //Every truncation past the magic is rejected rather than read past the end
+    int32 Accepted = 0;
+    for (int32 Size = sizeof(uint32); Size < Columns.Num(); Size += FMath::Max(Columns.Num() / 97, 1))
+    {
+        TArray<uint8> Truncated(Columns.GetData(), Size);
+        FQueryResultColumns Result;
+        SQueryResult Header;
+        Accepted += ReadColumns(Truncated, Result, Header) ? 1 : 0;
+    }
+    TestEqual(TEXT("Truncated columns are rejected"), Accepted, 0);
+
+    //A version the reader does not know is rejected
+    TArray<uint8> OtherVersion = Columns;
+    OtherVersion[4] ^= 0xff;
+    FQueryResultColumns VersionResult;
+    SQueryResult VersionHeader;
+    TestFalse(TEXT("Columns of another version are rejected"), ReadColumns(OtherVersion, VersionResult, VersionHeader));
+
+    //Gzip of a few members, padding, damage and size limits
+    TArray<uint8> First;
+    TArray<uint8> Second;
+    const TArray<uint8> Json = Server.HandleQuery(FString(), 0, FString());
+    const int32 Half = Json.Num() / 2;
+    FQueryResponseFormat::Gzip(Json.GetData(), Half, First);
+    FQueryResponseFormat::Gzip(Json.GetData() + Half, Json.Num() - Half, Second);
+
+    TArray<uint8> Inflated;
+    TestTrue(TEXT("One member inflates"), FQueryResponseFormat::Gunzip(First.GetData(), First.Num(), Inflated));
+    TestTrue(TEXT("One member inflates to what was compressed"), Inflated.Num() == Half && FMemory::Memcmp(Inflated.GetData(), Json.GetData(), Half) == 0);
+
+    TArray<uint8> Members = First;
+    Members.Append(Second);
+    TestTrue(TEXT("Two members inflate"), FQueryResponseFormat::Gunzip(Members.GetData(), Members.Num(), Inflated));
+    TestTrue(TEXT("Two members inflate to their concatenation"), Inflated == Json);
+
+    TArray<uint8> Padded = First;
+    Padded.AddZeroed(16);
+    TestTrue(TEXT("Zero padding after the last member is allowed"), FQueryResponseFormat::Gunzip(Padded.GetData(), Padded.Num(), Inflated));
+
+    TArray<uint8> Trailing = First;
+    Trailing.Append((const uint8 *)"garbage", 7);
+    TestFalse(TEXT("Other data after the last member is rejected"), FQueryResponseFormat::Gunzip(Trailing.GetData(), Trailing.Num(), Inflated));
+    TestEqual(TEXT("A rejected body leaves no output"), Inflated.Num(), 0);
+
+    TestFalse(TEXT("A truncated member is rejected"), FQueryResponseFormat::Gunzip(First.GetData(), First.Num() - 8, Inflated));
+
+    TArray<uint8> Damaged = First;
+    Damaged[Damaged.Num() / 2] ^= 0x55;
+    TestFalse(TEXT("A damaged member is rejected"), FQueryResponseFormat::Gunzip(Damaged.GetData(), Damaged.Num(), Inflated));
+
+    //The limit counts what is inflated, not the size a trailer claims
+    TArray<uint8> Understated = Members;
+    FMemory::Memzero(Understated.GetData() + Understated.Num() - 4, 4);
+    TestFalse(TEXT("A trailer that understates the size is rejected"), FQueryResponseFormat::Gunzip(Understated.GetData(), Understated.Num(), Inflated));
+    TestFalse(TEXT("A body larger than the limit is rejected"), FQueryResponseFormat::Gunzip(Members.GetData(), Members.Num(), Inflated, Json.Num() - 1));
+    TestEqual(TEXT("A body over the limit leaves no output"), Inflated.Num(), 0);
+    TestTrue(TEXT("A body at the limit inflates"), FQueryResponseFormat::Gunzip(Members.GetData(), Members.Num(), Inflated, Json.Num()));
+
+    return true;
+}
+
+#endif //WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,132 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//--------------------------------------------------------------------------------------
+// TelemetryQueryOptimizerTest.cpp
+//
+// Checks that optimized queries match the same events as the queries they came from
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "Query/TelemetryQueryOptimizer.h"
+#include "Tests/TelemetryQueryTestServer.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+//Trees like the ones the visualizer builds, one for each thing the optimizer rewrites
+static FQueryNodeList MakeOptimizerTestQueries()
+{
+    auto Name = [](const TCHAR *Value) { return FJsonValueUtil::Create(FString(Value)); };
+
+    FQueryNodeList Queries;
+
+    //Nested single child groups
+    Queries.Add(QBuilder::And({ QBuilder::And({ QBuilder::Or({ QBuilder::Eq(TEXT("name"), FString(TEXT("player_death"))) }) }) }));
+
+    //Eq on one column under an Or, folded in to an In, with a repeated value and an In already there
+    Queries.Add(QBuilder::Or({
+        QBuilder::Eq(TEXT("name"), FString(TEXT("player_death"))),
+        QBuilder::Eq(TEXT("name"), FString(TEXT("enemy_killed"))),
+        QBuilder::Eq(TEXT("name"), FString(TEXT("player_death"))),
+        QBuilder::In(TEXT("cat"), TArray<TSharedPtr<FJsonValue>>({ Name(TEXT("Movement")) })) }));
+
+    //Ranges merged in to a Btwn, or narrowed to the tighter bound
+    Queries.Add(QBuilder::And({ QBuilder::Gte(TEXT("pos_x"), -2000.0), QBuilder::Lte(TEXT("pos_x"), 2000.0) }));
+    Queries.Add(QBuilder::And({ QBuilder::Gt(TEXT("val_fps"), 30.0), QBuilder::Gt(TEXT("val_fps"), 40.0), QBuilder::Lt(TEXT("val_fps"), 55.0) }));
+    Queries.Add(QBuilder::And({ QBuilder::Gte(TEXT("pct_progress"), 0.5), QBuilder::Lte(TEXT("pct_progress"), 0.5) }));
+
+    //Eq intersected with a range on the same column
+    Queries.Add(QBuilder::And({
+        QBuilder::In(TEXT("name"), TArray<TSharedPtr<FJsonValue>>({ Name(TEXT("player_death")), Name(TEXT("item_pickup")) })),
+        QBuilder::Neq(TEXT("name"), FString(TEXT("item_pickup"))) }));
+
+    //Clauses implied by another
+    Queries.Add(QBuilder::Or({ QBuilder::Gt(TEXT("val_damage"), 10.0), QBuilder::Gt(TEXT("val_damage"), 20.0), QBuilder::Eq(TEXT("cat"), FString(TEXT("Combat"))) }));
+
+    //Queries that match nothing, which are never sent
+    Queries.Add(QBuilder::And({ QBuilder::Gt(TEXT("val_fps"), 50.0), QBuilder::Lt(TEXT("val_fps"), 20.0) }));
+    Queries.Add(QBuilder::Btwn(TEXT("pos_y"), 100.0, -100.0));
+    Queries.Add(QBuilder::And({ QBuilder::Eq(TEXT("name"), FString(TEXT("player_death"))), QBuilder::Eq(TEXT("name"), FString(TEXT("item_pickup"))) }));
+
+    //Comparisons of a field to values of two types, which the server decides
+    Queries.Add(QBuilder::And({ QBuilder::Gt(TEXT("val_fps"), 20.0), QBuilder::Lt(TEXT("val_fps"), FString(TEXT("90"))) }));
+
+    //Fields some events do not have, under an Or with fields they do
+    Queries.Add(QBuilder::Or({ QBuilder::Lt(TEXT("pct_accuracy"), 0.5), QBuilder::And({ QBuilder::Eq(TEXT("cat"), FString(TEXT("Gameplay"))), QBuilder::Gte(TEXT("pct_accuracy"), 0.0) }) }));
+
+    return Queries;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQueryOptimizerEquivalenceTest, "Telemetry.Query.Optimizer.Equivalence", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FQueryOptimizerEquivalenceTest::RunTest(const FString &Parameters)
+{
+    FQueryTestServer Server(5000);
+
+    for (const FQueryNodePtr &Raw : MakeOptimizerTestQueries())
+    {
+        const FString Text = FQueryTestServer::Serialize(Raw);
+        const FQueryNodePtr Optimized = FQueryOptimizer::Optimize(Raw);
+
+        TArray<FString> RawIds;
+        if (!Server.QueryIds(Raw, RawIds))
+        {
+            AddError(FString::Printf(TEXT("Server did not answer %s"), *Text));
+            continue;
+        }
+
+        if (FQueryOptimizer::IsEmpty(Optimized))
+        {
+            TestEqual(FString::Printf(TEXT("Empty query %s matches no events"), *Text), RawIds.Num(), 0);
+            continue;
+        }
+
+        TArray<FString> OptimizedIds;
+        if (!Server.QueryIds(Optimized, OptimizedIds))
+        {
+            AddError(FString::Printf(TEXT("Server did not answer the optimized form of %s"), *Text));
+            continue;
+        }
+
+        TestTrue(FString::Printf(TEXT("%s and %s match the same events (%d and %d)"), *Text, *FQueryTestServer::Serialize(Optimized), RawIds.Num(), OptimizedIds.Num()), RawIds == OptimizedIds);
+        TestTrue(FString::Printf(TEXT("Optimizing %s again changes nothing"), *Text), FQueryOptimizer::GetCanonicalText(Optimized) == FQueryTestServer::Serialize(Optimized));
+    }
+
+    return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQueryOptimizerCanonicalTest, "Telemetry.Query.Optimizer.CanonicalText", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FQueryOptimizerCanonicalTest::RunTest(const FString &Parameters)
+{
+    //Clauses in another order, or written another way, are the same query and share a cache entry
+    const FQueryNodePtr First = QBuilder::And({
+        QBuilder::Eq(TEXT("cat"), FString(TEXT("Combat"))),
+        QBuilder::Or({ QBuilder::Eq(TEXT("name"), FString(TEXT("enemy_killed"))), QBuilder::Eq(TEXT("name"), FString(TEXT("player_death"))) }),
+        QBuilder::Gte(TEXT("val_damage"), 10.0) });
+
+    const FQueryNodePtr Second = QBuilder::And({
+        QBuilder::And({ QBuilder::Gte(TEXT("val_damage"), 5.0), QBuilder::Gte(TEXT("val_damage"), 10.0) }),
+        QBuilder::Or({ QBuilder::Eq(TEXT("name"), FString(TEXT("player_death"))), QBuilder::Eq(TEXT("name"), FString(TEXT("enemy_killed"))) }),
+        QBuilder::Eq(TEXT("cat"), FString(TEXT("Combat"))) });
+
+    TestEqual(TEXT("Equivalent queries have the same canonical text"), FQueryOptimizer::GetCanonicalText(First), FQueryOptimizer::GetCanonicalText(Second));
+
+    //A different bound is a different query
+    const FQueryNodePtr Third = QBuilder::And({
+        QBuilder::Eq(TEXT("cat"), FString(TEXT("Combat"))),
+        QBuilder::Or({ QBuilder::Eq(TEXT("name"), FString(TEXT("enemy_killed"))), QBuilder::Eq(TEXT("name"), FString(TEXT("player_death"))) }),
+        QBuilder::Gt(TEXT("val_damage"), 10.0) });
+
+    TestNotEqual(TEXT("Different queries have different canonical text"), FQueryOptimizer::GetCanonicalText(First), FQueryOptimizer::GetCanonicalText(Third));
+
+    TestTrue(TEXT("No query is a tautology"), FQueryOptimizer::IsTautology(nullptr));
+    TestTrue(TEXT("An empty And is a tautology"), FQueryOptimizer::IsTautology(QBuilder::And({})));
+    TestTrue(TEXT("An empty Or matches nothing"), FQueryOptimizer::IsEmpty(FQueryOptimizer::Optimize(QBuilder::Or({}))));
+
+    return true;
+}
+
+#endif //WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,96 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//--------------------------------------------------------------------------------------
+// TelemetryQueryShardTest.cpp
+//
+// Checks that time shards of a query together match exactly the events of the query
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "Query/TelemetryQuery.h"
+#include "Tests/TelemetryQueryTestServer.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQueryTimeShardsTest, "Telemetry.Query.TimeShards.Partition", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FQueryTimeShardsTest::RunTest(const FString &Parameters)
+{
+    FQueryTestServer Server(5000);
+
+    //The synthesized sessions start over the last week and last up to an hour
+    const FDateTime Now = FDateTime::UtcNow();
+    const FString Lower = (Now - FTimespan::FromDays(8)).ToIso8601();
+    const FString Upper = (Now + FTimespan::FromHours(1)).ToIso8601();
+
+    const FQueryNodeList Queries =
+    {
+        QBuilder::Btwn(TEXT("client_ts"), Lower, Upper),
+        QBuilder::And({ QBuilder::Eq(TEXT("cat"), FString(TEXT("Combat"))), QBuilder::Btwn(TEXT("client_ts"), Lower, Upper) }),
+        QBuilder::And({ QBuilder::Btwn(TEXT("client_ts"), (Now - FTimespan::FromDays(3)).ToIso8601(), (Now - FTimespan::FromDays(1)).ToIso8601()), QBuilder::Gt(TEXT("val_fps"), 40.0) }),
+    };
+
+    for (const FQueryNodePtr &Query : Queries)
+    {
+        const FString Text = FQueryTestServer::Serialize(Query);
+
+        TArray<FString> Ids;
+        if (!Server.QueryIds(Query, Ids))
+        {
+            AddError(FString::Printf(TEXT("Server did not answer %s"), *Text));
+            continue;
+        }
+
+        for (const int32 NumShards : { 2, 3, 5, 8, 16 })
+        {
+            FQueryNodeList Shards;
+            if (!FQueryTimeShards::Split(Query, NumShards, Shards))
+            {
+                AddError(FString::Printf(TEXT("Could not split %s in to %d shards"), *Text, NumShards));
+                continue;
+            }
+
+            TestEqual(FString::Printf(TEXT("%s splits in to %d shards"), *Text, NumShards), Shards.Num(), NumShards);
+
+            //Together the shards hold every event once, and each shard holds only events older than the one before
+            TArray<FString> ShardIds;
+            int64 PreviousOldest = MAX_int64;
+            bool IsOrdered = true;
+
+            for (const FQueryNodePtr &Shard : Shards)
+            {
+                TArray<FString> Each;
+                FQueryResultColumns Columns;
+                if (!Server.QueryIds(Shard, Each) || !Server.QueryColumns(Shard, Columns))
+                {
+                    AddError(FString::Printf(TEXT("Server did not answer %s"), *FQueryTestServer::Serialize(Shard)));
+                    continue;
+                }
+                ShardIds.Append(Each);
+
+                const TArray<int64> Ticks = FQueryTestServer::GetSortedTicks(Columns);
+                if (Ticks.Num() > 0)
+                {
+                    IsOrdered = IsOrdered && Ticks.Last() < PreviousOldest;
+                    PreviousOldest = Ticks[0];
+                }
+            }
+
+            ShardIds.Sort();
+            TestTrue(FString::Printf(TEXT("%d shards of %s match the same %d events"), NumShards, *Text, Ids.Num()), ShardIds == Ids);
+            TestTrue(FString::Printf(TEXT("%d shards of %s are newest first"), NumShards, *Text), IsOrdered);
+        }
+    }
+
+    //Queries without a range every match must fall in are not split
+    FQueryNodeList Unsplit;
+    TestFalse(TEXT("A query without a time range is not split"), FQueryTimeShards::Split(QBuilder::Eq(TEXT("cat"), FString(TEXT("Combat"))), 4, Unsplit));
+    TestFalse(TEXT("A time range under an Or is not split"), FQueryTimeShards::Split(QBuilder::Or({ QBuilder::Btwn(TEXT("client_ts"), Lower, Upper), QBuilder::Eq(TEXT("cat"), FString(TEXT("Combat"))) }), 4, Unsplit));
+
+    return true;
+}
+
+#endif //WITH_DEV_AUTOMATION_TESTS
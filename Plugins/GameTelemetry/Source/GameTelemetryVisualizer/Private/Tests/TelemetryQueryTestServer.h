@@ -0,0 +1,121 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//--------------------------------------------------------------------------------------
+// TelemetryQueryTestServer.h
+//
+// Local query server of its own for the query tests
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Query/TelemetryLocalServer.h"
+#include "Query/TelemetryQueryFormat.h"
+#include "Query/TelemetryQueryReader.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+//Answers the queries of a test with the same semantics as the service, without touching the server local:// urls use
+class FQueryTestServer : public FTelemetryLocalServer
+{
+public:
+    //Starts with a synthesized dataset of Count events, the same events every run apart from their times
+    explicit FQueryTestServer(int32 Count = 0)
+    {
+        if (Count > 0)
+        {
+            FTelemetryDatasetOptions Options;
+            Options.Count = Count;
+            Options.Sessions = 20;
+            Options.Seed = 1;
+            GenerateDataset(Options);
+        }
+    }
+
+    //Ids of every event Query matches, sorted.  A null Query matches every event
+    bool QueryIds(const FQueryNodePtr &Query, TArray<FString> &OutIds)
+    {
+        const TArray<uint8> Response = HandleQuery(Serialize(Query), 0, FString());
+
+        SQueryResult Result;
+        if (!FQueryResultReader::Read(Response.GetData(), Response.Num(), Result))
+        {
+            return false;
+        }
+
+        OutIds.Reset(Result.Events.Num());
+        for (const FSimpleEvent &Event : Result.Events)
+        {
+            OutIds.Add(Event.GetId());
+        }
+        OutIds.Sort();
+        return true;
+    }
+
+    //Every event Query matches, read from a columnar response in to OutColumns
+    bool QueryColumns(const FQueryNodePtr &Query, FQueryResultColumns &OutColumns, const FString &Columns = FString())
+    {
+        const TArray<uint8> Response = HandleQuery(Serialize(Query), 0, FString(), Columns, true);
+
+        SQueryResult Result;
+        FQueryColumnSink Sink(OutColumns);
+        return FQueryResponseFormat::Read(Response.GetData(), Response.Num(), Result, Sink);
+    }
+
+    //Times of the events, sorted, which tell apart events from the same columns
+    static TArray<int64> GetSortedTicks(const FQueryResultColumns &Columns, const TArray<uint8> *Mask = nullptr)
+    {
+        TArray<int64> Ticks;
+        for (int32 Row = 0; Row < Columns.Num(); Row++)
+        {
+            if (Mask == nullptr || (*Mask)[Row])
+            {
+                Ticks.Add(Columns.Ticks[Row]);
+            }
+        }
+        Ticks.Sort();
+        return Ticks;
+    }
+
+    //Compares every row of every column.  Missing values are NaN, so value columns are compared by their bits
+    static bool AreColumnsEqual(const FQueryResultColumns &A, const FQueryResultColumns &B)
+    {
+        if (A.Num() != B.Num() || A.Values.Num() != B.Values.Num())
+        {
+            return false;
+        }
+
+        for (int32 Row = 0; Row < A.Num(); Row++)
+        {
+            if (A.Ticks[Row] != B.Ticks[Row] || A.Counts[Row] != B.Counts[Row] ||
+                A.Position.Get(Row) != B.Position.Get(Row) || A.Direction.Get(Row) != B.Direction.Get(Row) ||
+                A.Name.Get(Row) != B.Name.Get(Row) || A.Category.Get(Row) != B.Category.Get(Row) || A.Session.Get(Row) != B.Session.Get(Row) ||
+                A.GetBuild(Row) != B.GetBuild(Row))
+            {
+                return false;
+            }
+        }
+
+        for (const FQueryValueColumn &Column : A.Values)
+        {
+            const FQueryValueColumn *Other = B.FindValues(Column.Name);
+            if (Other == nullptr || FMemory::Memcmp(Column.Values.GetData(), Other->Values.GetData(), Column.Values.Num() * sizeof(double)) != 0)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    static FString Serialize(const FQueryNodePtr &Query)
+    {
+        FQuerySerializer Serializer;
+        return Query.IsValid() ? Serializer.Serialize(Query) : FString();
+    }
+};
+
+#endif //WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,88 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//--------------------------------------------------------------------------------------
+// TelemetryStringTableTest.cpp
+//
+// Checks that string handles are unique, stable and safe to take from many threads
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "TelemetryVisualizerTypes.h"
+#include "Async/ParallelFor.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTelemetryStringTableTest, "Telemetry.Visualizer.StringTable", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FTelemetryStringTableTest::RunTest(const FString &Parameters)
+{
+    //A table of its own, so the strings of the test are freed with it rather than kept by the one events use
+    TUniquePtr<FTelemetryStringTable> OwnTable = MakeUnique<FTelemetryStringTable>();
+    FTelemetryStringTable &Table = *OwnTable;
+
+    TestEqual(TEXT("The empty string is handle 0"), Table.Intern(FString()), (FTelemetryStringHandle)0);
+    TestTrue(TEXT("Handle 0 is the empty string"), Table.GetString(0).IsEmpty());
+
+    //Enough strings to fill more than one chunk
+    const int32 NumStrings = 10000;
+
+    TArray<FString> Strings;
+    for (int32 i = 0; i < NumStrings; i++)
+    {
+        Strings.Add(FString::Printf(TEXT("string_%d"), i));
+    }
+
+    const FTelemetryStringHandle First = Table.Intern(Strings[0]);
+    const FString *FirstString = &Table.GetString(First);
+
+    //Every thread interns every string, in a different order
+    const int32 NumThreads = 8;
+    TArray<TArray<FTelemetryStringHandle>> Handles;
+    Handles.SetNum(NumThreads);
+
+    ParallelFor(NumThreads, [&](int32 Thread)
+    {
+        Handles[Thread].SetNumZeroed(NumStrings);
+        for (int32 i = 0; i < NumStrings; i++)
+        {
+            const int32 Index = (i * (Thread * 2 + 1) + Thread * 997) % NumStrings;
+            Handles[Thread][Index] = Table.Intern(Strings[Index]);
+        }
+    });
+
+    //The same string always has the same handle, and different strings different handles
+    TSet<FTelemetryStringHandle> Distinct;
+    int32 Mismatched = 0;
+    int32 Wrong = 0;
+
+    for (int32 i = 0; i < NumStrings; i++)
+    {
+        const FTelemetryStringHandle Handle = Handles[0][i];
+        Distinct.Add(Handle);
+
+        for (int32 Thread = 1; Thread < NumThreads; Thread++)
+        {
+            Mismatched += Handles[Thread][i] != Handle ? 1 : 0;
+        }
+
+        Wrong += Table.GetString(Handle) != Strings[i] ? 1 : 0;
+    }
+
+    TestEqual(TEXT("Every thread gets the same handle for a string"), Mismatched, 0);
+    TestEqual(TEXT("Different strings get different handles"), Distinct.Num(), NumStrings);
+    TestEqual(TEXT("Every handle reads back its string"), Wrong, 0);
+    TestEqual(TEXT("The table holds only the empty string and the strings interned"), Table.Num(), NumStrings + 1);
+    TestEqual(TEXT("A string interned again keeps its handle"), Handles[0][0], First);
+    TestTrue(TEXT("A string does not move as the table grows"), &Table.GetString(First) == FirstString);
+
+    //Interning from a pointer and length, as the readers do, finds the same string
+    const FString Padded = Strings[NumStrings - 1] + TEXT("_padding");
+    TestEqual(TEXT("Part of a buffer interns as the string it holds"), Table.Intern(*Padded, Strings[NumStrings - 1].Len()), Handles[0][NumStrings - 1]);
+
+    return true;
+}
+
+#endif //WITH_DEV_AUTOMATION_TESTS
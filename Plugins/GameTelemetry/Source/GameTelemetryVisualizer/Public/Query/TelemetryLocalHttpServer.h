@@ -0,0 +1,57 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//--------------------------------------------------------------------------------------
+// TelemetryLocalHttpServer.h
+//
+// Serves the local query server over loopback http
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "HAL/ThreadSafeCounter64.h"
+
+class FSocket;
+class FTcpListener;
+class FTelemetryLocalServer;
+struct FIPv4Endpoint;
+
+//Answers the query and ingestion requests of the service on 127.0.0.1 from an FTelemetryLocalServer, so the
+//visualizer and games can be pointed at http://127.0.0.1:<port>/api/query and /api/ingest with no backend.
+// - paths ending in "query" run the posted query, or every event for a GET, honoring ?take=, &columns=, the
+//   x-ms-continuation header, an Accept of FQueryResponseFormat::ColumnsContentType and an Accept-Encoding of gzip
+// - paths ending in "ingest" add a posted batch as FTelemetryLocalServer::Ingest does
+//Each connection is answered on the thread pool and closed after one response.
+class FTelemetryLocalHttpServer
+{
+public:
+    explicit FTelemetryLocalHttpServer(FTelemetryLocalServer &InServer);
+    ~FTelemetryLocalHttpServer();
+
+    //Listens on the loopback address only.  Returns false if the port cannot be bound
+    bool Start(int32 Port);
+
+    void Stop();
+
+    bool IsRunning() const { return Listener.IsValid(); }
+
+    int32 GetNumRequests() const { return NumRequests.GetValue(); }
+
+    //Events added by ingestion requests
+    int64 GetNumIngested() const { return NumIngested.GetValue(); }
+
+private:
+    bool OnConnection(FSocket *Socket, const FIPv4Endpoint &Endpoint);
+
+    FTelemetryLocalServer &Server;
+    TUniquePtr<FTcpListener> Listener;
+    FThreadSafeCounter NumRequests;
+    FThreadSafeCounter64 NumIngested;
+
+    //Connections still being answered, waited for when stopping
+    FThreadSafeCounter NumConnections;
+};
@@ -0,0 +1,125 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//--------------------------------------------------------------------------------------
+// TelemetryLocalServer.h
+//
+// In process stand-in for the query service
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Dom/JsonObject.h"
+#include "Query/TelemetryQueryTransport.h"
+
+//Options of a synthesized dataset
+struct FTelemetryDatasetOptions
+{
+    int32 Count = 1000000;
+
+    //Play sessions the events are spread over, each a few minutes to an hour long
+    int32 Sessions = 200;
+
+    //Areas of the map where players spend most of their time
+    int32 Clusters = 12;
+
+    //Sessions start at random over this many days before now
+    float Days = 7.f;
+
+    //The same seed always synthesizes the same events, apart from their times
+    int32 Seed = 0;
+};
+
+//Answers queries without a server, for testing the visualizer.  The module registers the shared server as the
+//transport for QueryUrls that start with "local://", and it can also be reached over loopback http through
+//FTelemetryLocalHttpServer.
+//Events come from a saved query response, from a generator that keeps adding events as time passes, from a
+//synthesized dataset, from ingested batches, or any of these.  Queries take the same serialized form and return the
+//same response as the service, including continuation tokens.
+//Safe to call from any thread.
+class FTelemetryLocalServer : public IQueryTransport
+{
+public:
+    //The server local:// urls are answered by
+    static FTelemetryLocalServer &Get();
+
+    //A server of its own with no events, e.g. for tests that must not disturb the shared one
+    FTelemetryLocalServer();
+
+    static bool IsLocalUrl(const FString &Url) { return Url.StartsWith(TEXT("local://")); }
+
+    bool HandlesUrl(const FString &Url) const override { return IsLocalUrl(Url); }
+
+    //Runs a query and returns the response body.  An empty QueryText matches every event.  Columns is a comma
+    //separated list of the fields to return, or empty for all of them.  AsColumns returns events in the columnar
+    //format of FQueryResponseFormat instead of Json
+    TArray<uint8> HandleQuery(const FString &QueryText, int32 TakeLimit, const FString &ContinuationToken, const FString &Columns = FString(), bool AsColumns = false) override;
+
+    //Adds the events of a saved query response
+    bool LoadFile(const FString &Path);
+
+    //Adds the events of a batch as the game sends them to IngestUrl, {"header": {...}, "events": [...]}, gzipped or
+    //not.  The fields of the header are copied in to each event.  Returns the number of events added, or -1 if the
+    //body is not a batch
+    int32 Ingest(const uint8 *Data, int32 Size);
+
+    //Keeps events in a file of newline delimited Json, one event per line.  Events already in the file are added,
+    //and every event added from then on is appended, so a dataset outlives the process and the file can be imported
+    //by the visualizer
+    bool OpenStore(const FString &Path);
+
+    //Adds a dataset of players moving between a few busy areas of a map, each session with its own build and
+    //platform, and val_ and pct_ attributes that follow the session
+    void GenerateDataset(const FTelemetryDatasetOptions &Options);
+
+    //Generates EventsPerSecond events from now on, spread over a few sessions and locations.  0 stops the generator
+    void SetGenerateRate(float EventsPerSecond);
+
+    //Delays every response by Milliseconds, plus MillisecondsPerThousandEvents for each thousand results it
+    //returns, so the visualizer can be tried against the latency of a remote service
+    void SetLatency(float Milliseconds, float MillisecondsPerThousandEvents = 0.f);
+
+    //Oldest events are dropped past this many
+    void SetMaxEvents(int32 InMaxEvents);
+
+    //Removes every event.  The store, if any, is left as it is
+    void Empty();
+
+    int32 Num();
+
+private:
+    void GenerateUntil(const FDateTime &Now);
+    bool Matches(const FJsonObject &Event, const FJsonObject &Query) const;
+
+    //Merges events sorted newest first in to Events, and appends them to the store
+    void AddEvents(TArray<TSharedPtr<FJsonObject>> &&Added);
+
+    //An event and when it was added.  Every page of a query only returns events added before its first page, so
+    //events that arrive while it is paged through, however old their time, do not shift its pages
+    struct FStoredEvent
+    {
+        TSharedPtr<FJsonObject> Object;
+        uint64 Sequence;
+    };
+
+    //Newest first, the order the service returns
+    TArray<FStoredEvent> Events;
+    uint64 NextSequence;
+    int32 MaxEvents;
+
+    TUniquePtr<FArchive> Store;
+
+    float Latency;
+    float LatencyPerThousandEvents;
+
+    float GenerateRate;
+    FDateTime LastGenerated;
+    FRandomStream Random;
+    TArray<FString> Sessions;
+    TArray<FVector> Clusters;
+
+    FCriticalSection Lock;
+};
@@ -13,13 +13,30 @@
 #include "Misc/ConfigCacheIni.h"
 #include "Serialization/JsonSerializer.h"
 #include "Http.h"
+#include "Async/Async.h"
+#include "HAL/ThreadSafeBool.h"
 #include "TelemetryService.h"
+#include "Query/TelemetryQueryReader.h"
+#include "Query/TelemetryQueryFormat.h"
 
 #pragma once
 
 struct SQueryResult;
+class FQueryCache;
+class IQueryTransport;
 DECLARE_DELEGATE_OneParam(QueryResultHandler, TSharedPtr<SQueryResult>);
 
+//Stages of each page of a query, reported with the page index and the bytes received so far
+enum class EQueryStage
+{
+    Downloading,
+    Reading
+};
+DECLARE_DELEGATE_ThreeParams(QueryProgressHandler, EQueryStage, int32, int32);
+
+//Creates the sink a page of results is read in to.  Called on a worker thread
+typedef TFunction<TSharedRef<IQueryResultSink>()> FQueryResultSinkFactory;
+
 using FQueryOperator = FString;
 using FQueryNodeType = FString;
 
@@ -33,7 +50,8 @@ using FQueryNodeList = TArray<TSharedPtr<FQueryNode>>;
 enum class EQueryNodeType
 {
     Comparison = 0,
-    Group = 1
+    Group = 1,
+    Aggregate = 2
 };
 
 //Query operator
@@ -163,6 +181,18 @@ struct FQueryNode
     {
     }
 
+    // Overload for aggregate nodes, which AND their children and return one result per cell of CellSize instead of
+    // the matching events.  Column is the attribute summarized in each cell, or empty to only count events
+    FQueryNode(EQueryNodeType Type, FString Column, TSharedPtr<FJsonValue> &&CellSize, FQueryNodeList &&ChildNodes) :
+        Type(Type),
+        Operator(EQueryOp::And),
+        Column(Column),
+        Children(new FQueryNodeList(MoveTemp(ChildNodes))),
+        Value(MoveTemp(CellSize))
+    {
+        check(Type == EQueryNodeType::Aggregate);
+    }
+
 private:
     bool ValidateBetweenRange(FJsonValue &Value1, FJsonValue &Value2)
     {
@@ -238,6 +268,18 @@ public:
     
     static inline TSharedPtr<FQueryNode> Or(FQueryNodeList &&ChildNodes) { return CreateGroupNode(EQueryOp::Or, MoveTemp(ChildNodes)); }
 
+    // Events matching Query, summarized per cube of CellSize.  See FQueryAggregateCell for what each cell holds
+    static inline TSharedPtr<FQueryNode> Aggregate(FQueryNodePtr Query, float CellSize, FString Column = FString())
+    {
+        FQueryNodeList ChildNodes;
+        if (Query.IsValid())
+        {
+            ChildNodes.Add(Query);
+        }
+
+        return TSharedPtr<FQueryNode>(new FQueryNode(EQueryNodeType::Aggregate, Column, FJsonValueUtil::Create(CellSize), MoveTemp(ChildNodes)));
+    }
+
 };
 
 //Node to JSON serializer
@@ -246,10 +288,28 @@ class FQuerySerializer
 public:
     FString Serialize(const FQueryNodePtr Node);
 
+    //Reads a query in the serialized form.  Returns nullptr if QueryText is not a valid query
+    FQueryNodePtr Deserialize(const FString &QueryText);
+
+    //Projection sent with a query: the sorted, comma separated fields to return.  Empty returns every field
+    static FString SerializeColumns(const TArray<FString> &Columns);
+
 private:
 
     void Serialize(const FQueryNodePtr &Node, TSharedRef<TJsonWriter<>> &Writer);
     void Serialize(FQueryNodeList &Nodes, TSharedRef<TJsonWriter<>> &Writer);
+    FQueryNodePtr Deserialize(const TSharedPtr<FJsonObject> &Object);
+};
+
+//Splits a query over a time range in to queries over parts of it, so they can be run at once
+class FQueryTimeShards
+{
+public:
+    //Finds the client_ts Btwn Query requires, either Query itself or a child of its top level And, and fills
+    //OutShards with copies of Query that each require one of Shards consecutive millisecond ranges of it, newest
+    //first.  The ranges do not overlap, so the shards together match exactly the events Query does.  Returns false
+    //if Query has no such range or the range is shorter than two milliseconds
+    static bool Split(const FQueryNodePtr &Query, int32 Shards, FQueryNodeList &OutShards);
 };
 
 //Interface for standard event data
@@ -267,6 +327,7 @@ public:
 
     virtual uint32 GetSequence() const = 0;
     virtual FDateTime GetTime() const = 0;
+    virtual int32 GetCount() const = 0;
 
     virtual FVector GetPlayerPosition() const = 0;
     virtual FVector GetPlayerDirection() const = 0;
@@ -299,6 +360,7 @@ class FSimpleEvent : public ITelemetryEventData
     const TCHAR *BUILD_ID = TEXT("build_id");
     const TCHAR *PLATFORM = TEXT("platform");
     const TCHAR *CATEGORY = TEXT("cat");
+    const TCHAR *COUNT = TEXT("count");
 
     TMap<FString, TSharedPtr<FJsonValue>> Attributes;
 
@@ -316,6 +378,13 @@ public:
 
     uint32 GetSequence() const override { return (uint32)GetNumber(SEQUENCE); }
 
+    //Number of identical events this one stands for when the client coalesced repeats
+    int32 GetCount() const override
+    {
+        double Count;
+        return (GetNumber(COUNT, Count) && Count >= 1) ? (int32)Count : 1;
+    }
+
     FDateTime GetTime() const override
     {
         FDateTime Dt;
@@ -358,6 +427,31 @@ public:
         return GetVector(CAM_DIR);
     }
 
+    void SetAttribute(const FString &Name, TSharedPtr<FJsonValue> Value)
+    {
+        Attributes.Add(Name, MoveTemp(Value));
+    }
+
+    //Approximate bytes held by this event, including each Json value and its reference controller
+    SIZE_T GetAllocatedSize() const
+    {
+        SIZE_T Size = sizeof(FSimpleEvent) + Attributes.GetAllocatedSize();
+
+        for (auto &Attr : Attributes)
+        {
+            Size += Attr.Key.GetAllocatedSize() + sizeof(void *) * 3;
+
+            switch (Attr.Value->Type)
+            {
+            case EJson::String: Size += sizeof(FJsonValueString) + (Attr.Value->AsString().Len() + 1) * sizeof(TCHAR); break;
+            case EJson::Number: Size += sizeof(FJsonValueNumber); break;
+            default: Size += sizeof(FJsonValueBoolean); break;
+            }
+        }
+
+        return Size;
+    }
+
     void GetAttributes(TMap<FString, TSharedPtr<FJsonValue>>& inMap)
     {
         for (auto& attr : Attributes)
@@ -471,18 +565,66 @@ public:
     }
 };
 
+//Milliseconds a page spent in each phase before it reached the handler.  Phases the page did not go through are 0
+struct FQueryPageTimings
+{
+    //From sending the request to the first byte of the response
+    double FirstByte = 0;
+
+    //From the first byte of the response to the last
+    double Download = 0;
+
+    //Reading the response in to the sink, including any time the sink spent on the events
+    double Read = 0;
+};
+
 //Result data structure for query request
 struct SQueryResult
 {
     struct SQueryResultHeader
     {
-        bool Success;
-        int Count;
-        long QueryTime;
+        bool Success = false;
+        int Count = 0;
+        long QueryTime = 0;
+
+        //Set by the server when more results are available
+        FString ContinuationToken;
     } Header;
 
     TArray<FSimpleEvent> Events;
 
+    //Number of events read from the response, including any passed to a sink instead of Events
+    int32 EventCount = 0;
+
+    //Sink this page was read in to, when the query was given a sink factory
+    TSharedPtr<IQueryResultSink> Sink;
+
+    //Set when the whole result was loaded from the local query cache instead of the server
+    bool FromCache = false;
+
+    //Position of this result when a query is delivered in pages
+    int32 PageIndex = 0;
+    bool IsLastPage = true;
+
+    //Set on the last page when the pages hold every event matching the query, rather than being cut off by the
+    //result limit or cancelled
+    bool IsComplete = false;
+
+    //Set on the last page of a sharded query when a page of an earlier shard failed and was not merged, so the pages
+    //are missing that shard's time range
+    bool HasFailedShard = false;
+
+    FQueryPageTimings Timings;
+
+    //Reads a response with the streaming reader
+    static TSharedPtr<SQueryResult> Parse(const TArray<uint8> &Response)
+    {
+        TSharedPtr<SQueryResult> Result(new SQueryResult);
+        FQueryResultReader::Read(Response.GetData(), Response.Num(), *Result);
+        return Result;
+    }
+
+    //Reads a response through the Json DOM
     static TSharedPtr<SQueryResult> Parse(const FString &Response)
     {
         TSharedPtr<SQueryResult> Result(new SQueryResult);
@@ -497,105 +639,174 @@ struct SQueryResult
             Result->Header.Success = Header->GetBoolField("Success");
             Result->Header.Count = Header->GetNumberField("Count");
             Result->Header.QueryTime = Header->GetNumberField("QueryTime");
+            Header->TryGetStringField("ContinuationToken", Result->Header.ContinuationToken);
 
             for (TSharedPtr<FJsonValue> Event : Events)
             {
                 Result->Events.Add(FSimpleEvent::Parse(Event->AsObject()));
             }
+
+            Result->EventCount = Result->Events.Num();
         }
 
         return Result;
     }
 };
 
+//A running query, as seen through an FQueryHandle
+class IQueryOperation
+{
+public:
+    virtual ~IQueryOperation() {}
+
+    //Stops the query.  No further pages are requested or passed to its handler
+    virtual void Cancel() = 0;
+
+    virtual bool IsRunning() const = 0;
+};
+
+//Refers to a query started by an FQueryExecutor.  A handle does not keep its query alive, so cancelling one that has
+//finished or been replaced does nothing.  Only used on the game thread
+class FQueryHandle
+{
+public:
+    FQueryHandle() {}
+    explicit FQueryHandle(const TSharedRef<IQueryOperation, ESPMode::ThreadSafe> &Operation) : Operation(Operation) {}
+
+    //Aborts the request in flight.  A page already being read is dropped instead of being passed to the handler
+    void Cancel()
+    {
+        TSharedPtr<IQueryOperation, ESPMode::ThreadSafe> Pinned = Operation.Pin();
+        if (Pinned.IsValid())
+        {
+            Pinned->Cancel();
+        }
+
+        Operation.Reset();
+    }
+
+    //Whether pages may still be passed to the handler
+    bool IsRunning() const
+    {
+        TSharedPtr<IQueryOperation, ESPMode::ThreadSafe> Pinned = Operation.Pin();
+        return Pinned.IsValid() && Pinned->IsRunning();
+    }
+
+private:
+    TWeakPtr<IQueryOperation, ESPMode::ThreadSafe> Operation;
+};
+
 //Query execution
+//Results arrive in pages of at most the take limit.  While the server returns a continuation token, the next page is
+//requested automatically and every page is passed to the handler as it lands, with IsLastPage set on the final one.
+//Responses are read on a worker thread and only the finished page is handed back on the game thread.  When a sink
+//factory is given, each page is read in to a new sink instead of the result's Events, and complete results are
+//kept in the local query cache so the same query can be answered again without the server.
+//Queries over a time range can also be split in to shards that run at once, see ExecuteShardedQuery.
+//An executor runs one query at a time: starting another cancels the one running, so a page of a replaced query is
+//never passed to a handler after the query that replaced it has started.  A request that gets no response ends the
+//query with a failed, empty last page.
 class FQueryExecutor
 {
 public:
-    FQueryExecutor() : IsInitialized(false) {}
+    FQueryExecutor() : IsInitialized(false), AllowColumnResponses(false) {}
 
-    void ExecuteCustomQuery(const FString &QueryText, QueryResultHandler HandlerFunc)
+    FQueryHandle ExecuteCustomQuery(const FString &QueryText, QueryResultHandler HandlerFunc)
     {
-        ExecuteCustomQuery(QueryText, HandlerFunc, -1);
+        return ExecuteCustomQuery(QueryText, HandlerFunc, -1);
     }
 
-    void ExecuteCustomQuery(const FString &QueryText, QueryResultHandler HandlerFunc, int32 TakeLimit)
+    //UseCache can be turned off for queries that are only run once, such as live updates.
+    //Columns limits the fields the server returns for each event, or returns all of them when empty
+    FQueryHandle ExecuteCustomQuery(const FString &QueryText, QueryResultHandler HandlerFunc, int32 TakeLimit, FQueryResultSinkFactory SinkFactory = FQueryResultSinkFactory(), bool UseCache = true, const TArray<FString> &Columns = TArray<FString>())
     {
-        if (!IsInitialized)
-        {
-            Initialize();
-        }
+        return Execute(TEXT("POST"), QueryText, HandlerFunc, TakeLimit, MoveTemp(SinkFactory), UseCache, Columns);
+    }
 
-        if (TakeLimit < 0)
-        {
-            TakeLimit = ConfiguredTakeLimit;
-        }
+    FQueryHandle ExecuteCustomQuery(QueryResultHandler HandlerFunc)
+    {
+        return ExecuteDefaultQuery(HandlerFunc, -1);
+    }
 
-        FHttpRequestPtr Request = CreateRequest(HandlerFunc, TakeLimit);
-        Request->SetVerb(TEXT("POST"));
-        Request->SetContentAsString(QueryText);
-        Request->ProcessRequest();
+    FQueryHandle ExecuteDefaultQuery(QueryResultHandler HandlerFunc, int32 TakeLimit, FQueryResultSinkFactory SinkFactory = FQueryResultSinkFactory())
+    {
+        return Execute(TEXT("GET"), FString(), HandlerFunc, TakeLimit, MoveTemp(SinkFactory), true, TArray<FString>());
     }
 
-    void ExecuteCustomQuery(QueryResultHandler HandlerFunc)
+    //Splits the client_ts range of Query in to Shards parts and runs them at once, at most QueryShardParallelism at
+    //a time.  Pages reach the handler as from one query, newest first: the newest part is passed on as it lands and
+    //each older part is held until every newer one is done, which merges the disjoint parts in to time descending
+    //order.  A negative Shards uses the configured QueryShards.  Queries that cannot be split run unsplit
+    FQueryHandle ExecuteShardedQuery(const FQueryNodePtr &Query, int32 Shards, QueryResultHandler HandlerFunc, int32 TakeLimit, FQueryResultSinkFactory SinkFactory = FQueryResultSinkFactory(), bool UseCache = true, const TArray<FString> &Columns = TArray<FString>());
+
+    //Lets the server answer queries with a sink factory in columns rather than Json, when QueryColumnResponses is
+    //set.  Only for executors whose sinks read events, since columns do not carry the fields of aggregate cells
+    void SetAllowColumnResponses(bool Allow)
     {
-        ExecuteDefaultQuery(HandlerFunc, -1);
+        AllowColumnResponses = Allow;
     }
 
-    void ExecuteDefaultQuery(QueryResultHandler HandlerFunc, int32 TakeLimit)
+    //Progress of queries started after this is set
+    void SetProgressHandler(QueryProgressHandler HandlerFunc)
     {
-        if (!IsInitialized)
-        {
-            Initialize();
-        }
+        ProgressFunc = HandlerFunc;
+    }
 
-        if (TakeLimit < 0)
-        {
-            TakeLimit = ConfiguredTakeLimit;
-        }
+    //Stops the running query.  No further pages are requested or passed to the handler
+    void CancelQuery();
 
-        FHttpRequestPtr Request = CreateRequest(HandlerFunc, TakeLimit);
-        Request->SetVerb(TEXT("GET"));
-        Request->ProcessRequest();
-    }
+    bool IsQueryRunning() const;
+
+    //Queries to urls Transport handles are answered by it instead of over http, from queries started after this
+    //on.  Transport must stay alive until it is unregistered and the queries it answers are done
+    static void RegisterTransport(IQueryTransport *Transport);
+    static void UnregisterTransport(IQueryTransport *Transport);
 
 private:
-    FHttpRequestPtr CreateRequest(QueryResultHandler HandlerFunc, int32 TakeLimit)
-    {
-        auto Request = FTelemetryService::CreateServiceRequest();
+    struct FPagedQuery;
+    struct FShardedQuery;
 
-        FString Url = FString::Printf(TEXT("%s?take=%i"), *QueryUrl, TakeLimit);
+    typedef TSharedRef<FPagedQuery, ESPMode::ThreadSafe> FPagedQueryRef;
+    typedef TSharedRef<FShardedQuery, ESPMode::ThreadSafe> FShardedQueryRef;
+    typedef TSharedPtr<const TArray<uint8>, ESPMode::ThreadSafe> FContentPtr;
 
-        Request->SetURL(Url);
-        Request->SetHeader(TEXT("Content-Type"), TEXT("application/json"));
-        Request->SetHeader(TEXT("User-Agent"), "X-UnrealEngine-Agent");
+    static IQueryTransport *FindTransport(const FString &Url);
 
-        Request->OnProcessRequestComplete().BindLambda([HandlerFunc](FHttpRequestPtr Request, FHttpResponsePtr Response, bool bWasSuccessful)
-        {
-            if (bWasSuccessful)
-            {
-                TSharedPtr<SQueryResult> Result = SQueryResult::Parse(Response->GetContentAsString());
+    FQueryHandle Execute(const FString &Verb, const FString &QueryText, QueryResultHandler HandlerFunc, int32 TakeLimit, FQueryResultSinkFactory SinkFactory, bool UseCache, const TArray<FString> &Columns);
+    FPagedQueryRef CreateQuery(const FString &Verb, const FString &QueryText, QueryResultHandler HandlerFunc, int32 TakeLimit, FQueryResultSinkFactory SinkFactory, bool UseCache, const TArray<FString> &Columns);
 
-                HandlerFunc.ExecuteIfBound(Result);
-            }
-        });
+    static void StartQuery(FPagedQueryRef Query);
 
-        return Request;
-    }
+    //Starts waiting shards, newest first, until the parallelism limit is reached
+    static void StartShards(const FShardedQueryRef &Sharded);
+    static void DeliverShardPage(FShardedQueryRef Sharded, int32 Shard, TSharedPtr<SQueryResult> Result);
 
-    void Initialize()
-    {
-        const FString IniName = FString::Printf(TEXT("%sGameTelemetry.ini"), *FPaths::SourceConfigDir());
-        const FString SectionName = "GameTelemetry";
+    //Answers the query from the local cache on a worker thread, or goes to the server when there is no entry
+    static void LoadFromCache(FPagedQueryRef Query);
 
-        GConfig->GetString(*SectionName, TEXT("QueryUrl"), QueryUrl, IniName);
-        if (!GConfig->GetInt(*SectionName, TEXT("QueryTakeLimit"), ConfiguredTakeLimit, IniName))
-        {
-            ConfiguredTakeLimit = DefaultTakeLimit;
-        }
+    //Received is the number of events in the pages before this one, which limits the page to the results left
+    static void RequestPage(FPagedQueryRef Query, const FString &ContinuationToken, int32 Received);
 
-        IsInitialized = true;
-    }
+    //Requests the page after PageIndex while PageIndex is read, when its header has a token and Count events
+    static void RequestNextPage(FPagedQueryRef Query, int32 PageIndex, const FString &ContinuationToken, int32 Count);
+
+    //Answers the page from the query's transport on a worker thread
+    static void RequestTransportPage(FPagedQueryRef Query, int32 PageIndex, int32 TakeLimit, const FString &ContinuationToken);
+
+    static FHttpRequestPtr CreateRequest(FPagedQueryRef Query, int32 PageIndex, int32 TakeLimit);
+
+    //Reads a response that has arrived, or holds it until the page before it has been read.  A null ContentPtr is a
+    //request that failed
+    static void ReceivePage(FPagedQueryRef Query, FContentPtr ContentPtr, const FQueryPageTimings &Timings);
+
+    //Reads the response on a worker thread, then hands the page to the game thread
+    static void ReadPage(FPagedQueryRef Query, FContentPtr ContentPtr, const FQueryPageTimings &Timings);
+
+    //Ends the query with an empty page that is not successful, so the handler is not left waiting for a last page
+    static void DeliverFailedPage(FPagedQueryRef Query);
+    static void DeliverPage(FPagedQueryRef Query, TSharedPtr<SQueryResult> Result);
+
+    void Initialize();
 
 private:
     FString QueryUrl;
@@ -603,6 +814,33 @@ private:
     bool IsInitialized;
     int32 ConfiguredTakeLimit;
 
-    // Default max number of documents to retrieve from the server
+    // Total number of documents to retrieve across all pages, or 0 for no limit
+    int32 MaxResults;
+
+    // Whether responses may be gzip compressed, and whether executors that allow it ask for columnar responses
+    bool Compression;
+    bool ColumnResponses;
+    bool AllowColumnResponses;
+
+    // Largest size in bytes a compressed response may inflate to.  Larger pages fail rather than take the memory
+    int32 MaxResponseSize;
+
+    // Number of time ranges a sharded query is split in to, and how many of them run at once
+    int32 ConfiguredShards;
+    int32 ShardParallelism;
+
+    QueryProgressHandler ProgressFunc;
+    TSharedPtr<FPagedQuery, ESPMode::ThreadSafe> ActiveQuery;
+    TSharedPtr<FShardedQuery, ESPMode::ThreadSafe> ActiveSharded;
+    TSharedPtr<FQueryCache, ESPMode::ThreadSafe> Cache;
+
+    // Default max number of documents to retrieve from the server in each page
     static const int32 DefaultTakeLimit = 10000;
+
+    // Default seconds a cached result is used for, and megabytes the cache may hold
+    static constexpr float DefaultCacheTimeToLive = 3600.f;
+    static const int32 DefaultCacheMaxSize = 256;
+
+    // Default number of shards of a sharded query that run at once
+    static const int32 DefaultShardParallelism = 4;
 };
@@ -0,0 +1,76 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//--------------------------------------------------------------------------------------
+// TelemetryQueryAggregate.h
+//
+// Results of aggregate queries
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Query/TelemetryQueryReader.h"
+
+//One cell of an aggregate query: the events whose position falls in the cube of the cell size starting at
+//Cell * cell size.  Coalesced events count once for every event they stand for.
+//Sent as "cell_x", "cell_y", "cell_z", "count", "sum", "min", "max" and the mean direction as "dir_x", "dir_y", "dir_z"
+struct FQueryAggregateCell
+{
+    FIntVector Cell;
+    double Count;
+
+    //Of the aggregated attribute.  Events without it add nothing to Sum, and Min and Max are NaN when no event has it
+    double Sum;
+    double Min;
+    double Max;
+
+    FVector Direction;
+
+    FQueryAggregateCell() : Cell(0, 0, 0), Count(0), Sum(0), Min(NAN), Max(NAN), Direction(FVector::ZeroVector) {}
+
+    bool HasValue() const { return !FMath::IsNaN(Min); }
+};
+
+//Reads the cells of an aggregate query response
+class FQueryAggregateSink : public IQueryResultSink
+{
+public:
+    FQueryAggregateSink() : NumSkipped(0), HasCell(false) {}
+
+    TArray<FQueryAggregateCell> &GetCells() { return Cells; }
+
+    //Results that were not cells, e.g. events from a server that does not aggregate
+    int32 GetNumSkipped() const { return NumSkipped; }
+
+    void BeginEvent() override;
+    void EndEvent() override;
+    void SetNumber(EQueryResultField Field, const FString &Name, double Value) override;
+    void SetString(EQueryResultField Field, const FString &Name, const TCHAR *Value, int32 Length) override {}
+    void SetBool(EQueryResultField Field, const FString &Name, bool Value) override {}
+
+private:
+    TArray<FQueryAggregateCell> Cells;
+    FQueryAggregateCell Current;
+    int32 NumSkipped;
+    bool HasCell;
+};
+
+//Builds the cells of an aggregate from events added one at a time.  The reference for what the service returns
+class FQueryAggregator
+{
+public:
+    FQueryAggregator(float CellSize) : CellSize(FMath::Max(CellSize, KINDA_SMALL_NUMBER)) {}
+
+    //Value is the aggregated attribute of the event, or nullptr if it does not have it
+    void Add(const FVector &Position, const FVector &Direction, int32 Count, const double *Value);
+
+    //Cells ordered by index, so pages of the same aggregate line up
+    void GetCells(TArray<FQueryAggregateCell> &OutCells) const;
+
+private:
+    float CellSize;
+    TMap<FIntVector, FQueryAggregateCell> Cells;
+};
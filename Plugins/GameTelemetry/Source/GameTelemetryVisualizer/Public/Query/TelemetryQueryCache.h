@@ -0,0 +1,102 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//--------------------------------------------------------------------------------------
+// TelemetryQueryCache.h
+//
+// On disk cache of query results
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Query/TelemetryQueryColumns.h"
+
+//Passes every event to two sinks, so a response can be shown and cached in one read
+class FQueryTeeSink : public IQueryResultSink
+{
+public:
+    FQueryTeeSink(IQueryResultSink &First, IQueryResultSink &Second) : First(First), Second(Second) {}
+
+    void BeginPage(int32 PageIndex) override { First.BeginPage(PageIndex); Second.BeginPage(PageIndex); }
+    void EndPage() override { First.EndPage(); Second.EndPage(); }
+    void BeginEvent() override { First.BeginEvent(); Second.BeginEvent(); }
+    void EndEvent() override { First.EndEvent(); Second.EndEvent(); }
+
+    void SetNumber(EQueryResultField Field, const FString &Name, double Value) override
+    {
+        First.SetNumber(Field, Name, Value);
+        Second.SetNumber(Field, Name, Value);
+    }
+
+    void SetString(EQueryResultField Field, const FString &Name, const TCHAR *Value, int32 Length) override
+    {
+        First.SetString(Field, Name, Value, Length);
+        Second.SetString(Field, Name, Value, Length);
+    }
+
+    void SetBool(EQueryResultField Field, const FString &Name, bool Value) override
+    {
+        First.SetBool(Field, Name, Value);
+        Second.SetBool(Field, Name, Value);
+    }
+
+    bool AddColumns(const FQueryResultColumns &Columns) override
+    {
+        if (!First.AddColumns(Columns))
+        {
+            Columns.Replay(First);
+        }
+
+        if (!Second.AddColumns(Columns))
+        {
+            Columns.Replay(Second);
+        }
+
+        return true;
+    }
+
+private:
+    IQueryResultSink &First;
+    IQueryResultSink &Second;
+};
+
+//Complete query results kept in the project's Saved directory, one file per query.
+//Entries are result columns written as flat arrays, so loading one is a mapped read and a copy per column.
+//Entries older than the time to live are ignored and deleted, and the least recently used entries are deleted
+//once the cache grows past its size limit.  Safe to call from any thread.
+class FQueryCache
+{
+public:
+    //TimeToLive in seconds and MaxSize in bytes.  A time to live of 0 turns the cache off
+    FQueryCache(double TimeToLive, int64 MaxSize);
+
+    bool IsEnabled() const { return TimeToLive > 0; }
+
+    //Key for a query.  QueryText is normalized first, so formatting alone does not change the key.  Columns is the
+    //serialized projection, since an entry only holds the columns its query asked for
+    static FString MakeKey(const FString &Url, const FString &Verb, const FString &QueryText, int32 TakeLimit, int32 MaxResults, const FString &Columns);
+
+    //Removes Json whitespace outside of strings
+    static FString Normalize(const FString &QueryText);
+
+    //Returns false if there is no entry for Key, or it has expired or cannot be read
+    bool Load(const FString &Key, FQueryResultColumns &OutColumns, int32 &OutQueryTime) const;
+
+    //Writes the entry for Key, then evicts entries as needed
+    void Store(const FString &Key, const FQueryResultColumns &Columns, int32 QueryTime) const;
+
+    //Deletes every entry
+    void Clear() const;
+
+    static FString GetDirectory();
+
+private:
+    FString GetPath(const FString &Key) const;
+    void Evict() const;
+
+    double TimeToLive;
+    int64 MaxSize;
+};
@@ -0,0 +1,186 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//--------------------------------------------------------------------------------------
+// TelemetryQueryColumns.h
+//
+// Column storage for query results
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Query/TelemetryQueryReader.h"
+
+//Strings stored once each, with an index in to the dictionary per event
+class FQueryStringColumn
+{
+public:
+    int32 Num() const { return Indices.Num(); }
+
+    const FString &Get(int32 Row) const { return Dictionary[Indices[Row]]; }
+    int32 GetIndex(int32 Row) const { return Indices[Row]; }
+    const TArray<int32> &GetIndices() const { return Indices; }
+    const TArray<FString> &GetDictionary() const { return Dictionary; }
+
+    //Dictionary index of Value, or INDEX_NONE if no event has it
+    int32 Find(const FString &Value) const
+    {
+        const int32 *Index = Lookup.Find(Value);
+        return Index != nullptr ? *Index : INDEX_NONE;
+    }
+
+    void Add(const FString &Value)
+    {
+        //Events of the same group tend to arrive together, so the last value is checked before the lookup
+        if (Indices.Num() > 0 && Dictionary[Indices.Last()] == Value)
+        {
+            Indices.Add(Indices.Last());
+            return;
+        }
+
+        const int32 *Index = Lookup.Find(Value);
+        if (Index == nullptr)
+        {
+            Index = &Lookup.Add(Value, Dictionary.Add(Value));
+        }
+
+        Indices.Add(*Index);
+    }
+
+    //Replaces the column, e.g. when it is loaded from the query cache
+    void Set(TArray<FString> &&InDictionary, TArray<int32> &&InIndices);
+
+    //Adds the rows of Other, mapping its dictionary on to this one
+    void Append(const FQueryStringColumn &Other);
+
+    void Reorder(const TArray<int32> &Order);
+    void Empty();
+    SIZE_T GetAllocatedSize() const;
+
+private:
+    TArray<FString> Dictionary;
+    TMap<FString, int32> Lookup;
+    TArray<int32> Indices;
+};
+
+//Three columns for a vector field.  Kept as doubles, the precision the service compares them at
+struct FQueryVectorColumn
+{
+    TArray<double> X;
+    TArray<double> Y;
+    TArray<double> Z;
+
+    FVector Get(int32 Row) const { return FVector(X[Row], Y[Row], Z[Row]); }
+
+    void Add(const FVector &Value)
+    {
+        Add(Value.X, Value.Y, Value.Z);
+    }
+
+    void Add(double InX, double InY, double InZ)
+    {
+        X.Add(InX);
+        Y.Add(InY);
+        Z.Add(InZ);
+    }
+
+    void Reorder(const TArray<int32> &Order);
+    void Empty();
+    SIZE_T GetAllocatedSize() const { return X.GetAllocatedSize() + Y.GetAllocatedSize() + Z.GetAllocatedSize(); }
+};
+
+//A numeric "val_" or "pct_" attribute.  Events without the attribute hold NaN.
+//Values are kept as the doubles they were sent as, so a local comparison matches the same events as the service
+struct FQueryValueColumn
+{
+    FString Name;
+    TArray<double> Values;
+
+    bool HasValue(int32 Row) const { return !FMath::IsNaN(Values[Row]); }
+};
+
+//Query results stored as one array per field rather than one attribute map per event.
+//Every column has one entry per event, so event N is row N of each column.
+struct FQueryResultColumns
+{
+    FQueryVectorColumn Position;
+    FQueryVectorColumn Direction;
+    TArray<int64> Ticks;
+    TArray<int32> Counts;
+    FQueryStringColumn Name;
+    FQueryStringColumn Category;
+    FQueryStringColumn Session;
+    FQueryStringColumn BuildType;
+    FQueryStringColumn BuildId;
+    FQueryStringColumn Platform;
+    TArray<FQueryValueColumn> Values;
+
+    int32 Num() const { return Ticks.Num(); }
+
+    FDateTime GetTime(int32 Row) const { return FDateTime(Ticks[Row]); }
+
+    //Build in the form the editor shows it
+    FString GetBuild(int32 Row) const { return BuildType.Get(Row) + TEXT(" ") + BuildId.Get(Row) + TEXT(" ") + Platform.Get(Row); }
+
+    //Column for a "val_" or "pct_" attribute, or nullptr if no event has it
+    const FQueryValueColumn *FindValues(const FString &ValueName) const
+    {
+        return Values.FindByPredicate([&ValueName](const FQueryValueColumn &Column) { return Column.Name == ValueName; });
+    }
+
+    //Orders every column newest first, which the timeline and animation depend on
+    void SortByTimeDescending();
+
+    //Moves row Order[i] to row i in every column
+    void Reorder(const TArray<int32> &Order);
+
+    //Passes every row to Sink as if it had been read from a response.  When Selection is given, only rows where it
+    //is non-zero are passed
+    void Replay(IQueryResultSink &Sink, const TArray<uint8> *Selection = nullptr) const;
+
+    //Adds the rows of Other after the rows of this
+    void Append(const FQueryResultColumns &Other);
+
+    void Empty();
+
+    //Bytes held by all columns, including string dictionaries
+    SIZE_T GetAllocatedSize() const;
+};
+
+//Fills FQueryResultColumns as the reader walks a response
+class FQueryColumnSink : public IQueryResultSink
+{
+public:
+    FQueryColumnSink(FQueryResultColumns &Columns) : Columns(Columns) {}
+
+    void BeginEvent() override;
+    void EndEvent() override;
+    void SetNumber(EQueryResultField Field, const FString &Name, double Value) override;
+    void SetString(EQueryResultField Field, const FString &Name, const TCHAR *Value, int32 Length) override;
+    void SetBool(EQueryResultField Field, const FString &Name, bool Value) override;
+    bool AddColumns(const FQueryResultColumns &Other) override;
+
+private:
+    void SetValue(const FString &Name, double Value);
+
+    FQueryResultColumns &Columns;
+
+    //Fields of the event being read, added to the columns together once it ends
+    double Position[3];
+    double Direction[3];
+    FDateTime Time;
+    int32 Count;
+    FString Name;
+    FString Category;
+    FString Session;
+    FString BuildType;
+    FString BuildId;
+    FString Platform;
+    TArray<double> PendingValues;
+
+    //Value column index for each attribute name seen so far
+    TMap<FString, int32> ValueIndex;
+};
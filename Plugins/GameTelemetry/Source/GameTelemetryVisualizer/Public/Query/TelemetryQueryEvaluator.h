@@ -0,0 +1,83 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//--------------------------------------------------------------------------------------
+// TelemetryQueryEvaluator.h
+//
+// Evaluates queries over loaded result columns
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Query/TelemetryQuery.h"
+
+//A query compiled against result columns, so it can be answered without the server.
+//Each comparison is a single pass over one column, and groups combine the passes with and/or over byte masks.
+//String comparisons are made once per dictionary entry rather than once per event.
+class FQueryEvaluator
+{
+public:
+    //Returns nullptr if Query compares a field that is not kept in the columns, or compares it to a value of another
+    //type, in which case only the server can answer it.  When the columns were loaded with a projection, Projection
+    //lists the fields they hold and fields outside it are treated the same way.  Columns must outlive the evaluator
+    static TSharedPtr<FQueryEvaluator> Compile(const FQueryNodePtr &Query, const FQueryResultColumns &Columns, const TArray<FString> *Projection = nullptr);
+
+    //Sets OutMask[Row] to 1 for every row that matches and 0 for every other row
+    void Evaluate(TArray<uint8> &OutMask) const;
+
+    //True if every event matching Query also matches Loaded, so the complete results of Loaded hold every result
+    //of Query.  May return false for queries that do narrow Loaded, but never true for ones that do not
+    static bool IsNarrowing(const FQueryNodePtr &Query, const FQueryNodePtr &Loaded);
+
+    //Whether every event matching Query also matches Other
+    static bool Implies(const FQueryNode &Query, const FQueryNode &Other);
+
+    //Whether a field holding Value matches Comparison, with the ordering the service uses
+    static bool Satisfies(const TSharedPtr<FJsonValue> &Value, const FQueryNode &Comparison);
+
+    //Orders two values of the same type.  Returns false for values of different types, which never compare
+    static bool CompareValues(const TSharedPtr<FJsonValue> &A, const TSharedPtr<FJsonValue> &B, int32 &OutOrder);
+
+    //Values of a comparison, which holds an array for In and Btwn and a single value otherwise
+    static TArray<TSharedPtr<FJsonValue>> GetValues(const FQueryNode &Comparison);
+
+private:
+    enum class EColumnKind
+    {
+        Group,
+        Number,
+        Ticks,
+        String
+    };
+
+    struct FStep
+    {
+        EQueryOp Operator;
+        EColumnKind Kind;
+
+        const TArray<double> *Values;
+        const TArray<int64> *Ticks;
+        const FQueryStringColumn *Strings;
+
+        //Values compared against.  One for most operators, two for Btwn and any number for In.
+        //Numbers are compared as doubles, the same as the service, so both match the same events
+        TArray<double> Numbers;
+        TArray<int64> TickNumbers;
+
+        //For string columns, whether each dictionary entry matches
+        TArray<uint8> DictionaryMatch;
+
+        TArray<FStep> Children;
+
+        FStep() : Operator(EQueryOp::And), Kind(EColumnKind::Group), Values(nullptr), Ticks(nullptr), Strings(nullptr) {}
+    };
+
+    static bool CompileStep(const FQueryNode &Node, const FQueryResultColumns &Columns, const TArray<FString> *Projection, FStep &OutStep);
+    void EvaluateStep(const FStep &Step, TArray<uint8> &OutMask) const;
+
+    FStep Root;
+    int32 NumRows;
+};
@@ -0,0 +1,53 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//--------------------------------------------------------------------------------------
+// TelemetryQueryFormat.h
+//
+// Compressed and columnar query responses
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Query/TelemetryQueryColumns.h"
+
+//Encodings of a query response besides plain Json.
+//A response may be gzip compressed, and a server that knows the columnar content type may send the page as
+//FQueryResultColumns instead of Json: one typed array per field and a dictionary per string field, which is read
+//with a copy per column.  Responses are recognized by their first bytes, so it does not matter whether the http
+//backend passes the content headers on or has already inflated the body.
+//Multi byte values are little endian and strings are UTF-8 with a byte length.
+class FQueryResponseFormat
+{
+public:
+    //Sent in the Accept header by executors that can take columnar responses
+    static const TCHAR *ColumnsContentType;
+
+    static bool IsGzip(const uint8 *Data, int32 Size);
+    static bool IsColumns(const uint8 *Data, int32 Size);
+
+    //Inflated bodies are limited to this size unless a caller asks for another
+    static const int32 DefaultMaxInflatedSize;
+
+    //Inflates a gzip body of one or more members.  Returns false, with OutData empty, if it is not valid gzip or
+    //inflates to more than MaxSize bytes
+    static bool Gunzip(const uint8 *Data, int32 Size, TArray<uint8> &OutData, int32 MaxSize = DefaultMaxInflatedSize);
+    static bool Gzip(const uint8 *Data, int32 Size, TArray<uint8> &OutData);
+
+    //Reads a Json or columnar response, after inflating it if it is compressed.  The header goes in to OutResult and
+    //the events to Sink.  Returns false if the response is malformed
+    static bool Read(const uint8 *Data, int32 Size, SQueryResult &OutResult, IQueryResultSink &Sink);
+
+    //Reads only the header of an inflated Json or columnar response in to OutResult, which is enough to request the
+    //next page while this one is read.  Returns false if the header cannot be read
+    static bool ReadHeader(const uint8 *Data, int32 Size, SQueryResult &OutResult);
+
+    //Writes one page of results as a columnar response
+    static void WriteColumns(const FQueryResultColumns &Columns, bool Success, int32 QueryTime, const FString &ContinuationToken, TArray<uint8> &OutData);
+
+    //Converts a Json response in to a columnar one.  Only the fields the columns keep are carried over
+    static bool JsonToColumns(const uint8 *Data, int32 Size, TArray<uint8> &OutData);
+};
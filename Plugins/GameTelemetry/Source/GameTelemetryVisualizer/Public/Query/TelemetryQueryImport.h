@@ -0,0 +1,84 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//--------------------------------------------------------------------------------------
+// TelemetryQueryImport.h
+//
+// Reads event files without a server
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Query/TelemetryQuery.h"
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+//Reads a file of events in to pages of results, handed over as if they were the pages of a query.
+//Two formats are read:
+// - newline delimited Json, one event object per line with the fields of a query result
+// - event files: FileMagic, then each page as its size in bytes followed by a columnar response
+//The file is memory mapped where the platform supports it and split in to chunks at line or page boundaries.
+//Chunks are read at once on worker threads, each in to its own sink from the sink factory, and passed to the
+//handler on the game thread in file order, with IsLastPage set on the final one.
+class FQueryFileImport : public TSharedFromThis<FQueryFileImport, ESPMode::ThreadSafe>
+{
+public:
+    static const uint32 FileMagic;
+
+    ~FQueryFileImport();
+
+    //Returns nullptr if the file cannot be opened
+    static TSharedPtr<FQueryFileImport, ESPMode::ThreadSafe> Start(const FString &Path, QueryResultHandler HandlerFunc, FQueryResultSinkFactory SinkFactory);
+
+    //No further pages are passed to the handler
+    void Cancel() { IsCancelled = true; }
+
+    bool IsRunning() const { return !IsCancelled; }
+
+    int64 GetFileSize() const { return Size; }
+
+    //Writes the start of an event file, before any page
+    static void WriteFileHeader(FArchive &Writer);
+
+    //Writes a columnar response as the next page of an event file
+    static void WritePage(FArchive &Writer, const TArray<uint8> &Page);
+
+private:
+    FQueryFileImport();
+
+    bool Open(const FString &Path);
+    void Split();
+    void StartChunks();
+    void DeliverChunk(int32 Chunk, TSharedPtr<SQueryResult> Result);
+    static TSharedPtr<SQueryResult> ReadChunk(const uint8 *ChunkData, int64 ChunkSize, bool IsColumns, int32 Chunk, const FQueryResultSinkFactory &SinkFactory, int32 &OutSkipped);
+
+    FString Path;
+    TUniquePtr<IMappedFileHandle> MappedFile;
+    TUniquePtr<IMappedFileRegion> MappedRegion;
+    TArray<uint8> Loaded;
+    const uint8 *Data;
+    int64 Size;
+    bool IsColumns;
+
+    //Byte range of each chunk
+    TArray<TPair<int64, int64>> Chunks;
+
+    QueryResultHandler HandlerFunc;
+    FQueryResultSinkFactory SinkFactory;
+
+    //Chunks read but not yet passed on, because an earlier one is still being read
+    TMap<int32, TSharedPtr<SQueryResult>> Finished;
+    int32 NextChunk;
+    int32 NextDeliver;
+    int32 Running;
+    int32 Parallelism;
+    int32 Skipped;
+    bool IsComplete;
+    double StartTime;
+
+    FThreadSafeBool IsCancelled;
+};
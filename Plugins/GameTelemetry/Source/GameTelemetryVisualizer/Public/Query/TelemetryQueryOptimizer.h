@@ -0,0 +1,50 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//--------------------------------------------------------------------------------------
+// TelemetryQueryOptimizer.h
+//
+// Simplifies query trees before they are sent
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Query/TelemetryQuery.h"
+
+//Rewrites a query in to a smaller one that matches the same events:
+// - nested groups of the same operator are flattened and single child groups are replaced by the child
+// - Eq and In on the same column under an Or are folded in to one In
+// - ranges on the same column under an And are intersected, becoming a Btwn when both bounds are inclusive
+// - clauses another clause already implies are removed, and contradictions make the whole group empty
+// - children and In values are sorted, so queries that differ only in order serialize the same
+//A group that matches every event is an And without children, and one that matches none is an Or without children.
+class FQueryOptimizer
+{
+public:
+    //Returns a new tree.  Query is not changed, though unchanged comparisons are shared with it
+    static FQueryNodePtr Optimize(const FQueryNodePtr &Query);
+
+    //True for a query that can match no event, which need not be sent
+    static bool IsEmpty(const FQueryNodePtr &Query);
+
+    //True for a query that matches every event
+    static bool IsTautology(const FQueryNodePtr &Query);
+
+    //Serialized optimized form, equal for queries the optimizer can tell are the same
+    static FString GetCanonicalText(const FQueryNodePtr &Query);
+
+    //Number of nodes in the tree, for reporting what the optimizer removed
+    static int32 CountNodes(const FQueryNodePtr &Query);
+
+private:
+    static FQueryNodePtr OptimizeNode(const FQueryNodePtr &Node);
+    static FQueryNodePtr OptimizeComparison(const FQueryNodePtr &Node);
+    static FQueryNodePtr OptimizeGroup(const FQueryNodePtr &Node);
+
+    static void FoldPoints(FQueryNodeList &Children);
+    static bool IntersectColumns(FQueryNodeList &Children);
+    static void RemoveImplied(FQueryNodeList &Children, bool IsAnd);
+};
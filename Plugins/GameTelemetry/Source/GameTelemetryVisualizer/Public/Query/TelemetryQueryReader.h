@@ -0,0 +1,96 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//--------------------------------------------------------------------------------------
+// TelemetryQueryReader.h
+//
+// Streaming reader for query responses
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct SQueryResult;
+struct FQueryResultColumns;
+
+//Event fields the reader recognizes up front, so sinks can store them without comparing names
+enum class EQueryResultField
+{
+    Other,
+    PlayerPositionX,
+    PlayerPositionY,
+    PlayerPositionZ,
+    PlayerDirectionX,
+    PlayerDirectionY,
+    PlayerDirectionZ,
+    ClientTimestamp,
+    Name,
+    Category,
+    SessionId,
+    BuildType,
+    BuildId,
+    Platform,
+    Count
+};
+
+//Receives each event as the reader walks the response, so results can be stored without building a Json DOM first
+class IQueryResultSink
+{
+public:
+    virtual ~IQueryResultSink() {}
+
+    //Called before any event of a page is read.  Page 0 is the start of a new query
+    virtual void BeginPage(int32 PageIndex) {}
+
+    //Called on the same thread once every event of the page has been read, to finish any indexing
+    virtual void EndPage() {}
+
+    virtual void BeginEvent() = 0;
+    virtual void EndEvent() = 0;
+
+    //Name is the field as sent by the server and Field is set when it is one of the recognized fields
+    //String values are only valid for the duration of the call
+    virtual void SetNumber(EQueryResultField Field, const FString &Name, double Value) = 0;
+    virtual void SetString(EQueryResultField Field, const FString &Name, const TCHAR *Value, int32 Length) = 0;
+    virtual void SetBool(EQueryResultField Field, const FString &Name, bool Value) = 0;
+
+    //Called instead of the calls above when a page arrives already in columns.  Returns false if the sink has no
+    //faster way to take them, in which case every row is passed to it as an event
+    virtual bool AddColumns(const FQueryResultColumns &Columns) { return false; }
+};
+
+//Discards every event, so only the server and transfer time of a query are measured
+class FQueryDiscardSink : public IQueryResultSink
+{
+public:
+    void BeginEvent() override {}
+    void EndEvent() override {}
+    void SetNumber(EQueryResultField Field, const FString &Name, double Value) override {}
+    void SetString(EQueryResultField Field, const FString &Name, const TCHAR *Value, int32 Length) override {}
+    void SetBool(EQueryResultField Field, const FString &Name, bool Value) override {}
+    bool AddColumns(const FQueryResultColumns &Columns) override { return true; }
+};
+
+//Single pass reader over the raw UTF-8 bytes of a query response
+//Field names are resolved once per distinct name, and values are decoded in place without per-event allocations.
+class FQueryResultReader
+{
+public:
+    //Reads the header in to OutResult and passes every event to Sink.  Returns false if the response is malformed,
+    //in which case Sink may already have received the events before the error.
+    static bool Read(const uint8 *Data, int32 Size, SQueryResult &OutResult, IQueryResultSink &Sink);
+
+    //Reads the header and events in to OutResult
+    static bool Read(const uint8 *Data, int32 Size, SQueryResult &OutResult);
+
+    //Reads only the header in to OutResult, without going through the events that follow it.  Returns false if the
+    //response has no header
+    static bool ReadHeader(const uint8 *Data, int32 Size, SQueryResult &OutResult);
+
+    //Reads newline delimited Json, one event object per line with the fields of a query result, and passes every
+    //event to Sink.  Returns the number of events, with the number of lines that were not an event in OutSkipped
+    static int32 ReadLines(const uint8 *Data, int32 Size, IQueryResultSink &Sink, int32 &OutSkipped);
+};
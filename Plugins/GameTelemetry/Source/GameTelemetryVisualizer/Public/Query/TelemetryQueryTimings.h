@@ -0,0 +1,83 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//--------------------------------------------------------------------------------------
+// TelemetryQueryTimings.h
+//
+// Where the time of each query went
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Query/TelemetryQuery.h"
+
+//Milliseconds one query spent in each phase, from sending it to drawing its events.
+//Pages of a query are read on several threads at once, so the phases are summed over pages and can add up to more
+//than Total, which is the time the user waited.
+struct FQueryTimingRecord
+{
+    FDateTime Started;
+
+    //Serialized query, or the path of an imported file
+    FString Query;
+
+    //Where the events came from: server, cache, local or file
+    FString Source;
+
+    int32 Pages = 0;
+    int32 Events = 0;
+    bool Success = true;
+
+    //Time the server reported for running the query
+    double Server = 0;
+
+    //Time to the first byte of the first page
+    double FirstByte = 0;
+
+    //Time receiving pages, plus the wait for each page after the first
+    double Download = 0;
+
+    //Reading responses, not counting grouping
+    double Parse = 0;
+
+    //Grouping events by name, on worker threads and when merging pages
+    double Group = 0;
+
+    //Filtering events locally and updating the event lists
+    double Filter = 0;
+
+    //Spawning actors for the events
+    double Draw = 0;
+
+    double Total = 0;
+
+    //Adds a page that reached the handler.  GroupTime is the part of its read spent grouping
+    void AddPage(const SQueryResult &Page, double GroupTime);
+
+    //One line summary, as logged and shown in the status text
+    FString ToString() const;
+};
+
+//Rolling history of the most recent queries, kept for the session so it can be exported to compare datasets
+class FQueryTimingHistory
+{
+public:
+    static FQueryTimingHistory &Get();
+
+    //Logs the record under LogTelemetryQueryTiming and keeps it, dropping the oldest beyond MaxRecords
+    void Add(const FQueryTimingRecord &Record);
+
+    const TArray<FQueryTimingRecord> &GetRecords() const { return Records; }
+
+    //Writes every record as a row of comma separated values
+    bool ExportCsv(const FString &Path) const;
+
+    static const int32 MaxRecords = 200;
+
+private:
+    //Oldest first
+    TArray<FQueryTimingRecord> Records;
+};
@@ -0,0 +1,27 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//--------------------------------------------------------------------------------------
+// TelemetryQueryTransport.h
+//
+// Interface for answering queries without an http request
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+//Answers the queries of an FQueryExecutor in process, for the urls it handles.  Registered with
+//FQueryExecutor::RegisterTransport, e.g. the local server for "local://" urls
+class IQueryTransport
+{
+public:
+    virtual ~IQueryTransport() {}
+
+    virtual bool HandlesUrl(const FString &Url) const = 0;
+
+    //Returns the response body of one page, the same as the service would send.  Called on a worker thread
+    virtual TArray<uint8> HandleQuery(const FString &QueryText, int32 TakeLimit, const FString &ContinuationToken, const FString &Columns, bool AsColumns) = 0;
+};
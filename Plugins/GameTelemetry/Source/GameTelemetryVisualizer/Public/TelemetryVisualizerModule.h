@@ -14,6 +14,9 @@
 
 DECLARE_LOG_CATEGORY_EXTERN(LogTelemetryVisualizer, Log, All);
 
+//Phase timings of each query the data viewer runs
+DECLARE_LOG_CATEGORY_EXTERN(LogTelemetryQueryTiming, Log, All);
+
 class ITelemetryEngine;
 class FTelemetryVisualizerUI;
 